@@ -0,0 +1,225 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/bus.h>
+#include <core/dbus/message.h>
+#include <core/dbus/object.h>
+#include <core/dbus/server.h>
+#include <core/dbus/service.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+// Counts all allocations done via operator new, in all threads.
+std::atomic<std::uint64_t> allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+struct BenchmarkService
+{
+    struct MethodInt64
+    {
+        typedef BenchmarkService Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s
+            {
+                "MethodInt64"
+            };
+            return s;
+        }
+
+        inline static std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::milliseconds{5000};
+        }
+    };
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace traits
+{
+template<>
+struct Service<BenchmarkService>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s
+        {
+            "org.freedesktop.dbus.benchmark.Allocations"
+        };
+        return s;
+    }
+};
+}
+}
+}
+
+namespace
+{
+const dbus::types::ObjectPath& the_path()
+{
+    static const dbus::types::ObjectPath path{"/core/dbus/benchmark/Allocations"};
+    return path;
+}
+
+// Reports the mean time and the mean number of allocations it takes to run f once.
+void measure(const std::string& name, unsigned int iterations, const std::function<void(std::int64_t)>& f)
+{
+    // Warms up caches and free lists.
+    for (unsigned int i = 0; i < 100; i++)
+        f(i);
+
+    auto allocations_before = allocations.load();
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++)
+        f(i);
+
+    auto after = std::chrono::steady_clock::now();
+    auto allocations_after = allocations.load();
+
+    std::cout << name << "(" << iterations << ") -> "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / double(iterations)
+              << " [ns/round trip], "
+              << (allocations_after - allocations_before) / double(iterations)
+              << " [allocations/round trip]" << std::endl;
+}
+}
+
+// Measures time and heap allocations of the method_int64 round trip, once for the messages
+// alone and once on a direct connection between a client and a service in this process.
+//
+// Usage: allocations [number of round trips per measurement, defaults to 100000]
+int main(int argc, char** argv)
+{
+    const unsigned int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    measure("Messages", iterations, [](std::int64_t value)
+    {
+        auto call = dbus::Message::make_method_call(
+                    dbus::traits::Service<BenchmarkService>::interface_name(),
+                    the_path(),
+                    dbus::traits::Service<BenchmarkService>::interface_name(),
+                    BenchmarkService::MethodInt64::name());
+        call->writer() << value;
+        // Stands in for sending the call, replies require a serial.
+        call->ensure_serial_larger_than_zero_for_testing();
+
+        std::int64_t argument;
+        call->reader() >> argument;
+
+        auto reply = dbus::Message::make_method_return(call);
+        reply->writer() << argument;
+
+        std::int64_t result;
+        reply->reader() >> result;
+    });
+
+    std::mutex guard;
+    std::vector<dbus::Bus::Ptr> peers;
+    std::vector<dbus::Object::Ptr> skeletons;
+    std::vector<std::thread> workers;
+
+    auto server = std::make_shared<dbus::Server>();
+    server->on_new_connection([&](const dbus::Bus::Ptr& bus)
+    {
+        auto service = dbus::Service::add_service<BenchmarkService>(bus);
+        auto skeleton = service->add_object_for_path(the_path());
+        skeleton->install_method_handler<BenchmarkService::MethodInt64>([bus](const dbus::Message::Ptr& msg)
+        {
+            std::int64_t value;
+            msg->reader() >> value;
+
+            auto reply = dbus::Message::make_method_return(msg);
+            reply->writer() << value;
+            bus->send(reply);
+        });
+
+        bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+
+        std::lock_guard<std::mutex> lg(guard);
+        workers.emplace_back([bus]() { bus->run(); });
+        peers.push_back(bus);
+        skeletons.push_back(skeleton);
+    });
+    std::thread server_worker{[server]() { server->run(); }};
+
+    auto bus = dbus::Bus::connect_to_peer(server->address());
+    bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+    std::thread worker{[bus]() { bus->run(); }};
+
+    auto stub = dbus::Service::use_service<BenchmarkService>(bus)->object_for_path(the_path());
+
+    measure("PeerToPeer", iterations / 10, [stub](std::int64_t value)
+    {
+        stub->invoke_method_synchronously<BenchmarkService::MethodInt64, std::int64_t>(value);
+    });
+
+    bus->stop();
+    worker.join();
+
+    server->stop();
+    server_worker.join();
+
+    std::lock_guard<std::mutex> lg(guard);
+    for (const auto& peer : peers)
+        peer->stop();
+    for (auto& w : workers)
+        w.join();
+
+    return EXIT_SUCCESS;
+}
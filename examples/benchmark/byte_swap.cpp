@@ -0,0 +1,112 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/byte_swap.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace native = core::dbus::native;
+namespace validation = core::dbus::validation;
+
+namespace
+{
+const char* name_of(validation::Isa isa)
+{
+    switch (isa)
+    {
+    case validation::Isa::scalar: return "scalar";
+    case validation::Isa::sse2: return "sse2";
+    case validation::Isa::avx2: return "avx2";
+    }
+
+    return "unknown";
+}
+
+// Reports the mean time and throughput of swapping all of data with f.
+void measure(const std::string& name, unsigned int iterations, std::vector<std::uint8_t>& data, const std::function<void(std::vector<std::uint8_t>&)>& f)
+{
+    for (unsigned int i = 0; i < 100; i++)
+        f(data);
+
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++)
+        f(data);
+
+    auto after = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / double(iterations);
+
+    std::cout << "  " << name << " -> " << ns << " [ns], " << data.size() / ns << " [bytes/ns]" << std::endl;
+}
+
+// Swaps one value at a time, as libdbus does when converting a message to host byte order.
+template<typename T>
+__attribute__((noinline)) void swap_each(std::vector<std::uint8_t>& data)
+{
+    auto values = reinterpret_cast<T*>(data.data());
+    for (std::size_t i = 0; i < data.size() / sizeof(T); i++)
+        values[i] = native::swapped_byte_order(values[i]);
+}
+
+template<typename T>
+void compare(unsigned int iterations, std::size_t count)
+{
+    std::cout << count << " values of " << sizeof(T) << " bytes" << std::endl;
+
+    std::vector<std::uint8_t> data(count * sizeof(T));
+    for (std::size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<std::uint8_t>(i);
+
+    measure("per value", iterations, data, swap_each<T>);
+
+    for (auto isa : {validation::Isa::scalar, validation::Isa::sse2, validation::Isa::avx2})
+    {
+        if (!validation::is_supported(isa))
+            continue;
+
+        measure(name_of(isa), iterations, data, [isa](std::vector<std::uint8_t>& d)
+        {
+            native::swap_byte_order(isa, d.data(), d.size() / sizeof(T), sizeof(T));
+        });
+    }
+}
+}
+
+// Compares converting fixed-size arrays of opposite byte order one value at a time
+// to all bulk implementations supported by the CPU.
+//
+// Usage: byte_swap [number of swaps per measurement, defaults to 100000]
+int main(int argc, char** argv)
+{
+    const unsigned int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    for (std::size_t count : {16, 4096})
+    {
+        compare<std::uint16_t>(iterations, count);
+        compare<std::uint32_t>(iterations, count);
+        compare<std::uint64_t>(iterations, count);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#include <core/dbus/bus.h>
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+
+#include <core/dbus/types/object_path.h>
+
+#include <dbus/dbus.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+// Emits signals from thread_count threads at once, nobody listens to them.
+std::chrono::microseconds send_concurrently(
+        const dbus::Bus::Ptr& bus,
+        unsigned int thread_count,
+        unsigned int signals_per_thread)
+{
+    std::vector<std::thread> senders;
+
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < thread_count; i++)
+    {
+        senders.emplace_back([bus, i, signals_per_thread]()
+        {
+            for (unsigned int j = 0; j < signals_per_thread; j++)
+            {
+                auto signal = dbus::Message::make_signal(
+                            "/core/dbus/benchmark/Sender",
+                            "org.freedesktop.dbus.benchmark.Sender",
+                            "Tick");
+                auto writer = signal->writer();
+                dbus::encode_argument(writer, std::uint32_t{i});
+                dbus::encode_argument(writer, std::uint32_t{j});
+                bus->send(signal);
+            }
+        });
+    }
+
+    for (auto& sender : senders)
+        sender.join();
+
+    // libdbus might still hold queued messages, native buses write before send returns.
+    if (bus->raw())
+        dbus_connection_flush(bus->raw());
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - before);
+}
+
+void report(const std::string& backend, unsigned int thread_count, unsigned int signals_per_thread, const std::chrono::microseconds& elapsed)
+{
+    const double total = double(thread_count) * signals_per_thread;
+
+    std::cout << "ConcurrentSend(" << backend << ", " << thread_count << " threads) -> "
+              << "Total: " << elapsed.count() / 1000 << " [ms], "
+              << "Throughput: " << static_cast<std::uint64_t>(total / (elapsed.count() / 1e6)) << " [signals/s], "
+              << "Per signal: " << elapsed.count() / total << " [µs]" << std::endl;
+}
+}
+
+// Compares the throughput of Bus::send from several threads on a bus
+// connected through libdbus and on a natively connected bus.
+//
+// Usage: concurrent_send [number of threads, defaults to 4] [signals per thread, defaults to 50000]
+int main(int argc, char** argv)
+{
+    const unsigned int thread_count = argc > 1 ? std::atoi(argv[1]) : 4;
+    const unsigned int signals_per_thread = argc > 2 ? std::atoi(argv[2]) : 50000;
+
+    auto libdbus_bus = std::make_shared<dbus::Bus>(dbus::WellKnownBus::session);
+    report("libdbus", thread_count, signals_per_thread, send_concurrently(libdbus_bus, thread_count, signals_per_thread));
+
+    auto native_bus = dbus::Bus::connect_natively(dbus::WellKnownBus::session);
+    report("native", thread_count, signals_per_thread, send_concurrently(native_bus, thread_count, signals_per_thread));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+#include <core/dbus/native/codec.h>
+
+#include <core/dbus/types/array_range.h>
+#include <core/dbus/types/object_path.h>
+#include <core/dbus/types/struct.h>
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/unordered_map.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace dbus = core::dbus;
+
+namespace benchmark
+{
+// Plain struct equivalent to Entry below, encoded and decoded without a tuple in between.
+struct Record
+{
+    std::int32_t id;
+    dbus::types::ObjectPath path;
+    double weight;
+};
+}
+
+DBUS_CPP_STRUCT_DEF(benchmark::Record, id, path, weight)
+
+namespace
+{
+typedef dbus::types::Struct<std::tuple<std::int32_t, dbus::types::ObjectPath, double>> Entry;
+typedef std::map<std::string, Entry> Dictionary;
+
+dbus::Message::Ptr a_signal()
+{
+    return dbus::Message::make_signal("/core/dbus/benchmark", "core.dbus.benchmark", "Marshalling");
+}
+
+// Reports the mean time in microseconds it takes to process one message with f.
+template<typename Payload, typename Result>
+void measure(const std::string& name, unsigned int iterations, const Payload& payload, const std::function<Result(const Payload&)>& f)
+{
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++)
+        f(payload);
+
+    auto after = std::chrono::steady_clock::now();
+
+    std::cout << name << " -> "
+              << std::chrono::duration_cast<std::chrono::microseconds>(after - before).count() / double(iterations)
+              << " [µs/message]" << std::endl;
+}
+
+template<typename Payload>
+void compare(const std::string& name, unsigned int iterations, const Payload& payload)
+{
+    measure<Payload, dbus::Message::Ptr>(name + " encode (libdbus)", iterations, payload, [](const Payload& p)
+    {
+        auto msg = a_signal();
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, p);
+        return msg;
+    });
+
+    measure<Payload, dbus::Message::Ptr>(name + " encode (native)", iterations, payload, [](const Payload& p)
+    {
+        return dbus::native::make_message(a_signal(), p);
+    });
+
+    auto msg = dbus::native::make_message(a_signal(), payload);
+
+    measure<dbus::Message::Ptr, Payload>(name + " decode (libdbus)", iterations, msg, [](const dbus::Message::Ptr& m)
+    {
+        Payload p;
+        auto reader = m->reader();
+        dbus::decode_argument(reader, p);
+        return p;
+    });
+
+    measure<dbus::Message::Ptr, Payload>(name + " decode (native)", iterations, msg, [](const dbus::Message::Ptr& m)
+    {
+        Payload p;
+        dbus::native::decode_message(dbus::native::Body::from_message(m), p);
+        return p;
+    });
+}
+}
+
+// Compares encoding and decoding messages via libdbus' iterators to doing so natively.
+//
+// Usage: marshalling [number of elements per message, defaults to 1000]
+int main(int argc, char** argv)
+{
+    const unsigned int element_count = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const unsigned int iterations = 1000;
+
+    std::vector<double> doubles;
+    std::vector<std::string> strings;
+    Dictionary dictionary;
+
+    for (unsigned int i = 0; i < element_count; i++)
+    {
+        auto key = "element" + std::to_string(i);
+
+        doubles.push_back(i);
+        strings.push_back(key);
+        dictionary[key] = Entry{std::make_tuple(i, dbus::types::ObjectPath{"/core/dbus/benchmark/" + key}, i * .5)};
+    }
+
+    compare("ad", iterations, doubles);
+    compare("as", iterations, strings);
+    compare("a{s(iod)}", iterations, dictionary);
+
+    // Writes straight from a container without a codec of its own, no intermediate std::vector.
+    std::list<std::string> list{strings.begin(), strings.end()};
+    measure<std::list<std::string>, dbus::Message::Ptr>("as encode (range)", iterations, list, [](const std::list<std::string>& l)
+    {
+        auto msg = a_signal();
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, dbus::types::make_array_range(l));
+        return msg;
+    });
+
+    // Registered structs instead of tuples.
+    typedef std::map<std::string, benchmark::Record> Records;
+    Records records;
+    for (const auto& pair : dictionary)
+        records[pair.first] = benchmark::Record{std::get<0>(pair.second.value), std::get<1>(pair.second.value), std::get<2>(pair.second.value)};
+
+    measure<Records, dbus::Message::Ptr>("a{s(iod)} encode (registered struct)", iterations, records, [](const Records& r)
+    {
+        auto msg = a_signal();
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, r);
+        return msg;
+    });
+
+    auto records_msg = a_signal();
+    {
+        auto writer = records_msg->writer();
+        dbus::encode_argument(writer, records);
+    }
+    measure<dbus::Message::Ptr, Records>("a{s(iod)} decode (registered struct)", iterations, records_msg, [](const dbus::Message::Ptr& m)
+    {
+        Records r;
+        auto reader = m->reader();
+        dbus::decode_argument(reader, r);
+        return r;
+    });
+
+    // Sends and receives lookup tables as they are, without a std::map in between.
+    typedef std::unordered_map<std::string, Entry> Table;
+    Table table{dictionary.begin(), dictionary.end()};
+    measure<Table, dbus::Message::Ptr>("a{s(iod)} encode (unordered_map)", iterations, table, [](const Table& t)
+    {
+        auto msg = a_signal();
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, t);
+        return msg;
+    });
+
+    auto msg = a_signal();
+    {
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, table);
+    }
+    measure<dbus::Message::Ptr, Table>("a{s(iod)} decode (unordered_map)", iterations, msg, [](const dbus::Message::Ptr& m)
+    {
+        Table t;
+        auto reader = m->reader();
+        dbus::decode_argument(reader, t);
+        return t;
+    });
+
+    return EXIT_SUCCESS;
+}
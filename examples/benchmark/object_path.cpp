@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/types/object_path.h>
+#include <core/dbus/validation.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace types = core::dbus::types;
+
+namespace
+{
+// Reports the mean time per operation of f, which performs count operations per invocation.
+void measure(const std::string& name, unsigned int iterations, std::size_t count, const std::function<std::size_t()>& f)
+{
+    // Keeps the compiler from discarding the results.
+    volatile std::size_t sink = 0;
+
+    for (unsigned int i = 0; i < 10; i++)
+        sink = f();
+
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++)
+        sink = f();
+
+    auto after = std::chrono::steady_clock::now();
+
+    std::cout << "  " << name << " -> "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / double(iterations * count)
+              << " [ns/operation]" << (sink ? "" : " ") << std::endl;
+}
+
+// Paths of the objects exported by a typical service, e.g., ModemManager or UDisks.
+std::vector<std::string> object_paths(std::size_t count)
+{
+    std::vector<std::string> result;
+    for (std::size_t i = 0; i < count; i++)
+        result.push_back("/org/freedesktop/UDisks2/block_devices/device_" + std::to_string(i % 16) + "/partition_" + std::to_string(i));
+
+    return result;
+}
+}
+
+// Compares routing, hashing and namespace checks of interned object paths to plain strings,
+// as done by the signal router and the caches of signals and properties for every message.
+//
+// Usage: object_path [number of passes per measurement, defaults to 1000]
+int main(int argc, char** argv)
+{
+    const unsigned int iterations = argc > 1 ? std::atoi(argv[1]) : 1000;
+    const std::size_t count = 1000;
+
+    const auto strings = object_paths(count);
+    // Distinct strings with equal contents, as created for every incoming message.
+    const auto incoming_strings = object_paths(count);
+
+    std::vector<types::ObjectPath> paths, incoming_paths;
+    for (const auto& s : strings)
+        paths.emplace_back(s);
+    for (const auto& s : incoming_strings)
+        incoming_paths.emplace_back(s);
+
+    std::unordered_map<std::string, std::size_t> string_routes;
+    std::unordered_map<types::ObjectPath, std::size_t> path_routes;
+    for (std::size_t i = 0; i < count; i++)
+    {
+        string_routes[strings[i]] = i;
+        path_routes[paths[i]] = i;
+    }
+
+    std::cout << "creating from a string" << std::endl;
+    measure("std::string", iterations, count, [&incoming_strings]()
+    {
+        std::size_t n = 0;
+        for (const auto& s : incoming_strings)
+            n += std::string(s).size();
+        return n;
+    });
+    measure("std::string, validated", iterations, count, [&incoming_strings]()
+    {
+        std::size_t n = 0;
+        for (const auto& s : incoming_strings)
+            n += core::dbus::validation::is_valid_object_path(s) ? std::string(s).size() : 0;
+        return n;
+    });
+    measure("ObjectPath", iterations, count, [&incoming_strings]()
+    {
+        std::size_t n = 0;
+        for (const auto& s : incoming_strings)
+            n += types::ObjectPath(s).depth();
+        return n;
+    });
+
+    std::cout << "comparing for equality" << std::endl;
+    measure("std::string", iterations, count, [&strings, &incoming_strings]()
+    {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < strings.size(); i++)
+            n += strings[i] == incoming_strings[i];
+        return n;
+    });
+    measure("ObjectPath", iterations, count, [&paths, &incoming_paths]()
+    {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < paths.size(); i++)
+            n += paths[i] == incoming_paths[i];
+        return n;
+    });
+
+    std::cout << "routing" << std::endl;
+    measure("std::string", iterations, count, [&string_routes, &incoming_strings]()
+    {
+        std::size_t n = 0;
+        for (const auto& s : incoming_strings)
+            n += string_routes.find(s)->second;
+        return n;
+    });
+    measure("ObjectPath", iterations, count, [&path_routes, &incoming_paths]()
+    {
+        std::size_t n = 0;
+        for (const auto& p : incoming_paths)
+            n += path_routes.find(p)->second;
+        return n;
+    });
+
+    std::cout << "checking for a namespace" << std::endl;
+    const std::string string_ns{"/org/freedesktop/UDisks2/block_devices"};
+    const types::ObjectPath path_ns{string_ns};
+    measure("std::string", iterations, count, [&incoming_strings, &string_ns]()
+    {
+        std::size_t n = 0;
+        for (const auto& s : incoming_strings)
+            n += s.compare(0, string_ns.size(), string_ns) == 0 && (s.size() == string_ns.size() || s[string_ns.size()] == '/');
+        return n;
+    });
+    measure("ObjectPath", iterations, count, [&incoming_paths, &path_ns]()
+    {
+        std::size_t n = 0;
+        for (const auto& p : incoming_paths)
+            n += p.is_in_namespace(path_ns);
+        return n;
+    });
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/bus.h>
+#include <core/dbus/object.h>
+#include <core/dbus/server.h>
+#include <core/dbus/service.h>
+
+#include <core/dbus/interfaces/peer_to_peer.h>
+
+#include <boost/accumulators/accumulators.hpp>
+#include <boost/accumulators/statistics/max.hpp>
+#include <boost/accumulators/statistics/mean.hpp>
+#include <boost/accumulators/statistics/stats.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace acc = boost::accumulators;
+namespace dbus = core::dbus;
+
+namespace
+{
+struct EchoService
+{
+    struct Echo
+    {
+        typedef EchoService Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s
+            {
+                "Echo"
+            };
+            return s;
+        }
+
+        inline static std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::milliseconds{5000};
+        }
+    };
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace traits
+{
+template<>
+struct Service<EchoService>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s
+        {
+            "org.freedesktop.dbus.benchmark.EchoService"
+        };
+        return s;
+    }
+};
+}
+}
+}
+
+namespace
+{
+const dbus::types::ObjectPath& echo_path()
+{
+    static const dbus::types::ObjectPath path{"/core/dbus/benchmark/EchoService"};
+    return path;
+}
+
+// Client and service live in the same process, every bus gets its own io_service.
+void run_in_background(const dbus::Bus::Ptr& bus, std::vector<std::thread>& workers)
+{
+    bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+    workers.emplace_back([bus]() { bus->run(); });
+}
+
+dbus::Object::Ptr expose_echo(const dbus::Bus::Ptr& bus)
+{
+    auto service = dbus::Service::add_service(bus, dbus::traits::Service<EchoService>::interface_name());
+    auto skeleton = service->add_object_for_path(echo_path());
+    skeleton->install_method_handler<EchoService::Echo>([bus](const dbus::Message::Ptr& msg)
+    {
+        std::int64_t value;
+        msg->reader() >> value;
+
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << value;
+        bus->send(reply);
+    });
+    return skeleton;
+}
+
+void measure(const std::string& transport, const dbus::Object::Ptr& stub, unsigned int call_count)
+{
+    acc::accumulator_set<double, acc::stats<acc::tag::mean, acc::tag::max>> latency;
+
+    for (unsigned int i = 0; i < call_count; i++)
+    {
+        auto before = std::chrono::steady_clock::now();
+        stub->invoke_method_synchronously<EchoService::Echo, std::int64_t>(std::int64_t(i));
+        auto after = std::chrono::steady_clock::now();
+
+        latency(std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / 1000.);
+    }
+
+    std::mutex guard;
+    std::condition_variable all_done;
+    unsigned int completed = 0;
+
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < call_count; i++)
+    {
+        stub->invoke_method_asynchronously_with_callback<EchoService::Echo, std::int64_t>(
+                    [&](const dbus::Result<std::int64_t>&)
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            if (++completed == call_count)
+                all_done.notify_all();
+        }, std::int64_t(i));
+    }
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        all_done.wait_for(ul, std::chrono::seconds{60}, [&]() { return completed == call_count; });
+    }
+
+    auto after = std::chrono::steady_clock::now();
+    auto seconds = std::chrono::duration_cast<std::chrono::duration<double>>(after - before).count();
+
+    std::cout << transport << "(" << call_count << ") -> "
+              << "Latency mean: " << acc::mean(latency) << " [µs], max: " << acc::max(latency) << " [µs], "
+              << "Throughput: " << completed / seconds << " [calls/s]" << std::endl;
+}
+}
+
+// Compares method calls routed through the session bus daemon with calls
+// on a direct connection to the service, negotiated over the session bus.
+//
+// Usage: peer_to_peer [number of calls per measurement, defaults to 10000]
+int main(int argc, char** argv)
+{
+    const unsigned int call_count = argc > 1 ? std::atoi(argv[1]) : 10000;
+
+    std::vector<std::thread> workers;
+
+    // Accepted connections are only touched by the server thread until it has been joined.
+    std::vector<std::thread> peer_workers;
+    std::vector<dbus::Bus::Ptr> peers;
+    std::vector<dbus::Object::Ptr> peer_skeletons;
+
+    auto server = std::make_shared<dbus::Server>();
+    server->on_new_connection([&](const dbus::Bus::Ptr& bus)
+    {
+        peer_skeletons.push_back(expose_echo(bus));
+        run_in_background(bus, peer_workers);
+        peers.push_back(bus);
+    });
+    std::thread server_worker{[server]() { server->run(); }};
+
+    auto service_bus = std::make_shared<dbus::Bus>(dbus::WellKnownBus::session);
+    auto skeleton = expose_echo(service_bus);
+    dbus::interfaces::PeerToPeer::announce(service_bus, skeleton, server);
+    run_in_background(service_bus, workers);
+
+    auto client_bus = std::make_shared<dbus::Bus>(dbus::WellKnownBus::session);
+    run_in_background(client_bus, workers);
+
+    auto stub = dbus::Service::use_service<EchoService>(client_bus)->object_for_path(echo_path());
+    measure("Daemon", stub, call_count);
+
+    auto peer_bus = dbus::Bus::connect_to_peer(
+                dbus::interfaces::PeerToPeer::query(
+                    dbus::Service::use_service(
+                        client_bus,
+                        dbus::traits::Service<EchoService>::interface_name())->object_for_path(echo_path())));
+    run_in_background(peer_bus, workers);
+
+    auto peer_stub = dbus::Service::use_service<EchoService>(peer_bus)->object_for_path(echo_path());
+    measure("PeerToPeer", peer_stub, call_count);
+
+    server->stop();
+    server_worker.join();
+
+    peer_bus->stop();
+    client_bus->stop();
+    service_bus->stop();
+
+    for (const auto& bus : peers)
+        bus->stop();
+
+    for (auto& worker : workers)
+        worker.join();
+    for (auto& worker : peer_workers)
+        worker.join();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/bus.h>
+#include <core/dbus/object.h>
+#include <core/dbus/service.h>
+
+#include <boost/accumulators/accumulators.hpp>
+#include <boost/accumulators/statistics/max.hpp>
+#include <boost/accumulators/statistics/mean.hpp>
+#include <boost/accumulators/statistics/stats.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace acc = boost::accumulators;
+namespace dbus = core::dbus;
+
+namespace
+{
+// A service that never answers, such that every call to it is
+// resolved by the timeout of the respective pending call.
+struct SilentService
+{
+    struct Ignore
+    {
+        typedef SilentService Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s
+            {
+                "Ignore"
+            };
+            return s;
+        }
+
+        inline static std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::milliseconds{1000};
+        }
+    };
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace traits
+{
+template<>
+struct Service<SilentService>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s
+        {
+            "org.freedesktop.dbus.benchmark.SilentService"
+        };
+        return s;
+    }
+};
+}
+}
+}
+
+// Measures the cost of keeping a large number of pending calls in flight, i.e.,
+// of adding, removing and expiring libdbus timeouts.
+//
+// Usage: pending_calls [number of outstanding calls, defaults to 10000]
+int main(int argc, char** argv)
+{
+    const unsigned int call_count = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const auto timeout = SilentService::Ignore::default_timeout();
+
+    auto service_bus = std::make_shared<dbus::Bus>(dbus::WellKnownBus::session);
+    service_bus->install_executor(dbus::asio::make_executor(service_bus));
+    auto service = dbus::Service::add_service<SilentService>(service_bus);
+    auto skeleton = service->add_object_for_path(dbus::types::ObjectPath("/core/dbus/benchmark/SilentService"));
+    skeleton->install_method_handler<SilentService::Ignore>([](const dbus::Message::Ptr&) {});
+    std::thread service_worker{[service_bus]() { service_bus->run(); }};
+
+    auto client_bus = std::make_shared<dbus::Bus>(dbus::WellKnownBus::session);
+    client_bus->install_executor(dbus::asio::make_executor(client_bus));
+    std::thread client_worker{[client_bus]() { client_bus->run(); }};
+
+    auto stub = dbus::Service::use_service<SilentService>(client_bus)
+            ->object_for_path(dbus::types::ObjectPath("/core/dbus/benchmark/SilentService"));
+
+    std::mutex guard;
+    std::condition_variable all_done;
+    unsigned int completed = 0;
+    acc::accumulator_set<double, acc::stats<acc::tag::mean, acc::tag::max>> lateness;
+
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < call_count; i++)
+    {
+        auto issued_at = std::chrono::steady_clock::now();
+        stub->invoke_method_asynchronously_with_callback<SilentService::Ignore, void>(
+                    [&, issued_at](const dbus::Result<void>&)
+        {
+            auto late = std::chrono::steady_clock::now() - (issued_at + timeout);
+
+            std::lock_guard<std::mutex> lg(guard);
+            lateness(std::chrono::duration_cast<std::chrono::microseconds>(late).count());
+            if (++completed == call_count)
+                all_done.notify_all();
+        });
+    }
+
+    auto issued = std::chrono::steady_clock::now();
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        all_done.wait_for(ul, timeout + std::chrono::seconds{30}, [&]() { return completed == call_count; });
+    }
+
+    auto finished = std::chrono::steady_clock::now();
+
+    std::cout << "PendingCalls(" << call_count << ") -> "
+              << "Issue: " << std::chrono::duration_cast<std::chrono::microseconds>(issued - before).count() / double(call_count) << " [µs/call], "
+              << "Total: " << std::chrono::duration_cast<std::chrono::milliseconds>(finished - before).count() << " [ms], "
+              << "Timed out: " << completed << ", "
+              << "Lateness mean: " << acc::mean(lateness) << " [µs], max: " << acc::max(lateness) << " [µs]" << std::endl;
+
+    client_bus->stop();
+    service_bus->stop();
+
+    if (client_worker.joinable())
+        client_worker.join();
+    if (service_worker.joinable())
+        service_worker.join();
+
+    return completed == call_count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
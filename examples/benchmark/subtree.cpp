@@ -0,0 +1,231 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/bus.h>
+#include <core/dbus/object.h>
+#include <core/dbus/server.h>
+#include <core/dbus/service.h>
+
+#include <malloc.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+struct Device
+{
+    struct Ping
+    {
+        typedef Device Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s
+            {
+                "Ping"
+            };
+            return s;
+        }
+
+        inline static std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::milliseconds{5000};
+        }
+    };
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace traits
+{
+template<>
+struct Service<Device>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s
+        {
+            "org.freedesktop.dbus.benchmark.Device"
+        };
+        return s;
+    }
+};
+}
+}
+}
+
+namespace
+{
+const std::string& prefix()
+{
+    static const std::string s{"/core/dbus/benchmark/devices"};
+    return s;
+}
+
+dbus::types::ObjectPath device_path(std::size_t i)
+{
+    return dbus::types::ObjectPath{prefix() + "/device_" + std::to_string(i)};
+}
+
+// Bytes currently allocated via malloc, covering both libdbus and dbus-cpp.
+std::size_t allocated_bytes()
+{
+    return mallinfo2().uordblks;
+}
+
+void install_ping(const dbus::Bus::Ptr& bus, const dbus::Object::Ptr& object)
+{
+    object->install_method_handler<Device::Ping>([bus](const dbus::Message::Ptr& msg)
+    {
+        bus->send(dbus::Message::make_method_return(msg));
+    });
+}
+
+// Reports time and memory taken by setup, and the mean latency of calls to the registered objects.
+void measure(const std::string& name,
+             const dbus::Service::Ptr& client,
+             std::size_t object_count,
+             unsigned int call_count,
+             const std::function<void()>& setup,
+             const std::function<void()>& teardown)
+{
+    auto bytes_before = allocated_bytes();
+    auto before = std::chrono::steady_clock::now();
+
+    setup();
+
+    auto after = std::chrono::steady_clock::now();
+    auto bytes_after = allocated_bytes();
+
+    std::cout << name << "(" << object_count << ") -> "
+              << "Registration: " << std::chrono::duration_cast<std::chrono::milliseconds>(after - before).count() << " [ms], "
+              << (bytes_after - bytes_before) / (1024. * 1024.) << " [MiB]";
+
+    before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < call_count; i++)
+        client->object_for_path(device_path((i * 7919) % object_count))->invoke_method_synchronously<Device::Ping, void>();
+
+    after = std::chrono::steady_clock::now();
+
+    std::cout << ", Latency mean: "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / (1000. * call_count) << " [µs]";
+
+    before = std::chrono::steady_clock::now();
+
+    teardown();
+
+    after = std::chrono::steady_clock::now();
+
+    std::cout << ", Teardown: " << std::chrono::duration_cast<std::chrono::milliseconds>(after - before).count() << " [ms]" << std::endl;
+}
+}
+
+// Compares registering every object of a large tree with the bus to registering
+// a single subtree that resolves objects on demand, on a peer-to-peer connection.
+//
+// Usage: subtree [number of objects, defaults to 100000] [number of calls, defaults to 1000]
+int main(int argc, char** argv)
+{
+    const std::size_t object_count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    const unsigned int call_count = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    std::mutex guard;
+    std::condition_variable accepted;
+    dbus::Bus::Ptr service_bus;
+
+    auto server = std::make_shared<dbus::Server>();
+    server->on_new_connection([&](const dbus::Bus::Ptr& bus)
+    {
+        bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+
+        std::lock_guard<std::mutex> lg(guard);
+        service_bus = bus;
+        accepted.notify_all();
+    });
+    std::thread server_worker{[server]() { server->run(); }};
+
+    auto client_bus = dbus::Bus::connect_to_peer(server->address());
+    client_bus->install_executor(dbus::asio::make_executor(client_bus, dbus::asio::ExecutorOptions{}));
+    std::thread client_worker{[client_bus]() { client_bus->run(); }};
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        accepted.wait(ul, [&]() { return service_bus != nullptr; });
+    }
+
+    std::thread service_worker{[service_bus]() { service_bus->run(); }};
+
+    auto service = dbus::Service::add_service(service_bus, dbus::traits::Service<Device>::interface_name());
+    auto client = dbus::Service::use_service<Device>(client_bus);
+
+    std::vector<dbus::Object::Ptr> objects;
+    measure("Objects", client, object_count, call_count, [&]()
+    {
+        for (std::size_t i = 0; i < object_count; i++)
+        {
+            objects.push_back(service->add_object_for_path(device_path(i)));
+            install_ping(service_bus, objects.back());
+        }
+    }, [&]()
+    {
+        objects.clear();
+    });
+
+    // A single object serves all devices, the resolver only checks for existence.
+    dbus::Object::Ptr subtree, device;
+    measure("Subtree", client, object_count, call_count, [&]()
+    {
+        device = service->object_for_path(dbus::types::ObjectPath{prefix()});
+        install_ping(service_bus, device);
+
+        const dbus::types::ObjectPath root{prefix()};
+        subtree = service->add_subtree(root, [root, device](const dbus::types::ObjectPath& path)
+        {
+            return path.parent() == root ? device : dbus::Object::Ptr{};
+        });
+    }, [&]()
+    {
+        subtree.reset();
+        device.reset();
+    });
+
+    server->stop();
+    server_worker.join();
+
+    client_bus->stop();
+    client_worker.join();
+    service_bus->stop();
+    service_worker.join();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+#include <core/dbus/message_streaming_operators.h>
+
+#include <core/dbus/types/variant.h>
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+// Reports the mean time it takes to decode the single argument of msg to a T, checking
+// every value, and trusting the signature of the message.
+template<typename T>
+void compare(const std::string& name, unsigned int iterations, const dbus::Message::Ptr& msg)
+{
+    auto measure = [iterations, &msg](const std::function<void(dbus::Message::Reader&, T&)>& f)
+    {
+        // Warms up caches and free lists.
+        for (unsigned int i = 0; i < 100; i++)
+        {
+            T t; auto reader = msg->reader(); f(reader, t);
+        }
+
+        auto before = std::chrono::steady_clock::now();
+
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            T t; auto reader = msg->reader(); f(reader, t);
+        }
+
+        auto after = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / double(iterations);
+    };
+
+    auto checked = measure([](dbus::Message::Reader& reader, T& t)
+    {
+        dbus::Codec<T>::decode_argument(reader, t);
+    });
+
+    auto trusted = measure([](dbus::Message::Reader& reader, T& t)
+    {
+        reader >> t;
+    });
+
+    std::cout << name << " -> checked: " << checked << " [ns/message], trusted: " << trusted << " [ns/message]" << std::endl;
+}
+
+dbus::Message::Ptr a_message()
+{
+    return dbus::Message::make_signal("/core/dbus/benchmark", "core.dbus.benchmark", "TrustedDecode");
+}
+}
+
+// Compares decoding arguments with per-value type checks to decoding them after checking
+// the signature of the message once.
+//
+// Usage: trusted_decode [number of messages per measurement, defaults to 100000]
+int main(int argc, char** argv)
+{
+    const unsigned int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    {
+        auto msg = a_message();
+        msg->writer() << std::int64_t{42};
+        compare<std::int64_t>("int64", iterations, msg);
+    }
+
+    {
+        std::vector<std::string> v;
+        for (unsigned int i = 0; i < 100; i++)
+            v.push_back("element " + std::to_string(i));
+
+        auto msg = a_message();
+        msg->writer() << v;
+        compare<std::vector<std::string>>("vector<string>, 100 elements", iterations, msg);
+    }
+
+    {
+        std::map<std::string, dbus::types::Variant> m;
+        for (unsigned int i = 0; i < 30; i++)
+            m["key " + std::to_string(i)] = dbus::types::Variant::encode(std::int32_t(i));
+
+        auto msg = a_message();
+        msg->writer() << m;
+        compare<std::map<std::string, dbus::types::Variant>>("a{sv}, 30 entries", iterations, msg);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/validation.h>
+
+#include <dbus/dbus.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+
+namespace validation = core::dbus::validation;
+
+namespace
+{
+const char* name_of(validation::Isa isa)
+{
+    switch (isa)
+    {
+    case validation::Isa::scalar: return "scalar";
+    case validation::Isa::sse2: return "sse2";
+    case validation::Isa::avx2: return "avx2";
+    }
+
+    return "unknown";
+}
+
+// Reports the mean time and throughput of validating input with f.
+void measure(const std::string& name, unsigned int iterations, const std::string& input, const std::function<bool(const std::string&)>& f)
+{
+    // Keeps the compiler from discarding the results.
+    volatile bool sink = false;
+
+    for (unsigned int i = 0; i < 1000; i++)
+        sink = f(input);
+
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++)
+        sink = f(input);
+
+    auto after = std::chrono::steady_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / double(iterations);
+
+    std::cout << "  " << name << " -> " << ns << " [ns], " << input.size() / ns << " [bytes/ns]" << (sink ? "" : " (invalid)") << std::endl;
+}
+
+std::string repeat(const std::string& s, std::size_t size)
+{
+    std::string result;
+    while (result.size() < size)
+        result += s;
+
+    return result;
+}
+
+void compare_utf8(const std::string& name, unsigned int iterations, const std::string& input)
+{
+    std::cout << "utf8, " << name << ", " << input.size() << " bytes" << std::endl;
+
+    measure("libdbus", iterations, input, [](const std::string& s)
+    {
+        return dbus_validate_utf8(s.c_str(), nullptr) == TRUE;
+    });
+
+    for (auto isa : {validation::Isa::scalar, validation::Isa::sse2, validation::Isa::avx2})
+    {
+        if (!validation::is_supported(isa))
+            continue;
+
+        measure(name_of(isa), iterations, input, [isa](const std::string& s)
+        {
+            return validation::is_valid_utf8(isa, s.data(), s.size());
+        });
+    }
+}
+
+void compare_object_path(const std::string& name, unsigned int iterations, const std::string& input)
+{
+    std::cout << "object path, " << name << ", " << input.size() << " bytes" << std::endl;
+
+    measure("libdbus", iterations, input, [](const std::string& s)
+    {
+        return dbus_validate_path(s.c_str(), nullptr) == TRUE;
+    });
+
+    for (auto isa : {validation::Isa::scalar, validation::Isa::sse2, validation::Isa::avx2})
+    {
+        if (!validation::is_supported(isa))
+            continue;
+
+        measure(name_of(isa), iterations, input, [isa](const std::string& s)
+        {
+            return validation::is_valid_object_path(isa, s.data(), s.size());
+        });
+    }
+}
+
+void compare_signature(unsigned int iterations, const std::string& input)
+{
+    std::cout << "signature, " << input << std::endl;
+
+    measure("libdbus", iterations, input, [](const std::string& s)
+    {
+        return dbus_signature_validate(s.c_str(), nullptr) == TRUE;
+    });
+
+    measure("scalar", iterations, input, [](const std::string& s)
+    {
+        return validation::is_valid_signature(s);
+    });
+}
+}
+
+// Compares validating strings, object paths and signatures with libdbus to all
+// implementations supported by the CPU.
+//
+// Usage: validation [number of validations per measurement, defaults to 1000000]
+int main(int argc, char** argv)
+{
+    const unsigned int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    compare_utf8("ascii", iterations, "org.freedesktop.DBus.Properties");
+    compare_utf8("ascii", iterations / 10, repeat("The quick brown fox jumps over the lazy dog. ", 1024));
+    compare_utf8("latin", iterations / 10, repeat("Grüße aus Köln, schöne Straße. ", 1024));
+    compare_utf8("cjk", iterations / 10, repeat("\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", 1024));
+
+    compare_object_path("short", iterations, "/org/freedesktop/ModemManager1/Modem/0");
+    compare_object_path("long", iterations / 10, "/org" + repeat("/freedesktop_object_42", 250));
+
+    compare_signature(iterations, "a{sv}");
+    compare_signature(iterations, "a{oa{sa{sv}}}");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+#include <core/dbus/message_streaming_operators.h>
+
+#include <core/dbus/types/object_path.h>
+#include <core/dbus/types/struct.h>
+#include <core/dbus/types/variant.h>
+#include <core/dbus/types/variant_dict.h>
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+// Counts all allocations done via operator new.
+std::atomic<std::uint64_t> allocations{0};
+}
+
+// Not inlined, gcc would otherwise flag memory from malloc() being released by operator delete.
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+typedef std::map<std::string, dbus::types::Variant> Properties;
+
+template<typename T>
+dbus::types::Variant v(T t)
+{
+    return dbus::types::Variant::encode(t);
+}
+
+// The properties of org.freedesktop.UPower.Device for a laptop battery.
+Properties upower_device()
+{
+    return Properties
+    {
+        {"NativePath", v<std::string>("BAT0")},
+        {"Vendor", v<std::string>("SMP")},
+        {"Model", v<std::string>("5B10W13930")},
+        {"Serial", v<std::string>("1234")},
+        {"UpdateTime", v<std::uint64_t>(1380000000)},
+        {"Type", v<std::uint32_t>(2)},
+        {"PowerSupply", v(true)},
+        {"HasHistory", v(true)},
+        {"HasStatistics", v(true)},
+        {"Online", v(false)},
+        {"Energy", v(41.5)},
+        {"EnergyEmpty", v(0.)},
+        {"EnergyFull", v(50.2)},
+        {"EnergyFullDesign", v(57.)},
+        {"EnergyRate", v(7.9)},
+        {"Voltage", v(12.6)},
+        {"ChargeCycles", v<std::int32_t>(112)},
+        {"Luminosity", v(0.)},
+        {"TimeToEmpty", v<std::int64_t>(18900)},
+        {"TimeToFull", v<std::int64_t>(0)},
+        {"Percentage", v(82.7)},
+        {"Temperature", v(0.)},
+        {"IsPresent", v(true)},
+        {"State", v<std::uint32_t>(2)},
+        {"IsRechargeable", v(true)},
+        {"Capacity", v(88.1)},
+        {"Technology", v<std::uint32_t>(1)},
+        {"WarningLevel", v<std::uint32_t>(1)},
+        {"BatteryLevel", v<std::uint32_t>(1)},
+        {"IconName", v<std::string>("battery-full-symbolic")}
+    };
+}
+
+// The properties of org.freedesktop.ModemManager1.Modem for an LTE modem.
+Properties modem_manager_modem()
+{
+    typedef dbus::types::Struct<std::tuple<std::string, std::uint32_t>> Port;
+    typedef dbus::types::Struct<std::tuple<std::uint32_t, std::uint32_t>> Modes;
+    typedef dbus::types::Struct<std::tuple<std::uint32_t, bool>> SignalQuality;
+
+    return Properties
+    {
+        {"Sim", v(dbus::types::ObjectPath{"/org/freedesktop/ModemManager1/SIM/0"})},
+        {"SimSlots", v(std::vector<dbus::types::ObjectPath>{dbus::types::ObjectPath{"/org/freedesktop/ModemManager1/SIM/0"}})},
+        {"PrimarySimSlot", v<std::uint32_t>(0)},
+        {"Bearers", v(std::vector<dbus::types::ObjectPath>{dbus::types::ObjectPath{"/org/freedesktop/ModemManager1/Bearer/0"}})},
+        {"SupportedCapabilities", v(std::vector<std::uint32_t>{4, 8, 12})},
+        {"CurrentCapabilities", v<std::uint32_t>(12)},
+        {"MaxBearers", v<std::uint32_t>(1)},
+        {"MaxActiveBearers", v<std::uint32_t>(1)},
+        {"Manufacturer", v<std::string>("Sierra Wireless, Incorporated")},
+        {"Model", v<std::string>("EM7455")},
+        {"Revision", v<std::string>("SWI9X30C_02.24.05.06 r7040 CARMD-EV-FRMWR2 2017/05/19 06:23:09")},
+        {"CarrierConfiguration", v<std::string>("default")},
+        {"CarrierConfigurationRevision", v<std::string>("0")},
+        {"HardwareRevision", v<std::string>("EM7455")},
+        {"DeviceIdentifier", v<std::string>("a3f0ac6b4c3f3b4f4d3ff5a67e8a7c9bd4c0b3a1")},
+        {"Device", v<std::string>("/sys/devices/pci0000:00/0000:00:14.0/usb2/2-3")},
+        {"Physdev", v<std::string>("/sys/devices/pci0000:00/0000:00:14.0/usb2/2-3")},
+        {"Drivers", v(std::vector<std::string>{"cdc_mbim", "qcserial"})},
+        {"Plugin", v<std::string>("sierra")},
+        {"PrimaryPort", v<std::string>("cdc-wdm0")},
+        {"Ports", v(std::vector<Port>{Port{std::make_tuple(std::string{"cdc-wdm0"}, 6u)}, Port{std::make_tuple(std::string{"ttyUSB0"}, 4u)}, Port{std::make_tuple(std::string{"wwan0"}, 2u)}})},
+        {"EquipmentIdentifier", v<std::string>("014582000123456")},
+        {"UnlockRequired", v<std::uint32_t>(1)},
+        {"UnlockRetries", v(std::map<std::uint32_t, std::uint32_t>{{2, 3}, {3, 10}})},
+        {"State", v<std::int32_t>(11)},
+        {"StateFailedReason", v<std::uint32_t>(0)},
+        {"AccessTechnologies", v<std::uint32_t>(16384)},
+        {"SignalQuality", v(SignalQuality{std::make_tuple(75u, true)})},
+        {"OwnNumbers", v(std::vector<std::string>{"+4915112345678"})},
+        {"PowerState", v<std::uint32_t>(3)},
+        {"SupportedModes", v(std::vector<Modes>{Modes{std::make_tuple(14u, 0u)}, Modes{std::make_tuple(14u, 8u)}})},
+        {"CurrentModes", v(Modes{std::make_tuple(14u, 8u)})},
+        {"SupportedBands", v(std::vector<std::uint32_t>{31, 32, 33, 34, 35, 37, 38, 42, 43, 49, 50, 55})},
+        {"CurrentBands", v(std::vector<std::uint32_t>{31, 32, 33, 34, 35, 37, 38, 42, 43, 49, 50, 55})},
+        {"SupportedIpFamilies", v<std::uint32_t>(7)}
+    };
+}
+
+// Reports the mean time and the mean number of allocations it takes to process one message with f.
+void measure(const std::string& name, unsigned int iterations, const dbus::Message::Ptr& msg, const std::function<void(const dbus::Message::Ptr&)>& f)
+{
+    // Warms up caches and free lists.
+    for (unsigned int i = 0; i < 100; i++)
+        f(msg);
+
+    auto allocations_before = allocations.load();
+    auto before = std::chrono::steady_clock::now();
+
+    for (unsigned int i = 0; i < iterations; i++)
+        f(msg);
+
+    auto after = std::chrono::steady_clock::now();
+    auto allocations_after = allocations.load();
+
+    std::cout << name << " -> "
+              << std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count() / double(iterations)
+              << " [ns/message], "
+              << (allocations_after - allocations_before) / double(iterations)
+              << " [allocations/message]" << std::endl;
+}
+
+// Compares decoding all of properties to a map to the lazy dictionary, when reading
+// the given keys, and when reading all keys.
+void compare(const std::string& name, unsigned int iterations, const Properties& properties, const std::vector<std::string>& keys)
+{
+    auto msg = dbus::Message::make_signal("/core/dbus/benchmark", "core.dbus.benchmark", "VariantDict");
+    msg->writer() << std::string{"org.freedesktop.benchmark"} << properties;
+
+    measure(name + " std::map, " + std::to_string(keys.size()) + " keys", iterations, msg, [&keys](const dbus::Message::Ptr& m)
+    {
+        std::string interface; Properties p;
+        m->reader() >> interface >> p;
+        for (const auto& key : keys)
+            (void) p.at(key).signature();
+    });
+
+    measure(name + " VariantDict, " + std::to_string(keys.size()) + " keys", iterations, msg, [&keys](const dbus::Message::Ptr& m)
+    {
+        std::string interface; dbus::types::VariantDict p;
+        m->reader() >> interface >> p;
+        for (const auto& key : keys)
+            (void) p.at(key).signature();
+    });
+
+    measure(name + " std::map, all keys", iterations, msg, [](const dbus::Message::Ptr& m)
+    {
+        std::string interface; Properties p;
+        m->reader() >> interface >> p;
+        for (const auto& pair : p)
+            (void) pair.second.signature();
+    });
+
+    measure(name + " VariantDict, all keys", iterations, msg, [](const dbus::Message::Ptr& m)
+    {
+        std::string interface; dbus::types::VariantDict p;
+        m->reader() >> interface >> p;
+        for (std::size_t i = 0; i < p.size(); i++)
+            (void) p.value(i).signature();
+    });
+}
+}
+
+// Compares decoding realistic property maps, as received via PropertiesChanged or GetAll,
+// to a std::map<std::string, Variant> and to a VariantDict.
+//
+// Usage: variant_dict [number of messages per measurement, defaults to 100000]
+int main(int argc, char** argv)
+{
+    const unsigned int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    compare("UPower.Device", iterations, upower_device(), {"Percentage", "State"});
+    compare("ModemManager1.Modem", iterations, modem_manager_modem(), {"State", "SignalQuality"});
+
+    return EXIT_SUCCESS;
+}
@@ -22,11 +22,25 @@
 #include <core/dbus/executor.h>
 #include <core/dbus/visibility.h>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/version.hpp>
+
 namespace boost
 {
 namespace asio
 {
+#if BOOST_VERSION >= 106600
+// Starting with 1.66, io_service is an alias for io_context.
+class io_context;
+typedef io_context io_service;
+#else
 class io_service;
+#endif
 }
 }
 
@@ -36,8 +50,79 @@ namespace dbus
 {
 namespace asio
 {
+/**
+ * @brief Bounds the amount of messages dispatched per wakeup of the event loop.
+ *
+ * Once the budget is exhausted, the executor yields to other handlers queued on the
+ * io_service and continues dispatching afterwards. A default-constructed budget is unlimited.
+ */
+struct ORG_FREEDESKTOP_DBUS_DLL_PUBLIC DispatchBudget
+{
+    /** @brief Maximum number of messages dispatched before yielding, 0 for no limit. */
+    std::size_t max_messages{0};
+    /** @brief Maximum time spent dispatching before yielding, 0 for no limit. */
+    std::chrono::microseconds max_duration{0};
+};
+
+/**
+ * @brief Snapshot of the dispatch statistics of an executor.
+ */
+struct ORG_FREEDESKTOP_DBUS_DLL_PUBLIC DispatchStatistics
+{
+    /** @brief Total number of messages dispatched. */
+    std::uint64_t messages_dispatched{0};
+    /** @brief Number of times dispatching yielded with messages remaining. */
+    std::uint64_t budget_exhaustions{0};
+    /**
+     * @brief Messages dispatched since the incoming queue was last found empty.
+     *
+     * libdbus does not expose the length of its incoming queue. This gauge is zero
+     * whenever the queue has been drained and grows while a burst is worked off.
+     */
+    std::uint64_t backlog{0};
+};
+
+/**
+ * @brief Configures an executor that owns a dedicated io_service.
+ *
+ * Bus::run() spawns thread_count threads that run the io_service, applies the
+ * thread settings to each of them and blocks until Bus::stop() is called.
+ */
+struct ORG_FREEDESKTOP_DBUS_DLL_PUBLIC ExecutorOptions
+{
+    /** @brief Number of threads running the io_service, at least 1. */
+    std::size_t thread_count{1};
+    /** @brief CPUs the threads are pinned to, empty for no pinning. */
+    std::vector<unsigned int> cpu_affinity;
+    /** @brief Name of the threads, truncated to 15 characters, empty to keep the default. */
+    std::string thread_name;
+    /** @brief SCHED_FIFO priority of the threads, 0 to keep the default scheduling policy. */
+    int realtime_priority{0};
+    /** @brief Bounds the amount of messages dispatched per wakeup. */
+    DispatchBudget budget;
+};
+
+/**
+ * @brief Creates an executor running on an io_service shared by all executors created by this overload.
+ *
+ * Bus::stop() on any of the buses stops the shared io_service for all of them. Prefer
+ * the overload taking ExecutorOptions for isolating buses from each other.
+ */
 ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus);
 ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus, boost::asio::io_service& io);
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus, boost::asio::io_service& io, const DispatchBudget& budget);
+
+/**
+ * @brief Creates an executor that runs bus on its own io_service, configured by options.
+ * @throw std::runtime_error if bus is null or options.thread_count is 0.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus, const ExecutorOptions& options);
+
+/**
+ * @brief Queries the dispatch statistics of an executor created by this namespace.
+ * @throw std::runtime_error if executor has not been created by core::dbus::asio::make_executor.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC DispatchStatistics dispatch_statistics(const Executor::Ptr& executor);
 }
 }
 }
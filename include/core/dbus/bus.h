@@ -49,6 +49,7 @@ namespace dbus
 {
 class MatchRule;
 class Object;
+class Server;
 /**
  * @brief The Bus class constitutes a very thin wrapper and the starting
  * point to expose low-level DBus functionality for internal purposes.
@@ -171,6 +172,13 @@ public:
     /** @brief Function signature for handling a message. */
     typedef std::function<MessageHandlerResult(const Message::Ptr& msg)> MessageHandler;
 
+    /**
+     * @brief Function signature for resolving the object for a path below a subtree on demand.
+     *
+     * Returns nullptr if there is no object for the path.
+     */
+    typedef std::function<std::shared_ptr<Object>(const types::ObjectPath& path)> SubtreeResolver;
+
     /**
      * @brief Constructs an instance of Bus and connected to the bus specified by address.
      * @param address The address of the bus to connect to.
@@ -183,6 +191,38 @@ public:
      */
     explicit Bus(WellKnownBus bus);
 
+    /**
+     * @brief Connects directly to a peer listening on address, e.g., a core::dbus::Server.
+     *
+     * Messages are exchanged with the peer without a bus daemon in between. Names
+     * cannot be requested on such connections and match rules are not installed, as
+     * the peer delivers all of its signals anyway.
+     *
+     * @param address The address the peer listens on.
+     * @throw std::runtime_error if connecting to the peer fails.
+     */
+    static Ptr connect_to_peer(const std::string& address);
+
+    /**
+     * @brief Connects to a well-known bus, speaking the DBus protocol natively instead of through libdbus.
+     *
+     * Sending does not contend on the connection lock of libdbus, refer to native::Connection.
+     * Messages are read on a dedicated thread and delivered from within the loop of the installed
+     * executor, which has to implement FdWatcher. Messages carrying unix fds can neither be sent
+     * nor received, and raw() returns nullptr.
+     *
+     * @param bus The well-known bus the instance should connect to.
+     * @throw std::runtime_error if connecting to the bus fails.
+     */
+    static Ptr connect_natively(WellKnownBus bus);
+
+    /**
+     * @brief Connects to the bus specified by address, speaking the DBus protocol natively instead of through libdbus.
+     * @param address The address of the bus to connect to, only unix sockets are supported.
+     * @throw std::runtime_error if connecting to the bus fails.
+     */
+    static Ptr connect_natively(const std::string& address);
+
     // A Bus instance is not copy-able.
     Bus(const Bus&) = delete;
 
@@ -244,14 +284,25 @@ public:
             const std::shared_ptr<Message>& msg,
             const std::chrono::milliseconds& timeout);
 
+    /**
+     * @brief Checks whether this instance is a direct connection to a peer instead of a bus daemon.
+     */
+    bool is_peer_to_peer() const;
+
     /**
      * @brief Installs a match rule to the underlying DBus connection.
+     *
+     * Does nothing for peer-to-peer connections.
+     *
      * @param rule The match rule to be installed, has to be a valid match rule.
      */
     void add_match(const MatchRule& rule);
 
     /**
      * @brief Uninstalls a match rule to the underlying DBus connection.
+     *
+     * Does nothing for peer-to-peer connections.
+     *
      * @param rule The match rule to be uninstalled.
      */
     void remove_match(const MatchRule& rule);
@@ -266,6 +317,7 @@ public:
     /**
      * @brief Installs an executor for this bus connection, enabling signal and method call delivery.
      * @param e The executor instance, must not be null.
+     * @throw std::logic_error if the bus is connected natively and e does not implement FdWatcher.
      */
     void install_executor(const Executor::Ptr& e);
 
@@ -279,6 +331,17 @@ public:
      */
     void run();
 
+    /**
+     * @brief Invokes handler from within the loop of the installed executor whenever fd is readable.
+     *
+     * Allows for integrating additional event sources with the thread(s) delivering
+     * signals and method calls. Monitoring stops once the returned handle is released.
+     *
+     * @throw std::runtime_error if no executor has been installed.
+     * @throw std::logic_error if the executor does not implement FdWatcher.
+     */
+    std::shared_ptr<void> watch_readable(int fd, const std::function<void()>& handler);
+
     /**
      * @brief Provides mutable access to the contained signal router.
      */
@@ -286,6 +349,8 @@ public:
 
     /**
      * @brief Provides raw, unmanaged access to the underlying DBus connection.
+     *
+     * Returns nullptr for buses connected natively.
      */
     DBusConnection* raw() const;
 
@@ -300,6 +365,24 @@ public:
             const types::ObjectPath& path,
             const std::shared_ptr<Object>& object);
 
+    /**
+     * @brief register_subtree_for_path makes the given object known for prefix, and resolver for all paths below prefix.
+     *
+     * A single registration covers the whole namespace of prefix: messages for descendants of prefix
+     * that have not been registered themselves are handed to the object resolver returns for their path.
+     * Resolved objects are not kept alive by the bus. Unregister the subtree by unregistering prefix.
+     *
+     * @throw std::runtime_error if resolver is empty, if prefix is already used or if libdbus runs out of memory.
+     * On buses connected natively, a prefix that is already used yields Bus::Errors::ObjectPathInUse.
+     * @param prefix The path to make the object and the subtree known for on the bus.
+     * @param object The object to make known for prefix.
+     * @param resolver Invoked on the thread dispatching the message for every message to a descendant of prefix.
+     */
+    void register_subtree_for_path(
+            const types::ObjectPath& prefix,
+            const std::shared_ptr<Object>& object,
+            const SubtreeResolver& resolver);
+
     /**
      * @brief unregister_object_path removes the object known under the given name from the bus.
      * @throw Bus::Errors::NoMemory if not enough memory.
@@ -314,6 +397,14 @@ public:
     MessageHandlerResult handle_message(const Message::Ptr& msg);
 
 private:
+    friend class Server;
+
+    // Adopts a reference to an established peer-to-peer connection.
+    explicit Bus(DBusConnection* peer);
+
+    // Dispatches messages of a natively connected bus.
+    explicit Bus(const std::shared_ptr<native::Connection>& connection);
+
     struct Private;
     std::unique_ptr<Private> d;
 };
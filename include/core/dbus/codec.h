@@ -19,8 +19,11 @@
 #define CORE_DBUS_CODEC_H_
 
 #include <core/dbus/message.h>
+#include <core/dbus/helper/signature.h>
 #include <core/dbus/helper/type_mapper.h>
 
+#include <stdexcept>
+
 namespace core
 {
 namespace dbus
@@ -49,6 +52,34 @@ struct Codec
     static void decode_argument(Message::Reader& in, T& arg);
 };
 
+namespace helper
+{
+/**
+ * @brief Evaluates to true if Codec<T> decodes exactly the signature reported by TypeMapper<T>.
+ *
+ * Only arguments of such types skip per-value type checks, see Message::Reader::Trusted.
+ * The codecs shipped with dbus-cpp opt in. Specialize for user-defined codecs to opt in.
+ */
+template<typename T>
+struct DecodesSignature : public std::false_type
+{
+};
+
+/**
+ * @brief Evaluates to true if DecodesSignature holds for all of Args.
+ */
+template<typename... Args>
+struct AllDecodeSignature : public std::true_type
+{
+};
+
+template<typename Arg, typename... Args>
+struct AllDecodeSignature<Arg, Args...>
+        : public std::integral_constant<bool, DecodesSignature<Arg>::value && AllDecodeSignature<Args...>::value>
+{
+};
+}
+
 /**
  * @brief Template specialization for void argument types.
  */
@@ -309,6 +340,69 @@ struct Codec<types::Any>
     }
 };
 
+namespace helper
+{
+template<>
+struct DecodesSignature<bool> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<std::int8_t> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<std::int16_t> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<std::uint16_t> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<std::int32_t> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<std::uint32_t> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<std::int64_t> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<std::uint64_t> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<double> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<types::ObjectPath> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<types::Signature> : public std::true_type
+{
+};
+
+template<>
+struct DecodesSignature<types::UnixFd> : public std::true_type
+{
+};
+}
+
 /**
  * @brief Helper function that encodes the supplied argument relying on a Codec template specialization.
  * @tparam T Type of the argument that should be encoded.
@@ -340,8 +434,45 @@ inline void encode_message(Message::Writer& out, const Arg& arg, Args... params)
     encode_message(out, params...);
 }
 
+namespace detail
+{
+// Values of basic types are checked by a single comparison anyway.
+template<typename T, bool mapped = helper::IsMapped<T>::value && helper::DecodesSignature<T>::value>
+struct DecodesTrusted : public std::integral_constant<bool, !helper::TypeMapper<T>::is_basic_type()>
+{
+};
+
+template<typename T>
+struct DecodesTrusted<T, false> : public std::false_type
+{
+};
+
+template<typename T>
+inline void decode_argument(Message::Reader& out, T& arg, std::true_type)
+{
+    static const std::string signature = helper::TypeMapper<T>::signature();
+
+    Message::Reader::Trusted trusted{out, signature};
+    Codec<T>::decode_argument(out, arg);
+    trusted.commit();
+}
+
+// Without a signature known at compile time, the argument is decoded checked.
+template<typename T>
+inline void decode_argument(Message::Reader& out, T& arg, std::false_type)
+{
+    Codec<T>::decode_argument(out, arg);
+}
+}
+
 /**
  * @brief Helper function that decodes the supplied argument relying on a Codec template specialization.
+ *
+ * If out has been obtained from Message::reader() and the signature of the message proves
+ * the argument to be of type T, per-value type checks are skipped, see Message::Reader::Trusted.
+ * This only applies to types T for which helper::DecodesSignature holds, other arguments
+ * are decoded checked.
+ *
  * @tparam T Type of the argument that should be decoded.
  * @param out Input iterator to read from.
  * @param arg Argument to decode.
@@ -350,7 +481,7 @@ inline void encode_message(Message::Writer& out, const Arg& arg, Args... params)
 template<typename T>
 inline void decode_argument(Message::Reader& out, T& arg)
 {
-    Codec<T>::decode_argument(out, arg);
+    detail::decode_argument(out, arg, detail::DecodesTrusted<T>{});
 }
 
 /**
@@ -364,7 +495,7 @@ template<typename T>
 inline T decode_argument(Message::Reader& out)
 {
     T arg;
-    Codec<T>::decode_argument(out, arg);
+    decode_argument(out, arg);
 
     return arg;
 }
@@ -385,6 +516,53 @@ inline void decode_message(Message::Reader& out, Arg& arg, Args& ... params)
 {
     decode_argument(out, arg); decode_message(out, params...);
 }
+
+/**
+ * @brief Outcome of decoding without exceptions, see try_decode_message.
+ */
+enum class DecodeError
+{
+    none, ///< All arguments have been decoded.
+    signature_mismatch, ///< The message does not carry arguments of the requested types.
+    invalid_argument ///< An argument of matching signature cannot be represented, e.g., as a std::array of different size.
+};
+
+/**
+ * @brief Decodes the arguments of msg to args, reporting errors by value instead of throwing.
+ *
+ * The signature of the message is compared to the one of Args up front. Messages of a
+ * different signature are rejected without decoding any argument, formatting an error
+ * message or unwinding the stack. Trailing arguments of msg are ignored.
+ *
+ * @tparam Args Types of the arguments to decode.
+ * @param msg The message to decode from.
+ * @param args Arguments to decode to, in order, only valid if DecodeError::none is returned.
+ * @throw std::bad_alloc and other failures to acquire resources, they are not decode errors.
+ */
+template<typename... Args>
+inline DecodeError try_decode_message(const Message::Ptr& msg, Args& ... args)
+{
+    try
+    {
+        static const std::string signature = helper::concatenated_signature<Args...>();
+        if (!msg->signature_starts_with(signature))
+            return DecodeError::signature_mismatch;
+
+        auto reader = msg->reader();
+        decode_message(reader, args...);
+    }
+    catch (const std::runtime_error&)
+    {
+        return DecodeError::invalid_argument;
+    }
+    catch (const std::logic_error&)
+    {
+        // E.g., std::out_of_range or malformed object paths and signatures.
+        return DecodeError::invalid_argument;
+    }
+
+    return DecodeError::none;
+}
 }
 }
 
@@ -21,6 +21,8 @@
 #include <core/dbus/visibility.h>
 #include <core/dbus/signal.h>
 
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -94,6 +96,12 @@ public:
       */
     std::vector<std::string> list_names() const;
 
+    /**
+      * @brief Hands all known names on the bus to visitor, one at a time, until visitor returns false.
+      * @return The number of names handed to visitor.
+      */
+    std::size_t list_names(const std::function<bool(const std::string&)>& visitor) const;
+
     /**
      * @brief Create a new service watcher for the specified name and watch mode
      * @return Unique instance of ServiceWatcher with the specified parameters
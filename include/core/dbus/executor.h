@@ -20,6 +20,7 @@
 
 #include <core/dbus/visibility.h>
 
+#include <functional>
 #include <memory>
 
 namespace core
@@ -53,6 +54,34 @@ protected:
      */
     virtual void stop() = 0;
 };
+
+/**
+ * @brief Implemented by executors that are able to monitor fds besides the ones of the bus connection.
+ *
+ * Bus::watch_readable discovers support for monitoring fds by casting an installed
+ * executor to FdWatcher, keeping the layout of Executor unchanged.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC FdWatcher
+{
+public:
+    virtual ~FdWatcher() = default;
+
+protected:
+    friend class Bus;
+
+    FdWatcher() = default;
+    FdWatcher(const FdWatcher&) = delete;
+    FdWatcher& operator=(const FdWatcher&) = delete;
+
+    /**
+     * @brief Invokes handler from within the event loop whenever fd is readable.
+     *
+     * Monitoring stops once the returned handle is released, which has to happen
+     * before the executor is destroyed. The handler is invoked again for as long as
+     * fd stays readable, i.e., it has to consume whatever made fd readable.
+     */
+    virtual std::shared_ptr<void> watch_readable(int fd, const std::function<void()>& handler) = 0;
+};
 }
 }
 
@@ -0,0 +1,181 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_EXTERNAL_EXECUTOR_H_
+#define CORE_DBUS_EXTERNAL_EXECUTOR_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/executor.h>
+#include <core/dbus/visibility.h>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+namespace core
+{
+namespace dbus
+{
+namespace external
+{
+/**
+ * @brief A file descriptor that the event loop has to monitor on behalf of a bus.
+ *
+ * Instances are handed out by the executor and stay valid as long as they are referenced.
+ * Once removed from the event loop, all operations on a watch become no-ops.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Watch
+{
+public:
+    typedef std::shared_ptr<Watch> Ptr;
+
+    /** @brief Events reported by and requested from a watch, to be or'ed together. */
+    enum Event
+    {
+        readable = 1 << 0,
+        writable = 1 << 1,
+        error = 1 << 2,
+        hangup = 1 << 3
+    };
+
+    virtual ~Watch() = default;
+
+    /** @brief The file descriptor to monitor. */
+    virtual int fd() const = 0;
+
+    /** @brief The events the loop should monitor fd for, errors and hangups are always of interest. */
+    virtual unsigned int events() const = 0;
+
+    /** @brief Whether the loop should currently monitor fd. */
+    virtual bool is_enabled() const = 0;
+
+    /**
+     * @brief Reports the given events on fd to the bus.
+     * @return false if the bus ran out of memory while handling the events, the loop should retry later.
+     */
+    virtual bool handle(unsigned int events) = 0;
+
+protected:
+    Watch() = default;
+    Watch(const Watch&) = delete;
+    Watch& operator=(const Watch&) = delete;
+};
+
+/**
+ * @brief A timeout that the event loop has to track on behalf of a bus.
+ *
+ * While enabled, handle() has to be invoked every interval(). Once removed from the
+ * event loop, all operations on a timeout become no-ops.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Timeout
+{
+public:
+    typedef std::shared_ptr<Timeout> Ptr;
+
+    virtual ~Timeout() = default;
+
+    /** @brief The interval of the timeout. */
+    virtual std::chrono::milliseconds interval() const = 0;
+
+    /** @brief Whether the timeout is currently active. */
+    virtual bool is_enabled() const = 0;
+
+    /**
+     * @brief Reports the expiry of the timeout to the bus.
+     * @return false if the bus ran out of memory while handling the timeout, the loop should retry later.
+     */
+    virtual bool handle() = 0;
+
+protected:
+    Timeout() = default;
+    Timeout(const Timeout&) = delete;
+    Timeout& operator=(const Timeout&) = delete;
+};
+
+/**
+ * @brief Interface to be implemented for integrating a bus with an event loop
+ * like glib, libuv, Qt or a custom epoll loop.
+ *
+ * All functions are invoked from whichever thread interacts with the bus. If the bus is
+ * only ever used from the thread running the event loop, no synchronization is required.
+ * Implementations must not call back into the bus from within these functions.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC EventLoop
+{
+public:
+    typedef std::shared_ptr<EventLoop> Ptr;
+
+    virtual ~EventLoop() = default;
+
+    /** @brief Starts monitoring watch, taking watch->is_enabled() into account. */
+    virtual void add_watch(const Watch::Ptr& watch) = 0;
+    /** @brief Stops monitoring watch. */
+    virtual void remove_watch(const Watch::Ptr& watch) = 0;
+    /** @brief Either watch->is_enabled() or watch->events() changed. */
+    virtual void watch_toggled(const Watch::Ptr& watch) = 0;
+
+    /** @brief Starts tracking timeout, taking timeout->is_enabled() into account. */
+    virtual void add_timeout(const Timeout::Ptr& timeout) = 0;
+    /** @brief Stops tracking timeout. */
+    virtual void remove_timeout(const Timeout::Ptr& timeout) = 0;
+    /** @brief Either timeout->is_enabled() or timeout->interval() changed, the interval restarts. */
+    virtual void timeout_toggled(const Timeout::Ptr& timeout) = 0;
+
+    /**
+     * @brief Messages are ready for dispatching, the loop should call Executor::dispatch() soon.
+     *
+     * Implementations must not dispatch from within this function.
+     */
+    virtual void wakeup() = 0;
+
+protected:
+    EventLoop() = default;
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+};
+
+/**
+ * @brief An executor that leaves monitoring a bus to an external event loop.
+ *
+ * Bus::run() blocks until Bus::stop() is called while the external loop drives the bus.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor : public core::dbus::Executor
+{
+public:
+    typedef std::shared_ptr<Executor> Ptr;
+
+    /**
+     * @brief Dispatches queued messages, to be invoked from the thread running the event loop.
+     * @param max_messages Upper bound of messages to dispatch, 0 for no limit.
+     * @return true if messages remain for dispatching, in which case the loop should call dispatch() again.
+     */
+    virtual bool dispatch(std::size_t max_messages = 0) = 0;
+
+protected:
+    Executor() = default;
+};
+
+/**
+ * @brief Creates an executor that hands all watches and timeouts of bus to loop.
+ * @throw std::runtime_error if bus or loop is null.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus, const EventLoop::Ptr& loop);
+}
+}
+}
+
+#endif // CORE_DBUS_EXTERNAL_EXECUTOR_H_
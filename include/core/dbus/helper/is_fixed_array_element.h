@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_HELPER_IS_FIXED_ARRAY_ELEMENT_H_
+#define CORE_DBUS_HELPER_IS_FIXED_ARRAY_ELEMENT_H_
+
+#include <cstdint>
+#include <type_traits>
+
+namespace core
+{
+namespace dbus
+{
+namespace helper
+{
+/**
+ * @brief Checks whether arrays of T can be handed to and taken from a message in one go.
+ *
+ * True for fixed-size types whose in-memory representation matches the one libdbus
+ * uses for fixed arrays. Booleans are excluded, as libdbus represents them as 32-bit
+ * integers, as are floats, which are transmitted as doubles.
+ */
+template<typename T>
+struct IsFixedArrayElement
+{
+    static constexpr bool value =
+            std::is_same<T, std::int8_t>::value ||
+            std::is_same<T, std::int16_t>::value ||
+            std::is_same<T, std::uint16_t>::value ||
+            std::is_same<T, std::int32_t>::value ||
+            std::is_same<T, std::uint32_t>::value ||
+            std::is_same<T, std::int64_t>::value ||
+            std::is_same<T, std::uint64_t>::value ||
+            std::is_same<T, double>::value;
+};
+}
+}
+}
+
+#endif // CORE_DBUS_HELPER_IS_FIXED_ARRAY_ELEMENT_H_
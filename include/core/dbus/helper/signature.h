@@ -19,6 +19,7 @@
 #define CORE_DBUS_HELPER_SIGNATURE_H_
 
 #include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/signature.h>
 
 #include <string>
 
@@ -46,6 +47,27 @@ inline std::string signature(const Arg&, const Args& ... remainder)
     static const std::string s = atomic_signature<Arg>() + signature(remainder...);
     return s;
 }
+
+/**
+ * @brief Returns the signature of T, validated only once per type.
+ */
+template<typename T>
+inline const types::Signature& signature_of()
+{
+    static const types::Signature s{TypeMapper<T>::signature()};
+    return s;
+}
+
+/**
+ * @brief Concatenates the signatures of Args, without requiring instances.
+ */
+template<typename... Args>
+inline std::string concatenated_signature()
+{
+    std::string s;
+    int unpack[] = {0, (s += atomic_signature<Args>(), 0)...}; (void) unpack;
+    return s;
+}
 }
 }
 }
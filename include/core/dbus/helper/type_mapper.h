@@ -31,6 +31,7 @@
 #include <map>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace core
@@ -106,6 +107,9 @@ struct DBusTypeMapper<ArgumentType::floating_point>
 template<typename T>
 struct TypeMapper
 {
+    // Only present if there is no specialization for T, see IsMapped.
+    typedef void Unmapped;
+
     constexpr inline static ArgumentType type_value();
     constexpr inline static bool is_basic_type();
     constexpr inline static bool requires_signature();
@@ -113,6 +117,34 @@ struct TypeMapper
     static inline std::string signature();
 };
 
+/**
+ * @brief Evaluates to true if TypeMapper has been specialized for T.
+ *
+ * Containers specialize IsMapped to require a TypeMapper for their element types, too.
+ */
+template<typename T, typename Enable = void>
+struct IsMapped : public std::true_type
+{
+};
+
+template<typename T>
+struct IsMapped<T, typename TypeMapper<T>::Unmapped> : public std::false_type
+{
+};
+
+/**
+ * @brief Evaluates to true if IsMapped holds for all of Args.
+ */
+template<typename... Args>
+struct AreMapped : public std::true_type
+{
+};
+
+template<typename Arg, typename... Args>
+struct AreMapped<Arg, Args...> : public std::integral_constant<bool, IsMapped<Arg>::value && AreMapped<Args...>::value>
+{
+};
+
 template<>
 struct TypeMapper<bool>
 {
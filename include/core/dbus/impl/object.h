@@ -29,6 +29,7 @@
 #include <core/dbus/types/any.h>
 #include <core/dbus/types/object_path.h>
 #include <core/dbus/types/variant.h>
+#include <core/dbus/types/variant_dict.h>
 #include <core/dbus/types/stl/map.h>
 #include <core/dbus/types/stl/string.h>
 #include <core/dbus/types/stl/tuple.h>
@@ -218,6 +219,16 @@ Object::get_all_properties()
                 >(traits::Service<Interface>::interface_name()).value());
 }
 
+template<typename Interface>
+inline types::VariantDict
+Object::get_all_properties_as_dict()
+{
+    return invoke_method_synchronously<
+                interfaces::Properties::GetAll,
+                types::VariantDict
+            >(traits::Service<Interface>::interface_name()).value();
+}
+
 template<typename SignalDescription>
 inline const std::shared_ptr<Signal<SignalDescription, typename SignalDescription::ArgumentType>>
 Object::get_signal()
@@ -342,9 +353,10 @@ inline Object::Object(
             // by the lifetime of 'this'.
             [this](const Message::Ptr& msg)
             {
-                interfaces::Properties::Signals::PropertiesChanged::ArgumentType arg;
-                msg->reader() >> arg;
-                on_properties_changed(arg);
+                // Only the values of properties known to this object are decoded.
+                std::string interface; types::VariantDict changed_values;
+                msg->reader() >> interface >> changed_values;
+                on_properties_changed(interface, changed_values);
             });
     }
 }
@@ -380,17 +392,15 @@ inline void Object::remove_match(const MatchRule& rule)
 }
 
 inline void Object::on_properties_changed(
-        const interfaces::Properties::Signals::PropertiesChanged::ArgumentType& arg)
+        const std::string& interface,
+        const types::VariantDict& changed_values)
 {
-    const auto& interface = std::get<0>(arg);
-    const auto& changed_values = std::get<1>(arg);
-
-    for (const auto& value : changed_values)
+    for (std::size_t i = 0; i < changed_values.size(); i++)
     {
-        auto it = property_changed_vtable.find(std::make_tuple(interface, value.first));
+        auto it = property_changed_vtable.find(std::make_tuple(interface, std::string{changed_values.key(i)}));
         if (it != property_changed_vtable.end())
         {
-            it->second(value.second);
+            it->second(changed_values.value(i));
         }
     }
 }
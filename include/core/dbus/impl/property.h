@@ -179,9 +179,13 @@ template<typename PropertyType>
 void
 Property<PropertyType>::handle_changed(const types::Variant& arg)
 {
+    // Values of unexpected type are dropped without throwing, see Signal::operator().
+    typename PropertyType::ValueType value;
+    if (arg.try_as(value) != DecodeError::none)
+        return;
+
     try
     {
-        auto value = arg.as<typename PropertyType::ValueType>();
         Super::set(value);
     }
     catch (const std::exception &e){
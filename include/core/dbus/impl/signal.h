@@ -26,6 +26,28 @@ namespace core
 {
 namespace dbus
 {
+template<typename... Args>
+inline SignalEmission<Args...>::SignalEmission(
+    const std::shared_ptr<Bus>& bus,
+    const std::string& path,
+    const std::string& interface,
+    const std::string& name) : bus(bus),
+                               prototype(bus->message_factory()->make_signal(path, interface, name))
+{
+    if (!prototype)
+        throw std::runtime_error("No memory available to allocate DBus message");
+}
+
+template<typename... Args>
+inline void SignalEmission<Args...>::emit(const Args&... args) const
+{
+    // Copying the prototype skips validating and assembling the header fields.
+    auto msg = prototype->clone();
+    auto writer = msg->writer();
+    encode_message(writer, args...);
+    bus->send(msg);
+}
+
 template<typename SignalDescription, typename Argument>
 inline Signal<SignalDescription, Argument>::~Signal() noexcept
 {
@@ -51,6 +73,13 @@ Signal<SignalDescription, Argument>::emit(void)
     parent->emit_signal<SignalDescription>();
 }
 
+template<typename SignalDescription, typename Argument>
+inline SignalEmission<>
+Signal<SignalDescription, Argument>::prepare() const
+{
+    return SignalEmission<>(parent->parent->get_connection(), parent->path().as_string(), interface, name);
+}
+
 template<typename SignalDescription, typename Argument>
 inline typename Signal<SignalDescription, Argument>::SubscriptionToken
 Signal<SignalDescription, Argument>::connect(const Handler& h)
@@ -84,13 +113,14 @@ Signal<SignalDescription, Argument>::make_signal(
 {
     typedef std::shared_ptr<Signal<SignalDescription, void>> SharedSignalPtr;
 
-    typedef std::tuple<types::ObjectPath, std::string, std::string> SignalCacheKey;
+    // Signals are shared per connection, peers within one process must not see each other's.
+    typedef std::tuple<const Bus*, types::ObjectPath, std::string, std::string> SignalCacheKey;
     typedef Signal<SignalDescription, void> SignalCacheValue;
     typedef ThreadSafeLifetimeConstrainedCache<SignalCacheKey, SignalCacheValue> SignalCache;
 
     static SignalCache signal_cache;
 
-    auto key = std::make_tuple(parent->path(), interface, name);
+    auto key = std::make_tuple(parent->parent->get_connection().get(), parent->path(), interface, name);
     auto signal = signal_cache.retrieve_value_for_key(key);
 
     if (signal)
@@ -175,6 +205,22 @@ Signal<
     d->parent->template emit_signal<SignalDescription, typename SignalDescription::ArgumentType>(args);
 }
 
+template<typename SignalDescription>
+inline SignalEmission<typename SignalDescription::ArgumentType>
+Signal<
+    SignalDescription,
+    typename std::enable_if<
+        is_not_void<typename SignalDescription::ArgumentType>::value,
+        typename SignalDescription::ArgumentType>::type
+    >::prepare() const
+{
+    return SignalEmission<typename SignalDescription::ArgumentType>(
+                d->parent->parent->get_connection(),
+                d->parent->path().as_string(),
+                d->interface,
+                d->name);
+}
+
 template<typename SignalDescription>
 inline typename Signal<
 SignalDescription,
@@ -269,13 +315,14 @@ Signal<
 {
     typedef std::shared_ptr<Signal<SignalDescription, typename SignalDescription::ArgumentType>> SharedSignalPtr;
 
-    typedef std::tuple<types::ObjectPath, std::string, std::string> SignalCacheKey;
+    // Signals are shared per connection, peers within one process must not see each other's.
+    typedef std::tuple<const Bus*, types::ObjectPath, std::string, std::string> SignalCacheKey;
     typedef Signal<SignalDescription, typename SignalDescription::ArgumentType> SignalCacheValue;
     typedef ThreadSafeLifetimeConstrainedCache<SignalCacheKey, SignalCacheValue> SignalCache;
 
     static SignalCache signal_cache;
 
-    auto key = std::make_tuple(parent->path(), interface, name);
+    auto key = std::make_tuple(parent->parent->get_connection().get(), parent->path(), interface, name);
     auto signal = signal_cache.retrieve_value_for_key(key);
 
     if (signal)
@@ -324,10 +371,14 @@ Signal<
 {
     try
     {
+        // Malformed signals are dropped without throwing, such that peers flooding
+        // them cannot keep us busy unwinding the stack and formatting error messages.
         typename SignalDescription::ArgumentType value;
-        msg->reader() >> value;
+        if (try_decode_message(msg, value) != DecodeError::none)
+            return;
+
         std::lock_guard<std::mutex> lg(d->handlers_guard);
-        for (auto it : d->handlers)
+        for (const auto& it : d->handlers)
         {
             const MatchRule::MatchArgs& match_args(it.first);
             const Handler &handler(it.second);
@@ -348,7 +399,7 @@ Signal<
                     for (std::size_t i(0); i < index && reader.type() != dbus::ArgumentType::invalid; ++i)
                         reader.pop();
 
-                    if (value != reader.pop_string())
+                    if (reader.type() != dbus::ArgumentType::string || value != reader.pop_string())
                     {
                         matched = false;
                         continue;
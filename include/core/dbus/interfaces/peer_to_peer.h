@@ -0,0 +1,100 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_INTERFACES_PEER_TO_PEER_H_
+#define CORE_DBUS_INTERFACES_PEER_TO_PEER_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/message.h>
+#include <core/dbus/object.h>
+#include <core/dbus/server.h>
+
+#include <core/dbus/types/stl/string.h>
+
+#include <chrono>
+#include <string>
+
+namespace core
+{
+namespace dbus
+{
+namespace interfaces
+{
+/**
+ * @brief Negotiates the address of a Server over a regular bus connection.
+ *
+ * A service announces the address of its server on one of its objects, clients
+ * query it from the respective proxy object and connect with Bus::connect_to_peer.
+ */
+struct PeerToPeer
+{
+    struct Address
+    {
+        typedef PeerToPeer Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s{"Address"};
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::seconds{1};
+        }
+    };
+
+    /**
+     * @brief Answers queries for the address of server on object, which is exposed on bus.
+     */
+    inline static void announce(const Bus::Ptr& bus, const Object::Ptr& object, const Server::Ptr& server)
+    {
+        auto address = server->address();
+        object->install_method_handler<Address>([bus, address](const Message::Ptr& msg)
+        {
+            auto reply = Message::make_method_return(msg);
+            reply->writer() << address;
+            bus->send(reply);
+        });
+    }
+
+    /**
+     * @brief Queries the address announced on the remote object.
+     * @throw std::runtime_error if the query fails.
+     */
+    inline static std::string query(const Object::Ptr& object)
+    {
+        return object->invoke_method_synchronously<Address, std::string>().value();
+    }
+};
+}
+namespace traits
+{
+template<>
+struct Service<interfaces::PeerToPeer>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s{"core.dbus.PeerToPeer"};
+        return s;
+    }
+};
+}
+}
+}
+
+#endif // CORE_DBUS_INTERFACES_PEER_TO_PEER_H_
@@ -0,0 +1,154 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_INTERFACES_STREAM_H_
+#define CORE_DBUS_INTERFACES_STREAM_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/message.h>
+#include <core/dbus/object.h>
+#include <core/dbus/stream_channel.h>
+
+#include <core/dbus/types/unix_fd.h>
+#include <core/dbus/types/stl/tuple.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <tuple>
+
+namespace core
+{
+namespace dbus
+{
+namespace interfaces
+{
+/**
+ * @brief Negotiates a StreamChannel over a regular bus connection.
+ *
+ * The producing service exposes its channel on one of its objects, consumers
+ * open it from the respective proxy object. Afterwards, the bus only carries
+ * the requests of the consumer to resume a producer that ran out of space.
+ */
+struct Stream
+{
+    struct Open
+    {
+        typedef Stream Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s{"Open"};
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::seconds{1};
+        }
+    };
+
+    struct Resume
+    {
+        typedef Stream Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s{"Resume"};
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::seconds{1};
+        }
+    };
+
+    /**
+     * @brief Hands out channel to consumers of object, which is exposed on bus.
+     *
+     * on_resume is invoked whenever the consumer has made room after the producer ran out of space.
+     */
+    inline static void expose(
+            const Bus::Ptr& bus,
+            const Object::Ptr& object,
+            const StreamChannel::Ptr& channel,
+            const std::function<void()>& on_resume)
+    {
+        object->install_method_handler<Open>([bus, channel](const Message::Ptr& msg)
+        {
+            auto reply = Message::make_method_return(msg);
+            reply->writer() << std::make_tuple(channel->memory(), channel->notification());
+            bus->send(reply);
+        });
+
+        object->install_method_handler<Resume>([bus, on_resume](const Message::Ptr& msg)
+        {
+            if (on_resume)
+                on_resume();
+
+            bus->send(Message::make_method_return(msg));
+        });
+    }
+
+    /**
+     * @brief Attaches to the channel exposed on the remote object.
+     * @throw std::runtime_error if opening or attaching fails.
+     */
+    inline static StreamChannel::Ptr open(const Object::Ptr& object)
+    {
+        auto fds = object->invoke_method_synchronously<
+                Open,
+                std::tuple<types::UnixFd, types::UnixFd>>().value();
+
+        return StreamChannel::attach(std::get<0>(fds), std::get<1>(fds));
+    }
+
+    /**
+     * @brief Reads the records of channel on the loop of bus, asking object to resume whenever the producer waits for space.
+     *
+     * Reading stops once the returned handle is released.
+     */
+    inline static std::shared_ptr<void> read(
+            const Bus::Ptr& bus,
+            const Object::Ptr& object,
+            const StreamChannel::Ptr& channel,
+            const StreamChannel::RecordHandler& handler)
+    {
+        return channel->read_on(bus, handler, [object]()
+        {
+            object->invoke_method_asynchronously_with_callback<Resume, void>([](const Result<void>&) {});
+        });
+    }
+};
+}
+namespace traits
+{
+template<>
+struct Service<interfaces::Stream>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s{"core.dbus.Stream"};
+        return s;
+    }
+};
+}
+}
+}
+
+#endif // CORE_DBUS_INTERFACES_STREAM_H_
@@ -20,9 +20,11 @@
 
 #include <core/signal.h>
 
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <tuple>
-#include <map>
+#include <unordered_map>
 
 namespace core
 {
@@ -38,6 +40,40 @@ struct LifetimeConstraintTraits
     }
 };
 
+namespace detail
+{
+/**
+ * @brief Hashes keys of a ThreadSafeLifetimeConstrainedCache, combining the hashes of the elements of tuples.
+ */
+template<typename Key>
+struct CacheKeyHash : public std::hash<Key>
+{
+};
+
+template<typename... Args>
+struct CacheKeyHash<std::tuple<Args...>>
+{
+    template<std::size_t i>
+    static inline typename std::enable_if<i == sizeof...(Args), std::size_t>::type combine(const std::tuple<Args...>&, std::size_t seed)
+    {
+        return seed;
+    }
+
+    template<std::size_t i>
+    static inline typename std::enable_if<i < sizeof...(Args), std::size_t>::type combine(const std::tuple<Args...>& key, std::size_t seed)
+    {
+        typedef typename std::decay<typename std::tuple_element<i, std::tuple<Args...>>::type>::type Element;
+        seed ^= std::hash<Element>{}(std::get<i>(key)) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        return combine<i + 1>(key, seed);
+    }
+
+    inline std::size_t operator()(const std::tuple<Args...>& key) const
+    {
+        return combine<0>(key, 0);
+    }
+};
+}
+
 template<typename Key, typename Value>
 class ThreadSafeLifetimeConstrainedCache
 {
@@ -109,7 +145,7 @@ public:
 
 private:
     mutable std::mutex guard;
-    std::map<Key, std::tuple<std::weak_ptr<Value>, core::Connection>> cache;
+    std::unordered_map<Key, std::tuple<std::weak_ptr<Value>, core::Connection>, detail::CacheKeyHash<Key>> cache;
 };
 }
 }
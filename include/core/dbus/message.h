@@ -25,6 +25,7 @@
 #include <core/dbus/types/signature.h>
 #include <core/dbus/types/unix_fd.h>
 
+#include <cstddef>
 #include <exception>
 #include <map>
 #include <memory>
@@ -37,6 +38,12 @@ namespace dbus
 {
 template<typename T> struct Codec;
 class Error;
+namespace native
+{
+class Body;
+class Connection;
+class Marshaller;
+}
 
 /**
  * @brief The Message class wraps a raw DBus message
@@ -63,7 +70,36 @@ public:
      */
     class Reader
     {
+        struct Private;
+
     public:
+        /**
+         * @brief Skips per-value type checks while decoding an argument of known signature.
+         *
+         * Readers obtained from Message::reader() keep track of their position within the
+         * signature of the message. If the message continues with the given signature there,
+         * type checks are skipped until commit() is called, apart from the contents of variants.
+         * Otherwise, and for all other readers, decoding is checked as usual.
+         */
+        class Trusted
+        {
+        public:
+            Trusted(Reader& reader, const std::string& signature);
+            ~Trusted();
+
+            Trusted(const Trusted&) = delete;
+            Trusted& operator=(const Trusted&) = delete;
+
+            /**
+             * @brief Marks the argument as decoded completely, advancing the position within the signature.
+             */
+            void commit();
+
+        private:
+            Private* d;
+            std::size_t size;
+        };
+
         Reader();
         ~Reader();
 
@@ -73,12 +109,24 @@ public:
         Reader(Reader&&);
         Reader& operator=(Reader&&);
 
+        /**
+          * @brief Returns a view positioned at the same argument, advancing independently of this instance.
+          *
+          * In contrast, copies of a Reader share their position.
+          */
+        Reader copy() const;
+
         /**
           * @brief Returns the current type.
           *
           */
         ArgumentType type() const;
 
+        /**
+          * @brief Returns the signature of the argument at the current position.
+          */
+        std::string signature() const;
+
         /**
           * @brief Advances this view into the message.
           */
@@ -149,6 +197,14 @@ public:
          */
         types::UnixFd pop_unix_fd();
 
+        /**
+         * @brief Reads an array of fixed-size values from the underlying message in one go.
+         * @param [in] element_type The type of the elements, a fixed-size type other than unix fd.
+         * @param [out] count Receives the number of elements.
+         * @return Points to the elements in host byte order, valid as long as the message is alive.
+         */
+        const void* pop_fixed_array(ArgumentType element_type, std::size_t& count);
+
         /**
          * @brief Prepares reading of an array from the underlying message.
          * @return A reader pointing to the array.
@@ -179,7 +235,6 @@ public:
 
         const std::shared_ptr<Message>& access_message();
 
-        struct Private;
         std::shared_ptr<Private> d;
     };
 
@@ -261,6 +316,14 @@ public:
          */
         void push_unix_fd(const types::UnixFd& value);
 
+        /**
+         * @brief Writes an array of fixed-size values to the underlying message in one go.
+         * @param [in] element_type The type of the elements, a fixed-size type other than unix fd.
+         * @param [in] data Points to count elements in host byte order.
+         * @param [in] count The number of elements.
+         */
+        void push_fixed_array(ArgumentType element_type, const void* data, std::size_t count);
+
         /**
          * @brief Prepares writing of an array to the underlying message.
          * @param [in] signature The signature of the contained data type.
@@ -391,6 +454,13 @@ public:
      */
     std::string signature() const;
 
+    /**
+     * @brief Checks whether the arguments of this message start with the given complete types, without allocating.
+     *
+     * Complete types are never prefixes of one another, trailing arguments are accepted.
+     */
+    bool signature_starts_with(const std::string& signature) const;
+
     /**
      * @brief Queries the interface name that this message corresponds to.
      */
@@ -422,6 +492,13 @@ public:
      */
     Writer writer();
 
+    /**
+     * @brief Creates a copy of this message, including its header fields and body, e.g., to reuse a prototype.
+     *
+     * The copy has no serial and can be modified and sent independently of this instance.
+     */
+    std::shared_ptr<Message> clone() const;
+
     /**
      * @brief Meant for testing purposes only.
      */
@@ -429,13 +506,17 @@ public:
 
 private:
     friend class Bus;
-
-    std::shared_ptr<Message> clone();
+    friend class native::Body;
+    friend class native::Connection;
+    friend class native::Marshaller;
 
     struct Private;
     std::unique_ptr<Private> d;
 
     Message(std::unique_ptr<Private> d);
+
+    // Wraps d in a new instance, recycling the memory of released instances of the calling thread.
+    static std::shared_ptr<Message> wrap(std::unique_ptr<Private> d);
 };
 typedef std::shared_ptr<Message> MessagePtr;
 typedef std::unique_ptr<Message> MessageUPtr;
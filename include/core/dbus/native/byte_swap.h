@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_NATIVE_BYTE_SWAP_H_
+#define CORE_DBUS_NATIVE_BYTE_SWAP_H_
+
+#include <core/dbus/validation.h>
+#include <core/dbus/visibility.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+/**
+ * @brief Reverses the byte order of count values of size bytes each, in place.
+ *
+ * Sizes of 2, 4 and 8 bytes are swapped a vector at a time, the implementation is chosen
+ * at runtime as for the validators, see validation::Isa. Other sizes are left untouched.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC void swap_byte_order(void* data, std::size_t count, std::size_t size);
+
+/**
+ * @brief Runs the given implementation of swap_byte_order, e.g., for testing and benchmarking.
+ * @throw std::runtime_error if the implementation is not supported by the CPU.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC void swap_byte_order(validation::Isa isa, void* data, std::size_t count, std::size_t size);
+
+namespace detail
+{
+template<std::size_t size>
+struct ByteSwap;
+
+template<>
+struct ByteSwap<1>
+{
+    typedef std::uint8_t Type;
+    static inline Type swap(Type value) { return value; }
+};
+
+template<>
+struct ByteSwap<2>
+{
+    typedef std::uint16_t Type;
+    static inline Type swap(Type value) { return __builtin_bswap16(value); }
+};
+
+template<>
+struct ByteSwap<4>
+{
+    typedef std::uint32_t Type;
+    static inline Type swap(Type value) { return __builtin_bswap32(value); }
+};
+
+template<>
+struct ByteSwap<8>
+{
+    typedef std::uint64_t Type;
+    static inline Type swap(Type value) { return __builtin_bswap64(value); }
+};
+}
+
+/**
+ * @brief Returns value with its byte order reversed.
+ */
+template<typename T>
+inline T swapped_byte_order(T value)
+{
+    static_assert(std::is_arithmetic<T>::value, "Only fixed-size values can be swapped.");
+
+    typename detail::ByteSwap<sizeof(T)>::Type u;
+    std::memcpy(&u, &value, sizeof(T));
+    u = detail::ByteSwap<sizeof(T)>::swap(u);
+    std::memcpy(&value, &u, sizeof(T));
+
+    return value;
+}
+}
+}
+}
+
+#endif // CORE_DBUS_NATIVE_BYTE_SWAP_H_
@@ -0,0 +1,498 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_NATIVE_CODEC_H_
+#define CORE_DBUS_NATIVE_CODEC_H_
+
+#include <core/dbus/native/demarshaller.h>
+#include <core/dbus/native/marshaller.h>
+
+#include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/struct.h>
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace core
+{
+namespace dbus
+{
+namespace helper
+{
+template<>
+struct TypeMapper<native::VariantView>
+{
+    constexpr inline static ArgumentType type_value()
+    {
+        return ArgumentType::variant;
+    }
+    constexpr inline static bool is_basic_type()
+    {
+        return true;
+    }
+    constexpr inline static bool requires_signature()
+    {
+        return true;
+    }
+
+    inline static std::string signature()
+    {
+        return DBUS_TYPE_VARIANT_AS_STRING;
+    }
+};
+}
+
+namespace native
+{
+/**
+ * @brief Specifies encoding of T to and decoding of T from the DBus wire format, mirroring core::dbus::Codec.
+ *
+ * Specializations are provided for all fixed-size types, strings, object paths,
+ * signatures, arrays, maps and structures. Variants can only be decoded, to a
+ * VariantView. Unix fds are not supported.
+ *
+ * Decoding does not check the type of individual values, callers have to make
+ * sure that the signature of the decoded buffer matches, see decode_message.
+ *
+ * @tparam T The type for which encoding and decoding should be specified.
+ */
+template<typename T>
+struct Codec;
+
+namespace detail
+{
+// Fixed-size types whose in-memory representation equals their wire format
+// in host byte order, such that arrays of them can be copied in one go.
+template<typename T>
+struct IsLaidOutAsOnTheWire
+{
+    static constexpr bool value =
+            std::is_same<T, std::int8_t>::value ||
+            std::is_same<T, std::int16_t>::value ||
+            std::is_same<T, std::uint16_t>::value ||
+            std::is_same<T, std::int32_t>::value ||
+            std::is_same<T, std::uint32_t>::value ||
+            std::is_same<T, std::int64_t>::value ||
+            std::is_same<T, std::uint64_t>::value ||
+            std::is_same<T, double>::value;
+};
+
+template<typename T>
+constexpr inline std::size_t alignment_of()
+{
+    return native::alignment_of(helper::TypeMapper<T>::type_value());
+}
+
+template<typename T, bool contiguous = IsLaidOutAsOnTheWire<T>::value>
+struct ArrayElements
+{
+    template<typename Container>
+    inline static void encode(Marshaller& out, const Container& container)
+    {
+        for (const auto& element : container)
+            Codec<T>::encode_argument(out, element);
+    }
+
+    inline static void decode(Demarshaller& in, const Demarshaller::Array& array, std::vector<T>& container)
+    {
+        container.clear();
+        while (!in.is_at_end_of(array))
+        {
+            container.emplace_back();
+            Codec<T>::decode_argument(in, container.back());
+        }
+    }
+};
+
+template<typename T>
+struct ArrayElements<T, true>
+{
+    inline static void encode(Marshaller& out, const std::vector<T>& container)
+    {
+        out.push_fixed_array(container.data(), container.size());
+    }
+
+    inline static void decode(Demarshaller& in, const Demarshaller::Array& array, std::vector<T>& container)
+    {
+        in.pop_fixed_array(array, container);
+    }
+
+    template<typename Container>
+    inline static void encode(Marshaller& out, const Container& container)
+    {
+        for (const auto& element : container)
+            Codec<T>::encode_argument(out, element);
+    }
+};
+
+template<typename Tuple, std::size_t n, std::size_t size>
+struct TupleElements
+{
+    inline static void encode(Marshaller& out, const Tuple& t)
+    {
+        typedef typename std::tuple_element<size-n, Tuple>::type ElementType;
+        Codec<typename std::decay<ElementType>::type>::encode_argument(out, std::get<size-n>(t));
+        TupleElements<Tuple, n-1, size>::encode(out, t);
+    }
+
+    inline static void decode(Demarshaller& in, Tuple& t)
+    {
+        typedef typename std::tuple_element<size-n, Tuple>::type ElementType;
+        Codec<typename std::decay<ElementType>::type>::decode_argument(in, std::get<size-n>(t));
+        TupleElements<Tuple, n-1, size>::decode(in, t);
+    }
+};
+
+template<typename Tuple, std::size_t size>
+struct TupleElements<Tuple, 0, size>
+{
+    inline static void encode(Marshaller&, const Tuple&)
+    {
+    }
+
+    inline static void decode(Demarshaller&, Tuple&)
+    {
+    }
+};
+}
+
+// Fixed-size types map one to one onto the respective functions of the marshaller and demarshaller.
+#define CORE_DBUS_NATIVE_FIXED_CODEC(Type, push, pop) \
+    template<> \
+    struct Codec<Type> \
+    { \
+        inline static void encode_argument(Marshaller& out, Type value) \
+        { \
+            out.push(value); \
+        } \
+        inline static void decode_argument(Demarshaller& in, Type& value) \
+        { \
+            value = static_cast<Type>(in.pop()); \
+        } \
+    };
+
+CORE_DBUS_NATIVE_FIXED_CODEC(std::int8_t, push_byte, pop_byte)
+CORE_DBUS_NATIVE_FIXED_CODEC(bool, push_boolean, pop_boolean)
+CORE_DBUS_NATIVE_FIXED_CODEC(std::int16_t, push_int16, pop_int16)
+CORE_DBUS_NATIVE_FIXED_CODEC(std::uint16_t, push_uint16, pop_uint16)
+CORE_DBUS_NATIVE_FIXED_CODEC(std::int32_t, push_int32, pop_int32)
+CORE_DBUS_NATIVE_FIXED_CODEC(std::uint32_t, push_uint32, pop_uint32)
+CORE_DBUS_NATIVE_FIXED_CODEC(std::int64_t, push_int64, pop_int64)
+CORE_DBUS_NATIVE_FIXED_CODEC(std::uint64_t, push_uint64, pop_uint64)
+CORE_DBUS_NATIVE_FIXED_CODEC(double, push_floating_point, pop_floating_point)
+CORE_DBUS_NATIVE_FIXED_CODEC(float, push_floating_point, pop_floating_point)
+
+#undef CORE_DBUS_NATIVE_FIXED_CODEC
+
+/**
+ * @brief Template specialization for string argument types.
+ */
+template<>
+struct Codec<std::string>
+{
+    inline static void encode_argument(Marshaller& out, const std::string& arg)
+    {
+        out.push_string(arg);
+    }
+
+    inline static void decode_argument(Demarshaller& in, std::string& arg)
+    {
+        auto view = in.pop_string();
+        arg.assign(view.data, view.size);
+    }
+};
+
+/**
+ * @brief Template specialization for object path argument types.
+ */
+template<>
+struct Codec<types::ObjectPath>
+{
+    inline static void encode_argument(Marshaller& out, const types::ObjectPath& arg)
+    {
+        out.push_object_path(arg);
+    }
+
+    inline static void decode_argument(Demarshaller& in, types::ObjectPath& arg)
+    {
+        arg = types::ObjectPath{in.pop_object_path().to_string()};
+    }
+};
+
+/**
+ * @brief Template specialization for signature argument types.
+ */
+template<>
+struct Codec<types::Signature>
+{
+    inline static void encode_argument(Marshaller& out, const types::Signature& arg)
+    {
+        out.push_signature(arg);
+    }
+
+    inline static void decode_argument(Demarshaller& in, types::Signature& arg)
+    {
+        arg = types::Signature{in.pop_signature().to_string()};
+    }
+};
+
+/**
+ * @brief Template specialization for variants, which are decoded lazily.
+ */
+template<>
+struct Codec<VariantView>
+{
+    inline static void decode_argument(Demarshaller& in, VariantView& arg)
+    {
+        arg = in.pop_variant();
+    }
+};
+
+/**
+ * @brief Template specialization for vector argument types, copying fixed-size elements in one go.
+ */
+template<typename T>
+struct Codec<std::vector<T>>
+{
+    inline static void encode_argument(Marshaller& out, const std::vector<T>& arg)
+    {
+        auto array = out.open_array(detail::alignment_of<T>());
+        {
+            detail::ArrayElements<T>::encode(out, arg);
+        }
+        out.close_array(array);
+    }
+
+    inline static void decode_argument(Demarshaller& in, std::vector<T>& arg)
+    {
+        auto array = in.open_array(detail::alignment_of<T>());
+        detail::ArrayElements<T>::decode(in, array, arg);
+    }
+};
+
+/**
+ * @brief Template specialization for dict entry argument types.
+ */
+template<typename T, typename U>
+struct Codec<std::pair<T, U>>
+{
+    inline static void encode_argument(Marshaller& out, const std::pair<T, U>& arg)
+    {
+        out.open_dict_entry();
+        Codec<typename std::decay<T>::type>::encode_argument(out, arg.first);
+        Codec<typename std::decay<U>::type>::encode_argument(out, arg.second);
+    }
+
+    inline static void decode_argument(Demarshaller& in, std::pair<T, U>& arg)
+    {
+        in.open_dict_entry();
+        Codec<typename std::decay<T>::type>::decode_argument(in, arg.first);
+        Codec<typename std::decay<U>::type>::decode_argument(in, arg.second);
+    }
+};
+
+/**
+ * @brief Template specialization for map argument types.
+ */
+template<typename T, typename U>
+struct Codec<std::map<T, U>>
+{
+    inline static void encode_argument(Marshaller& out, const std::map<T, U>& arg)
+    {
+        auto array = out.open_array(8);
+        {
+            for (const auto& element : arg)
+            {
+                out.open_dict_entry();
+                Codec<T>::encode_argument(out, element.first);
+                Codec<U>::encode_argument(out, element.second);
+            }
+        }
+        out.close_array(array);
+    }
+
+    inline static void decode_argument(Demarshaller& in, std::map<T, U>& arg)
+    {
+        arg.clear();
+
+        auto array = in.open_array(8);
+        while (!in.is_at_end_of(array))
+        {
+            in.open_dict_entry();
+
+            T key; U value;
+            Codec<T>::decode_argument(in, key);
+            Codec<U>::decode_argument(in, value);
+
+            // Senders usually emit sorted keys, making insertion at the end cheap.
+            arg.emplace_hint(arg.end(), std::move(key), std::move(value));
+        }
+    }
+};
+
+/**
+ * @brief Template specialization for tuple argument types, encoding the elements one after the other.
+ */
+template<typename... Args>
+struct Codec<std::tuple<Args...>>
+{
+    inline static void encode_argument(Marshaller& out, const std::tuple<Args...>& arg)
+    {
+        detail::TupleElements<std::tuple<Args...>, sizeof...(Args), sizeof...(Args)>::encode(out, arg);
+    }
+
+    inline static void decode_argument(Demarshaller& in, std::tuple<Args...>& arg)
+    {
+        detail::TupleElements<std::tuple<Args...>, sizeof...(Args), sizeof...(Args)>::decode(in, arg);
+    }
+};
+
+/**
+ * @brief Template specialization for structure argument types.
+ */
+template<typename T>
+struct Codec<types::Struct<T>>
+{
+    inline static void encode_argument(Marshaller& out, const types::Struct<T>& arg)
+    {
+        out.open_structure();
+        Codec<T>::encode_argument(out, arg.value);
+    }
+
+    inline static void decode_argument(Demarshaller& in, types::Struct<T>& arg)
+    {
+        in.open_structure();
+        Codec<T>::decode_argument(in, arg.value);
+    }
+};
+
+/**
+ * @brief Special overload to end compile-time recursion.
+ */
+inline void encode_message(Marshaller&) {}
+
+/**
+ * @brief Compile-time recursion to encode a parameter pack to the DBus wire format.
+ * @throw std::runtime_error as propagated by Codec<Arg>::encode_argument.
+ */
+template<typename Arg, typename... Args>
+inline void encode_message(Marshaller& out, const Arg& arg, const Args&... params)
+{
+    Codec<typename std::decay<Arg>::type>::encode_argument(out, arg);
+    encode_message(out, params...);
+}
+
+namespace detail
+{
+inline std::string signature_of()
+{
+    return std::string{};
+}
+
+template<typename Arg, typename... Args>
+inline std::string signature_of(const Arg&, const Args&... args)
+{
+    return helper::TypeMapper<typename std::decay<Arg>::type>::signature() + signature_of(args...);
+}
+
+// Computes the signature of a parameter pack once per instantiation.
+template<typename... Args>
+inline const std::string& cached_signature_of(const Args&... args)
+{
+    static const std::string signature = signature_of(args...);
+    return signature;
+}
+}
+
+/**
+ * @brief Encodes args natively and creates a message with the header of prototype carrying them.
+ * @throw std::runtime_error if encoding fails or the resulting message is invalid.
+ */
+template<typename... Args>
+inline Message::Ptr make_message(const Message::Ptr& prototype, const Args&... args)
+{
+    Marshaller out;
+    encode_message(out, args...);
+
+    // Validated once per instantiation.
+    static const types::Signature signature{detail::signature_of(args...)};
+    return out.make_message(prototype, signature);
+}
+
+/**
+ * @brief Special overload to end compile-time recursion.
+ */
+inline void decode_message(Demarshaller&) {}
+
+/**
+ * @brief Compile-time recursion to decode a parameter pack from the DBus wire format.
+ *
+ * The types of the values are not checked, decode_message(const Body&, Args&...) does so once.
+ *
+ * @throw std::runtime_error as propagated by Codec<Arg>::decode_argument.
+ */
+template<typename Arg, typename... Args>
+inline void decode_message(Demarshaller& in, Arg& arg, Args&... params)
+{
+    Codec<typename std::decay<Arg>::type>::decode_argument(in, arg);
+    decode_message(in, params...);
+}
+
+/**
+ * @brief Checks the signature of body against args once and decodes it natively.
+ * @throw std::runtime_error if the signature does not match or the body is truncated.
+ */
+template<typename... Args>
+inline void decode_message(const Body& body, Args&... args)
+{
+    const auto& expected = detail::cached_signature_of(args...);
+    if (body.signature().as_string() != expected)
+        throw std::runtime_error(
+                "Signature mismatch, expected " + expected +
+                " but body has " + body.signature().as_string());
+
+    auto in = body.demarshaller();
+    decode_message(in, args...);
+}
+
+template<typename T>
+inline T VariantView::as() const
+{
+    if (!(signature == helper::TypeMapper<T>::signature()))
+        throw std::runtime_error(
+                "Variant contains " + signature.to_string() +
+                " instead of " + helper::TypeMapper<T>::signature());
+
+    T result;
+    Demarshaller in{data, size, offset, swapped};
+    Codec<T>::decode_argument(in, result);
+    return result;
+}
+}
+}
+}
+
+#endif // CORE_DBUS_NATIVE_CODEC_H_
@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_NATIVE_CONNECTION_H_
+#define CORE_DBUS_NATIVE_CONNECTION_H_
+
+#include <core/dbus/message.h>
+#include <core/dbus/visibility.h>
+#include <core/dbus/well_known_bus.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+/**
+ * @brief A connection to a bus that speaks the DBus protocol directly over a unix socket.
+ *
+ * Authentication (SASL EXTERNAL), the Hello handshake, message framing, serial
+ * tracking and passing of unix fds are implemented without a DBusConnection.
+ * Messages are still created and inspected with core::dbus::Message.
+ *
+ * Sending is thread-safe and lock-free: Messages are pushed onto a queue, and the
+ * first thread finding no write in progress writes out all queued messages in as
+ * few system calls as possible. Reading is meant to be done by one thread at a time.
+ *
+ * The connection does not dispatch messages to objects or track pending calls,
+ * refer to Bus::connect_natively for a bus on top of it.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Connection
+{
+public:
+    typedef std::shared_ptr<Connection> Ptr;
+
+    /** @brief A message read from the connection. */
+    struct Incoming
+    {
+        /** @brief The message, its unix fd arguments index into fds. */
+        Message::Ptr message;
+        /** @brief The serial the sender assigned to the message. */
+        std::uint32_t serial;
+        /** @brief The serial of the message this message replies to, 0 if not a reply. */
+        std::uint32_t reply_serial;
+        /** @brief Unix fds received with the message, ownership passes to the caller. */
+        std::vector<int> fds;
+    };
+
+    /**
+     * @brief Connects and authenticates to one of the well-known buses.
+     * @throw std::runtime_error if the address of the bus is unknown or connecting fails.
+     */
+    static Ptr open(WellKnownBus bus);
+
+    /**
+     * @brief Connects and authenticates to the first reachable unix socket listed in address.
+     * @throw std::runtime_error if address is malformed or connecting fails.
+     */
+    static Ptr open(const std::string& address);
+
+    Connection(const Connection&) = delete;
+    ~Connection();
+
+    Connection& operator=(const Connection&) = delete;
+    bool operator==(const Connection&) const = delete;
+
+    /** @brief The unique name assigned to the connection by the bus. */
+    const std::string& unique_name() const;
+
+    /** @brief Whether the peer agreed to passing unix fds. */
+    bool can_pass_unix_fds() const;
+
+    /** @brief The underlying socket, e.g. for polling for readability. */
+    int fd() const;
+
+    /**
+     * @brief Assigns a serial to msg and queues it for sending.
+     *
+     * msg cannot be modified afterwards. If msg carries unix fd arguments, fds has to
+     * contain the respective fds in the order they were appended. The fds are not
+     * closed by the connection.
+     *
+     * @return The serial assigned to msg.
+     * @throw std::runtime_error if msg is null, fds do not match msg or the connection is broken.
+     */
+    std::uint32_t send(const Message::Ptr& msg, const std::vector<int>& fds = std::vector<int>{});
+
+    /**
+     * @brief Reserves a serial for a message that is sent later on with send_with_serial.
+     *
+     * Replies might arrive before send returns, reserving the serial up front allows
+     * for tracking the reply before the message goes out.
+     */
+    std::uint32_t allocate_serial();
+
+    /**
+     * @brief Queues msg for sending with a serial obtained from allocate_serial.
+     * @throw std::runtime_error under the same conditions as send.
+     */
+    void send_with_serial(const Message::Ptr& msg, std::uint32_t serial, const std::vector<int>& fds = std::vector<int>{});
+
+    /**
+     * @brief Blocks until a complete message has been read.
+     * @throw std::runtime_error if the connection is closed or the peer sends malformed data.
+     */
+    Incoming read();
+
+    /**
+     * @brief Shuts down the connection, unblocking threads that are reading.
+     */
+    void close();
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+
+    Connection(std::unique_ptr<Private> d);
+};
+}
+}
+}
+
+#endif // CORE_DBUS_NATIVE_CONNECTION_H_
@@ -0,0 +1,401 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_NATIVE_DEMARSHALLER_H_
+#define CORE_DBUS_NATIVE_DEMARSHALLER_H_
+
+#include <core/dbus/message.h>
+#include <core/dbus/visibility.h>
+
+#include <core/dbus/native/byte_swap.h>
+
+#include <core/dbus/types/signature.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+/**
+ * @brief Refers to a string within a buffer without copying it.
+ */
+struct ORG_FREEDESKTOP_DBUS_DLL_PUBLIC StringView
+{
+    inline std::string to_string() const
+    {
+        return std::string(data, size);
+    }
+
+    inline bool operator==(const std::string& rhs) const
+    {
+        return rhs.size() == size && std::memcmp(rhs.data(), data, size) == 0;
+    }
+
+    /** @brief Start of the string, null-terminated. */
+    const char* data;
+    /** @brief Length of the string, excluding the terminating null. */
+    std::size_t size;
+};
+
+/**
+ * @brief Refers to a value contained in a variant without decoding or copying it.
+ *
+ * The view is only valid as long as the buffer it was read from is alive.
+ */
+struct ORG_FREEDESKTOP_DBUS_DLL_PUBLIC VariantView
+{
+    /**
+     * @brief Decodes the contained value.
+     * @throw std::runtime_error if the contained value is not of type T.
+     */
+    template<typename T>
+    T as() const;
+
+    /** @brief The signature of the contained value. */
+    StringView signature;
+    /** @brief The buffer containing the value. */
+    const std::uint8_t* data;
+    /** @brief The size of the buffer containing the value. */
+    std::size_t size;
+    /** @brief Offset of the contained value within the buffer. */
+    std::size_t offset;
+    /** @brief Whether the buffer is in the opposite of host byte order. */
+    bool swapped;
+};
+
+/**
+ * @brief Reads values in the DBus wire format from a contiguous buffer, bypassing libdbus.
+ *
+ * The buffer is expected to start 8-byte aligned relative to the start of the message,
+ * as is the case for message bodies. Buffers in the opposite of host byte order, e.g.,
+ * sent by peers of different endianness, are swapped while reading, arrays of
+ * fixed-size values in bulk. Reads are checked against the bounds of the buffer, but
+ * neither strings nor the type of values are validated: Callers are expected to check
+ * the signature of the buffer once.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Demarshaller
+{
+public:
+    /** @brief Handle to an array that is being read. */
+    struct Array
+    {
+        /** @brief Offset of the first byte following the array. */
+        std::size_t end;
+    };
+
+    /**
+     * @brief Creates a demarshaller reading size bytes from data, which has to outlive the instance.
+     *
+     * Reading starts at offset, alignment is always relative to data. If swapped is true,
+     * data is in the opposite of host byte order.
+     */
+    inline Demarshaller(const std::uint8_t* data, std::size_t size, std::size_t offset = 0, bool swapped = false)
+        : data(data),
+          size_(size),
+          offset_(offset),
+          swapped(swapped)
+    {
+    }
+
+    inline std::uint8_t pop_byte()
+    {
+        return pop_fixed<std::uint8_t>();
+    }
+
+    inline bool pop_boolean()
+    {
+        return pop_fixed<std::uint32_t>() != 0;
+    }
+
+    inline std::int16_t pop_int16()
+    {
+        return pop_fixed<std::int16_t>();
+    }
+
+    inline std::uint16_t pop_uint16()
+    {
+        return pop_fixed<std::uint16_t>();
+    }
+
+    inline std::int32_t pop_int32()
+    {
+        return pop_fixed<std::int32_t>();
+    }
+
+    inline std::uint32_t pop_uint32()
+    {
+        return pop_fixed<std::uint32_t>();
+    }
+
+    inline std::int64_t pop_int64()
+    {
+        return pop_fixed<std::int64_t>();
+    }
+
+    inline std::uint64_t pop_uint64()
+    {
+        return pop_fixed<std::uint64_t>();
+    }
+
+    inline double pop_floating_point()
+    {
+        return pop_fixed<double>();
+    }
+
+    /**
+     * @brief Reads a string, the returned view refers to the underlying buffer.
+     */
+    inline StringView pop_string()
+    {
+        std::size_t size = pop_uint32();
+        ensure_available(size + 1);
+
+        StringView result{reinterpret_cast<const char*>(data + offset_), size};
+        offset_ += size + 1;
+        return result;
+    }
+
+    inline StringView pop_object_path()
+    {
+        return pop_string();
+    }
+
+    inline StringView pop_signature()
+    {
+        std::size_t size = pop_byte();
+        ensure_available(size + 1);
+
+        StringView result{reinterpret_cast<const char*>(data + offset_), size};
+        offset_ += size + 1;
+        return result;
+    }
+
+    /**
+     * @brief Starts reading an array whose elements have the given alignment.
+     * @throw std::runtime_error if the array exceeds the buffer.
+     */
+    inline Array open_array(std::size_t element_alignment)
+    {
+        std::size_t length = pop_uint32();
+        align(element_alignment);
+        ensure_available(length);
+        return Array{offset_ + length};
+    }
+
+    /**
+     * @brief Checks whether all elements of array have been read.
+     */
+    inline bool is_at_end_of(const Array& array) const
+    {
+        return offset_ >= array.end;
+    }
+
+    /**
+     * @brief Reads all elements of an array of fixed-size values in one go.
+     *
+     * The in-memory layout of such values matches the wire format in host byte order,
+     * values in the opposite byte order are swapped in bulk after copying.
+     */
+    template<typename T>
+    inline void pop_fixed_array(const Array& array, std::vector<T>& values)
+    {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                      "Only fixed-size types apart from bool are laid out as on the wire.");
+
+        auto length = array.end - offset_;
+        if (length % sizeof(T) != 0)
+            throw std::runtime_error("Demarshaller: Array length is not a multiple of its element size.");
+
+        values.resize(length / sizeof(T));
+        if (length > 0)
+            std::memcpy(values.data(), data + offset_, length);
+        if (swapped)
+            swap_byte_order(values.data(), values.size(), sizeof(T));
+        offset_ = array.end;
+    }
+
+    inline void open_structure()
+    {
+        align(8);
+    }
+
+    inline void open_dict_entry()
+    {
+        align(8);
+    }
+
+    /**
+     * @brief Starts reading a variant.
+     * @return The signature of the value contained in the variant.
+     */
+    inline StringView open_variant()
+    {
+        return pop_signature();
+    }
+
+    /**
+     * @brief Reads a variant without decoding the contained value, which is skipped.
+     */
+    inline VariantView pop_variant()
+    {
+        auto signature = pop_signature();
+        auto offset = offset_;
+        skip(signature.data);
+
+        return VariantView{signature, data, size_, offset, swapped};
+    }
+
+    /**
+     * @brief Skips all values described by signature.
+     * @throw std::runtime_error if the signature is malformed or values exceed the buffer.
+     */
+    void skip(const types::Signature& signature);
+
+    /**
+     * @brief Skips all values described by the null-terminated signature.
+     * @throw std::runtime_error if the signature is malformed or values exceed the buffer.
+     */
+    void skip(const char* signature);
+
+    /** @brief The offset of the next value, relative to the start of the buffer. */
+    inline std::size_t offset() const
+    {
+        return offset_;
+    }
+
+    /** @brief The size of the underlying buffer. */
+    inline std::size_t size() const
+    {
+        return size_;
+    }
+
+    /** @brief Whether the buffer is in the opposite of host byte order. */
+    inline bool is_swapped() const
+    {
+        return swapped;
+    }
+
+private:
+    inline void ensure_available(std::size_t bytes) const
+    {
+        if (bytes > size_ - offset_)
+            throw std::runtime_error("Demarshaller: Read exceeds buffer.");
+    }
+
+    inline void align(std::size_t alignment)
+    {
+        auto aligned = (offset_ + alignment - 1) & ~(alignment - 1);
+        if (aligned > size_)
+            throw std::runtime_error("Demarshaller: Read exceeds buffer.");
+        offset_ = aligned;
+    }
+
+    template<typename T>
+    inline T pop_fixed()
+    {
+        align(sizeof(T));
+        ensure_available(sizeof(T));
+
+        T result;
+        std::memcpy(&result, data + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return swapped ? swapped_byte_order(result) : result;
+    }
+
+    const char* skip_complete_type(const char* signature);
+
+    const std::uint8_t* data;
+    std::size_t size_;
+    std::size_t offset_;
+    bool swapped;
+};
+
+/**
+ * @brief The body of a message in the DBus wire format, together with its signature.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Body
+{
+public:
+    /**
+     * @brief Marshals msg in one go and provides access to its body.
+     *
+     * Outgoing messages cannot be modified afterwards. Messages received from peers of
+     * different endianness keep their byte order, until inspected by libdbus.
+     *
+     * @throw std::runtime_error if msg is null or cannot be marshalled.
+     */
+    static Body from_message(const Message::Ptr& msg);
+
+    /**
+     * @brief Creates a body referring to size bytes starting at data, kept alive by storage.
+     *
+     * If swapped is true, data is in the opposite of host byte order.
+     */
+    Body(const std::shared_ptr<const std::uint8_t>& storage,
+         const std::uint8_t* data,
+         std::size_t size,
+         const types::Signature& signature,
+         bool swapped = false);
+
+    /** @brief A demarshaller positioned at the first value of the body. */
+    inline Demarshaller demarshaller() const
+    {
+        return Demarshaller{data_, size_, 0, swapped};
+    }
+
+    inline const types::Signature& signature() const
+    {
+        return signature_;
+    }
+
+    inline const std::uint8_t* data() const
+    {
+        return data_;
+    }
+
+    inline std::size_t size() const
+    {
+        return size_;
+    }
+
+    /** @brief Whether the body is in the opposite of host byte order. */
+    inline bool is_swapped() const
+    {
+        return swapped;
+    }
+
+private:
+    std::shared_ptr<const std::uint8_t> storage;
+    const std::uint8_t* data_;
+    std::size_t size_;
+    types::Signature signature_;
+    bool swapped;
+};
+}
+}
+}
+
+#endif // CORE_DBUS_NATIVE_DEMARSHALLER_H_
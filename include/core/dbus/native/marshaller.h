@@ -0,0 +1,350 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_NATIVE_MARSHALLER_H_
+#define CORE_DBUS_NATIVE_MARSHALLER_H_
+
+#include <core/dbus/argument_type.h>
+#include <core/dbus/message.h>
+#include <core/dbus/validation.h>
+#include <core/dbus/visibility.h>
+
+#include <core/dbus/types/object_path.h>
+#include <core/dbus/types/signature.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+/**
+ * @brief Alignment of values of the given type in the DBus wire format.
+ */
+constexpr inline std::size_t alignment_of(ArgumentType type)
+{
+    return type == ArgumentType::byte || type == ArgumentType::signature || type == ArgumentType::variant ? 1 :
+           type == ArgumentType::int16 || type == ArgumentType::uint16 ? 2 :
+           type == ArgumentType::int64 || type == ArgumentType::uint64 || type == ArgumentType::floating_point ? 8 :
+           type == ArgumentType::structure || type == ArgumentType::dictionary_entry ? 8 :
+           4;
+}
+
+/**
+ * @brief Alignment of the first complete type in signature, '(' and '{' start structures and dict entries.
+ */
+inline std::size_t alignment_of(const std::string& signature)
+{
+    if (signature.empty())
+        return 1;
+
+    switch (signature[0])
+    {
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+        return 8;
+    default:
+        return alignment_of(static_cast<ArgumentType>(signature[0]));
+    }
+}
+
+/**
+ * @brief Writes values in the DBus wire format to a contiguous buffer, bypassing libdbus.
+ *
+ * Values are written in host byte order, aligned relative to the start of the buffer,
+ * which makes the buffer suitable as the body of a message. Strings are validated when
+ * written, object paths and signatures when constructed, such that malformed values are
+ * reported right away rather than when the buffer is turned into a message.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Marshaller
+{
+public:
+    /** @brief Handle to an array that has been opened but not yet closed. */
+    struct Array
+    {
+        /** @brief Offset of the length of the array. */
+        std::size_t length;
+        /** @brief Offset of the first element of the array. */
+        std::size_t begin;
+    };
+
+    /**
+     * @brief Creates a marshaller with an initial buffer of capacity bytes.
+     */
+    explicit Marshaller(std::size_t capacity = 256);
+
+    Marshaller(const Marshaller&) = delete;
+    Marshaller& operator=(const Marshaller&) = delete;
+
+    Marshaller(Marshaller&&) = default;
+    Marshaller& operator=(Marshaller&&) = default;
+
+    inline void push_byte(std::uint8_t value)
+    {
+        push_fixed(value);
+    }
+
+    inline void push_boolean(bool value)
+    {
+        push_fixed(static_cast<std::uint32_t>(value ? 1 : 0));
+    }
+
+    inline void push_int16(std::int16_t value)
+    {
+        push_fixed(value);
+    }
+
+    inline void push_uint16(std::uint16_t value)
+    {
+        push_fixed(value);
+    }
+
+    inline void push_int32(std::int32_t value)
+    {
+        push_fixed(value);
+    }
+
+    inline void push_uint32(std::uint32_t value)
+    {
+        push_fixed(value);
+    }
+
+    inline void push_int64(std::int64_t value)
+    {
+        push_fixed(value);
+    }
+
+    inline void push_uint64(std::uint64_t value)
+    {
+        push_fixed(value);
+    }
+
+    inline void push_floating_point(double value)
+    {
+        push_fixed(value);
+    }
+
+    /**
+     * @brief Writes size bytes from s as a string.
+     * @throw std::runtime_error if s is not valid UTF-8, contains null bytes or exceeds the maximum length.
+     */
+    inline void push_stringn(const char* s, std::size_t size)
+    {
+        if (size > max_array_length)
+            throw std::runtime_error("Marshaller: String exceeds maximum length.");
+
+        if (!validation::is_valid_utf8(s, size))
+            throw std::runtime_error("Marshaller: String is not valid UTF-8.");
+
+        align(4);
+        reserve_additional(sizeof(std::uint32_t) + size + 1);
+        write(static_cast<std::uint32_t>(size));
+        write(s, size);
+        write(static_cast<std::uint8_t>(0));
+    }
+
+    inline void push_string(const std::string& s)
+    {
+        push_stringn(s.data(), s.size());
+    }
+
+    inline void push_object_path(const types::ObjectPath& path)
+    {
+        push_string(path.as_string());
+    }
+
+    /**
+     * @throw std::runtime_error if the signature exceeds 255 characters.
+     */
+    inline void push_signature(const types::Signature& signature)
+    {
+        const auto& s = signature.as_string();
+
+        if (s.size() > DBUS_MAXIMUM_SIGNATURE_LENGTH)
+            throw std::runtime_error("Marshaller: Signature exceeds maximum length.");
+
+        reserve_additional(s.size() + 2);
+        write(static_cast<std::uint8_t>(s.size()));
+        write(s.data(), s.size());
+        write(static_cast<std::uint8_t>(0));
+    }
+
+    /**
+     * @brief Writes count fixed-size values in one go, to be invoked on an open array.
+     *
+     * The in-memory layout of such values matches the wire format in host byte order.
+     */
+    template<typename T>
+    inline void push_fixed_array(const T* values, std::size_t count)
+    {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value,
+                      "Only fixed-size types apart from bool are laid out as on the wire.");
+
+        if (count == 0)
+            return;
+
+        align(sizeof(T));
+        write(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+
+    /**
+     * @brief Starts an array whose elements have the given alignment.
+     * @return A handle to be passed to close_array once all elements have been written.
+     */
+    inline Array open_array(std::size_t element_alignment)
+    {
+        align(4);
+        Array result;
+        result.length = size_;
+        write(static_cast<std::uint32_t>(0));
+        // Padding to the first element is not part of the array length, even if the array is empty.
+        align(element_alignment);
+        result.begin = size_;
+        return result;
+    }
+
+    /**
+     * @brief Finalizes an array by patching its length.
+     * @throw std::runtime_error if the array exceeds the maximum size of 64MiB.
+     */
+    inline void close_array(Array array)
+    {
+        auto length = size_ - array.begin;
+
+        if (length > max_array_length)
+            throw std::runtime_error("Marshaller: Array exceeds maximum length.");
+
+        auto value = static_cast<std::uint32_t>(length);
+        std::memcpy(buffer.get() + array.length, &value, sizeof(value));
+    }
+
+    inline void open_structure()
+    {
+        align(8);
+    }
+
+    inline void open_dict_entry()
+    {
+        align(8);
+    }
+
+    /**
+     * @brief Starts a variant holding a single complete type described by signature.
+     */
+    inline void open_variant(const types::Signature& signature)
+    {
+        push_signature(signature);
+    }
+
+    /**
+     * @brief Ensures that at least capacity bytes can be written without reallocating.
+     */
+    void reserve(std::size_t capacity);
+
+    /**
+     * @brief Discards all data, keeping the buffer for reuse.
+     */
+    inline void clear()
+    {
+        size_ = 0;
+    }
+
+    inline const std::uint8_t* data() const
+    {
+        return buffer.get();
+    }
+
+    inline std::size_t size() const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief Creates a message with the header of prototype and the marshalled data as body.
+     *
+     * The header fields of prototype are copied, its body is discarded. The new message
+     * carries no serial, such that it is assigned when sending.
+     *
+     * @param prototype The message providing type, flags and header fields.
+     * @param signature The signature of the marshalled data.
+     * @throw std::runtime_error if the resulting message is invalid, e.g., for malformed strings.
+     */
+    Message::Ptr make_message(const Message::Ptr& prototype, const types::Signature& signature) const;
+
+private:
+    enum
+    {
+        max_array_length = DBUS_MAXIMUM_ARRAY_LENGTH
+    };
+
+    inline void align(std::size_t alignment)
+    {
+        auto padding = (alignment - (size_ & (alignment - 1))) & (alignment - 1);
+
+        if (padding == 0)
+            return;
+
+        reserve_additional(padding);
+        std::memset(buffer.get() + size_, 0, padding);
+        size_ += padding;
+    }
+
+    template<typename T>
+    inline void push_fixed(T value)
+    {
+        align(sizeof(T));
+        write(value);
+    }
+
+    template<typename T>
+    inline void write(T value)
+    {
+        reserve_additional(sizeof(T));
+        std::memcpy(buffer.get() + size_, &value, sizeof(T));
+        size_ += sizeof(T);
+    }
+
+    inline void write(const char* data, std::size_t size)
+    {
+        reserve_additional(size);
+        std::memcpy(buffer.get() + size_, data, size);
+        size_ += size;
+    }
+
+    inline void reserve_additional(std::size_t additional)
+    {
+        if (size_ + additional > capacity)
+            reserve(std::max(2 * capacity, size_ + additional));
+    }
+
+    std::unique_ptr<std::uint8_t[]> buffer;
+    std::size_t size_;
+    std::size_t capacity;
+};
+}
+}
+}
+
+#endif // CORE_DBUS_NATIVE_MARSHALLER_H_
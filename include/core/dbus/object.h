@@ -69,6 +69,7 @@ namespace types
 class Any;
 class ObjectPath;
 class Variant;
+class VariantDict;
 }
 class MatchRule;
 template<typename T>
@@ -166,6 +167,13 @@ class Object : public std::enable_shared_from_this<Object>
     inline std::map<std::string, types::Variant>
     get_all_properties();
 
+    /**
+     * @brief Queries all properties in one go for the object, only decoding values on access.
+     */
+    template<typename Interface>
+    inline types::VariantDict
+    get_all_properties_as_dict();
+
     /**
      * @brief Accesses a signal of the object.
      * @return An instance of the signal or nullptr in case of errors.
@@ -225,7 +233,8 @@ class Object : public std::enable_shared_from_this<Object>
     void add_match(const MatchRule& rule);
     void remove_match(const MatchRule& rule);
     void on_properties_changed(
-            const interfaces::Properties::Signals::PropertiesChanged::ArgumentType&);
+            const std::string& interface,
+            const types::VariantDict& changed_values);
 
     std::shared_ptr<Service> parent;
     types::ObjectPath object_path;
@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_SERVER_H_
+#define CORE_DBUS_SERVER_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/visibility.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace core
+{
+namespace dbus
+{
+/**
+ * @brief Listens for direct connections from peers, bypassing the bus daemon.
+ *
+ * Every accepted connection is handed out as a peer-to-peer Bus instance. Services
+ * and skeletons can be exposed on it as usual, but need to be created per connection
+ * with the non-caching Service::add_service(bus, name). Clients connect with
+ * Bus::connect_to_peer.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Server
+{
+public:
+    typedef std::shared_ptr<Server> Ptr;
+
+    /** @brief Function signature for handling new connections. */
+    typedef std::function<void(const Bus::Ptr&)> ConnectionHandler;
+
+    /**
+     * @brief The address servers listen on by default, a private unix socket.
+     */
+    static const std::string& default_address();
+
+    /**
+     * @brief Starts listening on the given address.
+     * @param address The address to listen on, e.g., unix:tmpdir=/tmp.
+     * @throw std::runtime_error if listening fails.
+     */
+    explicit Server(const std::string& address = default_address());
+
+    Server(const Server&) = delete;
+    ~Server() noexcept;
+
+    Server& operator=(const Server&) = delete;
+    bool operator==(const Server&) const = delete;
+
+    /**
+     * @brief The address clients can connect to, including the guid of the server.
+     */
+    std::string address() const;
+
+    /**
+     * @brief Installs the handler invoked for every accepted connection.
+     *
+     * The handler is invoked on the thread executing run(). Connections are closed
+     * when the last reference to the respective bus instance is dropped. Installing
+     * an executor on the bus and running it is up to the handler.
+     */
+    void on_new_connection(const ConnectionHandler& handler);
+
+    /**
+     * @brief Accepts connections until stop is called.
+     */
+    void run();
+
+    /**
+     * @brief Makes run return, can be called from any thread.
+     */
+    void stop();
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+}
+}
+
+#endif // CORE_DBUS_SERVER_H_
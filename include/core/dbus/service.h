@@ -154,6 +154,21 @@ public:
      */
     std::shared_ptr<Object> add_object_for_path(const types::ObjectPath& path);
 
+    /**
+     * @brief Adds a new object on prefix, resolving the objects for all paths below prefix on demand.
+     *
+     * In contrast to adding every object with add_object_for_path, the whole namespace of prefix is
+     * registered with the bus once, independent of the number of objects below prefix. For every
+     * message to a descendant of prefix, resolver is handed the path of the message and returns the
+     * object to dispatch to, or nullptr if there is none. Resolved objects can be created with
+     * object_for_path, and a single object might serve many paths, reading the path from the message.
+     *
+     * @param [in] prefix The path to mount the object and the subtree upon.
+     * @param [in] resolver Resolves objects for the descendants of prefix, see Bus::SubtreeResolver.
+     * @return The object mounted on prefix, the subtree is removed from the bus with its destruction.
+     */
+    std::shared_ptr<Object> add_subtree(const types::ObjectPath& prefix, const Bus::SubtreeResolver& resolver);
+
     /**
      * @brief Non-mutable access to the name of the service.
      */
@@ -162,6 +177,7 @@ public:
 protected:
     friend class Bus;
     friend class Object;
+    template<typename T, typename U> friend class Signal;
     template<typename T> friend class Property;
 
     Service(const Bus::Ptr& connection, const std::string& name);
@@ -34,8 +34,37 @@ namespace core
 {
 namespace dbus
 {
+class Bus;
 class Object;
 
+/**
+ * @brief A reusable emission of a signal, created by Signal::prepare().
+ *
+ * The header fields of the signal are validated and assembled once. Every emission
+ * copies them and only encodes the arguments. Instances are cheap to copy.
+ */
+template<typename... Args>
+class SignalEmission
+{
+public:
+    /**
+     * @brief Emits the signal with the provided arguments.
+     */
+    inline void emit(const Args&... args) const;
+
+private:
+    template<typename SignalDescription, typename Argument> friend class Signal;
+
+    inline SignalEmission(
+        const std::shared_ptr<Bus>& bus,
+        const std::string& path,
+        const std::string& interface,
+        const std::string& name);
+
+    std::shared_ptr<Bus> bus;
+    Message::Ptr prototype;
+};
+
 template<typename T>
 struct is_not_void
 {
@@ -76,6 +105,12 @@ public:
       */
     inline void emit(void);
 
+    /**
+     * @brief Prepares the repeated emission of the signal, see SignalEmission.
+     * @throw std::runtime_error if the header fields of the signal are invalid.
+     */
+    inline SignalEmission<> prepare() const;
+
     /**
      * @brief connect creates a connection to the provided handler.
      * @param h The handler to be invoked when the signal is emitted.
@@ -150,6 +185,12 @@ public:
       */
     inline void emit(const typename SignalDescription::ArgumentType& arg);
 
+    /**
+     * @brief Prepares the repeated emission of the signal, see SignalEmission.
+     * @throw std::runtime_error if the header fields of the signal are invalid.
+     */
+    inline SignalEmission<typename SignalDescription::ArgumentType> prepare() const;
+
     /**
      * @brief connect creates a connection to the provided handler.
      * @param h The handler to be invoked when the signal is emitted.
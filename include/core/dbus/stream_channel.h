@@ -0,0 +1,136 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_STREAM_CHANNEL_H_
+#define CORE_DBUS_STREAM_CHANNEL_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/visibility.h>
+
+#include <core/dbus/types/unix_fd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+
+namespace core
+{
+namespace dbus
+{
+/**
+ * @brief A single-producer/single-consumer ring of records in shared memory.
+ *
+ * One side creates the channel and hands out memory() and notification() to its
+ * peer, typically via types::UnixFd arguments of a method call. The peer attaches
+ * to the very same ring, and records flow between both sides without involving the
+ * bus. The producer only signals the eventfd if the consumer waits for records, and
+ * the consumer reports whether the producer ran out of space, such that DBus only
+ * needs to carry control and backpressure messages.
+ *
+ * Exactly one thread may write and exactly one thread may read at any time.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC StreamChannel : public std::enable_shared_from_this<StreamChannel>
+{
+public:
+    typedef std::shared_ptr<StreamChannel> Ptr;
+
+    /** @brief Invoked for every record, the data is only valid during the invocation. */
+    typedef std::function<void(const std::uint8_t* data, std::size_t size)> RecordHandler;
+
+    /**
+     * @brief Creates a channel holding up to capacity bytes of records.
+     *
+     * Every record occupies its size plus 4 bytes, rounded up to a multiple of 8,
+     * and may not occupy more than half of the capacity.
+     * @throw std::runtime_error if capacity is too small or not a multiple of 8.
+     * @throw std::system_error if allocating the shared memory or the eventfd fails.
+     */
+    static Ptr create(std::size_t capacity);
+
+    /**
+     * @brief Attaches to a channel created by a peer, taking ownership of both fds.
+     * @throw std::runtime_error if memory does not refer to a channel.
+     * @throw std::system_error if mapping memory fails.
+     */
+    static Ptr attach(const types::UnixFd& memory, const types::UnixFd& notification);
+
+    StreamChannel(const StreamChannel&) = delete;
+    ~StreamChannel() noexcept;
+
+    StreamChannel& operator=(const StreamChannel&) = delete;
+    bool operator==(const StreamChannel&) const = delete;
+
+    /** @brief The fd of the shared memory, to be handed to the peer. Remains owned by the channel. */
+    types::UnixFd memory() const;
+
+    /** @brief The eventfd signalled for a waiting consumer. Remains owned by the channel. */
+    types::UnixFd notification() const;
+
+    /** @brief The number of bytes available for records. */
+    std::size_t capacity() const;
+
+    /**
+     * @brief Appends a record, to be called by the producer only.
+     *
+     * If the record does not fit, the request is remembered and the consumer
+     * reports it via take_resume_request() once it has made room.
+     * Readers waiting in read_on() are woken up only if they have run out of records.
+     *
+     * @return false if the ring is full.
+     * @throw std::runtime_error if the record can never fit into the ring.
+     */
+    bool try_write(const void* data, std::size_t size);
+
+    /**
+     * @brief Reads up to max_records records, to be called by the consumer only.
+     * @return The number of records read.
+     * @throw std::runtime_error if the ring has been corrupted by the peer.
+     */
+    std::size_t read(const RecordHandler& handler, std::size_t max_records = std::numeric_limits<std::size_t>::max());
+
+    /**
+     * @brief Queries and clears whether the producer ran out of space, to be called by the consumer only.
+     */
+    bool take_resume_request();
+
+    /**
+     * @brief Reads all records from within the loop of the executor of bus whenever the producer signals new ones.
+     *
+     * Once all records have been read and the producer is waiting for space, on_resume
+     * is invoked, e.g., to ask the producer to continue via a DBus call. Reading stops
+     * once the returned handle is released, which keeps the channel alive until then.
+     *
+     * @throw std::runtime_error if bus has no executor.
+     * @throw std::logic_error if the executor of bus cannot monitor additional fds.
+     */
+    std::shared_ptr<void> read_on(const Bus::Ptr& bus,
+                                  const RecordHandler& handler,
+                                  const std::function<void()>& on_resume = std::function<void()>());
+
+private:
+    struct Private;
+
+    explicit StreamChannel(std::unique_ptr<Private> d);
+
+    std::unique_ptr<Private> d;
+};
+}
+}
+
+#endif // CORE_DBUS_STREAM_CHANNEL_H_
@@ -0,0 +1,255 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TYPES_ARRAY_RANGE_H_
+#define CORE_DBUS_TYPES_ARRAY_RANGE_H_
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+#include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/stl/map.h>
+
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+namespace core
+{
+namespace dbus
+{
+namespace helper
+{
+/**
+ * @brief Encodes single elements of an array, std::pair<K, V> elements as dictionary entries.
+ */
+template<typename T>
+struct ArrayElement
+{
+    inline static void encode(Message::Writer& out, const T& element)
+    {
+        Codec<T>::encode_argument(out, element);
+    }
+};
+
+template<typename K, typename V>
+struct ArrayElement<std::pair<K, V>>
+{
+    inline static void encode(Message::Writer& out, const std::pair<K, V>& element)
+    {
+        auto de = out.open_dict_entry();
+        {
+            Codec<typename std::decay<K>::type>::encode_argument(de, element.first);
+            Codec<typename std::decay<V>::type>::encode_argument(de, element.second);
+        }
+        out.close_dict_entry(std::move(de));
+    }
+};
+}
+namespace types
+{
+/**
+ * @brief ArrayRange encodes the elements of [first, last) as an array, in a single pass.
+ *
+ * Allows for writing arrays straight from arbitrary containers or iterator adapters,
+ * without building a std::vector or std::map first. Ranges of std::pair<K, V> are
+ * encoded as dictionaries. Use make_array_range to create instances.
+ */
+template<typename Iterator>
+class ArrayRange
+{
+public:
+    typedef typename std::decay<
+        typename std::iterator_traits<Iterator>::value_type
+    >::type Element;
+
+    ArrayRange(Iterator first, Iterator last) : first(first), last(last)
+    {
+    }
+
+    Iterator begin() const
+    {
+        return first;
+    }
+
+    Iterator end() const
+    {
+        return last;
+    }
+
+private:
+    Iterator first;
+    Iterator last;
+};
+
+template<typename Iterator>
+inline ArrayRange<Iterator> make_array_range(Iterator first, Iterator last)
+{
+    return ArrayRange<Iterator>{first, last};
+}
+
+/**
+ * @brief Refers to all elements of range, which has to outlive the returned instance.
+ */
+template<typename Range>
+inline auto make_array_range(const Range& range) -> ArrayRange<decltype(std::begin(range))>
+{
+    return ArrayRange<decltype(std::begin(range))>{std::begin(range), std::end(range)};
+}
+
+/**
+ * @brief Handed to the generator of a GeneratedArray, encodes every element it is invoked with.
+ */
+template<typename T>
+class ArrayYield
+{
+public:
+    inline void operator()(const T& element)
+    {
+        helper::ArrayElement<T>::encode(out, element);
+    }
+
+private:
+    template<typename U, typename Generator> friend class GeneratedArray;
+
+    explicit ArrayYield(Message::Writer& out) : out(out)
+    {
+    }
+
+    Message::Writer& out;
+};
+
+/**
+ * @brief GeneratedArray encodes the elements a generator yields as an array of T.
+ *
+ * The generator is invoked once per encoding as void(ArrayYield<T>&), and hands every
+ * element to the yield it has been passed. Use make_generated_array to create instances.
+ */
+template<typename T, typename Generator>
+class GeneratedArray
+{
+public:
+    explicit GeneratedArray(Generator generator) : generator(std::move(generator))
+    {
+    }
+
+    void generate(Message::Writer& out) const
+    {
+        ArrayYield<T> yield{out};
+        generator(yield);
+    }
+
+private:
+    Generator generator;
+};
+
+template<typename T, typename Generator>
+inline GeneratedArray<T, Generator> make_generated_array(Generator generator)
+{
+    return GeneratedArray<T, Generator>{std::move(generator)};
+}
+}
+namespace helper
+{
+template<typename Iterator>
+struct TypeMapper<types::ArrayRange<Iterator>>
+{
+    constexpr static ArgumentType type_value()
+    {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type()
+    {
+        return false;
+    }
+    constexpr static bool requires_signature()
+    {
+        return true;
+    }
+
+    static std::string signature()
+    {
+        static const std::string s = DBUS_TYPE_ARRAY_AS_STRING + TypeMapper<typename types::ArrayRange<Iterator>::Element>::signature();
+        return s;
+    }
+};
+
+template<typename T, typename Generator>
+struct TypeMapper<types::GeneratedArray<T, Generator>>
+{
+    constexpr static ArgumentType type_value()
+    {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type()
+    {
+        return false;
+    }
+    constexpr static bool requires_signature()
+    {
+        return true;
+    }
+
+    static std::string signature()
+    {
+        static const std::string s = DBUS_TYPE_ARRAY_AS_STRING + TypeMapper<T>::signature();
+        return s;
+    }
+};
+}
+
+/**
+ * @brief Template specialization for arrays encoded from iterator ranges.
+ *
+ * ArrayRange can only be encoded, decode to the respective container or to an ArrayView.
+ */
+template<typename Iterator>
+struct Codec<types::ArrayRange<Iterator>>
+{
+    typedef typename types::ArrayRange<Iterator>::Element Element;
+
+    inline static void encode_argument(Message::Writer& out, const types::ArrayRange<Iterator>& range)
+    {
+        auto aw = out.open_array(helper::signature_of<Element>());
+        {
+            for (const auto& element : range)
+                helper::ArrayElement<Element>::encode(aw, element);
+        }
+        out.close_array(std::move(aw));
+    }
+};
+
+/**
+ * @brief Template specialization for arrays encoded from generators.
+ *
+ * GeneratedArray can only be encoded, decode to the respective container or to an ArrayView.
+ */
+template<typename T, typename Generator>
+struct Codec<types::GeneratedArray<T, Generator>>
+{
+    inline static void encode_argument(Message::Writer& out, const types::GeneratedArray<T, Generator>& array)
+    {
+        auto aw = out.open_array(helper::signature_of<T>());
+        {
+            array.generate(aw);
+        }
+        out.close_array(std::move(aw));
+    }
+};
+}
+}
+
+#endif // CORE_DBUS_TYPES_ARRAY_RANGE_H_
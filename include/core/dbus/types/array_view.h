@@ -0,0 +1,259 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TYPES_ARRAY_VIEW_H_
+#define CORE_DBUS_TYPES_ARRAY_VIEW_H_
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+#include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/stl/map.h>
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace core
+{
+namespace dbus
+{
+namespace types
+{
+template<typename T>
+class ArrayView;
+}
+namespace helper
+{
+template<typename T>
+struct TypeMapper<types::ArrayView<T>>
+{
+    constexpr static ArgumentType type_value()
+    {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type()
+    {
+        return false;
+    }
+    constexpr static bool requires_signature()
+    {
+        return true;
+    }
+
+    static std::string signature()
+    {
+        static const std::string s = DBUS_TYPE_ARRAY_AS_STRING + TypeMapper<typename std::decay<T>::type>::signature();
+        return s;
+    }
+};
+
+template<typename T>
+struct IsMapped<types::ArrayView<T>> : public IsMapped<T>
+{
+};
+}
+namespace types
+{
+/**
+ * @brief ArrayView decodes the elements of an array in a message one at a time, while being iterated.
+ *
+ * Use std::pair<K, V> as element type for dictionaries. In contrast to decoding to a
+ * std::vector or std::map, only a single element is held in memory at any time. An
+ * ArrayView is an input range and can only be iterated once, copies share their position
+ * in the message.
+ *
+ * An ArrayView keeps the message it has been decoded from alive.
+ */
+template<typename T>
+class ArrayView
+{
+public:
+    class Iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        Iterator() : view(nullptr)
+        {
+        }
+
+        const T& operator*() const
+        {
+            return view->current;
+        }
+
+        const T* operator->() const
+        {
+            return std::addressof(view->current);
+        }
+
+        Iterator& operator++()
+        {
+            if (!view->advance())
+                view = nullptr;
+
+            return *this;
+        }
+
+        bool operator==(const Iterator& rhs) const
+        {
+            return view == rhs.view;
+        }
+
+        bool operator!=(const Iterator& rhs) const
+        {
+            return view != rhs.view;
+        }
+
+    private:
+        friend class ArrayView;
+
+        explicit Iterator(const ArrayView* view) : view(view)
+        {
+        }
+
+        const ArrayView* view;
+    };
+
+    /**
+     * @brief Constructs an empty instance.
+     */
+    ArrayView() : started(false), at_end(true)
+    {
+    }
+
+    /**
+     * @brief Decodes the first element and returns an iterator referring to it.
+     *
+     * Subsequent calls return an iterator referring to the current element.
+     */
+    Iterator begin() const
+    {
+        if (!started)
+        {
+            started = true;
+            advance();
+        }
+
+        return at_end ? Iterator{} : Iterator{this};
+    }
+
+    Iterator end() const
+    {
+        return Iterator{};
+    }
+
+private:
+    friend struct core::dbus::Codec<ArrayView<T>>;
+
+    explicit ArrayView(Message::Reader reader)
+        : reader(std::move(reader)),
+          current(),
+          started(false),
+          at_end(false)
+    {
+    }
+
+    template<typename U>
+    static void decode_element(Message::Reader& in, U& element)
+    {
+        Codec<U>::decode_argument(in, element);
+    }
+
+    template<typename K, typename V>
+    static void decode_element(Message::Reader& in, std::pair<K, V>& element)
+    {
+        auto de = in.pop_dict_entry();
+        Codec<std::pair<K, V>>::decode_argument(de, element);
+    }
+
+    // Decodes the next element into current, returns false at the end of the array.
+    bool advance() const
+    {
+        if (at_end || reader.type() == ArgumentType::invalid)
+        {
+            at_end = true;
+            return false;
+        }
+
+        // Codecs append to containers, each element is decoded into a fresh instance.
+        T element;
+        decode_element(reader, element);
+        current = std::move(element);
+        return true;
+    }
+
+    // Iterating does not alter the logical state, e.g., for accessing the value of a Result.
+    mutable Message::Reader reader;
+    mutable T current;
+    mutable bool started;
+    mutable bool at_end;
+};
+}
+
+/**
+ * @brief Template specialization for lazily decoded arrays.
+ *
+ * ArrayView can only be decoded, encoding is covered by the codecs of the respective containers.
+ */
+template<typename T>
+struct Codec<types::ArrayView<T>>
+{
+    inline static void decode_argument(Message::Reader& in, types::ArrayView<T>& view)
+    {
+        if (in.type() != ArgumentType::array)
+            throw std::runtime_error("ArrayView: Argument is not an array.");
+
+        view = types::ArrayView<T>{in.pop_array()};
+    }
+};
+
+/**
+ * @brief Decodes the elements of the next array from in one at a time and hands them to visitor.
+ *
+ * Iterating stops once visitor returns false, in is advanced past the array in any case.
+ *
+ * @tparam T Type of the elements, std::pair<K, V> for dictionaries.
+ * @param visitor Invoked as bool(const T&) for every element.
+ * @return The number of elements handed to visitor.
+ * @throw std::runtime_error if the array cannot be decoded.
+ */
+template<typename T, typename Visitor>
+inline std::size_t visit_array(Message::Reader& in, Visitor visitor)
+{
+    types::ArrayView<T> view;
+    Codec<types::ArrayView<T>>::decode_argument(in, view);
+
+    std::size_t count = 0;
+    for (const auto& element : view)
+    {
+        count++;
+        if (!visitor(element))
+            break;
+    }
+
+    return count;
+}
+}
+}
+
+#endif // CORE_DBUS_TYPES_ARRAY_VIEW_H_
@@ -20,6 +20,8 @@
 
 #include <core/dbus/visibility.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <stdexcept>
 #include <string>
@@ -30,8 +32,20 @@ namespace dbus
 {
 namespace types
 {
+namespace detail
+{
+struct ObjectPathAtom;
+}
+
 /**
  * @brief The ObjectPath class encapsulates a DBus object path.
+ *
+ * Object paths are interned in a process-wide table: all instances referring to the same
+ * path share a single atom that carries a unique id, the precomputed hash and a reference
+ * to the atom of the parent path. Comparing for equality, hashing and checking for
+ * ancestry thus do not touch the string representation. Strings are validated once, when
+ * the first instance for a path is created. Atoms are released with the last instance
+ * referring to them.
  */
 class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC ObjectPath
 {
@@ -75,6 +89,21 @@ public:
      */
     ObjectPath(const std::string& path = ObjectPath::root());
 
+    ObjectPath(const ObjectPath& rhs) noexcept;
+    ObjectPath& operator=(const ObjectPath& rhs);
+
+    /**
+     * @brief Takes over the atom of rhs, leaving rhs referring to the root path.
+     */
+    ObjectPath(ObjectPath&& rhs) noexcept;
+
+    /**
+     * @brief Exchanges the atoms of this instance and rhs.
+     */
+    ObjectPath& operator=(ObjectPath&& rhs) noexcept;
+
+    ~ObjectPath();
+
     /**
      * @brief Checks if an object path is empty.
      * @return true iff the object path is empty.
@@ -87,6 +116,36 @@ public:
      */
     const std::string& as_string() const;
 
+    /**
+     * @brief id returns the id of the interned path, never handed out twice within a process.
+     */
+    std::uint64_t id() const;
+
+    /**
+     * @brief hash returns the precomputed hash of the string representation.
+     */
+    std::size_t hash() const;
+
+    /**
+     * @brief depth returns the number of elements of the path, 0 for the root path.
+     */
+    std::size_t depth() const;
+
+    /**
+     * @brief parent returns the path with the last element removed, the root path for the root path.
+     */
+    ObjectPath parent() const;
+
+    /**
+     * @brief Checks whether this instance is a strict descendant of ancestor, e.g., /a/b of /a.
+     */
+    bool is_descendant_of(const ObjectPath& ancestor) const;
+
+    /**
+     * @brief Checks whether this instance equals or descends from ns, as for the path_namespace match rule.
+     */
+    bool is_in_namespace(const ObjectPath& ns) const;
+
     /**
      * @brief operator < compares two object path instances.
      * @param rhs The right-hand-side of the comparison.
@@ -109,7 +168,9 @@ public:
     bool operator!=(const ObjectPath& rhs) const;
 
 private:
-    std::string path;
+    explicit ObjectPath(const detail::ObjectPathAtom* atom);
+
+    const detail::ObjectPathAtom* atom;
 };
 
 /**
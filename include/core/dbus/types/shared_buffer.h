@@ -0,0 +1,141 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TYPES_SHARED_BUFFER_H_
+#define CORE_DBUS_TYPES_SHARED_BUFFER_H_
+
+#include <core/dbus/codec.h>
+#include <core/dbus/visibility.h>
+
+#include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/unix_fd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+namespace core
+{
+namespace dbus
+{
+namespace types
+{
+/**
+ * @brief An immutable block of bytes in a sealed memfd, passed between peers as a unix fd.
+ *
+ * Instead of copying large payloads into a message, only the file descriptor is
+ * transferred and the receiver maps the buffer read-only. Instances are cheap to
+ * copy and share the underlying mapping, which is released together with the last copy.
+ */
+class ORG_FREEDESKTOP_DBUS_DLL_PUBLIC SharedBuffer
+{
+public:
+    /**
+     * @brief Allocates a buffer of size bytes, has fill write its contents and seals it afterwards.
+     * @throw std::system_error if allocating, mapping or sealing the buffer fails.
+     */
+    static SharedBuffer create(std::size_t size, const std::function<void(std::uint8_t*)>& fill);
+
+    /**
+     * @brief Allocates a buffer holding a copy of size bytes starting at data.
+     * @throw std::system_error if allocating, mapping or sealing the buffer fails.
+     */
+    static SharedBuffer copy_of(const void* data, std::size_t size);
+
+    /**
+     * @brief Maps the buffer referred to by fd read-only, taking ownership of fd.
+     * @throw std::runtime_error if fd is not a memfd sealed against writing and resizing.
+     * @throw std::system_error if mapping the buffer fails.
+     */
+    static SharedBuffer from_fd(const UnixFd& fd);
+
+    /** @brief Creates an empty instance, not referring to any buffer. */
+    SharedBuffer() = default;
+
+    /** @brief Whether the instance refers to a buffer. */
+    bool is_valid() const;
+
+    /** @brief The contents of the buffer, nullptr if the buffer is empty or invalid. */
+    const std::uint8_t* data() const;
+
+    /** @brief The size of the buffer in bytes. */
+    std::size_t size() const;
+
+    /** @brief The fd of the buffer, which remains owned by this instance. */
+    UnixFd fd() const;
+
+private:
+    struct Private;
+
+    explicit SharedBuffer(const std::shared_ptr<Private>& d);
+
+    std::shared_ptr<Private> d;
+};
+}
+
+namespace helper
+{
+template<>
+struct TypeMapper<types::SharedBuffer>
+{
+    constexpr inline static ArgumentType type_value()
+    {
+        return ArgumentType::unix_fd;
+    }
+    constexpr inline static bool is_basic_type()
+    {
+        return true;
+    }
+    constexpr inline static bool requires_signature()
+    {
+        return true;
+    }
+
+    inline static std::string signature()
+    {
+        return DBUS_TYPE_UNIX_FD_AS_STRING;
+    }
+};
+}
+
+/**
+ * @brief Template specialization for shared buffers, encoded as the fd of the buffer.
+ */
+template<>
+struct Codec<types::SharedBuffer>
+{
+    inline static void encode_argument(Message::Writer& out, const types::SharedBuffer& value)
+    {
+        if (!value.is_valid())
+            throw std::runtime_error("Cannot encode an invalid shared buffer.");
+
+        // libdbus duplicates the fd, the buffer stays valid on our side.
+        out.push_unix_fd(value.fd());
+    }
+
+    inline static void decode_argument(Message::Reader& in, types::SharedBuffer& value)
+    {
+        // libdbus hands out a duplicate of the fd, which is owned by the buffer afterwards.
+        value = types::SharedBuffer::from_fd(in.pop_unix_fd());
+    }
+};
+}
+}
+
+#endif // CORE_DBUS_TYPES_SHARED_BUFFER_H_
@@ -18,6 +18,8 @@
 #ifndef CORE_DBUS_TYPES_SIGNATURE_H_
 #define CORE_DBUS_TYPES_SIGNATURE_H_
 
+#include <core/dbus/validation.h>
+
 #include <stdexcept>
 #include <string>
 
@@ -30,8 +32,39 @@ namespace types
 class Signature
 {
 public:
+    /**
+     * @brief The Errors struct summarizes all exceptions thrown by
+     * methods of class Signature.
+     */
+    struct Errors
+    {
+        Errors() = delete;
+
+        /**
+         * @brief Thrown if a string representation of a signature is invalid.
+         */
+        struct InvalidSignatureStringRepresentation : public std::logic_error
+        {
+            inline InvalidSignatureStringRepresentation(const std::string& s)
+                : std::logic_error(
+                      "Could not construct valid signature from provided string: " + s)
+            {
+            }
+        };
+    };
+
+    /**
+     * @brief Constructs a signature from a string.
+     *
+     * Besides sequences of complete types, single dictionary entries are accepted,
+     * as they describe the elements of dictionaries.
+     *
+     * @throw Errors::InvalidSignatureStringRepresentation if signature is invalid.
+     */
     explicit Signature(const std::string& signature = std::string()) : signature(signature)
     {
+        if (!validation::is_valid_signature(signature) && !validation::is_valid_element_signature(signature))
+            throw Errors::InvalidSignatureStringRepresentation{signature};
     }
 
     const std::string& as_string() const
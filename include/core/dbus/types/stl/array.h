@@ -0,0 +1,138 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TYPES_STL_ARRAY_H_
+#define CORE_DBUS_TYPES_STL_ARRAY_H_
+
+#include <core/dbus/codec.h>
+#include <core/dbus/helper/is_fixed_array_element.h>
+#include <core/dbus/helper/type_mapper.h>
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
+namespace core
+{
+namespace dbus
+{
+namespace helper
+{
+template<typename T, std::size_t N>
+struct TypeMapper<std::array<T, N>>
+{
+    constexpr static ArgumentType type_value()
+    {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type()
+    {
+        return false;
+    }
+    constexpr static bool requires_signature()
+    {
+        return true;
+    }
+
+    static std::string signature()
+    {
+        static const std::string s = DBUS_TYPE_ARRAY_AS_STRING + TypeMapper<typename std::decay<T>::type>::signature();
+        return s;
+    }
+};
+
+template<typename T, std::size_t N>
+struct IsMapped<std::array<T, N>> : public IsMapped<T>
+{
+};
+
+template<typename T, std::size_t N>
+struct DecodesSignature<std::array<T, N>> : public DecodesSignature<T>
+{
+};
+}
+/**
+ * @brief Template specialization for fixed-size arrays, copying fixed-size elements in one go.
+ *
+ * Decoding throws std::runtime_error if the number of elements in the message differs from N.
+ */
+template<typename T, std::size_t N>
+struct Codec<std::array<T, N>>
+{
+    static void encode_argument(Message::Writer& out, const std::array<T, N>& arg)
+    {
+        encode(out, arg, std::integral_constant<bool, helper::IsFixedArrayElement<T>::value>{});
+    }
+
+    static void decode_argument(Message::Reader& in, std::array<T, N>& out)
+    {
+        decode(in, out, std::integral_constant<bool, helper::IsFixedArrayElement<T>::value>{});
+    }
+
+private:
+    static std::runtime_error size_mismatch()
+    {
+        return std::runtime_error("Number of elements in array does not match size of std::array.");
+    }
+
+    static void encode(Message::Writer& out, const std::array<T, N>& arg, std::true_type)
+    {
+        out.push_fixed_array(helper::TypeMapper<T>::type_value(), arg.data(), N);
+    }
+
+    static void encode(Message::Writer& out, const std::array<T, N>& arg, std::false_type)
+    {
+        auto aw = out.open_array(
+                    helper::signature_of<T>());
+        {
+            for (const auto& element : arg)
+                core::dbus::encode_argument(aw, element);
+        }
+        out.close_array(std::move(aw));
+    }
+
+    static void decode(Message::Reader& in, std::array<T, N>& out, std::true_type)
+    {
+        std::size_t count = 0;
+        auto data = static_cast<const T*>(in.pop_fixed_array(helper::TypeMapper<T>::type_value(), count));
+        if (count != N)
+            throw size_mismatch();
+
+        std::copy(data, data + N, out.begin());
+    }
+
+    static void decode(Message::Reader& in, std::array<T, N>& out, std::false_type)
+    {
+        auto ar = in.pop_array();
+
+        std::size_t count = 0;
+        while (ar.type() != ArgumentType::invalid)
+        {
+            if (count == N)
+                throw size_mismatch();
+
+            Codec<T>::decode_argument(ar, out[count++]);
+        }
+
+        if (count != N)
+            throw size_mismatch();
+    }
+};
+}
+}
+#endif // CORE_DBUS_TYPES_STL_ARRAY_H_
@@ -51,6 +51,16 @@ struct TypeMapper<std::list<T>>
         return s;
     }
 };
+
+template<typename T>
+struct IsMapped<std::list<T>> : public IsMapped<T>
+{
+};
+
+template<typename T>
+struct DecodesSignature<std::list<T>> : public DecodesSignature<T>
+{
+};
 }
 template<typename T>
 struct Codec<std::list<T>>
@@ -52,6 +52,11 @@ struct TypeMapper<std::pair<T, U>>
     }
 };
 
+template<typename T, typename U>
+struct IsMapped<std::pair<T, U>> : public AreMapped<T, U>
+{
+};
+
 template<typename T, typename U>
 struct TypeMapper<std::map<T, U>>
 {
@@ -74,6 +79,16 @@ struct TypeMapper<std::map<T, U>>
         return s;
     }
 };
+
+template<typename T, typename U>
+struct IsMapped<std::map<T, U>> : public AreMapped<T, U>
+{
+};
+
+template<typename T, typename U>
+struct DecodesSignature<std::map<T, U>> : public AllDecodeSignature<T, U>
+{
+};
 }
 template<typename T, typename U>
 struct Codec<std::pair<const T, U>>
@@ -113,8 +128,7 @@ struct Codec<std::map<T, U>>
     static void encode_argument(Message::Writer& out, const std::map<T, U>& arg)
     {
         auto aw = out.open_array(
-                    types::Signature(
-                        helper::TypeMapper<typename std::map<T, U>::value_type>::signature()));
+                    helper::signature_of<typename std::map<T, U>::value_type>());
         {
             for (const auto& element : arg)
             {
@@ -66,6 +66,14 @@ struct Codec<std::string>
             arg = s;
     }
 };
+
+namespace helper
+{
+template<>
+struct DecodesSignature<std::string> : public std::true_type
+{
+};
+}
 }
 }
 #endif // CORE_DBUS_TYPES_STL_STRING_H_
@@ -78,6 +78,16 @@ struct TypeMapper<std::tuple<Args...>>
         return s;
     }
 };
+
+template<typename... Args>
+struct IsMapped<std::tuple<Args...>> : public AreMapped<Args...>
+{
+};
+
+template<typename... Args>
+struct DecodesSignature<std::tuple<Args...>> : public AllDecodeSignature<Args...>
+{
+};
 }
 namespace detail
 {
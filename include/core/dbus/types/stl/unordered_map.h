@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TYPES_STL_UNORDERED_MAP_H_
+#define CORE_DBUS_TYPES_STL_UNORDERED_MAP_H_
+
+#include <core/dbus/codec.h>
+#include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/stl/map.h>
+
+#include <unordered_map>
+#include <utility>
+
+namespace core
+{
+namespace dbus
+{
+namespace helper
+{
+template<typename T, typename U>
+struct TypeMapper<std::unordered_map<T, U>>
+{
+    constexpr static ArgumentType type_value()
+    {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type()
+    {
+        return false;
+    }
+    constexpr static bool requires_signature()
+    {
+        return true;
+    }
+
+    static std::string signature()
+    {
+        static const std::string s = DBUS_TYPE_ARRAY_AS_STRING + TypeMapper<std::pair<T, U>>::signature();
+        return s;
+    }
+};
+
+template<typename T, typename U>
+struct IsMapped<std::unordered_map<T, U>> : public AreMapped<T, U>
+{
+};
+
+template<typename T, typename U>
+struct DecodesSignature<std::unordered_map<T, U>> : public AllDecodeSignature<T, U>
+{
+};
+}
+/**
+ * @brief Template specialization for unordered map argument types.
+ */
+template<typename T, typename U>
+struct Codec<std::unordered_map<T, U>>
+{
+    static void encode_argument(Message::Writer& out, const std::unordered_map<T, U>& arg)
+    {
+        auto aw = out.open_array(
+                    helper::signature_of<std::pair<T, U>>());
+        {
+            for (const auto& element : arg)
+            {
+                auto de = aw.open_dict_entry();
+                {
+                    Codec<std::pair<T, U>>::encode_argument(de, element);
+                }
+                aw.close_dict_entry(std::move(de));
+            }
+        }
+        out.close_array(std::move(aw));
+    }
+
+    static void decode_argument(Message::Reader& in, std::unordered_map<T, U>& out)
+    {
+        out.clear();
+
+        auto array_reader = in.pop_array();
+
+        while (array_reader.type() != ArgumentType::invalid)
+        {
+            auto de = array_reader.pop_dict_entry();
+            std::pair<T, U> v;
+            Codec<std::pair<T, U>>::decode_argument(de, v);
+            // Later entries win for duplicate keys, as for std::map.
+            out[std::move(v.first)] = std::move(v.second);
+        }
+    }
+};
+}
+}
+#endif // CORE_DBUS_TYPES_STL_UNORDERED_MAP_H_
@@ -0,0 +1,99 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TYPES_STL_UNORDERED_SET_H_
+#define CORE_DBUS_TYPES_STL_UNORDERED_SET_H_
+
+#include <core/dbus/codec.h>
+#include <core/dbus/helper/type_mapper.h>
+
+#include <unordered_set>
+#include <utility>
+
+namespace core
+{
+namespace dbus
+{
+namespace helper
+{
+template<typename T>
+struct TypeMapper<std::unordered_set<T>>
+{
+    constexpr static ArgumentType type_value()
+    {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type()
+    {
+        return false;
+    }
+    constexpr static bool requires_signature()
+    {
+        return true;
+    }
+
+    static std::string signature()
+    {
+        static const std::string s = DBUS_TYPE_ARRAY_AS_STRING + TypeMapper<typename std::decay<T>::type>::signature();
+        return s;
+    }
+};
+
+template<typename T>
+struct IsMapped<std::unordered_set<T>> : public IsMapped<T>
+{
+};
+
+template<typename T>
+struct DecodesSignature<std::unordered_set<T>> : public DecodesSignature<T>
+{
+};
+}
+/**
+ * @brief Template specialization for unordered set argument types.
+ */
+template<typename T>
+struct Codec<std::unordered_set<T>>
+{
+    static void encode_argument(Message::Writer& out, const std::unordered_set<T>& arg)
+    {
+        auto aw = out.open_array(
+                    helper::signature_of<T>());
+        {
+            for (const auto& element : arg)
+                core::dbus::encode_argument(aw, element);
+        }
+        out.close_array(std::move(aw));
+    }
+
+    static void decode_argument(Message::Reader& in, std::unordered_set<T>& out)
+    {
+        out.clear();
+
+        auto ar = in.pop_array();
+
+        while (ar.type() != ArgumentType::invalid)
+        {
+            T value;
+            Codec<T>::decode_argument(ar, value);
+            out.insert(std::move(value));
+        }
+    }
+};
+}
+}
+#endif // CORE_DBUS_TYPES_STL_UNORDERED_SET_H_
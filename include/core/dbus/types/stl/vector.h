@@ -19,9 +19,13 @@
 #define CORE_DBUS_TYPES_STL_VECTOR_H_
 
 #include <core/dbus/codec.h>
+#include <core/dbus/helper/is_fixed_array_element.h>
 #include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/stl/map.h>
 
 #include <algorithm>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace core
@@ -52,31 +56,115 @@ struct TypeMapper<std::vector<T>>
         return s;
     }
 };
+
+template<typename T>
+struct IsMapped<std::vector<T>> : public IsMapped<T>
+{
+};
+
+template<typename T>
+struct DecodesSignature<std::vector<T>> : public DecodesSignature<T>
+{
+};
+
+// Entries of flat dictionaries are decoded as dict entries, see below.
+template<typename K, typename V>
+struct DecodesSignature<std::vector<std::pair<K, V>>> : public AllDecodeSignature<K, V>
+{
+};
 }
+/**
+ * @brief Template specialization for vector argument types, copying fixed-size elements in one go.
+ */
 template<typename T>
 struct Codec<std::vector<T>>
 {
     static void encode_argument(Message::Writer& out, const std::vector<T>& arg)
+    {
+        encode(out, arg, std::integral_constant<bool, helper::IsFixedArrayElement<T>::value>{});
+    }
+
+    static void decode_argument(Message::Reader& in, std::vector<T>& out)
+    {
+        decode(in, out, std::integral_constant<bool, helper::IsFixedArrayElement<T>::value>{});
+    }
+
+private:
+    static void encode(Message::Writer& out, const std::vector<T>& arg, std::true_type)
+    {
+        out.push_fixed_array(helper::TypeMapper<T>::type_value(), arg.data(), arg.size());
+    }
+
+    static void encode(Message::Writer& out, const std::vector<T>& arg, std::false_type)
     {
         auto aw = out.open_array(
-                    types::Signature(
-                        helper::TypeMapper<T>::signature()));
+                    helper::signature_of<T>());
         {
-            for(auto element : arg)
+            for(const auto& element : arg)
                 core::dbus::encode_argument(aw, element);
         }
         out.close_array(std::move(aw));
     }
 
-    static void decode_argument(Message::Reader& in, std::vector<T>& out)
+    static void decode(Message::Reader& in, std::vector<T>& out, std::true_type)
+    {
+        std::size_t count = 0;
+        auto data = static_cast<const T*>(in.pop_fixed_array(helper::TypeMapper<T>::type_value(), count));
+        out.insert(out.end(), data, data + count);
+    }
+
+    static void decode(Message::Reader& in, std::vector<T>& out, std::false_type)
     {
+        // Not reserving up front, libdbus walks arrays of variable-size elements for counting them.
         Message::Reader ar = in.pop_array();
 
         while (ar.type() != ArgumentType::invalid)
         {
             T value;
             Codec<T>::decode_argument(ar, value);
-            out.push_back(value);
+            out.push_back(std::move(value));
+        }
+    }
+};
+
+/**
+ * @brief Template specialization for flat dictionaries, i.e., vectors of key-value pairs.
+ *
+ * Allows for sending sorted vectors of pairs without building a std::map first. Entries
+ * are encoded and decoded in order, dictionaries sent from a std::map arrive sorted by key.
+ */
+template<typename K, typename V>
+struct Codec<std::vector<std::pair<K, V>>>
+{
+    static void encode_argument(Message::Writer& out, const std::vector<std::pair<K, V>>& arg)
+    {
+        auto aw = out.open_array(
+                    helper::signature_of<std::pair<K, V>>());
+        {
+            for (const auto& element : arg)
+            {
+                auto de = aw.open_dict_entry();
+                {
+                    Codec<typename std::decay<K>::type>::encode_argument(de, element.first);
+                    Codec<typename std::decay<V>::type>::encode_argument(de, element.second);
+                }
+                aw.close_dict_entry(std::move(de));
+            }
+        }
+        out.close_array(std::move(aw));
+    }
+
+    static void decode_argument(Message::Reader& in, std::vector<std::pair<K, V>>& out)
+    {
+        out.clear();
+
+        auto array_reader = in.pop_array();
+
+        while (array_reader.type() != ArgumentType::invalid)
+        {
+            auto de = array_reader.pop_dict_entry();
+            out.emplace_back();
+            Codec<std::pair<K, V>>::decode_argument(de, out.back());
         }
     }
 };
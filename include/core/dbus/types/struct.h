@@ -20,6 +20,9 @@
 
 #include <core/dbus/codec.h>
 
+#include <stdexcept>
+#include <string>
+
 namespace core
 {
 namespace dbus
@@ -66,6 +69,16 @@ struct TypeMapper<core::dbus::types::Struct<T>>
         return s;
     }
 };
+
+template<typename T>
+struct IsMapped<core::dbus::types::Struct<T>> : public IsMapped<T>
+{
+};
+
+template<typename T>
+struct DecodesSignature<core::dbus::types::Struct<T>> : public DecodesSignature<T>
+{
+};
 }
 
 template<typename T>
@@ -86,6 +99,169 @@ struct Codec<types::Struct<T>>
         Codec<T>::decode_argument(struct_reader, out.value);
     }
 };
+
+namespace helper
+{
+/**
+ * @brief Refers to a single data member of a plain struct registered with DBUS_CPP_STRUCT_DEF.
+ */
+template<typename Class, typename Type, Type Class::*member>
+struct StructField
+{
+    typedef Type ValueType;
+
+    inline static std::string signature()
+    {
+        return TypeMapper<Type>::signature();
+    }
+
+    inline static void encode(Message::Writer& out, const Class& arg)
+    {
+        Codec<Type>::encode_argument(out, arg.*member);
+    }
+
+    inline static void decode(Message::Reader& in, Class& arg)
+    {
+        Codec<Type>::decode_argument(in, arg.*member);
+    }
+};
+
+/**
+ * @brief Maps a plain struct registered with DBUS_CPP_STRUCT_DEF to a DBus structure of its fields.
+ */
+template<typename... Fields>
+struct StructTypeMapper
+{
+    constexpr inline static ArgumentType type_value()
+    {
+        return ArgumentType::structure;
+    }
+
+    constexpr inline static bool is_basic_type()
+    {
+        return false;
+    }
+
+    constexpr inline static bool requires_signature()
+    {
+        return false;
+    }
+
+    inline static std::string signature()
+    {
+        static const std::string s = assemble_signature();
+        return s;
+    }
+
+private:
+    inline static std::string assemble_signature()
+    {
+        std::string s{DBUS_STRUCT_BEGIN_CHAR_AS_STRING};
+        // Expanded in order of the fields, the array only serves for unpacking.
+        int unpack[] = {0, (s += Fields::signature(), 0)...}; (void) unpack;
+        s += DBUS_STRUCT_END_CHAR_AS_STRING;
+        return s;
+    }
+};
+
+/**
+ * @brief Evaluates to true if the codecs of all fields of a plain struct decode their exact signature.
+ */
+template<typename... Fields>
+struct StructDecodesSignature : public AllDecodeSignature<typename Fields::ValueType...>
+{
+};
+
+/**
+ * @brief Encodes and decodes a plain struct registered with DBUS_CPP_STRUCT_DEF field by field, in place.
+ */
+template<typename Class, typename... Fields>
+struct StructCodec
+{
+    inline static void encode_argument(Message::Writer& out, const Class& arg)
+    {
+        auto sw = out.open_structure();
+        {
+            int unpack[] = {0, (Fields::encode(sw, arg), 0)...}; (void) unpack;
+        }
+        out.close_structure(std::move(sw));
+    }
+
+    inline static void decode_argument(Message::Reader& in, Class& arg)
+    {
+        if (in.type() != ArgumentType::structure)
+            throw std::runtime_error("Incompatible argument type: Argument is not a structure.");
+
+        auto struct_reader = in.pop_structure();
+        int unpack[] = {0, (Fields::decode(struct_reader, arg), 0)...}; (void) unpack;
+    }
+};
+}
 }
 }
+
+#define DBUS_CPP_STRUCT_FIELD(Type, Field) \
+    ::core::dbus::helper::StructField<Type, decltype(Type::Field), &Type::Field>
+
+#define DBUS_CPP_STRUCT_FIELDS_1(Type, Field) DBUS_CPP_STRUCT_FIELD(Type, Field)
+#define DBUS_CPP_STRUCT_FIELDS_2(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_1(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_3(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_2(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_4(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_3(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_5(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_4(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_6(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_5(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_7(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_6(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_8(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_7(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_9(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_8(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_10(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_9(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_11(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_10(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_12(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_11(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_13(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_12(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_14(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_13(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_15(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_14(Type, __VA_ARGS__)
+#define DBUS_CPP_STRUCT_FIELDS_16(Type, Field, ...) DBUS_CPP_STRUCT_FIELD(Type, Field), DBUS_CPP_STRUCT_FIELDS_15(Type, __VA_ARGS__)
+
+#define DBUS_CPP_STRUCT_COUNT_FIELDS(...) \
+    DBUS_CPP_STRUCT_COUNT_FIELDS_IMPL(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define DBUS_CPP_STRUCT_COUNT_FIELDS_IMPL(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+
+#define DBUS_CPP_STRUCT_CONCAT(a, b) DBUS_CPP_STRUCT_CONCAT_IMPL(a, b)
+#define DBUS_CPP_STRUCT_CONCAT_IMPL(a, b) a##b
+
+/**
+ * @brief Registers a plain struct with up to 16 data members for transmission as a DBus structure.
+ *
+ * Specializes TypeMapper and Codec for Type, encoding and decoding the listed members in
+ * order, in place. Has to be invoked in the global namespace, after the definition of Type:
+ *
+ * @code
+ * namespace geo { struct Position { double latitude; double longitude; std::string label; }; }
+ * DBUS_CPP_STRUCT_DEF(geo::Position, latitude, longitude, label)
+ * @endcode
+ */
+#define DBUS_CPP_STRUCT_DEF(Type, ...) \
+    namespace core \
+    { \
+    namespace dbus \
+    { \
+    namespace helper \
+    { \
+    template<> \
+    struct TypeMapper<Type> \
+        : public StructTypeMapper<DBUS_CPP_STRUCT_CONCAT(DBUS_CPP_STRUCT_FIELDS_, DBUS_CPP_STRUCT_COUNT_FIELDS(__VA_ARGS__))(Type, __VA_ARGS__)> \
+    { \
+    }; \
+    template<> \
+    struct DecodesSignature<Type> \
+        : public StructDecodesSignature<DBUS_CPP_STRUCT_CONCAT(DBUS_CPP_STRUCT_FIELDS_, DBUS_CPP_STRUCT_COUNT_FIELDS(__VA_ARGS__))(Type, __VA_ARGS__)> \
+    { \
+    }; \
+    } \
+    template<> \
+    struct Codec<Type> \
+        : public helper::StructCodec<Type, DBUS_CPP_STRUCT_CONCAT(DBUS_CPP_STRUCT_FIELDS_, DBUS_CPP_STRUCT_COUNT_FIELDS(__VA_ARGS__))(Type, __VA_ARGS__)> \
+    { \
+    }; \
+    } \
+    }
+
 #endif // CORE_DBUS_TYPES_STRUCT_H_
@@ -20,15 +20,24 @@
 
 #include <core/dbus/codec.h>
 #include <core/dbus/message.h>
+#include <core/dbus/helper/signature.h>
 #include <core/dbus/helper/type_mapper.h>
-#include <core/dbus/types/any.h>
+#include <core/dbus/types/object_path.h>
 #include <core/dbus/types/signature.h>
+#include <core/dbus/types/stl/string.h>
 
+#include <cstddef>
 #include <cstring>
 
-#include <functional>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 
 namespace core
 {
@@ -36,170 +45,556 @@ namespace dbus
 {
 namespace types
 {
+/**
+ * @brief Variant carries a value of a type only known at runtime.
+ *
+ * Values are kept in an inline buffer if they are small enough, e.g., for all
+ * basic types and short strings, and are accessed via a static table of functions
+ * per type. Decoding a default-constructed instance reads basic types right away,
+ * values of container types are decoded on the first call to as<T>() and cached.
+ * Caching is synchronized, all const member functions can be invoked concurrently.
+ */
 class Variant
 {
-protected:
-    typedef std::function<void(dbus::Message::Writer&)> Encoder;
-    typedef std::function<void(dbus::Message::Reader&)> Decoder;
-
-    inline Variant(const Encoder& encoder, const types::Signature& signature)
-        : encoder(encoder),
-          decoder(),
-          signature_(signature)
-    {
-    }
-
-    inline Variant(const Decoder& decoder, const types::Signature& signature)
-        : encoder(),
-          decoder(decoder),
-          signature_(signature)
-    {
-    }
 public:
     template<typename T>
     static inline Variant encode(T t)
     {
-        Encoder encoder = [t](dbus::Message::Writer& writer)
-        {
-            Codec<T>::encode_argument(writer, t);
-        };
-
-        return Variant(
-                encoder,
-                types::Signature(
-                        core::dbus::helper::TypeMapper<T>::signature()));
+        Variant result(false);
+        result.construct<T, typename Owned<T>::Type>(std::move(t));
+        return result;
     }
 
     template<typename T>
     static inline Variant decode(T& t)
     {
-        Decoder decoder = [&t](dbus::Message::Reader& reader)
-        {
-            Codec<T>::decode_argument(reader, t);
-        };
-
-        return Variant(
-                decoder,
-                types::Signature(
-                        core::dbus::helper::TypeMapper<T>::signature()));
+        Variant result(false);
+        result.construct<T, Referenced<T>>(std::addressof(t));
+        return result;
     }
 
-    inline Variant()
+    inline Variant() : Variant(true)
     {
-        decoder = [this](dbus::Message::Reader& reader)
-        {
-            core::dbus::Codec<types::Any>::decode_argument(reader, any);
-        };
     }
 
-    inline Variant(const Variant&) = default;
+    inline Variant(const Variant& rhs) : Variant(rhs, rhs.lock_if_pending())
+    {
+    }
 
     inline Variant(Variant&& rhs)
-        : encoder(std::move(rhs.encoder)),
-          decoder(std::move(rhs.decoder)),
-          any(std::move(rhs.any)),
+        : vtable_(rhs.vtable_),
+          reader_(std::move(rhs.reader_)),
+          pending_(rhs.pending_.load()),
+          dynamic_(rhs.dynamic_),
           signature_(std::move(rhs.signature_))
     {
+        if (vtable_)
+            vtable_->move(rhs.storage_, storage_);
+
+        rhs.vtable_ = nullptr;
+        rhs.pending_ = false;
     }
 
-    virtual ~Variant() = default;
+    virtual ~Variant()
+    {
+        reset();
+    }
+
+    inline Variant& operator=(const Variant& rhs)
+    {
+        if (this != std::addressof(rhs))
+            *this = Variant(rhs);
+
+        return *this;
+    }
 
     inline Variant& operator=(Variant&& rhs)
     {
-        encoder = std::move(rhs.encoder);
-        decoder = std::move(rhs.decoder);
+        if (this == std::addressof(rhs))
+            return *this;
+
+        reset();
+
+        vtable_ = rhs.vtable_;
+        if (vtable_)
+            vtable_->move(rhs.storage_, storage_);
+        reader_ = std::move(rhs.reader_);
+        pending_ = rhs.pending_.load();
+        dynamic_ = rhs.dynamic_;
         signature_ = std::move(rhs.signature_);
-        any = std::move(rhs.any);
+
+        rhs.vtable_ = nullptr;
+        rhs.pending_ = false;
 
         return *this;
     }
 
     virtual void decode(Message::Reader& reader)
     {
-        if (!decoder)
+        if (dynamic_)
+        {
+            decode_dynamically(reader);
+            return;
+        }
+
+        if (!vtable_)
             throw std::runtime_error("Variant::decode: Missing a decoder specification.");
 
-        decoder(reader);
+        vtable_->decode(storage_, reader);
     }
 
     virtual void encode(Message::Writer& writer) const
     {
-        if (!encoder)
+        auto lock = lock_if_pending();
+        if (!vtable_)
             throw std::runtime_error("Variant::encode: Missing an encoder specification.");
 
-        encoder(writer);
+        vtable_->encode(storage_, writer);
     }
 
     virtual const types::Signature& signature() const
     {
+        // Values of container types that have not been decoded yet are only inspected on demand.
+        auto lock = lock_if_pending();
+        if (pending_ && signature_.as_string().empty())
+            signature_ = types::Signature{reader_.signature()};
+
         return signature_;
     }
 
+    /**
+     * @brief Returns a copy of the contained value.
+     *
+     * Values of a different type but of the same signature, e.g., a double for a float,
+     * are converted by means of their codecs.
+     *
+     * @throw std::runtime_error if the value cannot be represented as T.
+     */
     template<typename T>
     T as() const
     {
-        T result;
-        any.reader() >> result;
+        auto lock = lock_if_pending();
+        if (pending_)
+        {
+            auto reader = reader_.copy();
+            T result;
+            Codec<T>::decode_argument(reader, result);
 
-        return result;
+            cache<T>(result);
+            return result;
+        }
+
+        if (!vtable_)
+            throw std::runtime_error("Variant::as: Variant does not carry a value.");
+
+        if (vtable_->type() == typeid(T))
+            return *static_cast<const T*>(vtable_->get(storage_));
+
+        if (signature_ == helper::signature_of<T>())
+            return convert<T>();
+
+        throw std::runtime_error(
+                    "Variant::as: Variant of signature " + signature_.as_string() +
+                    " does not carry a value of signature " + helper::signature_of<T>().as_string());
     }
 
-protected:
-    inline void set_encoder(const Encoder& encoder)
+    /**
+     * @brief Copies the contained value to value, reporting errors by value instead of throwing.
+     *
+     * Values of a different signature than the one of T are rejected up front, without
+     * formatting an error message or unwinding the stack.
+     *
+     * @throw std::bad_alloc and other failures to acquire resources, they are not decode errors.
+     */
+    template<typename T>
+    DecodeError try_as(T& value) const
     {
-        this->encoder = encoder;
+        try
+        {
+            // Only a pending value is replaced concurrently, signature() and as<T>() take care of it.
+            if (!pending_)
+            {
+                if (vtable_ && vtable_->type() == typeid(T))
+                {
+                    value = *static_cast<const T*>(vtable_->get(storage_));
+                    return DecodeError::none;
+                }
+
+                if (!vtable_)
+                    return DecodeError::signature_mismatch;
+            }
+
+            if (!(signature() == helper::signature_of<T>()))
+                return DecodeError::signature_mismatch;
+
+            value = as<T>();
+        }
+        catch (const std::runtime_error&)
+        {
+            return DecodeError::invalid_argument;
+        }
+        catch (const std::logic_error&)
+        {
+            return DecodeError::invalid_argument;
+        }
+
+        return DecodeError::none;
     }
 
-    inline void set_decoder(const Decoder& decoder)
+protected:
+    /**
+     * @brief Accesses the value constructed by hold<T>() or decoded into it.
+     */
+    template<typename T>
+    inline T* value_pointer() const
     {
-        this->decoder = decoder;
+        return static_cast<T*>(vtable_->get(storage_));
     }
 
-    inline void set_signature(const types::Signature& signature)
+    /**
+     * @brief Makes this instance own a value of type T, also for subsequent decoding.
+     */
+    template<typename T, typename... Args>
+    inline void hold(Args&&... args)
     {
-        this->signature_ = signature;
+        dynamic_ = false;
+        construct<T, typename Owned<T>::Type>(std::forward<Args>(args)...);
     }
 
 private:
-    Encoder encoder;
-    Decoder decoder;
-    types::Any any;
-    types::Signature signature_;
+    typedef std::aligned_storage<4 * sizeof(void*), alignof(std::max_align_t)>::type Storage;
+
+    struct VTable
+    {
+        const std::type_info& (*type)();
+        void* (*get)(Storage&);
+        void (*copy)(const Storage& from, Storage& to);
+        // Leaves from destroyed.
+        void (*move)(Storage& from, Storage& to);
+        void (*destroy)(Storage&);
+        void (*encode)(const Storage&, Message::Writer&);
+        void (*decode)(Storage&, Message::Reader&);
+    };
+
+    template<typename T>
+    struct Inline
+    {
+        template<typename... Args>
+        static void construct(Storage& s, Args&&... args)
+        {
+            new (std::addressof(s)) T(std::forward<Args>(args)...);
+        }
+
+        static T* pointer(Storage& s)
+        {
+            return reinterpret_cast<T*>(std::addressof(s));
+        }
+
+        static const T* pointer(const Storage& s)
+        {
+            return reinterpret_cast<const T*>(std::addressof(s));
+        }
+
+        static void copy(const Storage& from, Storage& to)
+        {
+            construct(to, *pointer(from));
+        }
+
+        static void move(Storage& from, Storage& to)
+        {
+            construct(to, std::move(*pointer(from)));
+            destroy(from);
+        }
+
+        static void destroy(Storage& s)
+        {
+            pointer(s)->~T();
+        }
+    };
+
+    template<typename T>
+    struct Allocated
+    {
+        template<typename... Args>
+        static void construct(Storage& s, Args&&... args)
+        {
+            new (std::addressof(s)) T*(new T(std::forward<Args>(args)...));
+        }
+
+        static T* pointer(Storage& s)
+        {
+            return *reinterpret_cast<T**>(std::addressof(s));
+        }
+
+        static const T* pointer(const Storage& s)
+        {
+            return *reinterpret_cast<T* const*>(std::addressof(s));
+        }
+
+        static void copy(const Storage& from, Storage& to)
+        {
+            construct(to, *pointer(from));
+        }
+
+        static void move(Storage& from, Storage& to)
+        {
+            std::memcpy(std::addressof(to), std::addressof(from), sizeof(T*));
+        }
+
+        static void destroy(Storage& s)
+        {
+            delete pointer(s);
+        }
+    };
+
+    // Refers to a value owned by the caller of decode(T&).
+    template<typename T>
+    struct Referenced : public Allocated<T>
+    {
+        static void construct(Storage& s, T* t)
+        {
+            new (std::addressof(s)) T*(t);
+        }
+
+        static void copy(const Storage& from, Storage& to)
+        {
+            std::memcpy(std::addressof(to), std::addressof(from), sizeof(T*));
+        }
+
+        static void destroy(Storage&)
+        {
+        }
+    };
+
+    template<typename T>
+    struct Owned
+    {
+        typedef typename std::conditional<
+            sizeof(T) <= sizeof(Storage) &&
+            alignof(Storage) % alignof(T) == 0 &&
+            std::is_nothrow_move_constructible<T>::value,
+            Inline<T>,
+            Allocated<T>
+        >::type Type;
+    };
+
+    template<typename T, typename Policy>
+    struct Model
+    {
+        static const std::type_info& type()
+        {
+            return typeid(T);
+        }
+
+        static void* get(Storage& s)
+        {
+            return Policy::pointer(s);
+        }
+
+        static void encode(const Storage& s, Message::Writer& writer)
+        {
+            Codec<T>::encode_argument(writer, *Policy::pointer(s));
+        }
+
+        static void decode(Storage& s, Message::Reader& reader)
+        {
+            Codec<T>::decode_argument(reader, *Policy::pointer(s));
+        }
+
+        static const VTable vtable;
+    };
+
+    inline explicit Variant(bool dynamic)
+        : vtable_(nullptr),
+          pending_(false),
+          dynamic_(dynamic)
+    {
+    }
+
+    // Keeps rhs locked while copying, a pending value might be cached concurrently otherwise.
+    inline Variant(const Variant& rhs, std::unique_lock<std::mutex>&&)
+        : vtable_(rhs.vtable_),
+          reader_(rhs.reader_.copy()),
+          pending_(rhs.pending_.load()),
+          dynamic_(rhs.dynamic_),
+          signature_(rhs.signature_)
+    {
+        if (vtable_)
+            vtable_->copy(rhs.storage_, storage_);
+    }
+
+    // Values are only ever replaced concurrently while pending, by as<T>() caching them.
+    inline std::unique_lock<std::mutex> lock_if_pending() const
+    {
+        std::unique_lock<std::mutex> lock(guard_, std::defer_lock);
+        if (pending_)
+            lock.lock();
+
+        return lock;
+    }
+
+    // Invoked by as<T>() with guard_ locked, the signature might have been handed out already.
+    template<typename T>
+    inline void cache(const T& value) const
+    {
+        typedef typename Owned<T>::Type Policy;
+
+        Policy::construct(storage_, value);
+        vtable_ = std::addressof(Model<T, Policy>::vtable);
+        if (signature_.as_string().empty())
+            signature_ = helper::signature_of<T>();
+        reader_ = Message::Reader();
+        pending_ = false;
+    }
+
+    // Replaces the current content.
+    template<typename T, typename Policy, typename... Args>
+    inline void construct(Args&&... args)
+    {
+        reset();
+
+        Policy::construct(storage_, std::forward<Args>(args)...);
+        vtable_ = std::addressof(Model<T, Policy>::vtable);
+        signature_ = helper::signature_of<T>();
+    }
+
+    inline void reset()
+    {
+        if (vtable_)
+            vtable_->destroy(storage_);
+
+        vtable_ = nullptr;
+        pending_ = false;
+        reader_ = Message::Reader();
+    }
+
+    inline void decode_dynamically(Message::Reader& reader)
+    {
+        switch (reader.type())
+        {
+        case ArgumentType::byte:
+            construct<std::int8_t, Inline<std::int8_t>>(reader.pop_byte());
+            break;
+        case ArgumentType::boolean:
+            construct<bool, Inline<bool>>(reader.pop_boolean());
+            break;
+        case ArgumentType::int16:
+            construct<std::int16_t, Inline<std::int16_t>>(reader.pop_int16());
+            break;
+        case ArgumentType::uint16:
+            construct<std::uint16_t, Inline<std::uint16_t>>(reader.pop_uint16());
+            break;
+        case ArgumentType::int32:
+            construct<std::int32_t, Inline<std::int32_t>>(reader.pop_int32());
+            break;
+        case ArgumentType::uint32:
+            construct<std::uint32_t, Inline<std::uint32_t>>(reader.pop_uint32());
+            break;
+        case ArgumentType::int64:
+            construct<std::int64_t, Inline<std::int64_t>>(reader.pop_int64());
+            break;
+        case ArgumentType::uint64:
+            construct<std::uint64_t, Inline<std::uint64_t>>(reader.pop_uint64());
+            break;
+        case ArgumentType::floating_point:
+            construct<double, Inline<double>>(reader.pop_floating_point());
+            break;
+        case ArgumentType::string:
+            construct<std::string, Owned<std::string>::Type>(reader.pop_string());
+            break;
+        case ArgumentType::object_path:
+            static_assert(std::is_same<Owned<types::ObjectPath>::Type, Inline<types::ObjectPath>>::value,
+                          "Object paths refer to an interned atom and are expected to be held inline");
+            construct<types::ObjectPath, Owned<types::ObjectPath>::Type>(reader.pop_object_path());
+            break;
+        case ArgumentType::signature:
+            construct<types::Signature, Owned<types::Signature>::Type>(reader.pop_signature());
+            break;
+        default:
+            // The type is only known once as<T>() is called, we keep a position of our own.
+            reset();
+            reader_ = reader.copy();
+            pending_ = true;
+            signature_ = types::Signature{};
+            reader.pop();
+            break;
+        }
+    }
+
+    // Round-trips the contained value through a scratch message.
+    template<typename T>
+    T convert() const
+    {
+        auto msg = Message::make_signal("/", "core.dbus.Variant", "Convert");
+        {
+            auto writer = msg->writer();
+            vtable_->encode(storage_, writer);
+        }
+
+        auto reader = msg->reader();
+        T result;
+        Codec<T>::decode_argument(reader, result);
+
+        return result;
+    }
+
+    mutable const VTable* vtable_;
+    mutable Storage storage_;
+    mutable Message::Reader reader_;
+    mutable std::atomic<bool> pending_;
+    bool dynamic_;
+    mutable types::Signature signature_;
+    mutable std::mutex guard_;
+};
+
+template<typename T, typename Policy>
+const Variant::VTable Variant::Model<T, Policy>::vtable =
+{
+    &Variant::Model<T, Policy>::type,
+    &Variant::Model<T, Policy>::get,
+    &Policy::copy,
+    &Policy::move,
+    &Policy::destroy,
+    &Variant::Model<T, Policy>::encode,
+    &Variant::Model<T, Policy>::decode
 };
 
 template<typename T>
 class TypedVariant : public Variant
 {
 public:
-    explicit TypedVariant(const T& t = T()) : value(t)
+    explicit TypedVariant(const T& t = T())
     {
-        auto decoder = [this](dbus::Message::Reader& reader)
-        {
-            Codec<T>::decode_argument(reader, value);
-        };
-
-        auto encoder = [this](dbus::Message::Writer& writer)
-        {
-            Codec<T>::encode_argument(writer, value);
-        };
-
-        set_decoder(decoder);
-        set_encoder(encoder);
-        set_signature(types::Signature{helper::TypeMapper<T>::signature()});
+        hold<T>(t);
     }
 
     inline const T& get() const
     {
-        return value;
+        return *value_pointer<T>();
     }
 
     inline void set(const T& t)
     {
-        value = t;
+        *value_pointer<T>() = t;
     }
+};
+}
+namespace helper
+{
+template<typename T>
+struct TypeMapper<types::TypedVariant<T>> : public TypeMapper<types::Variant>
+{
+};
 
-private:
-    T value;
+// The contents of variants are checked in any case.
+template<>
+struct DecodesSignature<types::Variant> : public std::true_type
+{
+};
+
+template<typename T>
+struct DecodesSignature<types::TypedVariant<T>> : public std::true_type
+{
 };
 }
 /**
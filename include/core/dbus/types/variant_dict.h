@@ -0,0 +1,242 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TYPES_VARIANT_DICT_H_
+#define CORE_DBUS_TYPES_VARIANT_DICT_H_
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+#include <core/dbus/helper/type_mapper.h>
+#include <core/dbus/types/variant.h>
+
+#include <cstring>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace core
+{
+namespace dbus
+{
+namespace types
+{
+class VariantDict;
+}
+namespace helper
+{
+template<>
+struct TypeMapper<types::VariantDict>
+{
+    constexpr static ArgumentType type_value()
+    {
+        return ArgumentType::array;
+    }
+    constexpr static bool is_basic_type()
+    {
+        return false;
+    }
+    constexpr static bool requires_signature()
+    {
+        return true;
+    }
+
+    static std::string signature()
+    {
+        static const std::string s =
+                DBUS_TYPE_ARRAY_AS_STRING
+                DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+                DBUS_TYPE_STRING_AS_STRING
+                DBUS_TYPE_VARIANT_AS_STRING
+                DBUS_DICT_ENTRY_END_CHAR_AS_STRING;
+        return s;
+    }
+};
+}
+namespace types
+{
+/**
+ * @brief VariantDict is a read-only view of a dictionary of type a{sv} in a message.
+ *
+ * In contrast to decoding the dictionary to a std::map<std::string, Variant>, the keys
+ * are only scanned on first access, and values are only decoded when requested, at
+ * most once. Copies share the scanned keys and decoded values.
+ *
+ * A VariantDict keeps the message it has been decoded from alive for as long as it exists,
+ * as the keys point into the message.
+ */
+class VariantDict
+{
+public:
+    /**
+     * @brief Constructs an empty instance.
+     */
+    VariantDict() = default;
+
+    /**
+     * @brief Returns the number of entries.
+     */
+    inline std::size_t size() const
+    {
+        return index().size();
+    }
+
+    /**
+     * @brief Returns the key of the i-th entry, in order of the message.
+     */
+    inline const char* key(std::size_t i) const
+    {
+        return index().at(i).key;
+    }
+
+    /**
+     * @brief Returns the value of the i-th entry, decoding it on first access.
+     */
+    inline const Variant& value(std::size_t i) const
+    {
+        auto& entry = index().at(i);
+        if (!entry.decoded)
+        {
+            if (entry.value.type() != ArgumentType::variant)
+                throw std::runtime_error("VariantDict: Entry does not carry a variant.");
+
+            Codec<Variant>::decode_argument(entry.value, entry.variant);
+            entry.value = Message::Reader();
+            entry.decoded = true;
+        }
+
+        return entry.variant;
+    }
+
+    /**
+     * @brief Checks whether an entry with the given key exists.
+     */
+    inline bool contains(const std::string& key) const
+    {
+        return find(key) != index().size();
+    }
+
+    /**
+     * @brief Returns the value of the entry with the given key, decoding it on first access.
+     * @throw std::out_of_range if there is no such entry.
+     */
+    inline const Variant& at(const std::string& key) const
+    {
+        auto i = find(key);
+        if (i == index().size())
+            throw std::out_of_range("VariantDict: No entry for key " + key);
+
+        return value(i);
+    }
+
+    /**
+     * @brief Returns the value of the entry with the given key as T.
+     * @throw std::out_of_range if there is no such entry, std::runtime_error if decoding fails.
+     */
+    template<typename T>
+    inline T get(const std::string& key) const
+    {
+        return at(key).as<T>();
+    }
+
+private:
+    friend struct core::dbus::Codec<VariantDict>;
+
+    struct Entry
+    {
+        // Points into the message.
+        const char* key;
+        // Positioned at the value until it has been decoded.
+        Message::Reader value;
+        bool decoded;
+        Variant variant;
+    };
+
+    struct Private
+    {
+        // Kept after scanning, holds on to the message the keys point into.
+        Message::Reader entries;
+        bool scanned;
+        std::vector<Entry> index;
+    };
+
+    inline explicit VariantDict(Message::Reader entries)
+        : d(std::make_shared<Private>())
+    {
+        d->entries = std::move(entries);
+        d->scanned = false;
+    }
+
+    inline std::vector<Entry>& index() const
+    {
+        static std::vector<Entry> empty;
+        if (!d)
+            return empty;
+
+        if (!d->scanned)
+        {
+            while (d->entries.type() != ArgumentType::invalid)
+            {
+                if (d->entries.type() != ArgumentType::dictionary_entry)
+                    throw std::runtime_error("VariantDict: Array does not contain dictionary entries.");
+
+                auto entry = d->entries.pop_dict_entry();
+                auto key = entry.pop_string();
+                d->index.push_back(Entry{key, std::move(entry), false, Variant{}});
+            }
+
+            d->scanned = true;
+        }
+
+        return d->index;
+    }
+
+    inline std::size_t find(const std::string& key) const
+    {
+        const auto& entries = index();
+        for (std::size_t i = 0; i < entries.size(); i++)
+            if (std::strcmp(entries[i].key, key.c_str()) == 0)
+                return i;
+
+        return entries.size();
+    }
+
+    std::shared_ptr<Private> d;
+};
+}
+
+/**
+ * @brief Template specialization for lazily decoded dictionaries of type a{sv}.
+ *
+ * VariantDict can only be decoded, use std::map<std::string, types::Variant> for encoding.
+ */
+template<>
+struct Codec<types::VariantDict>
+{
+    inline static void decode_argument(Message::Reader& in, types::VariantDict& dict)
+    {
+        if (in.type() != ArgumentType::array)
+            throw std::runtime_error("VariantDict: Argument is not an array.");
+
+        dict = types::VariantDict{in.pop_array()};
+    }
+};
+}
+}
+
+#endif // CORE_DBUS_TYPES_VARIANT_DICT_H_
@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_URING_EXECUTOR_H_
+#define CORE_DBUS_URING_EXECUTOR_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/executor.h>
+#include <core/dbus/visibility.h>
+
+namespace core
+{
+namespace dbus
+{
+namespace uring
+{
+/**
+ * @brief Checks whether dbus-cpp has been built with io_uring support and
+ * whether the running kernel provides the features required by the io_uring executor.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_supported();
+
+/**
+ * @brief Creates an executor that monitors the connection of the given bus with io_uring.
+ *
+ * Watches are monitored with polls that are re-armed after every event, and all
+ * requests that accumulate while handling a batch of completions are handed to
+ * the kernel with a single system call. If io_uring is not available, either at build time or on the running
+ * kernel, an executor created by core::dbus::asio::make_executor(bus) is returned instead.
+ *
+ * @throw std::runtime_error if bus is null.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus);
+}
+}
+}
+
+#endif // CORE_DBUS_URING_EXECUTOR_H_
@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_VALIDATION_H_
+#define CORE_DBUS_VALIDATION_H_
+
+#include <core/dbus/visibility.h>
+
+#include <cstddef>
+#include <string>
+
+namespace core
+{
+namespace dbus
+{
+/**
+ * @brief Validators for strings, object paths and signatures as defined by the DBus specification.
+ *
+ * The functions accept exactly the same input as their libdbus counterparts, but check
+ * many bytes at once where the CPU supports it. The implementation is chosen once at
+ * runtime, falling back to plain byte-at-a-time checks.
+ */
+namespace validation
+{
+/**
+ * @brief Instruction set extensions the validators are implemented for.
+ */
+enum class Isa
+{
+    scalar,
+    sse2,
+    avx2
+};
+
+/**
+ * @brief Checks whether the CPU we are running on supports the given implementation.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_supported(Isa isa);
+
+/**
+ * @brief The implementation chosen at runtime, the fastest one supported by the CPU.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Isa best_isa();
+
+/**
+ * @brief Checks if [s, s + size) is valid UTF-8 without null bytes, as required for DBus strings.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_valid_utf8(const char* s, std::size_t size);
+
+/**
+ * @brief Checks if [s, s + size) is a valid object path, e.g., / or /org/freedesktop/DBus.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_valid_object_path(const char* s, std::size_t size);
+
+/**
+ * @brief Checks if [s, s + size) is a valid signature, i.e., a sequence of complete types.
+ *
+ * Signatures are at most 255 characters long and their nesting has to be checked
+ * character by character, they are always validated by the scalar implementation.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_valid_signature(const char* s, std::size_t size);
+
+/**
+ * @brief Checks if [s, s + size) is a single complete type that may be the element of an array.
+ *
+ * In contrast to is_valid_signature, dictionary entries are accepted, e.g., {sv}.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_valid_element_signature(const char* s, std::size_t size);
+
+/**
+ * @brief Runs the given implementation of is_valid_utf8, e.g., for testing and benchmarking.
+ * @throw std::runtime_error if the implementation is not supported by the CPU.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_valid_utf8(Isa isa, const char* s, std::size_t size);
+
+/**
+ * @brief Runs the given implementation of is_valid_object_path, e.g., for testing and benchmarking.
+ * @throw std::runtime_error if the implementation is not supported by the CPU.
+ */
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC bool is_valid_object_path(Isa isa, const char* s, std::size_t size);
+
+inline bool is_valid_utf8(const std::string& s)
+{
+    return is_valid_utf8(s.data(), s.size());
+}
+
+inline bool is_valid_object_path(const std::string& s)
+{
+    return is_valid_object_path(s.data(), s.size());
+}
+
+inline bool is_valid_signature(const std::string& s)
+{
+    return is_valid_signature(s.data(), s.size());
+}
+
+inline bool is_valid_element_signature(const std::string& s)
+{
+    return is_valid_element_signature(s.data(), s.size());
+}
+}
+}
+}
+
+#endif // CORE_DBUS_VALIDATION_H_
@@ -16,21 +16,34 @@
  * Authored by: Thomas Voß <thomas.voss@canonical.com>
  */
 
+#include <core/dbus/asio/executor.h>
+
 #include <core/dbus/bus.h>
 #include <core/dbus/executor.h>
 #include <core/dbus/traits/timeout.h>
 #include <core/dbus/traits/watch.h>
 
+#include "../timer_wheel.h"
+
 #include <boost/asio.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include <stdexcept>
+#include <system_error>
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <future>
 #include <thread>
+#include <vector>
 
 namespace core
 {
@@ -95,73 +108,173 @@ struct Watch<DBusWatch>
 }
 namespace asio
 {
-class Executor : public core::dbus::Executor
+class Executor : public core::dbus::Executor, public core::dbus::FdWatcher
 {
 public:
-    template<typename UnderlyingTimeoutType = DBusTimeout>
-    struct Timeout : std::enable_shared_from_this<Timeout<UnderlyingTimeoutType>>
+    // Multiplexes all timeouts of an executor onto a single asio timer, keeping
+    // track of individual deadlines in a hierarchical timer wheel with millisecond
+    // resolution. With thousands of outstanding pending calls, this avoids
+    // maintaining thousands of timers in asio's timer queue.
+    class TimeoutScheduler : public std::enable_shared_from_this<TimeoutScheduler>
     {
-        Timeout(boost::asio::io_service& io_service, UnderlyingTimeoutType* timeout)
-            : io_service(io_service),
-              timer(io_service),
-              timeout(timeout)
+    public:
+        typedef boost::asio::steady_timer::clock_type Clock;
+
+        struct Entry : public impl::TimerWheel::Timer
+        {
+            virtual ~Entry() = default;
+            virtual void on_timeout() = 0;
+
+            // Allows for keeping the entry alive while its handler is invoked.
+            std::weak_ptr<Entry> self;
+        };
+
+        TimeoutScheduler(boost::asio::io_service& io_service)
+            : timer(io_service),
+              epoch(Clock::now()),
+              armed_for(impl::TimerWheel::never)
         {
-            if (!timeout)
-                throw std::runtime_error("Precondition violated: timeout has to be non-null");
         }
 
-        ~Timeout()
+        void schedule(const std::shared_ptr<Entry>& entry, const std::chrono::milliseconds& timeout)
+        {
+            std::lock_guard<std::mutex> lg(guard);
+
+            auto now = Clock::now();
+
+            // Fast-forward an idle wheel, keeping newly scheduled timers in the finest level.
+            if (wheel.empty())
+                wheel.advance(elapsed_ticks(now), [](impl::TimerWheel::Timer*) {});
+
+            entry->self = entry;
+            wheel.schedule(entry.get(), elapsed_ticks(now + timeout, true));
+
+            rearm_locked();
+        }
+
+        void cancel(Entry* entry)
         {
-            // cancel();
+            // We do not rearm the timer here. If cancelled entries leave the wheel empty
+            // or with a later next event, we simply wake up once without work to do.
+            std::lock_guard<std::mutex> lg(guard);
+            wheel.cancel(entry);
         }
 
-        void start()
+    private:
+        // Translates a point in time to ticks since epoch, rounding up if requested.
+        impl::TimerWheel::Tick elapsed_ticks(const Clock::time_point& tp, bool round_up = false) const
         {
-            if (!traits::Timeout<UnderlyingTimeoutType>::is_timeout_enabled(timeout))
-            {
+            if (tp <= epoch)
+                return 0;
+
+            auto elapsed = tp - epoch;
+            auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+
+            if (round_up && ticks < elapsed)
+                ticks += std::chrono::milliseconds{1};
+
+            return ticks.count();
+        }
+
+        void rearm_locked()
+        {
+            auto next = wheel.next_event();
+
+            if (next >= armed_for)
                 return;
-            }
+
+            armed_for = next;
 
             // We do not keep ourselves alive to prevent from races during destruction.
-            std::weak_ptr<Timeout<UnderlyingTimeoutType>> wp{this->shared_from_this()};
+            std::weak_ptr<TimeoutScheduler> wp{shared_from_this()};
 
-            timer.expires_from_now(
-                        boost::posix_time::milliseconds(
-                            traits::Timeout<UnderlyingTimeoutType>::get_timeout_interval(
-                                timeout)));
+            timer.expires_at(epoch + std::chrono::milliseconds(next));
             timer.async_wait([wp](const boost::system::error_code& ec)
             {
+                if (ec)
+                    return;
+
                 auto sp = wp.lock();
 
                 if (sp)
-                    sp->on_timeout(ec);
+                    sp->on_timer();
             });
         }
 
-        void cancel()
+        void on_timer()
         {
-            try
-            {
-                timer.cancel();
-            } catch(...)
+            std::vector<std::shared_ptr<Entry>> expired;
+
             {
-                // Really not sure what we should do about exceptions here.
+                std::lock_guard<std::mutex> lg(guard);
+
+                armed_for = impl::TimerWheel::never;
+
+                wheel.advance(elapsed_ticks(Clock::now()), [&expired](impl::TimerWheel::Timer* timer)
+                {
+                    // The entry might be in the process of being destroyed.
+                    auto sp = static_cast<Entry*>(timer)->self.lock();
+                    if (sp)
+                        expired.push_back(sp);
+                });
+
+                rearm_locked();
             }
+
+            // Handlers are invoked without holding the lock as libdbus is very
+            // likely to call back into the scheduler.
+            for (const auto& entry : expired)
+                entry->on_timeout();
         }
 
-        void on_timeout(const boost::system::error_code& ec)
+        std::mutex guard;
+        boost::asio::steady_timer timer;
+        Clock::time_point epoch;
+        impl::TimerWheel wheel;
+        impl::TimerWheel::Tick armed_for;
+    };
+
+    template<typename UnderlyingTimeoutType = DBusTimeout>
+    struct Timeout : public TimeoutScheduler::Entry, public std::enable_shared_from_this<Timeout<UnderlyingTimeoutType>>
+    {
+        Timeout(const std::shared_ptr<TimeoutScheduler>& scheduler, UnderlyingTimeoutType* timeout)
+            : scheduler(scheduler),
+              timeout(timeout)
         {
-            if (ec == boost::asio::error::operation_aborted)
-                return;
+            if (!timeout)
+                throw std::runtime_error("Precondition violated: timeout has to be non-null");
+        }
+
+        ~Timeout()
+        {
+            cancel();
+        }
 
-            if (ec)
+        void start()
+        {
+            if (!traits::Timeout<UnderlyingTimeoutType>::is_timeout_enabled(timeout))
+            {
                 return;
+            }
+
+            scheduler->schedule(
+                        this->shared_from_this(),
+                        std::chrono::milliseconds(
+                            traits::Timeout<UnderlyingTimeoutType>::get_timeout_interval(
+                                timeout)));
+        }
+
+        void cancel()
+        {
+            scheduler->cancel(this);
+        }
 
+        void on_timeout() override
+        {
             traits::Timeout<UnderlyingTimeoutType>::invoke_timeout_handler(timeout);
         }
 
-        boost::asio::io_service& io_service;
-        boost::asio::deadline_timer timer;
+        std::shared_ptr<TimeoutScheduler> scheduler;
         UnderlyingTimeoutType* timeout;
     };
 
@@ -178,13 +291,24 @@ public:
 
         ~Watch() noexcept
         {
-            stream_descriptor.cancel();
-            stream_descriptor.release();
+            // Watches that have never been enabled do not own a descriptor.
+            if (!stream_descriptor.is_open())
+                return;
+
+            boost::system::error_code ec;
+            stream_descriptor.cancel(ec);
+            stream_descriptor.close(ec);
         }
 
         void start()
         {
-            stream_descriptor.assign(traits::Watch<UnderlyingWatchType>::get_watch_unix_fd(watch));
+            // libdbus hands out separate watches for reading and writing on the same fd,
+            // which the reactor refuses to register twice. Each watch monitors a duplicate.
+            auto fd = ::dup(traits::Watch<UnderlyingWatchType>::get_watch_unix_fd(watch));
+            if (fd == -1)
+                throw std::system_error(errno, std::system_category());
+
+            stream_descriptor.assign(fd);
             restart();
         }
 
@@ -251,7 +375,9 @@ public:
                 if (!traits::Watch<UnderlyingWatchType>::invoke_watch_handler_for_event(watch, event))
                     throw std::runtime_error("Insufficient memory while handling watch event");
 
-                restart();
+                // Handling the event might have disabled the watch, e.g., once all pending data is written.
+                if (traits::Watch<UnderlyingWatchType>::is_watch_enabled(watch))
+                    restart();
             }
         }
 
@@ -260,6 +386,53 @@ public:
         UnderlyingWatchType* watch;
     };
 
+    // Monitors an fd handed to us via Bus::watch_readable. Starting and cancelling
+    // is serialized on a strand, as the io_service might be run by several threads.
+    struct ReadableWatch : std::enable_shared_from_this<ReadableWatch>
+    {
+        ReadableWatch(boost::asio::io_service& io_service, int fd, const std::function<void()>& handler)
+            : strand(io_service),
+              stream_descriptor(io_service),
+              handler(handler)
+        {
+            // The caller keeps ownership of fd, we monitor a duplicate.
+            auto duplicate = ::dup(fd);
+            if (duplicate == -1)
+                throw std::system_error(errno, std::system_category());
+
+            stream_descriptor.assign(duplicate);
+        }
+
+        void start()
+        {
+            std::weak_ptr<ReadableWatch> wp{this->shared_from_this()};
+
+            stream_descriptor.async_read_some(boost::asio::null_buffers(), strand.wrap([wp](boost::system::error_code ec, std::size_t)
+            {
+                auto sp = wp.lock();
+
+                if (!sp || ec || sp->cancelled)
+                    return;
+
+                sp->handler();
+                sp->start();
+            }));
+        }
+
+        void cancel()
+        {
+            cancelled = true;
+
+            boost::system::error_code ec;
+            stream_descriptor.cancel(ec);
+        }
+
+        boost::asio::io_service::strand strand;
+        boost::asio::posix::stream_descriptor stream_descriptor;
+        std::function<void()> handler;
+        bool cancelled = false;
+    };
+
     template<typename T>
     struct Holder
     {
@@ -277,15 +450,14 @@ public:
 
     static dbus_bool_t on_dbus_add_watch(DBusWatch* watch, void* data)
     {
-        if (dbus_watch_get_enabled(watch) == FALSE)
-            return TRUE;
-
         auto thiz = static_cast<Executor*>(data);
         auto w = std::shared_ptr<Watch<>>(new Watch<>(thiz->io_service, watch));
         auto holder = new Holder<std::shared_ptr<Watch<>>>(w);
         dbus_watch_set_data(watch, holder, Holder<std::shared_ptr<Watch<>>>::ptr_delete);
 
-        w->start();
+        // Disabled watches, e.g., for writing during authentication, are started once toggled.
+        if (dbus_watch_get_enabled(watch) == TRUE)
+            w->start();
 
         return TRUE;
     }
@@ -303,13 +475,18 @@ public:
         auto holder = static_cast<Holder<std::shared_ptr<Watch<>>>*>(dbus_watch_get_data(watch));
         if (!holder)
             return;
-        dbus_watch_get_enabled(watch) == TRUE ? holder->value->restart() : holder->value->cancel();
+        if (dbus_watch_get_enabled(watch) == FALSE)
+            holder->value->cancel();
+        else if (!holder->value->stream_descriptor.is_open())
+            holder->value->start();
+        else
+            holder->value->restart();
     }
 
     static dbus_bool_t on_dbus_add_timeout(DBusTimeout* timeout, void* data)
     {
         auto thiz = static_cast<Executor*>(data);
-        auto t = std::shared_ptr<Timeout<>>(new Timeout<>(thiz->io_service, timeout));
+        auto t = std::make_shared<Timeout<>>(thiz->timeouts, timeout);
         auto holder = new Holder<std::shared_ptr<Timeout<>>>(t);
         dbus_timeout_set_data(
                     timeout,
@@ -331,26 +508,220 @@ public:
         holder->value->start();
     }
 
-    static void on_dbus_wakeup_event_loop(void* data)
+    // Dispatches incoming messages on the io_service, yielding to other handlers
+    // whenever the configured budget is exhausted.
+    class Dispatcher : public std::enable_shared_from_this<Dispatcher>
     {
-        auto thiz = static_cast<Executor*>(data);
-        auto bus = thiz->bus;
-        thiz->io_service.post([bus]()
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        Dispatcher(const Bus::Ptr& bus, boost::asio::io_service& io_service, const DispatchBudget& budget)
+            : bus(bus),
+              io_service(io_service),
+              budget(budget),
+              scheduled(false),
+              messages_dispatched(0),
+              budget_exhaustions(0),
+              backlog(0)
+        {
+        }
+
+        void schedule()
         {
+            // libdbus wakes us up for every message it queues. We coalesce those
+            // wakeups such that at most one dispatch round is pending at any time.
+            if (scheduled.exchange(true))
+                return;
+
+            auto sp = shared_from_this();
+            io_service.post([sp]()
+            {
+                sp->dispatch();
+            });
+        }
+
+        DispatchStatistics statistics() const
+        {
+            DispatchStatistics result;
+            result.messages_dispatched = messages_dispatched.load();
+            result.budget_exhaustions = budget_exhaustions.load();
+            result.backlog = backlog.load();
+            return result;
+        }
+
+    private:
+        bool is_budget_exhausted(std::size_t dispatched, const Clock::time_point& start) const
+        {
+            if (budget.max_messages > 0 && dispatched >= budget.max_messages)
+                return true;
+
+            if (budget.max_duration.count() > 0 && Clock::now() - start >= budget.max_duration)
+                return true;
+
+            return false;
+        }
+
+        void dispatch()
+        {
+            // Wakeups from here on schedule another round, we thus cannot miss
+            // messages that arrive after we found the queue to be empty.
+            scheduled.store(false);
+
+            auto start = budget.max_duration.count() > 0 ? Clock::now() : Clock::time_point{};
+            std::size_t dispatched = 0;
+
             while (dbus_connection_get_dispatch_status(bus->raw()) == DBUS_DISPATCH_DATA_REMAINS)
             {
+                if (is_budget_exhausted(dispatched, start))
+                {
+                    budget_exhaustions++;
+                    schedule();
+                    return;
+                }
+
                 dbus_connection_dispatch(bus->raw());
+
+                dispatched++;
+                messages_dispatched++;
+                backlog++;
             }
-        });
+
+            backlog.store(0);
+        }
+
+        Bus::Ptr bus;
+        boost::asio::io_service& io_service;
+        DispatchBudget budget;
+        std::atomic<bool> scheduled;
+        std::atomic<std::uint64_t> messages_dispatched;
+        std::atomic<std::uint64_t> budget_exhaustions;
+        std::atomic<std::uint64_t> backlog;
+    };
+
+    static void on_dbus_wakeup_event_loop(void* data)
+    {
+        auto thiz = static_cast<Executor*>(data);
+        thiz->dispatcher->schedule();
     }
 
 public:
 
-    Executor(const Bus::Ptr& bus, boost::asio::io_service& io) : bus(bus), io_service(io), work(io_service)
+    Executor(const Bus::Ptr& bus, boost::asio::io_service& io, const DispatchBudget& budget = DispatchBudget{})
+        : Executor(bus, std::unique_ptr<boost::asio::io_service>{}, io, options_for_budget(budget))
+    {
+    }
+
+    Executor(const Bus::Ptr& bus, const ExecutorOptions& options)
+        : Executor(bus, make_dedicated_io_service(options), options)
+    {
+    }
+
+    ~Executor() noexcept
+    {
+        stop();
+    }
+
+    void run()
+    {
+        if (!dedicated_io_service)
+        {
+            io_service.run();
+            return;
+        }
+
+        std::mutex guard;
+        std::exception_ptr error;
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 0; i < options.thread_count; i++)
+        {
+            workers.emplace_back([this, &guard, &error]()
+            {
+                try
+                {
+                    configure_current_thread();
+                    io_service.run();
+                } catch(...)
+                {
+                    std::lock_guard<std::mutex> lg(guard);
+                    if (!error)
+                        error = std::current_exception();
+                    io_service.stop();
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+            worker.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    void stop()
+    {
+        io_service.stop();
+    }
+
+    std::shared_ptr<void> watch_readable(int fd, const std::function<void()>& handler) override
+    {
+        auto watch = std::make_shared<ReadableWatch>(io_service, fd, handler);
+        watch->strand.post([watch]() { watch->start(); });
+
+        return std::shared_ptr<void>(watch.get(), [watch](void*)
+        {
+            watch->strand.post([watch]() { watch->cancel(); });
+        });
+    }
+
+    DispatchStatistics dispatch_statistics() const
+    {
+        return dispatcher->statistics();
+    }
+
+private:
+    // Validates options before anything is installed on the bus.
+    static std::unique_ptr<boost::asio::io_service> make_dedicated_io_service(const ExecutorOptions& options)
+    {
+        if (options.thread_count == 0)
+            throw std::runtime_error("Precondition violated, executor requires at least one thread.");
+
+        return std::unique_ptr<boost::asio::io_service>{new boost::asio::io_service{}};
+    }
+
+    static ExecutorOptions options_for_budget(const DispatchBudget& budget)
+    {
+        ExecutorOptions options;
+        options.budget = budget;
+        return options;
+    }
+
+    Executor(const Bus::Ptr& bus,
+             std::unique_ptr<boost::asio::io_service>&& dedicated,
+             const ExecutorOptions& options)
+        : Executor(bus, std::move(dedicated), *dedicated, options)
+    {
+    }
+
+    Executor(const Bus::Ptr& bus,
+             std::unique_ptr<boost::asio::io_service>&& dedicated,
+             boost::asio::io_service& io,
+             const ExecutorOptions& options)
+        : dedicated_io_service(std::move(dedicated)),
+          bus(bus),
+          io_service(io),
+          work(io_service),
+          timeouts(std::make_shared<TimeoutScheduler>(io_service)),
+          dispatcher(std::make_shared<Dispatcher>(bus, io_service, options.budget)),
+          options(options)
     {
         if (!bus)
             throw std::runtime_error("Precondition violated, cannot construct executor for null bus.");
 
+        // Natively connected buses lack a DBusConnection, their messages are delivered through watch_readable.
+        if (!bus->raw())
+            return;
+
         if (!dbus_connection_set_watch_functions(
                     bus->raw(),
                     on_dbus_add_watch,
@@ -376,25 +747,53 @@ public:
                     nullptr);
     }
 
-    ~Executor() noexcept
+    // Applies the thread settings of options to the calling thread.
+    void configure_current_thread()
     {
-        stop();
-    }
+        if (!options.thread_name.empty())
+        {
+            // The kernel limits thread names to 16 bytes, including the terminating null.
+            auto rc = pthread_setname_np(pthread_self(), options.thread_name.substr(0, 15).c_str());
+            if (rc != 0)
+                throw std::system_error(rc, std::system_category(), "Could not set thread name");
+        }
 
-    void run()
-    {
-        io_service.run();
-    }
+        if (!options.cpu_affinity.empty())
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
 
-    void stop()
-    {
-        io_service.stop();
+            for (auto cpu : options.cpu_affinity)
+            {
+                if (cpu >= CPU_SETSIZE)
+                    throw std::runtime_error("Precondition violated, cpu index exceeds CPU_SETSIZE.");
+                CPU_SET(cpu, &cpus);
+            }
+
+            auto rc = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            if (rc != 0)
+                throw std::system_error(rc, std::system_category(), "Could not set cpu affinity");
+        }
+
+        if (options.realtime_priority != 0)
+        {
+            sched_param param;
+            param.sched_priority = options.realtime_priority;
+
+            auto rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (rc != 0)
+                throw std::system_error(rc, std::system_category(), "Could not set SCHED_FIFO priority");
+        }
     }
 
-private:
+    // Only set if the executor owns its io_service, has to outlive all members referring to it.
+    std::unique_ptr<boost::asio::io_service> dedicated_io_service;
     Bus::Ptr bus;
     boost::asio::io_service& io_service;
     boost::asio::io_service::work work;
+    std::shared_ptr<TimeoutScheduler> timeouts;
+    std::shared_ptr<Dispatcher> dispatcher;
+    ExecutorOptions options;
 };
 
 ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus)
@@ -408,6 +807,26 @@ ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus,
     return std::make_shared<core::dbus::asio::Executor>(bus, io);
 }
 
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus, boost::asio::io_service& io, const DispatchBudget& budget)
+{
+    return std::make_shared<core::dbus::asio::Executor>(bus, io, budget);
+}
+
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC Executor::Ptr make_executor(const Bus::Ptr& bus, const ExecutorOptions& options)
+{
+    return std::make_shared<core::dbus::asio::Executor>(bus, options);
+}
+
+ORG_FREEDESKTOP_DBUS_DLL_PUBLIC DispatchStatistics dispatch_statistics(const core::dbus::Executor::Ptr& executor)
+{
+    auto asio_executor = std::dynamic_pointer_cast<core::dbus::asio::Executor>(executor);
+
+    if (!asio_executor)
+        throw std::runtime_error("Precondition violated, executor has not been created by core::dbus::asio::make_executor.");
+
+    return asio_executor->dispatch_statistics();
+}
+
 }
 }
 }
@@ -19,8 +19,11 @@
 #include <core/dbus/bus.h>
 #include <core/dbus/dbus.h>
 #include <core/dbus/match_rule.h>
+#include <core/dbus/message_streaming_operators.h>
 #include <core/dbus/object.h>
 
+#include <core/dbus/native/connection.h>
+
 #include <core/dbus/traits/timeout.h>
 #include <core/dbus/traits/watch.h>
 
@@ -30,6 +33,8 @@
 #include "message_factory_impl.h"
 #include "pending_call_impl.h"
 
+#include "native/backend.h"
+
 namespace
 {
 struct VTable
@@ -51,6 +56,17 @@ struct VTable
         if (not sp)
             return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
+        // Messages for descendants of a subtree are dispatched to the resolved object.
+        if (thiz->resolver)
+        {
+            core::dbus::types::ObjectPath path{dbus_message_get_path(message)};
+            if (path != sp->path())
+                sp = thiz->resolver(path);
+
+            if (not sp)
+                return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
+
         if (sp->on_new_message(
                     core::dbus::Message::from_raw_message(
                         message)))
@@ -60,6 +76,19 @@ struct VTable
     }
 
     std::weak_ptr<core::dbus::Object> object;
+    // Only set for subtrees.
+    core::dbus::Bus::SubtreeResolver resolver;
+};
+
+// libdbus copies the function pointers, thus all registrations share a single instance.
+const DBusObjectPathVTable vtable
+{
+    VTable::unregister_object_path,
+    VTable::on_new_message,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
 };
 
 DBusHandlerResult static_handle_message(
@@ -127,7 +156,33 @@ struct Bus::Private
         init_libdbus_thread_support_and_install_shutdown_handler();
     }
 
+    // Invokes a method of the bus daemon on a natively connected bus.
+    template<typename... Args>
+    Message::Ptr call_daemon(const std::string& method, const Args&... args)
+    {
+        auto call = Message::make_method_call(
+                    DBus::name(),
+                    DBus::path(),
+                    DBus::interface(),
+                    method);
+
+        auto writer = call->writer();
+        int expansion[] = {0, (encode_argument(writer, args), 0)...};
+        (void) expansion;
+
+        auto reply = backend->send_with_reply_and_block(call, std::chrono::milliseconds{DBUS_TIMEOUT_USE_DEFAULT});
+        if (reply->type() == Message::Type::error)
+            throw std::runtime_error(reply->error().print());
+
+        return reply;
+    }
+
     std::shared_ptr<DBusConnection> connection;
+    bool is_peer_to_peer{false};
+    // Only set for natively connected buses.
+    std::shared_ptr<native::Backend> backend;
+    // Keeps the executor delivering messages of the backend.
+    std::vector<std::shared_ptr<void>> backend_watches;
     std::shared_ptr<MessageFactory> message_factory_impl;
     Executor::Ptr executor;
     MessageTypeRouter message_type_router;
@@ -207,8 +262,77 @@ Bus::Bus(WellKnownBus bus)
     dbus_connection_set_exit_on_disconnect(d->connection.get(), FALSE);
 }
 
+Bus::Bus(DBusConnection* peer)
+    : d(new Private())
+{
+    d->connection.reset(peer, [](DBusConnection*){});
+    d->is_peer_to_peer = true;
+
+    d->message_type_router.install_route(
+                Message::Type::signal,
+                std::bind(
+                    &Bus::SignalRouter::operator(),
+                    std::ref(d->signal_router),
+                    std::placeholders::_1));
+
+    dbus_connection_add_filter(
+                d->connection.get(),
+                static_handle_message,
+                this,
+                nullptr);
+
+    dbus_connection_set_exit_on_disconnect(d->connection.get(), FALSE);
+}
+
+Bus::Bus(const std::shared_ptr<native::Connection>& connection)
+    : d(new Private())
+{
+    d->message_type_router.install_route(
+                Message::Type::signal,
+                std::bind(
+                    &Bus::SignalRouter::operator(),
+                    std::ref(d->signal_router),
+                    std::placeholders::_1));
+
+    d->backend = native::Backend::create(connection, [this](const Message::Ptr& msg)
+    {
+        handle_message(msg);
+    });
+}
+
+Bus::Ptr Bus::connect_to_peer(const std::string& address)
+{
+    init_libdbus_thread_support_and_install_shutdown_handler();
+
+    Error se;
+    auto connection = dbus_connection_open_private(address.c_str(), std::addressof(se.raw()));
+
+    if (!connection)
+        throw std::runtime_error(se.print());
+
+    return Ptr{new Bus{connection}};
+}
+
+Bus::Ptr Bus::connect_natively(WellKnownBus bus)
+{
+    return Ptr{new Bus{native::Connection::open(bus)}};
+}
+
+Bus::Ptr Bus::connect_natively(const std::string& address)
+{
+    return Ptr{new Bus{native::Connection::open(address)}};
+}
+
 Bus::~Bus() noexcept
 {
+    if (d->backend)
+    {
+        // Monitoring has to stop before the executor goes away.
+        d->backend_watches.clear();
+        d->backend.reset();
+        return;
+    }
+
     dbus_connection_remove_filter(d->connection.get(), static_handle_message, this);
     dbus_connection_close(d->connection.get());
     dbus_connection_unref(d->connection.get());
@@ -224,11 +348,21 @@ Bus::Name Bus::request_name_on_bus(
         Bus::RequestNameFlag flags)
 {
     Error error;
-    auto rc = dbus_bus_request_name(
-                d->connection.get(),
-                name.c_str(),
-                static_cast<unsigned int>(flags),
-                std::addressof(error.raw()));
+    int rc = -1;
+
+    if (d->backend)
+    {
+        std::uint32_t reply;
+        d->call_daemon("RequestName", name, static_cast<std::uint32_t>(flags))->reader() >> reply;
+        rc = static_cast<int>(reply);
+    } else
+    {
+        rc = dbus_bus_request_name(
+                    d->connection.get(),
+                    name.c_str(),
+                    static_cast<unsigned int>(flags),
+                    std::addressof(error.raw()));
+    }
 
     Bus::Name result{name};
 
@@ -246,6 +380,12 @@ Bus::Name Bus::request_name_on_bus(
 
 void Bus::release_name_on_bus(Bus::Name&& name)
 {
+    if (d->backend)
+    {
+        d->call_daemon("ReleaseName", name.as_string());
+        return;
+    }
+
     Error error;
     dbus_bus_release_name(
                 d->connection.get(),
@@ -255,6 +395,9 @@ void Bus::release_name_on_bus(Bus::Name&& name)
 
 uint32_t Bus::send(const std::shared_ptr<Message>& msg)
 {
+    if (d->backend)
+        return d->backend->send(msg);
+
     dbus_uint32_t serial;
     if (!dbus_connection_send(
                 d->connection.get(),
@@ -279,6 +422,15 @@ std::shared_ptr<Message> Bus::send_with_reply_and_block_for_at_most(
     //                           "is racy");
     //}
 
+    if (d->backend)
+    {
+        auto reply = d->backend->send_with_reply_and_block(msg, milliseconds);
+        // libdbus reports error replies as errors of the call.
+        if (reply->type() == Message::Type::error)
+            throw std::runtime_error(reply->error().print());
+        return reply;
+    }
+
     Error se;
 
     auto result = dbus_connection_send_with_reply_and_block(
@@ -299,6 +451,9 @@ PendingCall::Ptr Bus::send_with_reply_and_timeout(
         const std::shared_ptr<Message>& msg,
         const std::chrono::milliseconds& timeout)
 {
+    if (d->backend)
+        return d->backend->send_with_reply(msg, timeout);
+
     DBusPendingCall* pending_call;
     auto result = dbus_connection_send_with_reply(
                 d->connection.get(),
@@ -315,8 +470,22 @@ PendingCall::Ptr Bus::send_with_reply_and_timeout(
     return impl::PendingCall::create(pending_call);
 }
 
+bool Bus::is_peer_to_peer() const
+{
+    return d->is_peer_to_peer;
+}
+
 void Bus::add_match(const MatchRule& rule)
 {
+    if (d->is_peer_to_peer)
+        return;
+
+    if (d->backend)
+    {
+        d->call_daemon("AddMatch", rule.as_string());
+        return;
+    }
+
     Error se;
     dbus_bus_add_match(d->connection.get(), rule.as_string().c_str(), std::addressof(se.raw()));
     if (se)
@@ -325,6 +494,15 @@ void Bus::add_match(const MatchRule& rule)
 
 void Bus::remove_match(const MatchRule& rule)
 {
+    if (d->is_peer_to_peer)
+        return;
+
+    if (d->backend)
+    {
+        d->call_daemon("RemoveMatch", rule.as_string());
+        return;
+    }
+
     Error se;
     dbus_bus_remove_match(d->connection.get(), rule.as_string().c_str(), std::addressof(se.raw()));
     if (se)
@@ -333,11 +511,39 @@ void Bus::remove_match(const MatchRule& rule)
 
 bool Bus::has_owner_for_name(const std::string& name)
 {
+    if (d->backend)
+    {
+        bool result = false;
+        d->call_daemon("NameHasOwner", name)->reader() >> result;
+        return result;
+    }
+
     return dbus_bus_name_has_owner(d->connection.get(), name.c_str(), nullptr);
 }
 
 void Bus::install_executor(const Executor::Ptr& e)
 {
+    if (d->backend)
+    {
+        auto watcher = std::dynamic_pointer_cast<FdWatcher>(e);
+        if (!watcher)
+            throw std::logic_error("Natively connected buses require an executor implementing FdWatcher.");
+
+        d->backend_watches.clear();
+
+        std::weak_ptr<native::Backend> wp{d->backend};
+        d->backend_watches.push_back(watcher->watch_readable(d->backend->dispatch_fd(), [wp]()
+        {
+            if (auto sp = wp.lock())
+                sp->dispatch();
+        }));
+        d->backend_watches.push_back(watcher->watch_readable(d->backend->timeout_fd(), [wp]()
+        {
+            if (auto sp = wp.lock())
+                sp->expire();
+        }));
+    }
+
     d->executor = e;
 }
 
@@ -355,38 +561,105 @@ void Bus::run()
     d->executor->run();
 }
 
+std::shared_ptr<void> Bus::watch_readable(int fd, const std::function<void()>& handler)
+{
+    if (!d->executor)
+        throw std::runtime_error("Missing executor, cannot watch fd.");
+
+    // Keeps the executor alive until monitoring has stopped.
+    struct Handle
+    {
+        ~Handle()
+        {
+            watch.reset();
+        }
+
+        Executor::Ptr executor;
+        std::shared_ptr<void> watch;
+    };
+
+    auto watcher = std::dynamic_pointer_cast<FdWatcher>(d->executor);
+    if (!watcher)
+        throw std::logic_error("Executor does not support monitoring additional fds.");
+
+    auto watch = watcher->watch_readable(fd, handler);
+    return std::make_shared<Handle>(Handle{d->executor, watch});
+}
+
 void Bus::register_object_for_path(
         const types::ObjectPath& path,
         const std::shared_ptr<Object>& object)
 {
-    auto vtable = new DBusObjectPathVTable
+    if (d->backend)
     {
-            VTable::unregister_object_path,
-            VTable::on_new_message,
-            nullptr,
-            nullptr,
-            nullptr,
-            nullptr
-    };
+        d->backend->register_object(path, object, SubtreeResolver{});
+        return;
+    }
+
+    std::unique_ptr<VTable> data{new VTable{object, SubtreeResolver{}}};
 
     Error e;
     auto result = dbus_connection_try_register_object_path(
                 d->connection.get(),
                 path.as_string().c_str(),
-                vtable,
-                new VTable{object},
+                std::addressof(vtable),
+                data.get(),
                 std::addressof(e.raw()));
 
     if (!result || e)
-    {
-        delete vtable;
         throw std::runtime_error(e.print());
+
+    data.release();
+}
+
+void Bus::register_subtree_for_path(
+        const types::ObjectPath& prefix,
+        const std::shared_ptr<Object>& object,
+        const SubtreeResolver& resolver)
+{
+    if (!resolver)
+        throw std::runtime_error("Bus::register_subtree_for_path: Resolver must not be empty.");
+
+    if (d->backend)
+    {
+        d->backend->register_object(prefix, object, resolver);
+        return;
     }
+
+    std::unique_ptr<VTable> data{new VTable{object, resolver}};
+
+    Error e;
+    auto result = dbus_connection_try_register_fallback(
+                d->connection.get(),
+                prefix.as_string().c_str(),
+                std::addressof(vtable),
+                data.get(),
+                std::addressof(e.raw()));
+
+    if (!result || e)
+        throw std::runtime_error(e.print());
+
+    data.release();
 }
 
 void Bus::unregister_object_path(
         const types::ObjectPath& path)
 {
+    if (d->backend)
+    {
+        d->backend->unregister_object(path);
+        return;
+    }
+
+    // Proxy objects are never registered, and libdbus considers
+    // unregistering an unknown path to be a programming error.
+    void* data = nullptr;
+    if (!dbus_connection_get_object_path_data(d->connection.get(), path.as_string().c_str(), &data))
+        throw Errors::NoMemory{};
+
+    if (!data)
+        return;
+
     dbus_connection_unregister_object_path(
                 d->connection.get(),
                 path.as_string().c_str());
@@ -21,6 +21,7 @@
 #include <core/dbus/service.h>
 #include <core/dbus/service_watcher.h>
 
+#include <core/dbus/types/array_view.h>
 #include <core/dbus/types/stl/string.h>
 #include <core/dbus/types/stl/vector.h>
 
@@ -134,6 +135,21 @@ std::vector<std::string> DBus::list_names() const
     return object->invoke_method_synchronously<ListNames, std::vector<std::string>>().value();
 }
 
+std::size_t DBus::list_names(const std::function<bool(const std::string&)>& visitor) const
+{
+    auto result = object->invoke_method_synchronously<ListNames, types::ArrayView<std::string>>();
+
+    std::size_t count = 0;
+    for (const auto& name : result.value())
+    {
+        count++;
+        if (!visitor(name))
+            break;
+    }
+
+    return count;
+}
+
 uint32_t DBus::get_connection_unix_process_id(const std::string& name) const
 {
     return object->invoke_method_synchronously<GetConnectionUnixProcessID, uint32_t>(name).value();
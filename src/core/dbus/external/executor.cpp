@@ -0,0 +1,363 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/external/executor.h>
+
+#include <dbus/dbus.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+
+namespace core
+{
+namespace dbus
+{
+namespace external
+{
+namespace impl
+{
+// Our event flags are chosen to match libdbus' flags, we make sure that this stays true.
+static_assert(static_cast<unsigned int>(external::Watch::readable) == DBUS_WATCH_READABLE, "Watch::readable has to match DBUS_WATCH_READABLE");
+static_assert(static_cast<unsigned int>(external::Watch::writable) == DBUS_WATCH_WRITABLE, "Watch::writable has to match DBUS_WATCH_WRITABLE");
+static_assert(static_cast<unsigned int>(external::Watch::error) == DBUS_WATCH_ERROR, "Watch::error has to match DBUS_WATCH_ERROR");
+static_assert(static_cast<unsigned int>(external::Watch::hangup) == DBUS_WATCH_HANGUP, "Watch::hangup has to match DBUS_WATCH_HANGUP");
+
+// The underlying libdbus objects are owned by the connection. We reset our reference
+// as soon as libdbus removes them, external loops might hold on to us for longer.
+class Watch : public core::dbus::external::Watch
+{
+public:
+    Watch(DBusWatch* watch) : watch(watch)
+    {
+    }
+
+    int fd() const override
+    {
+        auto w = watch.load();
+        return w ? dbus_watch_get_unix_fd(w) : -1;
+    }
+
+    unsigned int events() const override
+    {
+        auto w = watch.load();
+        return w ? dbus_watch_get_flags(w) : 0;
+    }
+
+    bool is_enabled() const override
+    {
+        auto w = watch.load();
+        return w ? dbus_watch_get_enabled(w) == TRUE : false;
+    }
+
+    bool handle(unsigned int events) override
+    {
+        auto w = watch.load();
+        return w ? dbus_watch_handle(w, events) == TRUE : true;
+    }
+
+    void invalidate()
+    {
+        watch.store(nullptr);
+    }
+
+private:
+    std::atomic<DBusWatch*> watch;
+};
+
+class Timeout : public core::dbus::external::Timeout
+{
+public:
+    Timeout(DBusTimeout* timeout) : timeout(timeout)
+    {
+    }
+
+    std::chrono::milliseconds interval() const override
+    {
+        auto t = timeout.load();
+        return std::chrono::milliseconds{t ? dbus_timeout_get_interval(t) : 0};
+    }
+
+    bool is_enabled() const override
+    {
+        auto t = timeout.load();
+        return t ? dbus_timeout_get_enabled(t) == TRUE : false;
+    }
+
+    bool handle() override
+    {
+        auto t = timeout.load();
+        return t ? dbus_timeout_handle(t) == TRUE : true;
+    }
+
+    void invalidate()
+    {
+        timeout.store(nullptr);
+    }
+
+private:
+    std::atomic<DBusTimeout*> timeout;
+};
+
+// Hands an fd monitored via Bus::watch_readable to the external loop.
+class ReadableWatch : public core::dbus::external::Watch
+{
+public:
+    ReadableWatch(int fd, const std::function<void()>& handler) : fd_(fd), handler(handler), enabled(true)
+    {
+    }
+
+    int fd() const override
+    {
+        return fd_;
+    }
+
+    unsigned int events() const override
+    {
+        return readable;
+    }
+
+    bool is_enabled() const override
+    {
+        return enabled.load();
+    }
+
+    bool handle(unsigned int events) override
+    {
+        if (enabled.load() && (events & readable))
+            handler();
+        return true;
+    }
+
+    void invalidate()
+    {
+        enabled.store(false);
+    }
+
+private:
+    int fd_;
+    std::function<void()> handler;
+    std::atomic<bool> enabled;
+};
+
+class Executor : public core::dbus::external::Executor, public core::dbus::FdWatcher
+{
+public:
+    template<typename T>
+    struct Holder
+    {
+        static void ptr_delete(void* p)
+        {
+            delete static_cast<Holder<T>*>(p);
+        }
+
+        Holder(const T& t) : value(t)
+        {
+        }
+
+        T value;
+    };
+
+    static dbus_bool_t on_dbus_add_watch(DBusWatch* watch, void* data)
+    {
+        auto thiz = static_cast<Executor*>(data);
+        auto w = std::make_shared<impl::Watch>(watch);
+        dbus_watch_set_data(watch, new Holder<std::shared_ptr<impl::Watch>>(w), Holder<std::shared_ptr<impl::Watch>>::ptr_delete);
+
+        thiz->loop->add_watch(w);
+
+        return TRUE;
+    }
+
+    static void on_dbus_remove_watch(DBusWatch* watch, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<impl::Watch>>*>(dbus_watch_get_data(watch));
+        if (!holder)
+            return;
+
+        static_cast<Executor*>(data)->loop->remove_watch(holder->value);
+        holder->value->invalidate();
+    }
+
+    static void on_dbus_watch_toggled(DBusWatch* watch, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<impl::Watch>>*>(dbus_watch_get_data(watch));
+        if (!holder)
+            return;
+
+        static_cast<Executor*>(data)->loop->watch_toggled(holder->value);
+    }
+
+    static dbus_bool_t on_dbus_add_timeout(DBusTimeout* timeout, void* data)
+    {
+        auto thiz = static_cast<Executor*>(data);
+        auto t = std::make_shared<impl::Timeout>(timeout);
+        dbus_timeout_set_data(timeout, new Holder<std::shared_ptr<impl::Timeout>>(t), Holder<std::shared_ptr<impl::Timeout>>::ptr_delete);
+
+        thiz->loop->add_timeout(t);
+
+        return TRUE;
+    }
+
+    static void on_dbus_remove_timeout(DBusTimeout* timeout, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<impl::Timeout>>*>(dbus_timeout_get_data(timeout));
+        if (!holder)
+            return;
+
+        static_cast<Executor*>(data)->loop->remove_timeout(holder->value);
+        holder->value->invalidate();
+    }
+
+    static void on_dbus_timeout_toggled(DBusTimeout* timeout, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<impl::Timeout>>*>(dbus_timeout_get_data(timeout));
+        if (!holder)
+            return;
+
+        static_cast<Executor*>(data)->loop->timeout_toggled(holder->value);
+    }
+
+    static void on_dbus_wakeup_event_loop(void* data)
+    {
+        static_cast<Executor*>(data)->loop->wakeup();
+    }
+
+    static void on_dbus_dispatch_status_changed(DBusConnection*, DBusDispatchStatus status, void* data)
+    {
+        if (status == DBUS_DISPATCH_DATA_REMAINS)
+            static_cast<Executor*>(data)->loop->wakeup();
+    }
+
+    Executor(const Bus::Ptr& bus, const EventLoop::Ptr& loop) : bus(bus), loop(loop), stopped(false)
+    {
+        if (!bus)
+            throw std::runtime_error("Precondition violated, cannot construct executor for null bus.");
+
+        if (!loop)
+            throw std::runtime_error("Precondition violated, cannot construct executor for null event loop.");
+
+        // Natively connected buses lack a DBusConnection, their messages are delivered through watch_readable.
+        if (!bus->raw())
+            return;
+
+        if (!dbus_connection_set_watch_functions(
+                    bus->raw(),
+                    on_dbus_add_watch,
+                    on_dbus_remove_watch,
+                    on_dbus_watch_toggled,
+                    this,
+                    nullptr))
+            throw std::runtime_error("Problem installing watch functions.");
+
+        if (!dbus_connection_set_timeout_functions(
+                    bus->raw(),
+                    on_dbus_add_timeout,
+                    on_dbus_remove_timeout,
+                    on_dbus_timeout_toggled,
+                    this,
+                    nullptr))
+            throw std::runtime_error("Problem installing timeout functions.");
+
+        dbus_connection_set_wakeup_main_function(
+                    bus->raw(),
+                    on_dbus_wakeup_event_loop,
+                    this,
+                    nullptr);
+
+        // Messages might be read by threads other than the one running the loop,
+        // e.g., while waiting for a reply to a blocking call.
+        dbus_connection_set_dispatch_status_function(
+                    bus->raw(),
+                    on_dbus_dispatch_status_changed,
+                    this,
+                    nullptr);
+
+        // Messages might have been queued before we were installed.
+        if (dbus_connection_get_dispatch_status(bus->raw()) == DBUS_DISPATCH_DATA_REMAINS)
+            loop->wakeup();
+    }
+
+    ~Executor() noexcept
+    {
+        stop();
+    }
+
+    bool dispatch(std::size_t max_messages) override
+    {
+        if (!bus->raw())
+            return false;
+
+        std::size_t dispatched = 0;
+
+        while (dbus_connection_get_dispatch_status(bus->raw()) == DBUS_DISPATCH_DATA_REMAINS)
+        {
+            if (max_messages > 0 && dispatched == max_messages)
+                return true;
+
+            dbus_connection_dispatch(bus->raw());
+            dispatched++;
+        }
+
+        return false;
+    }
+
+    void run() override
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        wait_condition.wait(ul, [this]() { return stopped; });
+    }
+
+    void stop() override
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        stopped = true;
+        wait_condition.notify_all();
+    }
+
+    std::shared_ptr<void> watch_readable(int fd, const std::function<void()>& handler) override
+    {
+        auto w = std::make_shared<impl::ReadableWatch>(fd, handler);
+        loop->add_watch(w);
+
+        auto l = loop;
+        return std::shared_ptr<void>(w.get(), [w, l](void*)
+        {
+            l->remove_watch(w);
+            w->invalidate();
+        });
+    }
+
+private:
+    Bus::Ptr bus;
+    EventLoop::Ptr loop;
+
+    std::mutex guard;
+    std::condition_variable wait_condition;
+    bool stopped;
+};
+}
+
+Executor::Ptr make_executor(const Bus::Ptr& bus, const EventLoop::Ptr& loop)
+{
+    return std::make_shared<impl::Executor>(bus, loop);
+}
+}
+}
+}
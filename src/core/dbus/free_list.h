@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_FREE_LIST_H_
+#define CORE_DBUS_FREE_LIST_H_
+
+#include <cstddef>
+#include <new>
+
+namespace core
+{
+namespace dbus
+{
+namespace impl
+{
+/**
+ * @brief Per-thread free lists of blocks of size bytes.
+ *
+ * Released blocks are kept for reuse by the releasing thread, up to capacity blocks
+ * per thread. Blocks may be released by another thread than the allocating one, they
+ * are all interchangeable. Blocks released while a thread exits go back to the heap.
+ */
+template<std::size_t size, std::size_t capacity = 1024>
+class FreeList
+{
+public:
+    static void* allocate()
+    {
+        auto& s = state();
+        if (s.head)
+        {
+            auto node = s.head;
+            s.head = node->next;
+            s.count--;
+            return node;
+        }
+
+        return ::operator new(block_size);
+    }
+
+    static void deallocate(void* block) noexcept
+    {
+        auto& s = state();
+        if (s.destroyed || s.count == capacity)
+        {
+            ::operator delete(block);
+            return;
+        }
+
+        // Makes sure the list is handed back to the heap once the thread exits.
+        static thread_local Reaper reaper;
+        (void) reaper;
+
+        auto node = static_cast<Node*>(block);
+        node->next = s.head;
+        s.head = node;
+        s.count++;
+    }
+
+private:
+    struct Node
+    {
+        Node* next;
+    };
+
+    static constexpr std::size_t block_size = size < sizeof(Node) ? sizeof(Node) : size;
+
+    // Trivially destructible, thus accessible for as long as the thread lives.
+    struct State
+    {
+        Node* head;
+        std::size_t count;
+        bool destroyed;
+    };
+
+    struct Reaper
+    {
+        ~Reaper()
+        {
+            auto& s = state();
+            s.destroyed = true;
+
+            while (s.head)
+            {
+                auto node = s.head;
+                s.head = node->next;
+                ::operator delete(node);
+            }
+            s.count = 0;
+        }
+    };
+
+    static State& state() noexcept
+    {
+        static thread_local State s{nullptr, 0, false};
+        return s;
+    }
+};
+
+/**
+ * @brief Recycles the memory of instances of T via a FreeList, to be inherited from by T.
+ */
+template<typename T>
+struct Recycled
+{
+    static void* operator new(std::size_t size)
+    {
+        return size == sizeof(T) ? FreeList<sizeof(T)>::allocate() : ::operator new(size);
+    }
+
+    static void operator delete(void* p, std::size_t size) noexcept
+    {
+        if (size == sizeof(T))
+            FreeList<sizeof(T)>::deallocate(p);
+        else
+            ::operator delete(p);
+    }
+};
+
+/**
+ * @brief Allocates single objects from a FreeList, e.g., the control blocks of shared pointers.
+ */
+template<typename T>
+struct FreeListAllocator
+{
+    typedef T value_type;
+
+    FreeListAllocator() = default;
+
+    template<typename U>
+    FreeListAllocator(const FreeListAllocator<U>&)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        if (n != 1)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+
+        return static_cast<T*>(FreeList<sizeof(T)>::allocate());
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (n != 1)
+        {
+            ::operator delete(p);
+            return;
+        }
+
+        FreeList<sizeof(T)>::deallocate(p);
+    }
+
+    template<typename U>
+    bool operator==(const FreeListAllocator<U>&) const
+    {
+        return true;
+    }
+
+    template<typename U>
+    bool operator!=(const FreeListAllocator<U>&) const
+    {
+        return false;
+    }
+};
+}
+}
+}
+
+#endif // CORE_DBUS_FREE_LIST_H_
@@ -28,6 +28,7 @@
 
 #include <dbus/dbus.h>
 
+#include <cstring>
 #include <exception>
 #include <map>
 #include <memory>
@@ -40,12 +41,62 @@ namespace core
 {
 namespace dbus
 {
+namespace
+{
+// libdbus asserts on the element type of fixed arrays, we rather throw.
+void ensure_fixed_array_element_type_or_throw(ArgumentType type)
+{
+    if (!dbus_type_is_fixed(static_cast<int>(type)) || type == ArgumentType::unix_fd)
+        throw std::runtime_error("Element type of array is not a fixed-size type.");
+}
+}
+
+Message::Reader::Trusted::Trusted(Message::Reader& reader, const std::string& signature)
+    : d(nullptr),
+      size(signature.size())
+{
+    auto p = reader.d.get();
+    // Nested decoding of an argument that is trusted already, or position unknown.
+    if (!p || p->trusted || p->signature_offset == Private::unknown_signature_offset)
+        return;
+
+    if (!p->message_signature)
+        p->message_signature = dbus_message_get_signature(p->msg->d->dbus_message.get());
+
+    // The offset never exceeds the length of the signature, see commit().
+    if (std::strncmp(p->message_signature + p->signature_offset, signature.c_str(), size) != 0)
+        return;
+
+    p->trusted = true;
+    d = p;
+}
+
+Message::Reader::Trusted::~Trusted()
+{
+    // Decoding has been aborted, leaving the position within the signature unknown.
+    if (d)
+    {
+        d->trusted = false;
+        d->signature_offset = Private::unknown_signature_offset;
+    }
+}
+
+void Message::Reader::Trusted::commit()
+{
+    if (d)
+    {
+        d->trusted = false;
+        d->signature_offset += size;
+        d = nullptr;
+    }
+}
+
 Message::Reader::Reader()
 {
 }
 
 Message::Reader::Reader(const std::shared_ptr<Message>& msg)
-    : d(new Private(msg))
+    : d(std::allocate_shared<Private>(impl::FreeListAllocator<Private>(), msg))
 {
     if (!msg)
         throw std::runtime_error(
@@ -66,6 +117,19 @@ Message::Reader::~Reader()
 {
 }
 
+Message::Reader Message::Reader::copy() const
+{
+    Reader result;
+    if (d)
+    {
+        result.d = std::allocate_shared<Private>(impl::FreeListAllocator<Private>(), *d);
+        // Trust only extends to the argument currently being decoded, not beyond.
+        if (d->signature_offset != Private::unknown_signature_offset)
+            result.d->trusted = false;
+    }
+    return result;
+}
+
 ArgumentType Message::Reader::type() const
 {
     return static_cast<ArgumentType>(
@@ -73,8 +137,20 @@ ArgumentType Message::Reader::type() const
                     std::addressof(d->iter)));
 }
 
+std::string Message::Reader::signature() const
+{
+    char* signature = dbus_message_iter_get_signature(std::addressof(d->iter));
+    if (!signature)
+        throw std::runtime_error("Not enough memory to query signature of argument.");
+
+    std::string result{signature};
+    dbus_free(signature);
+    return result;
+}
+
 void Message::Reader::pop()
 {
+    d->leave_signature();
     dbus_message_iter_next(std::addressof(d->iter));
 }
 
@@ -218,9 +294,40 @@ types::UnixFd Message::Reader::pop_unix_fd()
     return types::UnixFd(result);
 }
 
+const void* Message::Reader::pop_fixed_array(ArgumentType element_type, std::size_t& count)
+{
+    d->ensure_argument_type_or_throw(ArgumentType::array);
+    ensure_fixed_array_element_type_or_throw(element_type);
+
+    auto actual_type = static_cast<ArgumentType>(dbus_message_iter_get_element_type(std::addressof(d->iter)));
+    if (actual_type != element_type)
+    {
+        std::stringstream ss;
+        ss << "Mismatch between expected and actual element type of array: " << std::endl
+           << "\t Expected: " << element_type << std::endl
+           << "\t Actual: " << actual_type;
+        throw std::runtime_error(ss.str());
+    }
+
+    DBusMessageIter sub;
+    dbus_message_iter_recurse(std::addressof(d->iter), std::addressof(sub));
+
+    const void* result = nullptr;
+    int n = 0;
+    dbus_message_iter_get_fixed_array(std::addressof(sub), std::addressof(result), std::addressof(n));
+    dbus_message_iter_next(std::addressof(d->iter));
+
+    count = n;
+    return result;
+}
+
 Message::Reader Message::Reader::pop_array()
 {
+    d->leave_signature();
+
     Reader result(d->msg);
+    // Contents of arrays, structures and dict entries are covered by the signature of the message.
+    result.d->trusted = d->trusted;
     dbus_message_iter_recurse(
                 std::addressof(d->iter),
                 std::addressof(result.d->iter));
@@ -230,7 +337,10 @@ Message::Reader Message::Reader::pop_array()
 
 Message::Reader Message::Reader::pop_structure()
 {
+    d->leave_signature();
+
     Reader result(d->msg);
+    result.d->trusted = d->trusted;
     dbus_message_iter_recurse(
                 std::addressof(d->iter),
                 std::addressof(result.d->iter));
@@ -240,7 +350,10 @@ Message::Reader Message::Reader::pop_structure()
 
 Message::Reader Message::Reader::pop_variant()
 {
+    d->advance_signature(ArgumentType::variant);
+
     Reader result(d->msg);
+    // The type of the contents of a variant is only known at runtime, and is always checked.
     dbus_message_iter_recurse(
                 std::addressof(d->iter),
                 std::addressof(result.d->iter));
@@ -250,7 +363,10 @@ Message::Reader Message::Reader::pop_variant()
 
 Message::Reader Message::Reader::pop_dict_entry()
 {
+    d->leave_signature();
+
     Reader result(d->msg);
+    result.d->trusted = d->trusted;
     dbus_message_iter_recurse(
                 std::addressof(d->iter),
                 std::addressof(result.d->iter));
@@ -264,7 +380,7 @@ const std::shared_ptr<Message>& Message::Reader::access_message()
 }
 
 Message::Writer::Writer(const std::shared_ptr<Message>& msg)
-    : d(new Private{msg, DBusMessageIter()})
+    : d(new Private(msg))
 {
     if (!msg)
         throw std::runtime_error(
@@ -409,6 +525,34 @@ void Message::Writer::push_unix_fd(const types::UnixFd& value)
         throw std::runtime_error("Not enough memory to append data to message.");
 }
 
+void Message::Writer::push_fixed_array(ArgumentType element_type, const void* data, std::size_t count)
+{
+    ensure_fixed_array_element_type_or_throw(element_type);
+
+    const char signature[] = {static_cast<char>(element_type), '\0'};
+
+    DBusMessageIter sub;
+    if (!dbus_message_iter_open_container(
+                std::addressof(d->iter),
+                static_cast<int>(ArgumentType::array),
+                signature,
+                std::addressof(sub)))
+        throw std::runtime_error("Problem opening container");
+
+    if (!dbus_message_iter_append_fixed_array(
+                std::addressof(sub),
+                static_cast<int>(element_type),
+                std::addressof(data),
+                static_cast<int>(count)))
+    {
+        dbus_message_iter_abandon_container(std::addressof(d->iter), std::addressof(sub));
+        throw std::runtime_error("Not enough memory to append data to message.");
+    }
+
+    if (!dbus_message_iter_close_container(std::addressof(d->iter), std::addressof(sub)))
+        throw std::runtime_error("Problem closing container");
+}
+
 Message::Writer Message::Writer::open_array(const types::Signature& signature)
 {
     Writer w(d->msg);
@@ -498,25 +642,23 @@ std::shared_ptr<Message> Message::make_method_call(
         const std::string& interface,
         const std::string& method)
 {
-    return std::shared_ptr<Message>(
-                new Message(
-                    std::unique_ptr<Message::Private>(
-                        new Message::Private(
-                            dbus_message_new_method_call(
-                                destination.c_str(),
-                                path.as_string().c_str(),
-                                interface.c_str(),
-                                method.c_str())))));
+    return wrap(
+                std::unique_ptr<Message::Private>(
+                    new Message::Private(
+                        dbus_message_new_method_call(
+                            destination.c_str(),
+                            path.as_string().c_str(),
+                            interface.c_str(),
+                            method.c_str()))));
 }
 
 std::shared_ptr<Message> Message::make_method_return(const Message::Ptr& msg)
 {
-    return std::shared_ptr<Message>(
-                new Message(
-                    std::unique_ptr<Message::Private>(
-                        new Message::Private(
-                            dbus_message_new_method_return(
-                                msg->d->dbus_message.get())))));
+    return wrap(
+                std::unique_ptr<Message::Private>(
+                    new Message::Private(
+                        dbus_message_new_method_return(
+                            msg->d->dbus_message.get()))));
 }
 
 std::shared_ptr<Message> Message::make_signal(
@@ -524,14 +666,13 @@ std::shared_ptr<Message> Message::make_signal(
         const std::string& interface,
         const std::string& signal)
 {
-    return std::shared_ptr<Message>(
-                new Message(
-                    std::unique_ptr<Message::Private>(
-                        new Message::Private(
-                            dbus_message_new_signal(
-                                path.c_str(),
-                                interface.c_str(),
-                                signal.c_str())))));
+    return wrap(
+                std::unique_ptr<Message::Private>(
+                    new Message::Private(
+                        dbus_message_new_signal(
+                            path.c_str(),
+                            interface.c_str(),
+                            signal.c_str()))));
 }
 
 std::shared_ptr<Message> Message::make_error(
@@ -539,23 +680,21 @@ std::shared_ptr<Message> Message::make_error(
         const std::string& error_name,
         const std::string& error_desc)
 {
-    return std::shared_ptr<Message>(
-                new Message(
-                    std::unique_ptr<Message::Private>(
-                        new Message::Private(
-                            dbus_message_new_error(
-                                in_reply_to->d->dbus_message.get(),
-                                error_name.c_str(),
-                                error_desc.c_str())))));
+    return wrap(
+                std::unique_ptr<Message::Private>(
+                    new Message::Private(
+                        dbus_message_new_error(
+                            in_reply_to->d->dbus_message.get(),
+                            error_name.c_str(),
+                            error_desc.c_str()))));
 }
 
 std::shared_ptr<Message> Message::from_raw_message(DBusMessage* msg)
 {
-    return std::shared_ptr<Message>(
-                new Message(
-                    std::unique_ptr<Message::Private>(
-                        new Message::Private(
-                            msg, true))));
+    return wrap(
+                std::unique_ptr<Message::Private>(
+                    new Message::Private(
+                        msg, true)));
 }
 
 Message::Type Message::type() const
@@ -583,6 +722,14 @@ std::string Message::signature() const
     return dbus_message_get_signature(d->dbus_message.get());
 }
 
+bool Message::signature_starts_with(const std::string& signature) const
+{
+    return std::strncmp(
+                dbus_message_get_signature(d->dbus_message.get()),
+                signature.c_str(),
+                signature.size()) == 0;
+}
+
 std::string Message::interface() const
 {
     return dbus_message_get_interface(d->dbus_message.get());
@@ -617,6 +764,7 @@ Message::Reader Message::reader()
                 std::addressof(result.d->iter)))
         throw std::runtime_error(
                 "Could not initialize reader, message does not have arguments");
+    result.d->signature_offset = 0;
     return result;
 }
 
@@ -648,9 +796,36 @@ Message::~Message()
 {
 }
 
-std::shared_ptr<Message> Message::clone()
+std::shared_ptr<Message> Message::clone() const
 {
-    return std::shared_ptr<Message>(new Message(d->clone()));
+    return wrap(d->clone());
+}
+
+std::shared_ptr<Message> Message::wrap(std::unique_ptr<Message::Private> d)
+{
+    typedef impl::FreeList<sizeof(Message)> Instances;
+
+    auto block = Instances::allocate();
+
+    Message* msg = nullptr;
+    try
+    {
+        msg = new (block) Message(std::move(d));
+    } catch(...)
+    {
+        Instances::deallocate(block);
+        throw;
+    }
+
+    // Both the instance and the control block go back to the free lists of the releasing thread.
+    return std::shared_ptr<Message>(
+                msg,
+                [](Message* msg)
+                {
+                    msg->~Message();
+                    Instances::deallocate(msg);
+                },
+                impl::FreeListAllocator<Message>());
 }
 
 std::ostream& operator<<(std::ostream& out, Message::Type type)
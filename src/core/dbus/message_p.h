@@ -20,6 +20,8 @@
 
 #include <core/dbus/message.h>
 
+#include "free_list.h"
+
 #include <cstring>
 #include <sstream>
 
@@ -27,6 +29,8 @@ namespace core
 {
 namespace dbus
 {
+// The following are created and released for every message, we recycle their memory.
+// Allocated together with the control block of its shared pointer from a FreeList.
 struct Message::Reader::Private
 {
     Private(const std::shared_ptr<Message>& msg) : msg(msg)
@@ -40,6 +44,9 @@ struct Message::Reader::Private
 
     void ensure_argument_type_or_throw(ArgumentType expected_type)
     {
+        if (trusted)
+            return;
+
         auto actual_type = static_cast<ArgumentType>(dbus_message_iter_get_arg_type(std::addressof(iter)));
         if (actual_type != expected_type)
         {
@@ -49,6 +56,8 @@ struct Message::Reader::Private
                << "\t Actual: " << actual_type;
             throw std::runtime_error(ss.str());
         }
+
+        advance_signature(expected_type);
     }
 
     const char* pop_string_unchecked()
@@ -61,22 +70,63 @@ struct Message::Reader::Private
         return result;
     }
 
+    // Invoked when advancing past a value of the given type.
+    void advance_signature(ArgumentType type)
+    {
+        if (trusted || signature_offset == unknown_signature_offset)
+            return;
+
+        // Apart from arrays, all types read one at a time have single character signatures.
+        if (type == ArgumentType::array)
+            signature_offset = unknown_signature_offset;
+        else
+            signature_offset++;
+    }
+
+    // Invoked when advancing past a value of unknown signature.
+    void leave_signature()
+    {
+        if (!trusted)
+            signature_offset = unknown_signature_offset;
+    }
+
+    static constexpr std::size_t unknown_signature_offset = static_cast<std::size_t>(-1);
+
     std::shared_ptr<Message> msg;
     DBusMessageIter iter;
+    // Position of the current argument within the signature of the message, only known
+    // for readers obtained from Message::reader(), see Reader::Trusted.
+    std::size_t signature_offset = unknown_signature_offset;
+    // Signature of the message, only queried once the position is checked, see Reader::Trusted.
+    const char* message_signature = nullptr;
+    // Skips type checks while decoding arguments of verified signature.
+    bool trusted = false;
 };
 
-struct Message::Writer::Private
+struct Message::Writer::Private : public impl::Recycled<Message::Writer::Private>
 {
+    Private(const std::shared_ptr<Message>& msg) : msg(msg), iter()
+    {
+    }
+
     std::shared_ptr<Message> msg;
     DBusMessageIter iter;
 };
 
-struct Message::Private
+struct Message::Private : public impl::Recycled<Message::Private>
 {
+    // Releases our reference to the raw message, without requiring a control block.
+    struct Unref
+    {
+        void operator()(DBusMessage* msg) const
+        {
+            if (msg)
+                dbus_message_unref(msg);
+        }
+    };
+
     Private(DBusMessage* msg, bool ref_on_construction = false)
-        : dbus_message(
-              msg,
-              [](DBusMessage* msg) {if (msg) dbus_message_unref(msg);})
+        : dbus_message(msg)
     {
         if (ref_on_construction)
             dbus_message_ref(msg);
@@ -89,7 +139,7 @@ struct Message::Private
                         dbus_message_copy(dbus_message.get())));
     }
 
-    std::shared_ptr<DBusMessage> dbus_message;
+    std::unique_ptr<DBusMessage, Unref> dbus_message;
 };
 }
 }
@@ -0,0 +1,586 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#include "backend.h"
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message_streaming_operators.h>
+#include <core/dbus/object.h>
+
+#include <dbus/dbus.h>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+namespace
+{
+// Mirrors DBUS_TIMEOUT_USE_DEFAULT of libdbus.
+constexpr std::chrono::milliseconds default_timeout{25000};
+
+std::chrono::steady_clock::time_point deadline_for(const std::chrono::milliseconds& timeout)
+{
+    if (timeout >= core::dbus::PendingCall::inifinite_timeout())
+        return std::chrono::steady_clock::time_point::max();
+
+    return std::chrono::steady_clock::now() + (timeout.count() < 0 ? default_timeout : timeout);
+}
+
+// Synthesizes an error reply on behalf of the remote peer, like libdbus does for
+// calls that time out or are cut off by a disconnect.
+Message::Ptr make_error_reply(std::uint32_t serial, const char* name, const std::string& description)
+{
+    auto error = dbus_message_new(DBUS_MESSAGE_TYPE_ERROR);
+    if (!error)
+        throw std::runtime_error("Not enough memory to complete operation.");
+
+    auto text = description.c_str();
+    dbus_message_set_error_name(error, name);
+    dbus_message_set_reply_serial(error, serial);
+    dbus_message_append_args(error, DBUS_TYPE_STRING, &text, DBUS_TYPE_INVALID);
+
+    auto result = Message::from_raw_message(error);
+    dbus_message_unref(error);
+    return result;
+}
+
+void close_all(const std::vector<int>& fds)
+{
+    for (int fd : fds)
+        ::close(fd);
+}
+
+void signal(int event_fd)
+{
+    std::uint64_t value{1};
+    // EAGAIN only happens if the counter is saturated, i.e., the fd is readable anyway.
+    if (::write(event_fd, &value, sizeof(value)) < 0)
+        return;
+}
+}
+
+// Completed by the reading thread for blocking calls, and from within the loop of
+// the executor for all other calls.
+class PendingCall : public core::dbus::PendingCall
+{
+public:
+    PendingCall(const std::weak_ptr<Backend>& backend, std::uint32_t serial)
+        : backend(backend),
+          serial(serial)
+    {
+    }
+
+    void cancel() override
+    {
+        if (auto sp = backend.lock())
+            sp->forget(serial);
+    }
+
+    // Notifications are invoked without holding the guard, they may call back into this instance.
+    void then(const core::dbus::PendingCall::Notification& notification) override
+    {
+        Message::Ptr msg;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            callback = notification;
+            msg = reply;
+        }
+
+        // We already have a reply and invoke the callback directly.
+        if (msg)
+            notification(msg);
+    }
+
+    void complete(const Message::Ptr& msg)
+    {
+        core::dbus::PendingCall::Notification notification;
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            if (reply)
+                return;
+
+            reply = msg;
+            notification = callback;
+        }
+
+        replied.notify_all();
+
+        if (notification)
+            notification(msg);
+    }
+
+    // Returns null if no reply arrived until deadline.
+    Message::Ptr wait_until(const Backend::Clock::time_point& deadline)
+    {
+        std::unique_lock<std::mutex> ul(guard);
+
+        if (deadline == Backend::Clock::time_point::max())
+            replied.wait(ul, [this]() { return reply != nullptr; });
+        else
+            replied.wait_until(ul, deadline, [this]() { return reply != nullptr; });
+
+        return reply;
+    }
+
+    std::uint32_t id() const
+    {
+        return serial;
+    }
+
+private:
+    std::weak_ptr<Backend> backend;
+    std::uint32_t serial;
+
+    std::mutex guard;
+    std::condition_variable replied;
+    Message::Ptr reply;
+    core::dbus::PendingCall::Notification callback;
+};
+
+std::shared_ptr<Backend> Backend::create(const Connection::Ptr& connection, const Filter& filter)
+{
+    std::shared_ptr<Backend> backend{new Backend{connection, filter}};
+    backend->reader = std::thread{&Backend::read, backend.get()};
+    return backend;
+}
+
+Backend::Backend(const Connection::Ptr& connection, const Filter& filter)
+    : connection(connection),
+      filter(filter),
+      dispatch_event(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      timer(::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+      armed_deadline(Clock::time_point::max()),
+      is_disconnected(false)
+{
+    if (dispatch_event < 0 || timer < 0)
+    {
+        auto error = errno;
+
+        if (dispatch_event >= 0)
+            ::close(dispatch_event);
+        if (timer >= 0)
+            ::close(timer);
+
+        throw std::system_error(error, std::system_category(), "Could not create fds for dispatching");
+    }
+}
+
+Backend::~Backend()
+{
+    // Unblocks the reading thread.
+    connection->close();
+
+    if (reader.joinable())
+        reader.join();
+
+    ::close(dispatch_event);
+    ::close(timer);
+}
+
+std::uint32_t Backend::send(const Message::Ptr& msg)
+{
+    return connection->send(msg);
+}
+
+Message::Ptr Backend::send_with_reply_and_block(
+        const Message::Ptr& msg,
+        const std::chrono::milliseconds& timeout)
+{
+    auto deadline = deadline_for(timeout);
+    auto pending_call = start_call(msg, deadline, true);
+
+    if (auto reply = pending_call->wait_until(deadline))
+        return reply;
+
+    // The reading thread might have claimed the reply in the meantime, and hands it over shortly.
+    if (!forget(pending_call->id()))
+        return pending_call->wait_until(Clock::time_point::max());
+
+    throw std::runtime_error(std::string{DBUS_ERROR_NO_REPLY} + ": Did not receive a reply within the timeout.");
+}
+
+core::dbus::PendingCall::Ptr Backend::send_with_reply(
+        const Message::Ptr& msg,
+        const std::chrono::milliseconds& timeout)
+{
+    return start_call(msg, deadline_for(timeout), false);
+}
+
+void Backend::register_object(
+        const types::ObjectPath& path,
+        const std::shared_ptr<Object>& object,
+        const Bus::SubtreeResolver& resolver)
+{
+    std::lock_guard<std::mutex> lg(objects_guard);
+
+    if (!objects.insert(std::make_pair(path, Registration{object, resolver})).second)
+        throw Bus::Errors::ObjectPathInUse{};
+}
+
+void Backend::unregister_object(const types::ObjectPath& path)
+{
+    std::lock_guard<std::mutex> lg(objects_guard);
+    objects.erase(path);
+}
+
+int Backend::dispatch_fd() const
+{
+    return dispatch_event;
+}
+
+void Backend::dispatch()
+{
+    // Deliveries queued from here on make the fd readable again.
+    std::uint64_t value;
+    if (::read(dispatch_event, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        throw std::system_error(errno, std::system_category(), "Could not read from dispatch event");
+
+    while (true)
+    {
+        Delivery delivery;
+
+        {
+            std::lock_guard<std::mutex> lg(queue_guard);
+            if (deliveries.empty())
+                return;
+
+            delivery = std::move(deliveries.front());
+            deliveries.pop_front();
+        }
+
+        try
+        {
+            deliver(delivery);
+        } catch(...)
+        {
+            // Make sure the remaining deliveries are picked up by the next round.
+            signal(dispatch_event);
+            throw;
+        }
+    }
+}
+
+int Backend::timeout_fd() const
+{
+    return timer;
+}
+
+void Backend::expire()
+{
+    std::uint64_t expirations;
+    if (::read(timer, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        throw std::system_error(errno, std::system_category(), "Could not read from timer");
+
+    std::vector<std::shared_ptr<PendingCall>> expired;
+
+    {
+        std::lock_guard<std::mutex> lg(calls_guard);
+
+        auto now = Clock::now();
+        auto earliest = Clock::time_point::max();
+
+        for (auto it = calls.begin(); it != calls.end();)
+        {
+            if (it->second.is_blocking)
+            {
+                ++it;
+                continue;
+            }
+
+            if (it->second.deadline <= now)
+            {
+                expired.push_back(it->second.pending_call);
+                it = calls.erase(it);
+                continue;
+            }
+
+            earliest = std::min(earliest, it->second.deadline);
+            ++it;
+        }
+
+        arm_timeout_locked(earliest);
+    }
+
+    for (const auto& pending_call : expired)
+        pending_call->complete(make_error_reply(
+                    pending_call->id(),
+                    DBUS_ERROR_NO_REPLY,
+                    "Did not receive a reply within the timeout."));
+}
+
+std::shared_ptr<PendingCall> Backend::start_call(
+        const Message::Ptr& msg,
+        const Clock::time_point& deadline,
+        bool is_blocking)
+{
+    if (!msg)
+        throw std::runtime_error("Precondition violated, cannot send null message.");
+
+    // The reply might arrive before sending returns, the call has to be known up front.
+    auto serial = connection->allocate_serial();
+    auto pending_call = std::make_shared<PendingCall>(shared_from_this(), serial);
+
+    {
+        std::lock_guard<std::mutex> lg(calls_guard);
+
+        if (is_disconnected)
+            throw std::runtime_error(std::string{DBUS_ERROR_DISCONNECTED} + ": " + disconnect_reason);
+
+        calls.insert(std::make_pair(serial, Call{pending_call, is_blocking, deadline}));
+
+        if (!is_blocking && deadline < armed_deadline)
+            arm_timeout_locked(deadline);
+    }
+
+    try
+    {
+        connection->send_with_serial(msg, serial);
+    } catch(...)
+    {
+        forget(serial);
+        throw;
+    }
+
+    return pending_call;
+}
+
+bool Backend::forget(std::uint32_t serial)
+{
+    std::lock_guard<std::mutex> lg(calls_guard);
+    return calls.erase(serial) > 0;
+}
+
+void Backend::read()
+{
+    while (true)
+    {
+        Connection::Incoming incoming;
+
+        try
+        {
+            incoming = connection->read();
+        } catch(const std::exception& e)
+        {
+            disconnected(e.what());
+            return;
+        }
+
+        // Unix fds cannot be attached to messages read by a native connection.
+        close_all(incoming.fds);
+
+        if (incoming.reply_serial != 0)
+        {
+            Call call{nullptr, false, Clock::time_point{}};
+
+            {
+                std::lock_guard<std::mutex> lg(calls_guard);
+                auto it = calls.find(incoming.reply_serial);
+                if (it != calls.end())
+                {
+                    call = it->second;
+                    calls.erase(it);
+                }
+            }
+
+            if (call.pending_call && call.is_blocking)
+            {
+                call.pending_call->complete(incoming.message);
+                continue;
+            }
+
+            if (call.pending_call)
+            {
+                queue(Delivery{call.pending_call, incoming.message});
+                continue;
+            }
+        }
+
+        queue(Delivery{nullptr, incoming.message});
+    }
+}
+
+void Backend::disconnected(const std::string& reason)
+{
+    std::map<std::uint32_t, Call> pending;
+
+    {
+        std::lock_guard<std::mutex> lg(calls_guard);
+        is_disconnected = true;
+        disconnect_reason = reason;
+        pending.swap(calls);
+    }
+
+    for (const auto& pair : pending)
+    {
+        auto error = make_error_reply(pair.first, DBUS_ERROR_DISCONNECTED, reason);
+
+        if (pair.second.is_blocking)
+            pair.second.pending_call->complete(error);
+        else
+            queue(Delivery{pair.second.pending_call, error});
+    }
+}
+
+void Backend::queue(Delivery delivery)
+{
+    bool was_empty = false;
+
+    {
+        std::lock_guard<std::mutex> lg(queue_guard);
+        was_empty = deliveries.empty();
+        deliveries.push_back(std::move(delivery));
+    }
+
+    // The fd stays readable until dispatch() has drained the queue.
+    if (was_empty)
+        signal(dispatch_event);
+}
+
+void Backend::deliver(const Delivery& delivery)
+{
+    if (delivery.pending_call)
+    {
+        delivery.pending_call->complete(delivery.message);
+        return;
+    }
+
+    if (filter)
+        filter(delivery.message);
+
+    if (delivery.message->type() == Message::Type::method_call)
+        route(delivery.message);
+}
+
+void Backend::route(const Message::Ptr& msg)
+{
+    if (handle_peer_method(msg))
+        return;
+
+    if (auto object = object_for(msg->path()))
+        if (object->on_new_message(msg))
+            return;
+
+    if (!msg->expects_reply())
+        return;
+
+    std::stringstream ss;
+    ss << "Method \"" << msg->member()
+       << "\" with signature \"" << msg->signature()
+       << "\" on interface \"" << msg->interface()
+       << "\" doesn't exist";
+
+    send(Message::make_error(msg, DBUS_ERROR_UNKNOWN_METHOD, ss.str()));
+}
+
+bool Backend::handle_peer_method(const Message::Ptr& msg)
+{
+    if (msg->interface() != DBUS_INTERFACE_PEER)
+        return false;
+
+    if (msg->member() == "Ping")
+    {
+        send(Message::make_method_return(msg));
+        return true;
+    }
+
+    if (msg->member() == "GetMachineId")
+    {
+        auto id = dbus_get_local_machine_id();
+        if (!id)
+        {
+            send(Message::make_error(msg, DBUS_ERROR_FAILED, "Could not determine the machine id."));
+            return true;
+        }
+
+        auto reply = Message::make_method_return(msg);
+        reply->writer() << std::string{id};
+        dbus_free(id);
+
+        send(reply);
+        return true;
+    }
+
+    return false;
+}
+
+std::shared_ptr<Object> Backend::object_for(const types::ObjectPath& path)
+{
+    Registration registration;
+
+    {
+        std::lock_guard<std::mutex> lg(objects_guard);
+
+        auto it = objects.find(path);
+
+        // Like libdbus, we fall back to the closest subtree registered for an ancestor.
+        for (auto ancestor = path; it == objects.end() && ancestor != types::ObjectPath::root();)
+        {
+            ancestor = ancestor.parent();
+            it = objects.find(ancestor);
+            if (it != objects.end() && !it->second.resolver)
+                it = objects.end();
+        }
+
+        if (it == objects.end())
+            return std::shared_ptr<Object>{};
+
+        registration = it->second;
+    }
+
+    auto object = registration.object.lock();
+
+    // Messages for descendants of a subtree are dispatched to the resolved object.
+    if (object && registration.resolver && path != object->path())
+        return registration.resolver(path);
+
+    return object;
+}
+
+void Backend::arm_timeout_locked(const Clock::time_point& deadline)
+{
+    armed_deadline = deadline;
+
+    // A zero expiration disarms the timer.
+    itimerspec spec{};
+    if (deadline != Clock::time_point::max())
+    {
+        auto since_epoch = deadline.time_since_epoch();
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+        spec.it_value.tv_sec = seconds.count();
+        spec.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds).count();
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+            spec.it_value.tv_nsec = 1;
+    }
+
+    if (::timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr) < 0)
+        throw std::system_error(errno, std::system_category(), "Could not arm timer");
+}
+}
+}
+}
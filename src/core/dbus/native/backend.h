@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_NATIVE_BACKEND_H_
+#define CORE_DBUS_NATIVE_BACKEND_H_
+
+#include <core/dbus/bus.h>
+#include <core/dbus/message.h>
+#include <core/dbus/pending_call.h>
+
+#include <core/dbus/native/connection.h>
+
+#include <core/dbus/types/object_path.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace core
+{
+namespace dbus
+{
+class Object;
+
+namespace native
+{
+class PendingCall;
+
+// Takes over the parts of a Bus that libdbus implements otherwise, on top of a
+// native::Connection: Tracking replies to pending calls, routing method calls to
+// registered objects and handing over all other messages to the loop of an executor.
+//
+// A dedicated thread reads from the connection. Replies to blocking calls are handed
+// over directly, such that blocking calls neither need an executor nor block it.
+// Everything else is queued and delivered from within dispatch(), which an executor
+// invokes whenever dispatch_fd() is readable.
+class Backend : public std::enable_shared_from_this<Backend>
+{
+public:
+    // Invoked for every message that is not a reply to a pending call, before
+    // method calls are routed to objects.
+    typedef std::function<void(const Message::Ptr&)> Filter;
+
+    // Starts reading from connection.
+    static std::shared_ptr<Backend> create(const Connection::Ptr& connection, const Filter& filter);
+
+    Backend(const Backend&) = delete;
+    ~Backend();
+
+    Backend& operator=(const Backend&) = delete;
+
+    std::uint32_t send(const Message::Ptr& msg);
+
+    Message::Ptr send_with_reply_and_block(
+            const Message::Ptr& msg,
+            const std::chrono::milliseconds& timeout);
+
+    core::dbus::PendingCall::Ptr send_with_reply(
+            const Message::Ptr& msg,
+            const std::chrono::milliseconds& timeout);
+
+    // Mirrors the semantics of object paths and fallbacks registered with libdbus.
+    void register_object(
+            const types::ObjectPath& path,
+            const std::shared_ptr<Object>& object,
+            const Bus::SubtreeResolver& resolver);
+
+    void unregister_object(const types::ObjectPath& path);
+
+    // Readable whenever messages are waiting to be delivered by dispatch().
+    int dispatch_fd() const;
+    void dispatch();
+
+    // Readable whenever the earliest deadline of an asynchronous call has passed.
+    int timeout_fd() const;
+    void expire();
+
+private:
+    friend class PendingCall;
+
+    typedef std::chrono::steady_clock Clock;
+
+    struct Registration
+    {
+        std::weak_ptr<Object> object;
+        // Only set for subtrees.
+        Bus::SubtreeResolver resolver;
+    };
+
+    struct Call
+    {
+        std::shared_ptr<PendingCall> pending_call;
+        // Replies to blocking calls are handed over by the reading thread.
+        bool is_blocking;
+        Clock::time_point deadline;
+    };
+
+    // A message waiting to be delivered, together with the call it completes, if any.
+    struct Delivery
+    {
+        std::shared_ptr<PendingCall> pending_call;
+        Message::Ptr message;
+    };
+
+    Backend(const Connection::Ptr& connection, const Filter& filter);
+
+    std::shared_ptr<PendingCall> start_call(
+            const Message::Ptr& msg,
+            const Clock::time_point& deadline,
+            bool is_blocking);
+    // Returns false if the call has completed already.
+    bool forget(std::uint32_t serial);
+
+    void read();
+    void disconnected(const std::string& reason);
+    void queue(Delivery delivery);
+    void deliver(const Delivery& delivery);
+    void route(const Message::Ptr& msg);
+    bool handle_peer_method(const Message::Ptr& msg);
+    std::shared_ptr<Object> object_for(const types::ObjectPath& path);
+    void arm_timeout_locked(const Clock::time_point& deadline);
+
+    Connection::Ptr connection;
+    Filter filter;
+
+    int dispatch_event;
+    int timer;
+
+    std::mutex calls_guard;
+    std::map<std::uint32_t, Call> calls;
+    Clock::time_point armed_deadline;
+    bool is_disconnected;
+    std::string disconnect_reason;
+
+    std::mutex queue_guard;
+    std::deque<Delivery> deliveries;
+
+    std::mutex objects_guard;
+    std::unordered_map<types::ObjectPath, Registration> objects;
+
+    std::thread reader;
+};
+}
+}
+}
+
+#endif // CORE_DBUS_NATIVE_BACKEND_H_
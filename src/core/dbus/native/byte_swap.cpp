@@ -0,0 +1,174 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/byte_swap.h>
+
+#include <stdexcept>
+
+// See validation.cpp, AVX2 is enabled per function.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+#define CORE_DBUS_BYTE_SWAP_HAVE_X86
+#include <immintrin.h>
+#endif
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+namespace
+{
+typedef void (*Swapper)(std::uint8_t* data, std::size_t count);
+
+template<std::size_t size>
+void swap_scalar(std::uint8_t* data, std::size_t count)
+{
+    typedef typename detail::ByteSwap<size>::Type Type;
+
+    for (std::size_t i = 0; i < count; i++, data += size)
+    {
+        Type value;
+        std::memcpy(&value, data, size);
+        value = detail::ByteSwap<size>::swap(value);
+        std::memcpy(data, &value, size);
+    }
+}
+
+#if defined(CORE_DBUS_BYTE_SWAP_HAVE_X86)
+// SSE2 lacks byte shuffles: 16-bit lanes are swapped by shifting, wider lanes by
+// first reversing the order of their 16-bit (and 32-bit) parts.
+inline __m128i swap16_sse2(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+inline __m128i swap32_sse2(__m128i v)
+{
+    v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return swap16_sse2(v);
+}
+
+inline __m128i swap64_sse2(__m128i v)
+{
+    v = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    return swap32_sse2(v);
+}
+
+template<std::size_t size, __m128i (*swap)(__m128i)>
+void swap_sse2(std::uint8_t* data, std::size_t count)
+{
+    std::size_t i = 0;
+    for (; i + 16 / size <= count; i += 16 / size)
+    {
+        auto p = reinterpret_cast<__m128i*>(data + i * size);
+        _mm_storeu_si128(p, swap(_mm_loadu_si128(p)));
+    }
+
+    swap_scalar<size>(data + i * size, count - i);
+}
+
+template<std::size_t size>
+__attribute__((target("avx2")))
+void swap_avx2(std::uint8_t* data, std::size_t count)
+{
+    // Reverses the bytes within each lane of size bytes, per 128-bit half.
+    const auto mask = size == 2 ?
+                _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14) :
+                size == 4 ?
+                _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+                _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+    std::size_t i = 0;
+    for (; i + 32 / size <= count; i += 32 / size)
+    {
+        auto p = reinterpret_cast<__m256i*>(data + i * size);
+        _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), mask));
+    }
+
+    swap_scalar<size>(data + i * size, count - i);
+}
+#endif
+
+Swapper swapper(validation::Isa isa, std::size_t size)
+{
+    switch (isa)
+    {
+#if defined(CORE_DBUS_BYTE_SWAP_HAVE_X86)
+    case validation::Isa::avx2:
+        return size == 2 ? swap_avx2<2> : size == 4 ? swap_avx2<4> : size == 8 ? swap_avx2<8> : nullptr;
+    case validation::Isa::sse2:
+        return size == 2 ? swap_sse2<2, swap16_sse2> : size == 4 ? swap_sse2<4, swap32_sse2> : size == 8 ? swap_sse2<8, swap64_sse2> : nullptr;
+#endif
+    default:
+        return size == 2 ? swap_scalar<2> : size == 4 ? swap_scalar<4> : size == 8 ? swap_scalar<8> : nullptr;
+    }
+}
+
+// Picks the fastest implementation, a single bswap per value beats SSE2 for 64-bit values.
+Swapper fastest_swapper(std::size_t size)
+{
+    auto isa = validation::best_isa();
+    if (isa == validation::Isa::sse2 && size == 8)
+        isa = validation::Isa::scalar;
+
+    return swapper(isa, size);
+}
+
+struct Swappers
+{
+    Swapper swap16;
+    Swapper swap32;
+    Swapper swap64;
+};
+}
+
+void swap_byte_order(void* data, std::size_t count, std::size_t size)
+{
+    static const Swappers swappers
+    {
+        fastest_swapper(2),
+        fastest_swapper(4),
+        fastest_swapper(8)
+    };
+
+    auto p = static_cast<std::uint8_t*>(data);
+    switch (size)
+    {
+    case 2: swappers.swap16(p, count); break;
+    case 4: swappers.swap32(p, count); break;
+    case 8: swappers.swap64(p, count); break;
+    default: break;
+    }
+}
+
+void swap_byte_order(validation::Isa isa, void* data, std::size_t count, std::size_t size)
+{
+    if (!validation::is_supported(isa))
+        throw std::runtime_error("swap_byte_order: Implementation not supported by this CPU.");
+
+    if (auto swap = swapper(isa, size))
+        swap(static_cast<std::uint8_t*>(data), count);
+}
+}
+}
+}
@@ -0,0 +1,765 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/connection.h>
+
+#include <core/dbus/error.h>
+
+#include <core/dbus/types/object_path.h>
+
+#include "../message_p.h"
+
+#include <dbus/dbus.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <system_error>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+namespace
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+const char host_byte_order = DBUS_LITTLE_ENDIAN;
+#else
+const char host_byte_order = DBUS_BIG_ENDIAN;
+#endif
+
+// Byte order, type, flags, version, body length, serial and length of the header fields.
+constexpr std::size_t fixed_header_size = 16;
+constexpr std::size_t serial_offset = 8;
+constexpr std::size_t body_length_offset = 4;
+constexpr std::size_t header_fields_length_offset = 12;
+
+// The kernel refuses to pass more fds in one go (SCM_MAX_FD).
+constexpr std::size_t max_unix_fds_per_message = 253;
+// Upper bound for the number of messages written with a single system call.
+constexpr std::size_t max_messages_per_write = 64;
+
+const char* default_system_bus_address = "unix:path=/var/run/dbus/system_bus_socket";
+
+struct UnixAddress
+{
+    std::string path;
+    bool is_abstract;
+};
+
+inline std::size_t align(std::size_t offset, std::size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+inline std::uint32_t uint32_at(const std::uint8_t* p, char byte_order)
+{
+    std::uint32_t result;
+    std::memcpy(&result, p, sizeof(result));
+    return byte_order == host_byte_order ? result : __builtin_bswap32(result);
+}
+
+inline void set_uint32_at(std::uint8_t* p, std::uint32_t value, char byte_order)
+{
+    if (byte_order != host_byte_order)
+        value = __builtin_bswap32(value);
+    std::memcpy(p, &value, sizeof(value));
+}
+
+// Resolves %-escapes in values of server addresses.
+std::string unescape(const std::string& value)
+{
+    std::string result;
+    for (std::size_t i = 0; i < value.size(); i++)
+    {
+        if (value[i] != '%')
+        {
+            result.push_back(value[i]);
+            continue;
+        }
+
+        if (i + 2 >= value.size())
+            throw std::runtime_error("Malformed escape sequence in address: " + value);
+
+        result.push_back(static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16)));
+        i += 2;
+    }
+    return result;
+}
+
+// Extracts all unix socket addresses a client can connect to from a server address.
+std::vector<UnixAddress> parse_unix_addresses(const std::string& address)
+{
+    std::vector<UnixAddress> result;
+
+    std::stringstream entries{address};
+    std::string entry;
+    while (std::getline(entries, entry, ';'))
+    {
+        auto colon = entry.find(':');
+        if (colon == std::string::npos)
+            throw std::runtime_error("Malformed address: " + address);
+
+        if (entry.substr(0, colon) != "unix")
+            continue;
+
+        std::stringstream pairs{entry.substr(colon + 1)};
+        std::string pair;
+        while (std::getline(pairs, pair, ','))
+        {
+            auto equals = pair.find('=');
+            if (equals == std::string::npos)
+                throw std::runtime_error("Malformed address: " + address);
+
+            auto key = pair.substr(0, equals);
+            if (key == "path" || key == "abstract")
+                result.push_back(UnixAddress{unescape(pair.substr(equals + 1)), key == "abstract"});
+        }
+    }
+
+    return result;
+}
+
+int connect_to(const UnixAddress& address)
+{
+    sockaddr_un sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+
+    // Abstract addresses start with a null byte and are not null-terminated.
+    auto offset = address.is_abstract ? 1 : 0;
+    if (address.path.size() + offset >= sizeof(sa.sun_path))
+        throw std::runtime_error("Socket path too long: " + address.path);
+
+    std::memcpy(sa.sun_path + offset, address.path.data(), address.path.size());
+    auto length = offsetof(sockaddr_un, sun_path) + offset + address.path.size() + (address.is_abstract ? 0 : 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "Could not create socket");
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&sa), length) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Locates the value of the header field with the given code in a complete message.
+// Header fields only carry basic types, such that we can walk them without a demarshaller.
+std::uint8_t* find_header_field(std::uint8_t* message, std::uint8_t code)
+{
+    const char byte_order = message[0];
+    const std::size_t end = fixed_header_size + uint32_at(message + header_fields_length_offset, byte_order);
+
+    auto ensure_available = [end](std::size_t offset, std::size_t bytes)
+    {
+        if (offset + bytes > end)
+            throw std::runtime_error("Malformed header fields.");
+    };
+
+    std::size_t offset = fixed_header_size;
+    while (offset < end)
+    {
+        offset = align(offset, 8);
+        ensure_available(offset, 4);
+
+        auto field_code = message[offset];
+        if (message[offset + 1] != 1)
+            throw std::runtime_error("Header field with unexpected type.");
+        auto type = message[offset + 2];
+        offset += 4;
+
+        std::size_t value_size = 0;
+        switch (type)
+        {
+        case DBUS_TYPE_BYTE:
+            value_size = 1;
+            break;
+        case DBUS_TYPE_BOOLEAN:
+        case DBUS_TYPE_INT32:
+        case DBUS_TYPE_UINT32:
+        case DBUS_TYPE_UNIX_FD:
+            offset = align(offset, 4);
+            value_size = 4;
+            break;
+        case DBUS_TYPE_STRING:
+        case DBUS_TYPE_OBJECT_PATH:
+            offset = align(offset, 4);
+            ensure_available(offset, 4);
+            value_size = 4 + uint32_at(message + offset, byte_order) + 1;
+            break;
+        case DBUS_TYPE_SIGNATURE:
+            ensure_available(offset, 1);
+            value_size = 1 + message[offset] + 1;
+            break;
+        default:
+            throw std::runtime_error("Header field with unexpected type.");
+        }
+
+        ensure_available(offset, value_size);
+        if (field_code == code)
+            return message + offset;
+
+        offset += value_size;
+    }
+
+    return nullptr;
+}
+
+void close_all(const std::vector<int>& fds)
+{
+    for (int fd : fds)
+        ::close(fd);
+}
+}
+
+struct Connection::Private
+{
+    // A marshalled message waiting to be written.
+    struct Node
+    {
+        ~Node()
+        {
+            dbus_free(data);
+        }
+
+        Node* next;
+        char* data;
+        std::size_t size;
+        std::vector<int> fds;
+    };
+
+    // A message read from the socket, before it is handed out as core::dbus::Message.
+    struct Frame
+    {
+        DBusMessage* message;
+        std::vector<int> fds;
+    };
+
+    Private(int socket) : socket(socket), rx(4096)
+    {
+    }
+
+    ~Private()
+    {
+        ::close(socket);
+
+        free(queue.exchange(nullptr));
+
+        for (int fd : rx_fds)
+            ::close(fd);
+    }
+
+    std::uint32_t allocate_serial()
+    {
+        // 0 is not a valid serial, skip it on wrap-around.
+        std::uint32_t serial = 0;
+        while (serial == 0)
+            serial = next_serial.fetch_add(1);
+        return serial;
+    }
+
+    // Pushing and flushing have to be sequentially consistent: A writer clears
+    // is_writing and then checks the queue, while a sender pushes to the queue
+    // and then checks is_writing. With weaker orderings, both could miss the
+    // other's store and leave the message unsent.
+    void push(Node* node)
+    {
+        node->next = queue.load(std::memory_order_relaxed);
+        while (!queue.compare_exchange_weak(node->next, node, std::memory_order_seq_cst, std::memory_order_relaxed));
+    }
+
+    // Writes out queued messages unless another thread is doing so already.
+    // That thread picks up our messages before giving up the role of the writer.
+    void flush()
+    {
+        while (!is_writing.exchange(true))
+        {
+            auto batch = queue.exchange(nullptr);
+
+            // The queue is a stack, restore the order messages have been sent in.
+            Node* ordered = nullptr;
+            while (batch)
+            {
+                auto next = batch->next;
+                batch->next = ordered;
+                ordered = batch;
+                batch = next;
+            }
+
+            try
+            {
+                write(ordered);
+            } catch(...)
+            {
+                // Messages queued behind the failed write will never be sent.
+                is_broken = true;
+                free(queue.exchange(nullptr));
+                is_writing = false;
+                throw;
+            }
+
+            is_writing = false;
+
+            if (!queue.load())
+                break;
+        }
+    }
+
+    // Writes and frees the given list of messages, attaching fds to the first byte of their message.
+    void write(Node* node)
+    {
+        iovec iov[max_messages_per_write];
+
+        while (node)
+        {
+            auto first = node;
+            std::size_t count = 0;
+
+            do
+            {
+                iov[count].iov_base = node->data;
+                iov[count].iov_len = node->size;
+                count++;
+                node = node->next;
+            } while (node && node->fds.empty() && count < max_messages_per_write);
+
+            try
+            {
+                write_all(iov, count, first->fds);
+            } catch(...)
+            {
+                free(first);
+                throw;
+            }
+
+            // Detach the written messages from the remaining ones before freeing them.
+            auto last = first;
+            while (last->next != node)
+                last = last->next;
+            last->next = nullptr;
+
+            free(first);
+        }
+    }
+
+    static void free(Node* node)
+    {
+        while (node)
+        {
+            auto next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    void write_all(iovec* iov, std::size_t count, const std::vector<int>& fds)
+    {
+        char control[CMSG_SPACE(max_unix_fds_per_message * sizeof(int))];
+
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        if (!fds.empty())
+        {
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+
+            auto cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+            std::memcpy(CMSG_DATA(cmsg), fds.data(), fds.size() * sizeof(int));
+        }
+
+        while (msg.msg_iovlen > 0)
+        {
+            auto written = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::system_error(errno, std::system_category(), "Could not write to connection");
+            }
+
+            // Fds have been passed along with the first chunk.
+            msg.msg_control = nullptr;
+            msg.msg_controllen = 0;
+
+            std::size_t remaining = written;
+            while (msg.msg_iovlen > 0 && remaining >= msg.msg_iov->iov_len)
+            {
+                remaining -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+
+            if (msg.msg_iovlen > 0)
+            {
+                msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + remaining;
+                msg.msg_iov->iov_len -= remaining;
+            }
+        }
+    }
+
+    void write_line(const std::string& line)
+    {
+        iovec iov{const_cast<char*>(line.data()), line.size()};
+        write_all(&iov, 1, std::vector<int>{});
+    }
+
+    // Reads at least one more byte into the receive buffer, collecting passed fds.
+    void read_more()
+    {
+        if (rx_begin > 0)
+        {
+            std::memmove(rx.data(), rx.data() + rx_begin, rx_end - rx_begin);
+            rx_end -= rx_begin;
+            rx_begin = 0;
+        }
+
+        if (rx_end == rx.size())
+            rx.resize(rx.size() * 2);
+
+        char control[CMSG_SPACE(max_unix_fds_per_message * sizeof(int))];
+        iovec iov{rx.data() + rx_end, rx.size() - rx_end};
+
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t received = -1;
+        while ((received = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC)) < 0)
+        {
+            if (errno != EINTR)
+                throw std::system_error(errno, std::system_category(), "Could not read from connection");
+        }
+
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+
+            auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                rx_fds.push_back(fd);
+            }
+        }
+
+        if (msg.msg_flags & MSG_CTRUNC)
+            throw std::runtime_error("Received more unix fds than supported.");
+
+        if (received == 0)
+            throw std::runtime_error("Connection closed by peer.");
+
+        rx_end += received;
+    }
+
+    std::string read_line()
+    {
+        while (true)
+        {
+            auto begin = reinterpret_cast<const char*>(rx.data() + rx_begin);
+            auto end = reinterpret_cast<const char*>(rx.data() + rx_end);
+            auto eol = std::search(begin, end, "\r\n", "\r\n" + 2);
+
+            if (eol != end)
+            {
+                rx_begin += (eol - begin) + 2;
+                return std::string(begin, eol);
+            }
+
+            read_more();
+        }
+    }
+
+    Frame read_frame()
+    {
+        std::lock_guard<std::mutex> lg(read_guard);
+
+        while (rx_end - rx_begin < fixed_header_size)
+            read_more();
+
+        const char byte_order = rx[rx_begin];
+        if (byte_order != DBUS_LITTLE_ENDIAN && byte_order != DBUS_BIG_ENDIAN)
+            throw std::runtime_error("Received message with invalid byte order.");
+
+        auto fields_length = uint32_at(rx.data() + rx_begin + header_fields_length_offset, byte_order);
+        auto body_length = uint32_at(rx.data() + rx_begin + body_length_offset, byte_order);
+
+        if (fields_length > DBUS_MAXIMUM_MESSAGE_LENGTH || body_length > DBUS_MAXIMUM_MESSAGE_LENGTH)
+            throw std::runtime_error("Received message exceeding the maximum message length.");
+
+        std::size_t total = align(fixed_header_size + fields_length, 8) + body_length;
+        if (total > DBUS_MAXIMUM_MESSAGE_LENGTH)
+            throw std::runtime_error("Received message exceeding the maximum message length.");
+
+        while (rx_end - rx_begin < total)
+            read_more();
+
+        auto message = rx.data() + rx_begin;
+        rx_begin += total;
+
+        Frame frame{nullptr, std::vector<int>{}};
+
+        // libdbus cannot attach fds to demarshalled messages, we hand them out
+        // separately and tell libdbus that the message does not carry any.
+        if (auto field = find_header_field(message, DBUS_HEADER_FIELD_UNIX_FDS))
+        {
+            auto count = uint32_at(field, byte_order);
+            if (count > rx_fds.size())
+                throw std::runtime_error("Received message lacks unix fds.");
+
+            frame.fds.assign(rx_fds.begin(), rx_fds.begin() + count);
+            rx_fds.erase(rx_fds.begin(), rx_fds.begin() + count);
+            set_uint32_at(field, 0, byte_order);
+        }
+
+        Error error;
+        frame.message = dbus_message_demarshal(
+                    reinterpret_cast<const char*>(message),
+                    static_cast<int>(total),
+                    std::addressof(error.raw()));
+
+        if (!frame.message)
+        {
+            close_all(frame.fds);
+            throw std::runtime_error(error.print());
+        }
+
+        return frame;
+    }
+
+    // Authenticates with the credentials of the process, see
+    // http://dbus.freedesktop.org/doc/dbus-specification.html#auth-protocol
+    void authenticate()
+    {
+        static const char hex[] = "0123456789abcdef";
+
+        std::string uid = std::to_string(::getuid());
+        std::string encoded_uid;
+        for (char c : uid)
+        {
+            encoded_uid.push_back(hex[(c >> 4) & 0xf]);
+            encoded_uid.push_back(hex[c & 0xf]);
+        }
+
+        write_line(std::string(1, '\0') + "AUTH EXTERNAL " + encoded_uid + "\r\n");
+        auto reply = read_line();
+        if (reply.compare(0, 3, "OK ") != 0)
+            throw std::runtime_error("Authentication failed: " + reply);
+
+        write_line("NEGOTIATE_UNIX_FD\r\n");
+        can_pass_unix_fds = read_line() == "AGREE_UNIX_FD";
+
+        write_line("BEGIN\r\n");
+    }
+
+    int socket;
+    std::string unique_name;
+    bool can_pass_unix_fds{false};
+
+    std::atomic<std::uint32_t> next_serial{1};
+    std::atomic<Node*> queue{nullptr};
+    std::atomic<bool> is_writing{false};
+    std::atomic<bool> is_broken{false};
+
+    std::mutex read_guard;
+    std::vector<std::uint8_t> rx;
+    std::size_t rx_begin{0};
+    std::size_t rx_end{0};
+    std::deque<int> rx_fds;
+};
+
+Connection::Ptr Connection::open(WellKnownBus bus)
+{
+    const char* address = nullptr;
+
+    switch (bus)
+    {
+    case WellKnownBus::session:
+        address = std::getenv("DBUS_SESSION_BUS_ADDRESS");
+        break;
+    case WellKnownBus::system:
+        address = std::getenv("DBUS_SYSTEM_BUS_ADDRESS");
+        if (!address)
+            address = default_system_bus_address;
+        break;
+    case WellKnownBus::starter:
+        address = std::getenv("DBUS_STARTER_ADDRESS");
+        break;
+    }
+
+    if (!address)
+        throw std::runtime_error("Address of bus is unknown.");
+
+    return open(std::string{address});
+}
+
+Connection::Ptr Connection::open(const std::string& address)
+{
+    int fd = -1;
+    for (const auto& unix_address : parse_unix_addresses(address))
+        if ((fd = connect_to(unix_address)) >= 0)
+            break;
+
+    if (fd < 0)
+        throw std::runtime_error("Could not connect to any unix socket in: " + address);
+
+    Ptr connection{new Connection{std::unique_ptr<Private>{new Private{fd}}}};
+    connection->d->authenticate();
+
+    auto hello = Message::make_method_call(
+                DBUS_SERVICE_DBUS,
+                types::ObjectPath{DBUS_PATH_DBUS},
+                DBUS_INTERFACE_DBUS,
+                "Hello");
+    auto serial = connection->send(hello);
+
+    while (true)
+    {
+        auto incoming = connection->read();
+        close_all(incoming.fds);
+
+        if (incoming.reply_serial != serial)
+            continue;
+
+        if (incoming.message->type() == Message::Type::error)
+            throw std::runtime_error(incoming.message->error().print());
+
+        connection->d->unique_name = incoming.message->reader().pop_string();
+        break;
+    }
+
+    return connection;
+}
+
+Connection::Connection(std::unique_ptr<Private> d) : d(std::move(d))
+{
+}
+
+Connection::~Connection()
+{
+}
+
+const std::string& Connection::unique_name() const
+{
+    return d->unique_name;
+}
+
+bool Connection::can_pass_unix_fds() const
+{
+    return d->can_pass_unix_fds;
+}
+
+int Connection::fd() const
+{
+    return d->socket;
+}
+
+std::uint32_t Connection::send(const Message::Ptr& msg, const std::vector<int>& fds)
+{
+    auto serial = allocate_serial();
+    send_with_serial(msg, serial, fds);
+    return serial;
+}
+
+std::uint32_t Connection::allocate_serial()
+{
+    return d->allocate_serial();
+}
+
+void Connection::send_with_serial(const Message::Ptr& msg, std::uint32_t serial, const std::vector<int>& fds)
+{
+    if (!msg)
+        throw std::runtime_error("Precondition violated, cannot send null message.");
+
+    if (serial == 0)
+        throw std::runtime_error("Precondition violated, cannot send message with serial 0.");
+
+    if (d->is_broken)
+        throw std::runtime_error("Cannot send on broken connection.");
+
+    if (!fds.empty() && !d->can_pass_unix_fds)
+        throw std::runtime_error("Connection does not support passing unix fds.");
+
+    if (fds.size() > max_unix_fds_per_message)
+        throw std::runtime_error("Too many unix fds for one message.");
+
+    char* data = nullptr;
+    int size = 0;
+
+    if (!dbus_message_marshal(msg->d->dbus_message.get(), &data, &size))
+        throw std::runtime_error("Problem marshalling message.");
+
+    std::unique_ptr<Private::Node> node{new Private::Node{nullptr, data, static_cast<std::size_t>(size), fds}};
+
+    auto message = reinterpret_cast<std::uint8_t*>(data);
+    auto field = find_header_field(message, DBUS_HEADER_FIELD_UNIX_FDS);
+    if ((field ? uint32_at(field, data[0]) : 0) != fds.size())
+        throw std::runtime_error("Number of unix fds does not match the message.");
+
+    set_uint32_at(message + serial_offset, serial, data[0]);
+
+    d->push(node.release());
+    d->flush();
+}
+
+Connection::Incoming Connection::read()
+{
+    auto frame = d->read_frame();
+
+    return Incoming
+    {
+        Message::wrap(std::unique_ptr<Message::Private>(new Message::Private(frame.message))),
+        dbus_message_get_serial(frame.message),
+        dbus_message_get_reply_serial(frame.message),
+        std::move(frame.fds)
+    };
+}
+
+void Connection::close()
+{
+    ::shutdown(d->socket, SHUT_RDWR);
+}
+}
+}
+}
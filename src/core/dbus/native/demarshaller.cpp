@@ -0,0 +1,216 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/demarshaller.h>
+
+#include "../message_p.h"
+
+#include <dbus/dbus.h>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+namespace
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+const char host_byte_order = DBUS_LITTLE_ENDIAN;
+#else
+const char host_byte_order = DBUS_BIG_ENDIAN;
+#endif
+
+// Offset of the body length within the fixed part of the header.
+constexpr std::size_t body_length_offset = 4;
+
+std::size_t alignment_of(char type)
+{
+    switch (type)
+    {
+    case DBUS_TYPE_BYTE:
+    case DBUS_TYPE_SIGNATURE:
+    case DBUS_TYPE_VARIANT:
+        return 1;
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+        return 2;
+    case DBUS_TYPE_BOOLEAN:
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+    case DBUS_TYPE_UNIX_FD:
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_ARRAY:
+        return 4;
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+    case DBUS_TYPE_DOUBLE:
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+        return 8;
+    default:
+        throw std::runtime_error(std::string{"Demarshaller: Invalid type code in signature: "} + type);
+    }
+}
+
+// Returns the character following the complete type starting at signature.
+const char* end_of_complete_type(const char* signature)
+{
+    switch (*signature)
+    {
+    case DBUS_TYPE_ARRAY:
+        return end_of_complete_type(signature + 1);
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+    {
+        const char closing = *signature == DBUS_STRUCT_BEGIN_CHAR ? DBUS_STRUCT_END_CHAR : DBUS_DICT_ENTRY_END_CHAR;
+        ++signature;
+        while (*signature != closing)
+        {
+            if (*signature == '\0')
+                throw std::runtime_error("Demarshaller: Unterminated container in signature.");
+            signature = end_of_complete_type(signature);
+        }
+        return signature + 1;
+    }
+    case '\0':
+        throw std::runtime_error("Demarshaller: Incomplete type in signature.");
+    default:
+        alignment_of(*signature);
+        return signature + 1;
+    }
+}
+}
+
+void Demarshaller::skip(const types::Signature& signature)
+{
+    skip(signature.as_string().c_str());
+}
+
+void Demarshaller::skip(const char* signature)
+{
+    while (*signature != '\0')
+        signature = skip_complete_type(signature);
+}
+
+const char* Demarshaller::skip_complete_type(const char* signature)
+{
+    switch (*signature)
+    {
+    case DBUS_TYPE_BYTE:
+        pop_byte();
+        return signature + 1;
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+        pop_uint16();
+        return signature + 1;
+    case DBUS_TYPE_BOOLEAN:
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+    case DBUS_TYPE_UNIX_FD:
+        pop_uint32();
+        return signature + 1;
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+    case DBUS_TYPE_DOUBLE:
+        pop_uint64();
+        return signature + 1;
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+        pop_string();
+        return signature + 1;
+    case DBUS_TYPE_SIGNATURE:
+        pop_signature();
+        return signature + 1;
+    case DBUS_TYPE_VARIANT:
+        pop_variant();
+        return signature + 1;
+    case DBUS_TYPE_ARRAY:
+    {
+        // Arrays are skipped as a whole, without looking at their elements.
+        auto array = open_array(alignment_of(signature[1]));
+        offset_ = array.end;
+        return end_of_complete_type(signature + 1);
+    }
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+    {
+        const char closing = *signature == DBUS_STRUCT_BEGIN_CHAR ? DBUS_STRUCT_END_CHAR : DBUS_DICT_ENTRY_END_CHAR;
+        align(8);
+        ++signature;
+        while (*signature != closing)
+        {
+            if (*signature == '\0')
+                throw std::runtime_error("Demarshaller: Unterminated container in signature.");
+            signature = skip_complete_type(signature);
+        }
+        return signature + 1;
+    }
+    default:
+        throw std::runtime_error(std::string{"Demarshaller: Invalid type code in signature: "} + *signature);
+    }
+}
+
+Body Body::from_message(const Message::Ptr& msg)
+{
+    if (!msg)
+        throw std::runtime_error("Precondition violated, cannot access body of null message.");
+
+    auto raw = msg->d->dbus_message.get();
+
+    char* marshalled = nullptr;
+    int length = 0;
+
+    if (!dbus_message_marshal(raw, &marshalled, &length))
+        throw std::runtime_error("Problem marshalling message.");
+
+    std::shared_ptr<const std::uint8_t> storage
+    {
+        reinterpret_cast<const std::uint8_t*>(marshalled),
+        [](const std::uint8_t* p) { dbus_free(const_cast<std::uint8_t*>(p)); }
+    };
+
+    // libdbus only converts messages to host byte order once their contents are iterated.
+    const bool swapped = marshalled[0] != host_byte_order;
+
+    std::uint32_t body_length;
+    std::memcpy(&body_length, marshalled + body_length_offset, sizeof(body_length));
+    if (swapped)
+        body_length = swapped_byte_order(body_length);
+
+    // The body makes up the end of the message.
+    auto begin = storage.get() + (static_cast<std::size_t>(length) - body_length);
+    return Body{storage, begin, body_length, types::Signature{dbus_message_get_signature(raw)}, swapped};
+}
+
+Body::Body(const std::shared_ptr<const std::uint8_t>& storage,
+           const std::uint8_t* data,
+           std::size_t size,
+           const types::Signature& signature,
+           bool swapped)
+    : storage(storage),
+      data_(data),
+      size_(size),
+      signature_(signature),
+      swapped(swapped)
+{
+}
+}
+}
+}
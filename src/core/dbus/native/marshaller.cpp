@@ -0,0 +1,148 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/marshaller.h>
+
+#include <core/dbus/error.h>
+
+#include "../message_p.h"
+
+#include <dbus/dbus.h>
+
+namespace core
+{
+namespace dbus
+{
+namespace native
+{
+namespace
+{
+// We marshal in host byte order.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+const std::uint8_t host_byte_order = DBUS_LITTLE_ENDIAN;
+#else
+const std::uint8_t host_byte_order = DBUS_BIG_ENDIAN;
+#endif
+}
+
+Marshaller::Marshaller(std::size_t capacity)
+    : buffer(new std::uint8_t[std::max<std::size_t>(capacity, 8)]),
+      size_(0),
+      capacity(std::max<std::size_t>(capacity, 8))
+{
+}
+
+void Marshaller::reserve(std::size_t new_capacity)
+{
+    if (new_capacity <= capacity)
+        return;
+
+    std::unique_ptr<std::uint8_t[]> new_buffer(new std::uint8_t[new_capacity]);
+    std::memcpy(new_buffer.get(), buffer.get(), size_);
+
+    buffer = std::move(new_buffer);
+    capacity = new_capacity;
+}
+
+Message::Ptr Marshaller::make_message(const Message::Ptr& prototype, const types::Signature& signature) const
+{
+    if (!prototype)
+        throw std::runtime_error("Precondition violated, cannot create message from null prototype.");
+
+    auto raw = prototype->d->dbus_message.get();
+
+    std::uint8_t flags = 0;
+    if (dbus_message_get_no_reply(raw))
+        flags |= DBUS_HEADER_FLAG_NO_REPLY_EXPECTED;
+    if (!dbus_message_get_auto_start(raw))
+        flags |= DBUS_HEADER_FLAG_NO_AUTO_START;
+#if defined(DBUS_HEADER_FLAG_ALLOW_INTERACTIVE_AUTHORIZATION)
+    if (dbus_message_get_allow_interactive_authorization(raw))
+        flags |= DBUS_HEADER_FLAG_ALLOW_INTERACTIVE_AUTHORIZATION;
+#endif
+
+    // The header is followed by the body, which starts 8-byte aligned.
+    Marshaller out{256 + size_};
+
+    out.push_byte(host_byte_order);
+    out.push_byte(dbus_message_get_type(raw));
+    out.push_byte(flags);
+    out.push_byte(DBUS_MAJOR_PROTOCOL_VERSION);
+    out.push_uint32(size_);
+    // libdbus refuses to load messages without a serial, we reset it below.
+    out.push_uint32(1);
+
+    auto fields = out.open_array(8);
+    {
+        auto push_string_field = [&out](std::uint8_t code, const char* type, const char* value)
+        {
+            if (!value)
+                return;
+
+            out.open_structure();
+            out.push_byte(code);
+            out.write(static_cast<std::uint8_t>(1));
+            out.write(type, 2);
+            out.push_stringn(value, std::strlen(value));
+        };
+
+        push_string_field(DBUS_HEADER_FIELD_PATH, DBUS_TYPE_OBJECT_PATH_AS_STRING, dbus_message_get_path(raw));
+        push_string_field(DBUS_HEADER_FIELD_INTERFACE, DBUS_TYPE_STRING_AS_STRING, dbus_message_get_interface(raw));
+        push_string_field(DBUS_HEADER_FIELD_MEMBER, DBUS_TYPE_STRING_AS_STRING, dbus_message_get_member(raw));
+        push_string_field(DBUS_HEADER_FIELD_ERROR_NAME, DBUS_TYPE_STRING_AS_STRING, dbus_message_get_error_name(raw));
+        push_string_field(DBUS_HEADER_FIELD_DESTINATION, DBUS_TYPE_STRING_AS_STRING, dbus_message_get_destination(raw));
+        push_string_field(DBUS_HEADER_FIELD_SENDER, DBUS_TYPE_STRING_AS_STRING, dbus_message_get_sender(raw));
+
+        auto reply_serial = dbus_message_get_reply_serial(raw);
+        if (reply_serial != 0)
+        {
+            out.open_structure();
+            out.push_byte(DBUS_HEADER_FIELD_REPLY_SERIAL);
+            out.open_variant(types::Signature{DBUS_TYPE_UINT32_AS_STRING});
+            out.push_uint32(reply_serial);
+        }
+
+        if (!signature.as_string().empty())
+        {
+            out.open_structure();
+            out.push_byte(DBUS_HEADER_FIELD_SIGNATURE);
+            out.open_variant(types::Signature{DBUS_TYPE_SIGNATURE_AS_STRING});
+            out.push_signature(signature);
+        }
+    }
+    out.close_array(fields);
+
+    out.align(8);
+    out.write(reinterpret_cast<const char*>(buffer.get()), size_);
+
+    Error error;
+    auto msg = dbus_message_demarshal(
+                reinterpret_cast<const char*>(out.data()),
+                static_cast<int>(out.size()),
+                std::addressof(error.raw()));
+
+    if (!msg)
+        throw std::runtime_error(error.print());
+
+    dbus_message_set_serial(msg, 0);
+
+    return Message::wrap(std::unique_ptr<Message::Private>(new Message::Private(msg)));
+}
+}
+}
+}
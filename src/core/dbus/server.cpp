@@ -0,0 +1,238 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/server.h>
+
+#include <core/dbus/error.h>
+
+#include <dbus/dbus.h>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+namespace core
+{
+namespace dbus
+{
+struct Server::Private
+{
+    static dbus_bool_t on_add_watch(DBusWatch* watch, void* data)
+    {
+        auto thiz = static_cast<Private*>(data);
+        {
+            std::lock_guard<std::mutex> lg(thiz->guard);
+            thiz->watches.push_back(watch);
+        }
+        thiz->wake_up();
+        return TRUE;
+    }
+
+    static void on_remove_watch(DBusWatch* watch, void* data)
+    {
+        auto thiz = static_cast<Private*>(data);
+        {
+            std::lock_guard<std::mutex> lg(thiz->guard);
+            thiz->watches.erase(
+                        std::remove(thiz->watches.begin(), thiz->watches.end(), watch),
+                        thiz->watches.end());
+        }
+        thiz->wake_up();
+    }
+
+    static void on_watch_toggled(DBusWatch*, void* data)
+    {
+        static_cast<Private*>(data)->wake_up();
+    }
+
+    static void on_new_connection(DBusServer*, DBusConnection* connection, void* data)
+    {
+        auto thiz = static_cast<Private*>(data);
+
+        // The connection is dropped by libdbus unless we keep a reference.
+        dbus_connection_ref(connection);
+        Bus::Ptr bus{new Bus{connection}};
+
+        if (thiz->handler)
+            thiz->handler(bus);
+    }
+
+    void wake_up()
+    {
+        static const char c{'w'};
+        while (::write(wakeup[1], &c, 1) < 0 && errno == EINTR);
+    }
+
+    DBusServer* server{nullptr};
+    int wakeup[2];
+    std::atomic<bool> stopped{false};
+    ConnectionHandler handler;
+
+    std::mutex guard;
+    std::vector<DBusWatch*> watches;
+};
+
+const std::string& Server::default_address()
+{
+    static const std::string s{"unix:tmpdir=/tmp"};
+    return s;
+}
+
+Server::Server(const std::string& address) : d(new Private())
+{
+    dbus_threads_init_default();
+
+    if (::pipe2(d->wakeup, O_CLOEXEC | O_NONBLOCK) < 0)
+        throw std::system_error(errno, std::system_category(), "Could not create wakeup pipe");
+
+    Error error;
+    d->server = dbus_server_listen(address.c_str(), std::addressof(error.raw()));
+
+    if (!d->server)
+    {
+        ::close(d->wakeup[0]);
+        ::close(d->wakeup[1]);
+        throw std::runtime_error(error.print());
+    }
+
+    dbus_server_set_new_connection_function(d->server, Private::on_new_connection, d.get(), nullptr);
+
+    if (!dbus_server_set_watch_functions(
+                d->server,
+                Private::on_add_watch,
+                Private::on_remove_watch,
+                Private::on_watch_toggled,
+                d.get(),
+                nullptr))
+    {
+        dbus_server_disconnect(d->server);
+        dbus_server_unref(d->server);
+        ::close(d->wakeup[0]);
+        ::close(d->wakeup[1]);
+        throw std::runtime_error("Problem installing watch functions.");
+    }
+}
+
+Server::~Server() noexcept
+{
+    dbus_server_disconnect(d->server);
+    dbus_server_set_watch_functions(d->server, nullptr, nullptr, nullptr, nullptr, nullptr);
+    dbus_server_unref(d->server);
+
+    ::close(d->wakeup[0]);
+    ::close(d->wakeup[1]);
+}
+
+std::string Server::address() const
+{
+    auto address = dbus_server_get_address(d->server);
+    std::string result{address};
+    dbus_free(address);
+    return result;
+}
+
+void Server::on_new_connection(const ConnectionHandler& handler)
+{
+    d->handler = handler;
+}
+
+void Server::run()
+{
+    d->stopped = false;
+
+    std::vector<pollfd> fds;
+    std::vector<DBusWatch*> watches;
+
+    while (!d->stopped)
+    {
+        fds.clear();
+        watches.clear();
+
+        fds.push_back(pollfd{d->wakeup[0], POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lg(d->guard);
+            for (auto watch : d->watches)
+            {
+                if (!dbus_watch_get_enabled(watch))
+                    continue;
+
+                auto flags = dbus_watch_get_flags(watch);
+                short events = 0;
+                if (flags & DBUS_WATCH_READABLE)
+                    events |= POLLIN;
+                if (flags & DBUS_WATCH_WRITABLE)
+                    events |= POLLOUT;
+
+                fds.push_back(pollfd{dbus_watch_get_unix_fd(watch), events, 0});
+                watches.push_back(watch);
+            }
+        }
+
+        if (::poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::system_category(), "Could not poll for connections");
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            char buffer[64];
+            while (::read(d->wakeup[0], buffer, sizeof(buffer)) > 0);
+        }
+
+        for (std::size_t i = 1; i < fds.size(); i++)
+        {
+            if (fds[i].revents == 0)
+                continue;
+
+            // The watch might have been removed while we were waiting.
+            {
+                std::lock_guard<std::mutex> lg(d->guard);
+                if (std::find(d->watches.begin(), d->watches.end(), watches[i-1]) == d->watches.end())
+                    continue;
+            }
+
+            unsigned int flags = 0;
+            if (fds[i].revents & POLLIN)
+                flags |= DBUS_WATCH_READABLE;
+            if (fds[i].revents & POLLOUT)
+                flags |= DBUS_WATCH_WRITABLE;
+            if (fds[i].revents & POLLERR)
+                flags |= DBUS_WATCH_ERROR;
+            if (fds[i].revents & POLLHUP)
+                flags |= DBUS_WATCH_HANGUP;
+
+            dbus_watch_handle(watches[i-1], flags);
+        }
+    }
+}
+
+void Server::stop()
+{
+    d->stopped = true;
+    d->wake_up();
+}
+}
+}
@@ -95,24 +95,11 @@ Service::Service(const Bus::Ptr& connection, const std::string& name, const Bus:
       name(name),
       stub(false)
 {
-    Error error;
-    auto rc = dbus_bus_request_name(
-                connection->raw(),
-                name.c_str(),
-                static_cast<unsigned int>(flags),
-                std::addressof(error.raw()));
-
-    if (error)
-        throw std::runtime_error(error.name() + ": " + error.message());
-
-    switch (rc)
-    {
-    case DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER: break;
-    case DBUS_REQUEST_NAME_REPLY_IN_QUEUE: break;
-    case DBUS_REQUEST_NAME_REPLY_EXISTS: throw Bus::Errors::AlreadyOwned{}; break;
-    case DBUS_REQUEST_NAME_REPLY_ALREADY_OWNER: throw Bus::Errors::AlreadyOwner{}; break;
-    case -1: throw std::runtime_error(error.print());
-    }
+    // Peers talk to each other directly, there is no daemon to acquire names from.
+    if (connection->is_peer_to_peer())
+        return;
+
+    connection->request_name_on_bus(name, flags);
 }
 
 const std::shared_ptr<Object>& Service::root_object()
@@ -135,5 +122,14 @@ std::shared_ptr<Object> Service::add_object_for_path(const types::ObjectPath& pa
 
     return object;
 }
+
+std::shared_ptr<Object> Service::add_subtree(const types::ObjectPath& prefix, const Bus::SubtreeResolver& resolver)
+{
+    auto object = std::shared_ptr<Object>(new Object(shared_from_this(), prefix));
+
+    connection->register_subtree_for_path(prefix, object, resolver);
+
+    return object;
+}
 }
 }
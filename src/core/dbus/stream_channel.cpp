@@ -0,0 +1,398 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/stream_channel.h>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+constexpr std::uint32_t magic = 0x43445343; // "CSDC"
+constexpr std::uint32_t version = 1;
+
+// Marks the unused tail of the ring, the next record starts at offset 0.
+constexpr std::uint32_t wrap_marker = 0xFFFFFFFF;
+
+constexpr std::size_t length_size = sizeof(std::uint32_t);
+constexpr std::size_t alignment = 8;
+
+// Laid out at the very beginning of the shared memory, followed by the records.
+// Producer and consumer state live on separate cache lines to avoid false sharing.
+struct Header
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t capacity;
+
+    // Monotonically increasing byte offsets, only ever advanced by the producer and consumer, respectively.
+    alignas(64) std::atomic<std::uint64_t> head;
+    alignas(64) std::atomic<std::uint64_t> tail;
+
+    // Set by a consumer about to wait for the eventfd, cleared by whoever signals it.
+    alignas(64) std::atomic<std::uint32_t> consumer_waiting;
+    // Set by a producer that ran out of space, cleared by the consumer reporting it.
+    std::atomic<std::uint32_t> producer_waiting;
+};
+
+static_assert(sizeof(Header) % alignment == 0, "Records have to start aligned.");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "Atomics shared between processes have to be lock free.");
+
+constexpr std::size_t padded_size_of_record(std::size_t size)
+{
+    return (length_size + size + alignment - 1) & ~(alignment - 1);
+}
+
+void throw_system_error(const char* what)
+{
+    throw std::system_error(errno, std::system_category(), what);
+}
+
+void throw_corrupted()
+{
+    throw std::runtime_error("StreamChannel: Ring has been corrupted.");
+}
+}
+
+namespace core
+{
+namespace dbus
+{
+struct StreamChannel::Private
+{
+    Private(int memory, int notification) : memory(memory), notification(notification)
+    {
+    }
+
+    ~Private()
+    {
+        if (mapping)
+            ::munmap(mapping, mapping_size);
+
+        ::close(memory);
+        ::close(notification);
+    }
+
+    void map(std::size_t size)
+    {
+        auto result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+        if (result == MAP_FAILED)
+            throw_system_error("StreamChannel: Mapping ring");
+
+        mapping = result;
+        mapping_size = size;
+        header = static_cast<Header*>(mapping);
+        records = static_cast<std::uint8_t*>(mapping) + sizeof(Header);
+    }
+
+    void signal_consumer()
+    {
+        std::uint64_t value = 1;
+        // The counter saturating is fine, the consumer is woken up in any case.
+        while (::write(notification, &value, sizeof(value)) == -1 && errno == EINTR);
+    }
+
+    void drain_notification()
+    {
+        std::uint64_t value;
+        while (::read(notification, &value, sizeof(value)) == -1 && errno == EINTR);
+    }
+
+    int memory;
+    int notification;
+
+    void* mapping = nullptr;
+    std::size_t mapping_size = 0;
+
+    Header* header = nullptr;
+    std::uint8_t* records = nullptr;
+    // Read once, the peer is not trusted to keep it unchanged.
+    std::uint64_t capacity = 0;
+};
+
+StreamChannel::Ptr StreamChannel::create(std::size_t capacity)
+{
+    if (capacity < 2 * alignment || capacity % alignment != 0)
+        throw std::runtime_error("StreamChannel: Capacity has to be a multiple of 8 and at least 16.");
+
+    int memory = ::memfd_create("core-dbus-stream-channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memory == -1)
+        throw_system_error("StreamChannel: Creating memfd");
+
+    int notification = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (notification == -1)
+    {
+        auto error = errno;
+        ::close(memory);
+        errno = error;
+        throw_system_error("StreamChannel: Creating eventfd");
+    }
+
+    std::unique_ptr<Private> d{new Private{memory, notification}};
+
+    const std::size_t size = sizeof(Header) + capacity;
+    if (::ftruncate(memory, size) == -1)
+        throw_system_error("StreamChannel: Resizing memfd");
+
+    // Neither side may pull the memory from under the other one's mapping.
+    if (::fcntl(memory, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1)
+        throw_system_error("StreamChannel: Sealing memfd");
+
+    d->map(size);
+
+    auto header = new (d->mapping) Header;
+    header->magic = magic;
+    header->version = version;
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    // Nobody has read yet, the first record has to wake up the consumer.
+    header->consumer_waiting.store(1, std::memory_order_relaxed);
+    header->producer_waiting.store(0, std::memory_order_relaxed);
+
+    d->capacity = capacity;
+
+    return Ptr{new StreamChannel{std::move(d)}};
+}
+
+StreamChannel::Ptr StreamChannel::attach(const types::UnixFd& memory, const types::UnixFd& notification)
+{
+    if (memory.to_int() < 0 || notification.to_int() < 0)
+    {
+        if (memory.to_int() >= 0)
+            ::close(memory.to_int());
+        if (notification.to_int() >= 0)
+            ::close(notification.to_int());
+
+        throw std::runtime_error("StreamChannel: Invalid fd.");
+    }
+
+    std::unique_ptr<Private> d{new Private{memory.to_int(), notification.to_int()}};
+
+    auto seals = ::fcntl(d->memory, F_GET_SEALS);
+    if (seals == -1 || (seals & F_SEAL_SHRINK) == 0)
+        throw std::runtime_error("StreamChannel: fd does not refer to a sealed memfd.");
+
+    struct stat st;
+    if (::fstat(d->memory, &st) == -1)
+        throw_system_error("StreamChannel: Querying size of memfd");
+
+    const std::size_t size = st.st_size;
+    if (size < sizeof(Header) + 2 * alignment)
+        throw std::runtime_error("StreamChannel: fd does not refer to a channel.");
+
+    d->map(size);
+
+    auto capacity = d->header->capacity;
+    if (d->header->magic != magic
+            || d->header->version != version
+            || capacity < 2 * alignment
+            || capacity % alignment != 0
+            || capacity > size - sizeof(Header))
+        throw std::runtime_error("StreamChannel: fd does not refer to a channel.");
+
+    d->capacity = capacity;
+
+    return Ptr{new StreamChannel{std::move(d)}};
+}
+
+StreamChannel::StreamChannel(std::unique_ptr<Private> d) : d(std::move(d))
+{
+}
+
+StreamChannel::~StreamChannel() noexcept
+{
+}
+
+types::UnixFd StreamChannel::memory() const
+{
+    return types::UnixFd{d->memory};
+}
+
+types::UnixFd StreamChannel::notification() const
+{
+    return types::UnixFd{d->notification};
+}
+
+std::size_t StreamChannel::capacity() const
+{
+    return d->capacity;
+}
+
+bool StreamChannel::try_write(const void* data, std::size_t size)
+{
+    const auto padded = padded_size_of_record(size);
+    // Guarantees that a record fits into an empty ring, no matter where the ring wraps.
+    if (padded > d->capacity / 2)
+        throw std::runtime_error("StreamChannel: Record exceeds half of the capacity.");
+
+    auto header = d->header;
+    auto head = header->head.load(std::memory_order_relaxed);
+    auto tail = header->tail.load(std::memory_order_acquire);
+
+    auto offset = head % d->capacity;
+    auto contiguous = d->capacity - offset;
+    auto required = padded <= contiguous ? padded : contiguous + padded;
+
+    if (d->capacity - (head - tail) < required)
+    {
+        // Pairs with the fence in take_resume_request: Either the consumer sees the
+        // request, or we see the space it has made in the meantime.
+        header->producer_waiting.store(1, std::memory_order_seq_cst);
+        tail = header->tail.load(std::memory_order_seq_cst);
+
+        if (d->capacity - (head - tail) < required)
+            return false;
+
+        // The space has been made before the consumer saw our request, withdraw it.
+        header->producer_waiting.store(0, std::memory_order_relaxed);
+    }
+
+    if (padded > contiguous)
+    {
+        std::memcpy(d->records + offset, &wrap_marker, length_size);
+        head += contiguous;
+        offset = 0;
+    }
+
+    const std::uint32_t length = size;
+    std::memcpy(d->records + offset, &length, length_size);
+    std::memcpy(d->records + offset + length_size, data, size);
+
+    header->head.store(head + padded, std::memory_order_release);
+
+    // Pairs with the consumer announcing that it waits and checking head afterwards.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header->consumer_waiting.load(std::memory_order_relaxed) != 0
+            && header->consumer_waiting.exchange(0) != 0)
+        d->signal_consumer();
+
+    return true;
+}
+
+std::size_t StreamChannel::read(const RecordHandler& handler, std::size_t max_records)
+{
+    auto header = d->header;
+    auto tail = header->tail.load(std::memory_order_relaxed);
+    auto head = header->head.load(std::memory_order_acquire);
+
+    if (head - tail > d->capacity)
+        throw_corrupted();
+
+    std::size_t count = 0;
+    while (count < max_records && tail != head)
+    {
+        auto offset = tail % d->capacity;
+        auto contiguous = d->capacity - offset;
+
+        std::uint32_t length;
+        std::memcpy(&length, d->records + offset, length_size);
+
+        if (length == wrap_marker)
+        {
+            if (contiguous > head - tail)
+                throw_corrupted();
+
+            tail += contiguous;
+            header->tail.store(tail, std::memory_order_release);
+            continue;
+        }
+
+        auto padded = padded_size_of_record(length);
+        if (padded > contiguous || padded > head - tail)
+            throw_corrupted();
+
+        handler(d->records + offset + length_size, length);
+
+        tail += padded;
+        header->tail.store(tail, std::memory_order_release);
+        count++;
+    }
+
+    return count;
+}
+
+bool StreamChannel::take_resume_request()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    auto header = d->header;
+    return header->producer_waiting.load(std::memory_order_relaxed) != 0
+            && header->producer_waiting.exchange(0) != 0;
+}
+
+std::shared_ptr<void> StreamChannel::read_on(
+        const Bus::Ptr& bus,
+        const RecordHandler& handler,
+        const std::function<void()>& on_resume)
+{
+    std::weak_ptr<StreamChannel> wp{shared_from_this()};
+
+    auto watch = bus->watch_readable(d->notification, [wp, handler, on_resume]()
+    {
+        auto sp = wp.lock();
+        if (!sp)
+            return;
+
+        sp->d->drain_notification();
+
+        auto header = sp->d->header;
+        while (true)
+        {
+            sp->read(handler);
+
+            if (on_resume && sp->take_resume_request())
+                on_resume();
+
+            // Announce that we are about to wait and check whether a record slipped
+            // in. If the producer has taken the announcement, it signals the eventfd.
+            header->consumer_waiting.store(1, std::memory_order_seq_cst);
+            if (header->head.load(std::memory_order_seq_cst) == header->tail.load(std::memory_order_relaxed))
+                break;
+            if (header->consumer_waiting.exchange(0) == 0)
+                break;
+        }
+    });
+
+    // The channel has to outlive monitoring its eventfd.
+    struct Handle
+    {
+        ~Handle()
+        {
+            watch.reset();
+        }
+
+        Ptr channel;
+        std::shared_ptr<void> watch;
+    };
+
+    return std::make_shared<Handle>(Handle{shared_from_this(), watch});
+}
+}
+}
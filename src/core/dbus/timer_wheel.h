@@ -0,0 +1,352 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#ifndef CORE_DBUS_TIMER_WHEEL_H_
+#define CORE_DBUS_TIMER_WHEEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace core
+{
+namespace dbus
+{
+namespace impl
+{
+/**
+ * @brief A hashed, hierarchical timer wheel.
+ *
+ * Timers are intrusive and expire at absolute ticks. Insertion and cancellation are O(1).
+ * The wheel does not know about clocks, it is advanced explicitly by the owner, which
+ * typically drives it with a single OS timer programmed to next_event().
+ *
+ * The wheel is not synchronized, callers have to serialize access.
+ */
+class TimerWheel
+{
+public:
+    typedef std::uint64_t Tick;
+
+    static constexpr unsigned int bits_per_level = 8;
+    static constexpr unsigned int slots_per_level = 1u << bits_per_level;
+    static constexpr unsigned int level_count = 4;
+
+    /** @brief Marks the absence of any scheduled timer. */
+    static constexpr Tick never = std::numeric_limits<Tick>::max();
+
+    struct Link
+    {
+        Link* prev = this;
+        Link* next = this;
+
+        Link() = default;
+        Link(const Link&) = delete;
+        Link& operator=(const Link&) = delete;
+    };
+
+    /** @brief Base class for all timers managed by the wheel. */
+    class Timer : private Link
+    {
+    public:
+        Timer() = default;
+
+        ~Timer()
+        {
+            unlink();
+        }
+
+        /** @brief Checks whether the timer is currently scheduled. */
+        inline bool is_scheduled() const
+        {
+            return next != this;
+        }
+
+        /** @brief The absolute tick the timer expires at. */
+        inline Tick expiry() const
+        {
+            return expires_at;
+        }
+
+    private:
+        friend class TimerWheel;
+
+        inline void unlink()
+        {
+            prev->next = next;
+            next->prev = prev;
+            prev = next = this;
+        }
+
+        Tick expires_at = 0;
+        unsigned int level = 0;
+        unsigned int slot = 0;
+    };
+
+    TimerWheel(Tick start = 0) : current(start), count(0)
+    {
+        for (unsigned int l = 0; l < level_count; l++)
+            for (unsigned int w = 0; w < words_per_level; w++)
+                occupancy[l][w] = 0;
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    ~TimerWheel()
+    {
+        for (unsigned int l = 0; l < level_count; l++)
+            for (unsigned int s = 0; s < slots_per_level; s++)
+                while (slots[l][s].next != &slots[l][s])
+                    static_cast<Timer*>(slots[l][s].next)->unlink();
+    }
+
+    /** @brief The next tick that has not yet been processed by advance. */
+    inline Tick now() const
+    {
+        return current;
+    }
+
+    /** @brief The number of scheduled timers. */
+    inline std::size_t size() const
+    {
+        return count;
+    }
+
+    inline bool empty() const
+    {
+        return count == 0;
+    }
+
+    /**
+     * @brief Schedules timer to expire at tick expiry, rescheduling it if necessary.
+     *
+     * Expiries in the past are treated as expiring at now().
+     */
+    void schedule(Timer* timer, Tick expiry)
+    {
+        cancel(timer);
+
+        timer->expires_at = expiry < current ? current : expiry;
+        insert(timer);
+        count++;
+    }
+
+    /** @brief Removes the timer from the wheel if scheduled. */
+    void cancel(Timer* timer)
+    {
+        if (!timer->is_scheduled())
+            return;
+
+        remove(timer);
+        count--;
+    }
+
+    /**
+     * @brief The earliest tick at which advance has work to do, or never.
+     *
+     * The returned tick is either the exact expiry of the next timer, or a point in time
+     * at which timers with coarser granularity have to be moved to a finer-grained level.
+     * Owners should advance the wheel at the returned tick and query again.
+     */
+    Tick next_event() const
+    {
+        if (count == 0)
+            return never;
+
+        Tick result = never;
+
+        for (unsigned int l = 0; l < level_count; l++)
+        {
+            const unsigned int shift = l * bits_per_level;
+            const Tick block = current >> shift;
+            const Tick mask = (Tick(1) << shift) - 1;
+
+            // Level 0 slots are processed at every tick, higher levels only at block boundaries.
+            // A boundary that coincides with current has not been processed yet.
+            const Tick first = (current & mask) == 0 ? block : block + 1;
+
+            auto distance = distance_to_next_occupied(l, static_cast<unsigned int>(first & slot_mask));
+            if (distance == slots_per_level)
+                continue;
+
+            const Tick candidate = (first + distance) << shift;
+            if (candidate < result)
+                result = candidate;
+        }
+
+        return result;
+    }
+
+    /**
+     * @brief Processes all ticks up to and including tick t, invoking on_expired for every expired timer.
+     *
+     * Timers are removed from the wheel before on_expired is invoked. The callback may
+     * schedule and cancel timers, including those expiring in the same tick.
+     */
+    template<typename Callback>
+    void advance(Tick t, Callback on_expired)
+    {
+        while (current <= t)
+        {
+            auto next = next_event();
+
+            if (next > t)
+            {
+                current = t + 1;
+                break;
+            }
+
+            current = next;
+
+            for (unsigned int l = 1; l < level_count; l++)
+            {
+                const unsigned int shift = l * bits_per_level;
+                if ((current & ((Tick(1) << shift) - 1)) != 0)
+                    break;
+                cascade(l, static_cast<unsigned int>((current >> shift) & slot_mask));
+            }
+
+            Link expired;
+            splice(slots[0][current & slot_mask], expired);
+            clear_occupied(0, static_cast<unsigned int>(current & slot_mask));
+
+            current++;
+
+            while (expired.next != &expired)
+            {
+                auto timer = static_cast<Timer*>(expired.next);
+                timer->unlink();
+                count--;
+                on_expired(timer);
+            }
+        }
+    }
+
+private:
+    static constexpr Tick slot_mask = slots_per_level - 1;
+    static constexpr unsigned int words_per_level = slots_per_level / 64;
+
+    void insert(Timer* timer)
+    {
+        const Tick delta = timer->expires_at - current;
+
+        unsigned int l = 0;
+        while (l + 1 < level_count && delta >= (Tick(1) << ((l + 1) * bits_per_level)))
+            l++;
+
+        // Expiries beyond the range of the wheel are clamped to the last slot of the
+        // highest level and re-evaluated when cascaded.
+        Tick slot_tick = timer->expires_at;
+        const Tick range = Tick(1) << (level_count * bits_per_level);
+        if (delta >= range)
+            slot_tick = current + range - 1;
+
+        timer->level = l;
+        timer->slot = static_cast<unsigned int>((slot_tick >> (l * bits_per_level)) & slot_mask);
+
+        Link& head = slots[l][timer->slot];
+        timer->prev = head.prev;
+        timer->next = &head;
+        head.prev->next = timer;
+        head.prev = timer;
+
+        set_occupied(l, timer->slot);
+    }
+
+    void remove(Timer* timer)
+    {
+        timer->unlink();
+
+        Link& head = slots[timer->level][timer->slot];
+        if (head.next == &head)
+            clear_occupied(timer->level, timer->slot);
+    }
+
+    void cascade(unsigned int level, unsigned int slot)
+    {
+        Link pending;
+        splice(slots[level][slot], pending);
+        clear_occupied(level, slot);
+
+        while (pending.next != &pending)
+        {
+            auto timer = static_cast<Timer*>(pending.next);
+            timer->unlink();
+            insert(timer);
+        }
+    }
+
+    // Moves all elements from list from to the empty list to.
+    static void splice(Link& from, Link& to)
+    {
+        if (from.next == &from)
+            return;
+
+        to.next = from.next;
+        to.prev = from.prev;
+        to.next->prev = &to;
+        to.prev->next = &to;
+        from.next = from.prev = &from;
+    }
+
+    inline void set_occupied(unsigned int level, unsigned int slot)
+    {
+        occupancy[level][slot / 64] |= std::uint64_t(1) << (slot % 64);
+    }
+
+    inline void clear_occupied(unsigned int level, unsigned int slot)
+    {
+        occupancy[level][slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+    }
+
+    // Returns the distance from slot to the next occupied slot of the given level,
+    // wrapping around, or slots_per_level if the level is empty.
+    unsigned int distance_to_next_occupied(unsigned int level, unsigned int slot) const
+    {
+        for (unsigned int i = 0; i <= words_per_level; i++)
+        {
+            const unsigned int word = ((slot / 64) + i) % words_per_level;
+            std::uint64_t bits = occupancy[level][word];
+
+            // Mask out slots before the start in the first word, but allow them
+            // when wrapping around to the same word again at the end.
+            if (i == 0)
+                bits &= ~std::uint64_t(0) << (slot % 64);
+            else if (i == words_per_level)
+                bits &= (std::uint64_t(1) << (slot % 64)) - 1;
+
+            if (bits != 0)
+            {
+                const unsigned int found = word * 64 + static_cast<unsigned int>(__builtin_ctzll(bits));
+                return (found + slots_per_level - slot) % slots_per_level;
+            }
+        }
+
+        return slots_per_level;
+    }
+
+    Tick current;
+    std::size_t count;
+    Link slots[level_count][slots_per_level];
+    std::uint64_t occupancy[level_count][words_per_level];
+};
+}
+}
+}
+
+#endif // CORE_DBUS_TIMER_WHEEL_H_
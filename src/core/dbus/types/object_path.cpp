@@ -18,11 +18,14 @@
 
 #include <core/dbus/types/object_path.h>
 
-#include <core/dbus/error.h>
-
-#include <dbus/dbus.h>
+#include <core/dbus/validation.h>
 
+#include <atomic>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 
 namespace core
 {
@@ -30,6 +33,174 @@ namespace dbus
 {
 namespace types
 {
+namespace detail
+{
+struct ObjectPathAtom
+{
+    std::string path;
+    std::size_t hash;
+    std::uint64_t id;
+    // Holds a reference, nullptr for the root path.
+    const ObjectPathAtom* parent;
+    std::size_t depth;
+    // Transitions from and to 0 only happen with the guard of the respective shard held.
+    mutable std::atomic<std::size_t> references;
+};
+}
+
+namespace
+{
+typedef detail::ObjectPathAtom Atom;
+
+// Refers to the string representation of a path, either of an atom or of a path being looked up.
+struct Key
+{
+    const std::string* path;
+    std::size_t hash;
+};
+
+struct KeyHash
+{
+    std::size_t operator()(const Key& key) const
+    {
+        return key.hash;
+    }
+};
+
+struct KeyEqual
+{
+    bool operator()(const Key& lhs, const Key& rhs) const
+    {
+        return lhs.hash == rhs.hash && *lhs.path == *rhs.path;
+    }
+};
+
+// The table of interned paths, split into shards to reduce contention between threads.
+class Table
+{
+public:
+    static Table& instance()
+    {
+        // Never destroyed, instances with static storage duration may outlive the table otherwise.
+        static Table* table = new Table();
+        return *table;
+    }
+
+    // Returns the atom for path with a reference added, validates path if it has not been interned before.
+    const Atom* intern(const std::string& path, bool validate)
+    {
+        if (path == ObjectPath::root())
+            return root();
+
+        const Key key{&path, std::hash<std::string>{}(path)};
+        auto& shard = shard_for(key.hash);
+
+        {
+            std::lock_guard<std::mutex> lg(shard.guard);
+            auto it = shard.atoms.find(key);
+            if (it != shard.atoms.end())
+            {
+                it->second->references.fetch_add(1, std::memory_order_relaxed);
+                return it->second;
+            }
+        }
+
+        if (validate && !validation::is_valid_object_path(path))
+            throw ObjectPath::Errors::InvalidObjectPathStringRepresentation{path};
+
+        // Interning the parent might end up in the same shard, thus happens without holding its guard.
+        auto separator = path.rfind('/');
+        const Atom* parent = intern(separator == 0 ? ObjectPath::root() : path.substr(0, separator), false);
+
+        const Atom* result = nullptr;
+        {
+            std::lock_guard<std::mutex> lg(shard.guard);
+            auto it = shard.atoms.find(key);
+            if (it != shard.atoms.end())
+            {
+                // Another thread has been faster.
+                it->second->references.fetch_add(1, std::memory_order_relaxed);
+                result = it->second;
+            }
+            else
+            {
+                auto atom = new Atom{path, key.hash, next_id++, parent, parent->depth + 1, {1}};
+                shard.atoms.insert(std::make_pair(Key{&atom->path, atom->hash}, atom));
+                return atom;
+            }
+        }
+
+        release(parent);
+        return result;
+    }
+
+    // Returns the atom of the root path with a reference added.
+    const Atom* root()
+    {
+        acquire(root_);
+        return root_;
+    }
+
+    void acquire(const Atom* atom)
+    {
+        atom->references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void release(const Atom* atom)
+    {
+        while (atom)
+        {
+            // Dropping a reference that is not the last one does not need the guard.
+            auto references = atom->references.load(std::memory_order_relaxed);
+            while (references > 1)
+                if (atom->references.compare_exchange_weak(references, references - 1, std::memory_order_release, std::memory_order_relaxed))
+                    return;
+
+            auto& shard = shard_for(atom->hash);
+            {
+                std::lock_guard<std::mutex> lg(shard.guard);
+                if (atom->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                    return;
+
+                shard.atoms.erase(Key{&atom->path, atom->hash});
+            }
+
+            auto parent = atom->parent;
+            delete atom;
+            atom = parent;
+        }
+    }
+
+private:
+    static constexpr std::size_t shard_count = 16;
+
+    struct Shard
+    {
+        std::mutex guard;
+        std::unordered_map<Key, const Atom*, KeyHash, KeyEqual> atoms;
+    };
+
+    Table() : next_id{0}
+    {
+        const std::string path{"/"};
+        const Key key{&path, std::hash<std::string>{}(path)};
+
+        // The root atom is never released.
+        root_ = new Atom{path, key.hash, next_id++, nullptr, 0, {1}};
+        shard_for(key.hash).atoms.insert(std::make_pair(Key{&root_->path, root_->hash}, root_));
+    }
+
+    Shard& shard_for(std::size_t hash)
+    {
+        return shards[hash % shard_count];
+    }
+
+    Shard shards[shard_count];
+    std::atomic<std::uint64_t> next_id;
+    const Atom* root_;
+};
+}
+
 const std::string& ObjectPath::root()
 {
     static const std::string s{"/"};
@@ -40,36 +211,108 @@ const std::string& ObjectPath::root()
 // However, this is spurious and
 //   http://stackoverflow.com/questions/10750299/if-i-specify-a-default-value-for-an-argument-of-type-stdstring-in-c-cou
 // gives some insight.
-ObjectPath::ObjectPath(const std::string& path) : path(path)
+ObjectPath::ObjectPath(const std::string& path) : atom(Table::instance().intern(path, true))
+{
+}
+
+ObjectPath::ObjectPath(const detail::ObjectPathAtom* atom) : atom(atom)
+{
+    Table::instance().acquire(atom);
+}
+
+ObjectPath::ObjectPath(const ObjectPath& rhs) noexcept : atom(rhs.atom)
+{
+    Table::instance().acquire(atom);
+}
+
+ObjectPath::ObjectPath(ObjectPath&& rhs) noexcept : atom(rhs.atom)
 {
-    Error e;
-    if (!dbus_validate_path(path.c_str(), std::addressof(e.raw())))
-        throw ObjectPath::Errors::InvalidObjectPathStringRepresentation{path};
+    rhs.atom = Table::instance().root();
+}
+
+ObjectPath& ObjectPath::operator=(const ObjectPath& rhs)
+{
+    if (atom != rhs.atom)
+    {
+        Table::instance().acquire(rhs.atom);
+        Table::instance().release(atom);
+        atom = rhs.atom;
+    }
+
+    return *this;
+}
+
+ObjectPath& ObjectPath::operator=(ObjectPath&& rhs) noexcept
+{
+    std::swap(atom, rhs.atom);
+    return *this;
+}
+
+ObjectPath::~ObjectPath()
+{
+    Table::instance().release(atom);
 }
 
 bool ObjectPath::empty() const
 {
-    return path.empty();
+    return atom->path.empty();
 }
 
 const std::string& ObjectPath::as_string() const
 {
-    return path;
+    return atom->path;
+}
+
+std::uint64_t ObjectPath::id() const
+{
+    return atom->id;
+}
+
+std::size_t ObjectPath::hash() const
+{
+    return atom->hash;
+}
+
+std::size_t ObjectPath::depth() const
+{
+    return atom->depth;
+}
+
+ObjectPath ObjectPath::parent() const
+{
+    return ObjectPath{atom->parent ? atom->parent : atom};
+}
+
+bool ObjectPath::is_descendant_of(const ObjectPath& ancestor) const
+{
+    return atom->depth > ancestor.atom->depth && is_in_namespace(ancestor);
+}
+
+bool ObjectPath::is_in_namespace(const ObjectPath& ns) const
+{
+    if (atom->depth < ns.atom->depth)
+        return false;
+
+    auto a = atom;
+    for (auto i = atom->depth; i > ns.atom->depth; i--)
+        a = a->parent;
+
+    return a == ns.atom;
 }
 
 bool ObjectPath::operator<(const ObjectPath& rhs) const
 {
-    return path < rhs.path;
+    return atom != rhs.atom && atom->path < rhs.atom->path;
 }
 
 bool ObjectPath::operator==(const ObjectPath& rhs) const
 {
-    return path == rhs.path;
+    return atom == rhs.atom;
 }
 
 bool ObjectPath::operator!=(const ObjectPath& rhs) const
 {
-    return path != rhs.path;
+    return atom != rhs.atom;
 }
 
 std::ostream& operator<<(std::ostream& out, const ObjectPath& path)
@@ -84,6 +327,5 @@ std::ostream& operator<<(std::ostream& out, const ObjectPath& path)
 size_t std::hash<core::dbus::types::ObjectPath>::operator()(
         const core::dbus::types::ObjectPath& p) const
 {
-    static const std::hash<std::string> h {};
-    return h(p.as_string());
+    return p.hash();
 }
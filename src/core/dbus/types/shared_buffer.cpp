@@ -0,0 +1,177 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/types/shared_buffer.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace
+{
+// Once applied, neither the sender nor anybody else can modify or shrink the
+// buffer, such that receivers can rely on their read-only mapping.
+constexpr int required_seals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+
+void throw_system_error(const char* what)
+{
+    throw std::system_error(errno, std::system_category(), what);
+}
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace types
+{
+struct SharedBuffer::Private
+{
+    Private(int fd, std::size_t size) : fd(fd), size(size)
+    {
+        if (size == 0)
+            return;
+
+        auto result = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (result == MAP_FAILED)
+        {
+            auto error = errno;
+            ::close(fd);
+            errno = error;
+            throw_system_error("SharedBuffer: Mapping buffer");
+        }
+
+        data = static_cast<const std::uint8_t*>(result);
+    }
+
+    ~Private()
+    {
+        if (data)
+            ::munmap(const_cast<std::uint8_t*>(data), size);
+        ::close(fd);
+    }
+
+    int fd;
+    std::size_t size;
+    const std::uint8_t* data = nullptr;
+};
+
+SharedBuffer SharedBuffer::create(std::size_t size, const std::function<void(std::uint8_t*)>& fill)
+{
+    int fd = ::memfd_create("core-dbus-shared-buffer", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd == -1)
+        throw_system_error("SharedBuffer: Creating memfd");
+
+    try
+    {
+        if (::ftruncate(fd, size) == -1)
+            throw_system_error("SharedBuffer: Resizing memfd");
+
+        if (size > 0)
+        {
+            // The writable mapping has to be gone before the buffer can be sealed against writes.
+            auto mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED)
+                throw_system_error("SharedBuffer: Mapping memfd for writing");
+
+            try
+            {
+                fill(static_cast<std::uint8_t*>(mapping));
+            } catch(...)
+            {
+                ::munmap(mapping, size);
+                throw;
+            }
+
+            ::munmap(mapping, size);
+        }
+
+        if (::fcntl(fd, F_ADD_SEALS, required_seals | F_SEAL_SEAL) == -1)
+            throw_system_error("SharedBuffer: Sealing memfd");
+    } catch(...)
+    {
+        ::close(fd);
+        throw;
+    }
+
+    return SharedBuffer{std::make_shared<Private>(fd, size)};
+}
+
+SharedBuffer SharedBuffer::copy_of(const void* data, std::size_t size)
+{
+    return create(size, [data, size](std::uint8_t* buffer)
+    {
+        std::memcpy(buffer, data, size);
+    });
+}
+
+SharedBuffer SharedBuffer::from_fd(const UnixFd& fd)
+{
+    if (fd.to_int() < 0)
+        throw std::runtime_error("SharedBuffer: Invalid fd.");
+
+    auto seals = ::fcntl(fd.to_int(), F_GET_SEALS);
+    if (seals == -1 || (seals & required_seals) != required_seals)
+    {
+        ::close(fd.to_int());
+        throw std::runtime_error("SharedBuffer: fd does not refer to a sealed memfd.");
+    }
+
+    struct stat st;
+    if (::fstat(fd.to_int(), &st) == -1)
+    {
+        auto error = errno;
+        ::close(fd.to_int());
+        errno = error;
+        throw_system_error("SharedBuffer: Querying size of memfd");
+    }
+
+    return SharedBuffer{std::make_shared<Private>(fd.to_int(), st.st_size)};
+}
+
+SharedBuffer::SharedBuffer(const std::shared_ptr<Private>& d) : d(d)
+{
+}
+
+bool SharedBuffer::is_valid() const
+{
+    return d != nullptr;
+}
+
+const std::uint8_t* SharedBuffer::data() const
+{
+    return d ? d->data : nullptr;
+}
+
+std::size_t SharedBuffer::size() const
+{
+    return d ? d->size : 0;
+}
+
+UnixFd SharedBuffer::fd() const
+{
+    return UnixFd{d ? d->fd : -1};
+}
+}
+}
+}
@@ -0,0 +1,848 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/uring/executor.h>
+
+#include <core/dbus/asio/executor.h>
+
+#if defined(DBUS_CPP_HAVE_IO_URING)
+
+#include <linux/io_uring.h>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+int io_uring_setup(unsigned int entries, io_uring_params* params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+// Thin wrapper around the submission and completion queues shared with the kernel.
+// Access to the submission queue has to be serialized by the caller, the completion
+// queue must only be consumed by one thread at a time.
+class Ring
+{
+public:
+    static const unsigned int default_queue_depth = 256;
+
+    Ring(unsigned int queue_depth = default_queue_depth)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        fd = io_uring_setup(queue_depth, &params);
+
+        if (fd < 0)
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+
+        // We rely on the kernel to buffer completions if we fall behind.
+        if (!(params.features & IORING_FEAT_NODROP))
+        {
+            ::close(fd);
+            throw std::system_error(ENOTSUP, std::system_category(), "io_uring lacks IORING_FEAT_NODROP");
+        }
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+        sq_ring = map(sq_ring_size, IORING_OFF_SQ_RING);
+        cq_ring = single_mmap ? sq_ring : map(cq_ring_size, IORING_OFF_CQ_RING);
+        sqes = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+
+        if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            auto error = errno;
+            release();
+            throw std::system_error(error, std::system_category(), "mmap io_uring");
+        }
+
+        auto sq = static_cast<char*>(sq_ring);
+        sq_head = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+        sq_entries = params.sq_entries;
+        auto sq_array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+
+        // We never reorder submissions, slot i of the array thus always refers to sqe i.
+        for (unsigned int i = 0; i < sq_entries; i++)
+            sq_array[i] = i;
+
+        auto cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        local_sq_tail = *sq_tail;
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    ~Ring() noexcept
+    {
+        release();
+    }
+
+    // Returns a zeroed submission entry or nullptr if the submission queue is full.
+    io_uring_sqe* next_sqe()
+    {
+        if (local_sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries)
+            return nullptr;
+
+        auto sqe = sqes + (local_sq_tail & sq_mask);
+        std::memset(sqe, 0, sizeof(*sqe));
+        local_sq_tail++;
+
+        return sqe;
+    }
+
+    // Makes all entries handed out by next_sqe visible to the kernel.
+    void publish()
+    {
+        __atomic_store_n(sq_tail, local_sq_tail, __ATOMIC_RELEASE);
+    }
+
+    unsigned int unsubmitted() const
+    {
+        return local_sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    }
+
+    // Hands over to_submit entries to the kernel and waits for at least min_complete completions.
+    int enter(unsigned int to_submit, unsigned int min_complete)
+    {
+        int rc = 0;
+
+        do
+        {
+            rc = io_uring_enter(
+                        fd,
+                        to_submit,
+                        min_complete,
+                        min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+        } while (rc < 0 && errno == EINTR && min_complete == 0);
+
+        return rc < 0 ? -errno : rc;
+    }
+
+    // Moves all available completions to the end of cqes_out.
+    void reap(std::vector<io_uring_cqe>& cqes_out)
+    {
+        unsigned int head = *cq_head;
+        unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++)
+            cqes_out.push_back(cqes[head & cq_mask]);
+
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    void* map(std::size_t size, off_t offset)
+    {
+        return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+    }
+
+    void release()
+    {
+        if (sqes && sqes != MAP_FAILED)
+            ::munmap(sqes, sqes_size);
+        if (cq_ring && cq_ring != MAP_FAILED && cq_ring != sq_ring)
+            ::munmap(cq_ring, cq_ring_size);
+        if (sq_ring && sq_ring != MAP_FAILED)
+            ::munmap(sq_ring, sq_ring_size);
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    int fd = -1;
+
+    void* sq_ring = nullptr;
+    std::size_t sq_ring_size = 0;
+    unsigned int* sq_head = nullptr;
+    unsigned int* sq_tail = nullptr;
+    unsigned int sq_mask = 0;
+    unsigned int sq_entries = 0;
+    unsigned int local_sq_tail = 0;
+
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sqes_size = 0;
+
+    void* cq_ring = nullptr;
+    std::size_t cq_ring_size = 0;
+    unsigned int* cq_head = nullptr;
+    unsigned int* cq_tail = nullptr;
+    unsigned int cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace uring
+{
+class Executor : public core::dbus::Executor, public core::dbus::FdWatcher
+{
+public:
+    // Every watch, timeout, fd monitored on behalf of Bus::watch_readable and the
+    // internal wakeup eventfd is represented by an operation.
+    // Whenever an operation is armed, it is assigned a fresh token that is passed to the kernel
+    // as user data. Completions carrying a token other than the current one are stale and only
+    // serve to release the bookkeeping for the respective request.
+    struct Operation
+    {
+        enum class Kind
+        {
+            watch,
+            timeout,
+            readable,
+            wakeup
+        };
+
+        Kind kind;
+        DBusWatch* watch = nullptr;
+        DBusTimeout* timeout = nullptr;
+        int fd = -1;
+        std::function<void()> handler;
+        std::uint64_t token = 0;
+        bool removed = false;
+        bool multishot = false;
+        __kernel_timespec interval;
+    };
+
+    template<typename T>
+    struct Holder
+    {
+        static void ptr_delete(void* p)
+        {
+            delete static_cast<Holder<T>*>(p);
+        }
+
+        Holder(const T& t) : value(t)
+        {
+        }
+
+        T value;
+    };
+
+    static dbus_bool_t on_dbus_add_watch(DBusWatch* watch, void* data)
+    {
+        auto thiz = static_cast<Executor*>(data);
+        auto op = std::make_shared<Operation>();
+        op->kind = Operation::Kind::watch;
+        op->watch = watch;
+
+        dbus_watch_set_data(
+                    watch,
+                    new Holder<std::shared_ptr<Operation>>(op),
+                    Holder<std::shared_ptr<Operation>>::ptr_delete);
+
+        if (dbus_watch_get_enabled(watch) == TRUE)
+            return thiz->guarded([thiz, op]() { thiz->arm(op); }) ? TRUE : FALSE;
+
+        return TRUE;
+    }
+
+    static void on_dbus_remove_watch(DBusWatch* watch, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<Operation>>*>(dbus_watch_get_data(watch));
+        if (!holder)
+            return;
+        auto thiz = static_cast<Executor*>(data);
+        auto op = holder->value;
+        thiz->guarded([thiz, op]() { thiz->remove(op); });
+    }
+
+    static void on_dbus_watch_toggled(DBusWatch* watch, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<Operation>>*>(dbus_watch_get_data(watch));
+        if (!holder)
+            return;
+        auto thiz = static_cast<Executor*>(data);
+        auto op = holder->value;
+        bool enabled = dbus_watch_get_enabled(watch) == TRUE;
+        thiz->guarded([thiz, op, enabled]() { thiz->rearm(op, enabled); });
+    }
+
+    static dbus_bool_t on_dbus_add_timeout(DBusTimeout* timeout, void* data)
+    {
+        auto thiz = static_cast<Executor*>(data);
+        auto op = std::make_shared<Operation>();
+        op->kind = Operation::Kind::timeout;
+        op->timeout = timeout;
+
+        dbus_timeout_set_data(
+                    timeout,
+                    new Holder<std::shared_ptr<Operation>>(op),
+                    Holder<std::shared_ptr<Operation>>::ptr_delete);
+
+        if (dbus_timeout_get_enabled(timeout) == TRUE)
+            return thiz->guarded([thiz, op]() { thiz->arm(op); }) ? TRUE : FALSE;
+
+        return TRUE;
+    }
+
+    static void on_dbus_remove_timeout(DBusTimeout* timeout, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<Operation>>*>(dbus_timeout_get_data(timeout));
+        if (!holder)
+            return;
+        auto thiz = static_cast<Executor*>(data);
+        auto op = holder->value;
+        thiz->guarded([thiz, op]() { thiz->remove(op); });
+    }
+
+    static void on_dbus_timeout_toggled(DBusTimeout* timeout, void* data)
+    {
+        auto holder = static_cast<Holder<std::shared_ptr<Operation>>*>(dbus_timeout_get_data(timeout));
+        if (!holder)
+            return;
+        auto thiz = static_cast<Executor*>(data);
+        auto op = holder->value;
+        bool enabled = dbus_timeout_get_enabled(timeout) == TRUE;
+        thiz->guarded([thiz, op, enabled]() { thiz->rearm(op, enabled); });
+    }
+
+    static void on_dbus_wakeup_event_loop(void* data)
+    {
+        static_cast<Executor*>(data)->wakeup();
+    }
+
+public:
+    Executor(const Bus::Ptr& bus)
+        : bus(bus),
+          event_fd(-1),
+          stopped(false),
+          multishot_poll(true),
+          next_token(1)
+    {
+        if (!bus)
+            throw std::runtime_error("Precondition violated, cannot construct executor for null bus.");
+
+        // All fallible steps happen before touching the connection such that a failing
+        // setup leaves the bus untouched and the caller is free to fall back.
+        ring.reset(new Ring());
+
+        event_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (event_fd < 0)
+            throw std::system_error(errno, std::system_category(), "eventfd");
+
+        try
+        {
+            // Arming the wakeup operation hands it over to the kernel, a trial run of io_uring_enter.
+            wakeup_operation = std::make_shared<Operation>();
+            wakeup_operation->kind = Operation::Kind::wakeup;
+            arm(wakeup_operation);
+        } catch(...)
+        {
+            ::close(event_fd);
+            throw;
+        }
+
+        // Natively connected buses lack a DBusConnection, their messages are delivered through watch_readable.
+        if (!bus->raw())
+            return;
+
+        auto installed =
+                dbus_connection_set_watch_functions(
+                    bus->raw(),
+                    on_dbus_add_watch,
+                    on_dbus_remove_watch,
+                    on_dbus_watch_toggled,
+                    this,
+                    nullptr) &&
+                dbus_connection_set_timeout_functions(
+                    bus->raw(),
+                    on_dbus_add_timeout,
+                    on_dbus_remove_timeout,
+                    on_dbus_timeout_toggled,
+                    this,
+                    nullptr);
+
+        if (!installed || pending_error())
+        {
+            // Hands back the watches and timeouts added so far, the bus is left without functions.
+            uninstall();
+            ::close(event_fd);
+
+            if (auto error = pending_error())
+                std::rethrow_exception(error);
+            throw std::runtime_error("Problem installing watch and timeout functions.");
+        }
+
+        dbus_connection_set_wakeup_main_function(
+                    bus->raw(),
+                    on_dbus_wakeup_event_loop,
+                    this,
+                    nullptr);
+    }
+
+    ~Executor() noexcept
+    {
+        stop();
+
+        // The bus might outlive this instance, e.g., if the executor has never been installed.
+        // Removing the functions hands back all watches and timeouts while the ring is still alive.
+        if (bus->raw())
+            uninstall();
+
+        if (event_fd >= 0)
+            ::close(event_fd);
+    }
+
+    void run()
+    {
+        // Only one thread at a time may consume the completion queue. Additional
+        // threads calling into run() queue up here and take over once the current
+        // thread returns.
+        std::lock_guard<std::mutex> lg(loop_guard);
+
+        std::vector<io_uring_cqe> completions;
+
+        while (!stopped.load())
+        {
+            // Failures within libdbus callbacks are recorded and reported here.
+            if (auto error = pending_error())
+                std::rethrow_exception(error);
+
+            dispatch();
+
+            unsigned int to_submit = 0;
+            {
+                std::lock_guard<std::mutex> lg(guard);
+                ring->publish();
+                to_submit = ring->unsubmitted();
+            }
+
+            auto rc = ring->enter(to_submit, 1);
+
+            if (rc < 0 && rc != -EINTR && rc != -EAGAIN && rc != -EBUSY)
+                throw std::system_error(-rc, std::system_category(), "io_uring_enter");
+
+            completions.clear();
+            ring->reap(completions);
+
+            // Requests issued while handling completions are batched and handed
+            // over to the kernel with the next call to io_uring_enter.
+            loop_thread_marker = this;
+            for (const auto& cqe : completions)
+                handle(cqe);
+            loop_thread_marker = nullptr;
+        }
+    }
+
+    void stop()
+    {
+        stopped.store(true);
+        wakeup();
+    }
+
+    std::shared_ptr<void> watch_readable(int fd, const std::function<void()>& handler) override
+    {
+        auto op = std::make_shared<Operation>();
+        op->kind = Operation::Kind::readable;
+        op->fd = fd;
+        op->handler = handler;
+
+        arm(op);
+
+        return std::shared_ptr<void>(op.get(), [this, op](void*) { guarded([this, op]() { remove(op); }); });
+    }
+
+private:
+    // Exceptions must not cross libdbus, failures are recorded and reported from run().
+    // Returns false if f has thrown.
+    template<typename F>
+    bool guarded(F f) noexcept
+    {
+        try
+        {
+            f();
+            return true;
+        } catch(...)
+        {
+            {
+                std::lock_guard<std::mutex> lg(error_guard);
+                if (!error)
+                    error = std::current_exception();
+            }
+            wakeup();
+            return false;
+        }
+    }
+
+    std::exception_ptr pending_error()
+    {
+        std::lock_guard<std::mutex> lg(error_guard);
+        return error;
+    }
+
+    void uninstall() noexcept
+    {
+        dbus_connection_set_wakeup_main_function(bus->raw(), nullptr, nullptr, nullptr);
+        dbus_connection_set_timeout_functions(bus->raw(), nullptr, nullptr, nullptr, nullptr, nullptr);
+        dbus_connection_set_watch_functions(bus->raw(), nullptr, nullptr, nullptr, nullptr, nullptr);
+    }
+
+    void wakeup()
+    {
+        std::uint64_t value{1};
+        // EAGAIN only happens if the counter is saturated, i.e., a wakeup is pending anyway.
+        if (::write(event_fd, &value, sizeof(value)) < 0)
+            return;
+    }
+
+    void dispatch()
+    {
+        if (!bus->raw())
+            return;
+
+        while (dbus_connection_get_dispatch_status(bus->raw()) == DBUS_DISPATCH_DATA_REMAINS)
+        {
+            dbus_connection_dispatch(bus->raw());
+        }
+    }
+
+    // Queues a request for op. Requires guard to be held.
+    void prepare_locked(const std::shared_ptr<Operation>& op)
+    {
+        auto token = next_token++;
+        auto sqe = acquire_sqe_locked();
+
+        switch (op->kind)
+        {
+        case Operation::Kind::watch:
+        case Operation::Kind::readable:
+        case Operation::Kind::wakeup:
+        {
+            int fd = op->kind == Operation::Kind::readable ? op->fd : event_fd;
+            unsigned int events = POLLIN;
+            if (op->kind == Operation::Kind::watch)
+            {
+                fd = dbus_watch_get_unix_fd(op->watch);
+                auto flags = dbus_watch_get_flags(op->watch);
+                events = 0;
+                if (flags & DBUS_WATCH_READABLE)
+                    events |= POLLIN;
+                if (flags & DBUS_WATCH_WRITABLE)
+                    events |= POLLOUT;
+            }
+            // Multishot polls only report readiness that arises after an event, but libdbus reads
+            // a bounded amount of data per call to dbus_watch_handle and handlers of other fds need
+            // not drain them. Only the wakeup eventfd is drained completely, all other polls are
+            // single-shot and re-armed after every event. Re-arming is submitted with the next
+            // call to io_uring_enter and checks for readiness anew.
+            bool multishot = multishot_poll && op->kind == Operation::Kind::wakeup;
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = fd;
+            sqe->poll32_events = events;
+            sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+            op->multishot = multishot;
+            break;
+        }
+        case Operation::Kind::timeout:
+        {
+            auto ms = dbus_timeout_get_interval(op->timeout);
+            op->interval.tv_sec = ms / 1000;
+            op->interval.tv_nsec = (ms % 1000) * 1000 * 1000;
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<std::uint64_t>(&op->interval);
+            sqe->len = 1;
+            break;
+        }
+        }
+
+        sqe->user_data = token;
+        op->token = token;
+        in_flight[token] = op;
+    }
+
+    // Queues the cancellation of the request currently associated with op. Requires guard to be held.
+    void cancel_locked(const std::shared_ptr<Operation>& op)
+    {
+        if (op->token == 0)
+            return;
+
+        auto sqe = acquire_sqe_locked();
+        sqe->opcode = op->kind == Operation::Kind::timeout ? IORING_OP_TIMEOUT_REMOVE : IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = op->token;
+        // Completions of cancellation requests carry no information we are interested in.
+        sqe->user_data = 0;
+
+        op->token = 0;
+    }
+
+    io_uring_sqe* acquire_sqe_locked()
+    {
+        auto sqe = ring->next_sqe();
+
+        while (!sqe)
+        {
+            ring->publish();
+            auto rc = ring->enter(ring->unsubmitted(), 0);
+            if (rc < 0 && rc != -EAGAIN && rc != -EBUSY)
+                throw std::system_error(-rc, std::system_category(), "io_uring_enter");
+            sqe = ring->next_sqe();
+        }
+
+        return sqe;
+    }
+
+    // Hands over queued requests to the kernel, unless we are called from within the
+    // loop, in which case submission is deferred to the next iteration. Requires guard to be held.
+    void flush_locked()
+    {
+        ring->publish();
+
+        if (loop_thread_marker == this)
+            return;
+
+        auto rc = ring->enter(ring->unsubmitted(), 0);
+        if (rc < 0 && rc != -EAGAIN && rc != -EBUSY)
+            throw std::system_error(-rc, std::system_category(), "io_uring_enter");
+    }
+
+    void arm(const std::shared_ptr<Operation>& op)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        if (op->token != 0 || op->removed)
+            return;
+        prepare_locked(op);
+        flush_locked();
+    }
+
+    void rearm(const std::shared_ptr<Operation>& op, bool enabled)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        cancel_locked(op);
+        if (enabled && !op->removed)
+            prepare_locked(op);
+        flush_locked();
+    }
+
+    void remove(const std::shared_ptr<Operation>& op)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        op->removed = true;
+        cancel_locked(op);
+        flush_locked();
+    }
+
+    void handle(const io_uring_cqe& cqe)
+    {
+        if (cqe.user_data == 0)
+            return;
+
+        std::shared_ptr<Operation> op;
+        bool is_final = !(cqe.flags & IORING_CQE_F_MORE);
+
+        {
+            std::lock_guard<std::mutex> lg(guard);
+
+            auto it = in_flight.find(cqe.user_data);
+            if (it == in_flight.end())
+                return;
+
+            op = it->second;
+
+            if (is_final)
+                in_flight.erase(it);
+
+            // The request has been cancelled or superseded in the meantime.
+            if (op->token != cqe.user_data || op->removed)
+                return;
+
+            if (is_final)
+                op->token = 0;
+
+            // Kernels without support for multishot polls reject the request, we
+            // fall back to re-arming single-shot polls after every event.
+            if (cqe.res == -EINVAL && op->multishot)
+            {
+                multishot_poll = false;
+                prepare_locked(op);
+                return;
+            }
+        }
+
+        switch (op->kind)
+        {
+        case Operation::Kind::wakeup:
+        {
+            std::uint64_t value;
+            while (::read(event_fd, &value, sizeof(value)) > 0);
+            break;
+        }
+        case Operation::Kind::watch:
+        {
+            unsigned int flags = 0;
+
+            if (cqe.res < 0)
+                flags = DBUS_WATCH_ERROR;
+            else
+            {
+                if (cqe.res & POLLIN)
+                    flags |= DBUS_WATCH_READABLE;
+                if (cqe.res & POLLOUT)
+                    flags |= DBUS_WATCH_WRITABLE;
+                if (cqe.res & POLLERR)
+                    flags |= DBUS_WATCH_ERROR;
+                if (cqe.res & POLLHUP)
+                    flags |= DBUS_WATCH_HANGUP;
+            }
+
+            if (flags != 0 && !dbus_watch_handle(op->watch, flags))
+                throw std::runtime_error("Insufficient memory while handling watch event");
+
+            break;
+        }
+        case Operation::Kind::timeout:
+            if (cqe.res == -ETIME)
+                dbus_timeout_handle(op->timeout);
+            break;
+        case Operation::Kind::readable:
+            if (cqe.res > 0)
+                op->handler();
+            break;
+        }
+
+        if (!is_final)
+            return;
+
+        // Timeouts fire periodically until disabled or removed, and a poll that
+        // terminated is re-armed as long as the watch is still of interest.
+        std::lock_guard<std::mutex> lg(guard);
+
+        if (op->token != 0 || op->removed)
+            return;
+
+        bool enabled = true;
+        if (op->kind == Operation::Kind::watch)
+            enabled = dbus_watch_get_enabled(op->watch) == TRUE && cqe.res >= 0;
+        else if (op->kind == Operation::Kind::timeout)
+            enabled = dbus_timeout_get_enabled(op->timeout) == TRUE;
+        else if (op->kind == Operation::Kind::readable)
+            enabled = cqe.res >= 0;
+
+        if (enabled)
+            prepare_locked(op);
+    }
+
+    static thread_local Executor* loop_thread_marker;
+
+    Bus::Ptr bus;
+    std::unique_ptr<Ring> ring;
+    int event_fd;
+    std::atomic<bool> stopped;
+
+    std::mutex loop_guard;
+    std::mutex guard;
+    bool multishot_poll;
+    std::uint64_t next_token;
+    std::unordered_map<std::uint64_t, std::shared_ptr<Operation>> in_flight;
+    std::shared_ptr<Operation> wakeup_operation;
+
+    std::mutex error_guard;
+    std::exception_ptr error;
+};
+
+thread_local Executor* Executor::loop_thread_marker = nullptr;
+
+bool is_supported()
+{
+    try
+    {
+        Ring ring;
+        return true;
+    } catch(const std::system_error&)
+    {
+        return false;
+    }
+}
+
+Executor::Ptr make_executor(const Bus::Ptr& bus)
+{
+    try
+    {
+        return std::make_shared<core::dbus::uring::Executor>(bus);
+    } catch(const std::system_error&)
+    {
+        // The kernel does not support io_uring or the ring cannot be created
+        // due to resource limits, we fall back to the default executor.
+        return core::dbus::asio::make_executor(bus);
+    }
+}
+}
+}
+}
+
+#else
+
+namespace core
+{
+namespace dbus
+{
+namespace uring
+{
+bool is_supported()
+{
+    return false;
+}
+
+Executor::Ptr make_executor(const Bus::Ptr& bus)
+{
+    return core::dbus::asio::make_executor(bus);
+}
+}
+}
+}
+
+#endif // DBUS_CPP_HAVE_IO_URING
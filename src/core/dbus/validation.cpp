@@ -0,0 +1,492 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/validation.h>
+
+#include <dbus/dbus.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+// The vectorized implementations are available on x86 only, AVX2 is enabled per function.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+#define CORE_DBUS_VALIDATION_HAVE_X86
+#include <immintrin.h>
+#endif
+
+namespace core
+{
+namespace dbus
+{
+namespace validation
+{
+namespace
+{
+typedef bool (*Validator)(const unsigned char* s, std::size_t size);
+
+// Returns the length of the well-formed UTF-8 sequence starting with the non-ASCII
+// byte at s[i], or 0. Mirrors libdbus: overlong encodings, surrogates and code
+// points beyond U+10FFFF are rejected.
+inline std::size_t utf8_sequence_length(const unsigned char* s, std::size_t i, std::size_t size)
+{
+    std::size_t length; std::uint32_t code_point; std::uint32_t min;
+
+    auto c = s[i];
+    if ((c & 0xE0) == 0xC0)
+    {
+        length = 2; code_point = c & 0x1F; min = 0x80;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+        length = 3; code_point = c & 0x0F; min = 0x800;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+        length = 4; code_point = c & 0x07; min = 0x10000;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (size - i < length)
+        return 0;
+
+    for (std::size_t k = 1; k < length; k++)
+    {
+        auto b = s[i + k];
+        if ((b & 0xC0) != 0x80)
+            return 0;
+        code_point = (code_point << 6) | (b & 0x3F);
+    }
+
+    if (code_point < min || code_point > 0x10FFFF || (code_point & 0xFFFFF800) == 0xD800)
+        return 0;
+
+    return length;
+}
+
+// Validates s[i, end) one byte at a time, sequences starting before end may extend beyond.
+inline bool utf8_scalar_until(const unsigned char* s, std::size_t& i, std::size_t end, std::size_t size)
+{
+    while (i < end)
+    {
+        if (s[i] == 0)
+            return false;
+
+        if (s[i] < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        auto length = utf8_sequence_length(s, i, size);
+        if (length == 0)
+            return false;
+        i += length;
+    }
+
+    return true;
+}
+
+bool utf8_scalar(const unsigned char* s, std::size_t size)
+{
+    std::size_t i = 0;
+    return utf8_scalar_until(s, i, size, size);
+}
+
+inline bool is_object_path_char(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// Checks the first and last character, returns false if nothing is left to check.
+inline bool object_path_bounds(const unsigned char* s, std::size_t size, bool& valid)
+{
+    valid = size > 0 && s[0] == '/' && (size == 1 || s[size - 1] != '/');
+    return valid && size > 1;
+}
+
+// Checks s[i, size) for invalid characters and empty elements, s[0] being '/'.
+inline bool object_path_scalar_from(const unsigned char* s, std::size_t i, std::size_t size)
+{
+    for (; i < size; i++)
+    {
+        if (s[i] == '/')
+        {
+            if (i > 0 && s[i - 1] == '/')
+                return false;
+        }
+        else if (!is_object_path_char(s[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool object_path_scalar(const unsigned char* s, std::size_t size)
+{
+    bool valid;
+    if (!object_path_bounds(s, size, valid))
+        return valid;
+
+    return object_path_scalar_from(s, 1, size);
+}
+
+#if defined(CORE_DBUS_VALIDATION_HAVE_X86)
+// ASCII runs are skipped a vector at a time, typical DBus payloads are ASCII for the most part.
+// Vectors containing non-ASCII or null bytes are inspected one byte at a time from there on.
+bool utf8_sse2(const unsigned char* s, std::size_t size)
+{
+    const auto zero = _mm_setzero_si128();
+
+    std::size_t i = 0;
+    while (size - i >= 16)
+    {
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        auto mask = static_cast<unsigned int>(_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)));
+
+        if (mask == 0)
+        {
+            i += 16;
+            continue;
+        }
+
+        auto end = i + 16;
+        i += __builtin_ctz(mask);
+        if (!utf8_scalar_until(s, i, end, size))
+            return false;
+    }
+
+    return utf8_scalar_until(s, i, size, size);
+}
+
+__attribute__((target("avx2")))
+bool utf8_avx2(const unsigned char* s, std::size_t size)
+{
+    const auto zero = _mm256_setzero_si256();
+
+    std::size_t i = 0;
+    while (size - i >= 32)
+    {
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(v) | _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)));
+
+        if (mask == 0)
+        {
+            i += 32;
+            continue;
+        }
+
+        auto end = i + 32;
+        i += __builtin_ctz(mask);
+        if (!utf8_scalar_until(s, i, end, size))
+            return false;
+    }
+
+    return utf8_sse2(s + i, size - i);
+}
+
+// Bytes >= 0x80 compare as negative and never fall into one of the ranges.
+inline __m128i object_path_chars_sse2(__m128i v, __m128i& slashes)
+{
+    auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    auto letters = _mm_and_si128(
+                _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    auto digits = _mm_and_si128(
+                _mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    auto underscores = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    slashes = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+
+    return _mm_or_si128(_mm_or_si128(letters, digits), _mm_or_si128(underscores, slashes));
+}
+
+bool object_path_sse2(const unsigned char* s, std::size_t size)
+{
+    bool valid;
+    if (!object_path_bounds(s, size, valid))
+        return valid;
+
+    if (size < 16)
+        return object_path_scalar_from(s, 1, size);
+
+    // The last vector overlaps the previous one instead of leaving a scalar tail.
+    for (std::size_t i = 0; i < size; i += 16)
+    {
+        auto offset = std::min(i, size - 16);
+        auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + offset));
+
+        __m128i slashes;
+        if (_mm_movemask_epi8(object_path_chars_sse2(v, slashes)) != 0xFFFF)
+            return false;
+
+        auto m = static_cast<unsigned int>(_mm_movemask_epi8(slashes));
+        if ((m & (m << 1)) != 0 || (offset > 0 && (m & 1) && s[offset - 1] == '/'))
+            return false;
+    }
+
+    return true;
+}
+
+__attribute__((target("avx2")))
+bool object_path_avx2(const unsigned char* s, std::size_t size)
+{
+    if (size < 32)
+        return object_path_sse2(s, size);
+
+    bool valid;
+    if (!object_path_bounds(s, size, valid))
+        return valid;
+
+    for (std::size_t i = 0; i < size; i += 32)
+    {
+        auto offset = std::min(i, size - 32);
+        auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + offset));
+
+        auto lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        auto letters = _mm256_and_si256(
+                    _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                    _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        auto digits = _mm256_and_si256(
+                    _mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                    _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        auto underscores = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        auto slashes = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+        auto chars = _mm256_or_si256(_mm256_or_si256(letters, digits), _mm256_or_si256(underscores, slashes));
+
+        if (static_cast<unsigned int>(_mm256_movemask_epi8(chars)) != 0xFFFFFFFFu)
+            return false;
+
+        auto m = static_cast<unsigned int>(_mm256_movemask_epi8(slashes));
+        if ((m & (m << 1)) != 0 || (offset > 0 && (m & 1) && s[offset - 1] == '/'))
+            return false;
+    }
+
+    return true;
+}
+#endif
+
+Isa detect_isa()
+{
+#if defined(CORE_DBUS_VALIDATION_HAVE_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return Isa::avx2;
+
+    return Isa::sse2;
+#else
+    return Isa::scalar;
+#endif
+}
+
+Validator utf8_validator(Isa isa)
+{
+    switch (isa)
+    {
+#if defined(CORE_DBUS_VALIDATION_HAVE_X86)
+    case Isa::avx2: return utf8_avx2;
+    case Isa::sse2: return utf8_sse2;
+#endif
+    default: return utf8_scalar;
+    }
+}
+
+Validator object_path_validator(Isa isa)
+{
+    switch (isa)
+    {
+#if defined(CORE_DBUS_VALIDATION_HAVE_X86)
+    case Isa::avx2: return object_path_avx2;
+    case Isa::sse2: return object_path_sse2;
+#endif
+    default: return object_path_scalar;
+    }
+}
+
+void ensure_supported_or_throw(Isa isa)
+{
+    if (!is_supported(isa))
+        throw std::runtime_error("validation: Implementation not supported by this CPU.");
+}
+
+inline bool is_basic_type_code(unsigned char c)
+{
+    switch (c)
+    {
+    case DBUS_TYPE_BYTE:
+    case DBUS_TYPE_BOOLEAN:
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+    case DBUS_TYPE_DOUBLE:
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_SIGNATURE:
+    case DBUS_TYPE_UNIX_FD:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Follows the rules of libdbus' _dbus_validate_signature_with_reason. If element is true,
+// s is validated as if preceded by an array type code and has to be a single complete type.
+bool signature_scalar(const unsigned char* s, std::size_t size, bool element)
+{
+    if (size > DBUS_MAXIMUM_SIGNATURE_LENGTH)
+        return false;
+
+    // Number of complete types within the innermost structure or dict entry.
+    unsigned char counts[DBUS_MAXIMUM_TYPE_RECURSION_DEPTH * 2 + 1];
+    // The innermost open containers, ( and { respectively.
+    unsigned char brackets[DBUS_MAXIMUM_TYPE_RECURSION_DEPTH * 2 + 1];
+    std::size_t open = 0;
+
+    unsigned int struct_depth = 0, dict_entry_depth = 0;
+    unsigned int array_depth = element ? 1 : 0;
+    unsigned int complete_types = 0;
+    unsigned char last = element ? DBUS_TYPE_ARRAY : DBUS_TYPE_INVALID;
+
+    for (std::size_t i = 0; i < size; i++)
+    {
+        auto c = s[i];
+        switch (c)
+        {
+        case DBUS_TYPE_VARIANT:
+            break;
+        case DBUS_TYPE_ARRAY:
+            if (++array_depth > DBUS_MAXIMUM_TYPE_RECURSION_DEPTH)
+                return false;
+            break;
+        case DBUS_STRUCT_BEGIN_CHAR:
+            if (++struct_depth > DBUS_MAXIMUM_TYPE_RECURSION_DEPTH)
+                return false;
+            counts[open] = 0; brackets[open] = c; open++;
+            break;
+        case DBUS_STRUCT_END_CHAR:
+            if (open == 0 || brackets[open - 1] != DBUS_STRUCT_BEGIN_CHAR || last == DBUS_STRUCT_BEGIN_CHAR)
+                return false;
+            open--; struct_depth--;
+            break;
+        case DBUS_DICT_ENTRY_BEGIN_CHAR:
+            if (last != DBUS_TYPE_ARRAY || ++dict_entry_depth > DBUS_MAXIMUM_TYPE_RECURSION_DEPTH)
+                return false;
+            counts[open] = 0; brackets[open] = c; open++;
+            break;
+        case DBUS_DICT_ENTRY_END_CHAR:
+            if (open == 0 || brackets[open - 1] != DBUS_DICT_ENTRY_BEGIN_CHAR || counts[open - 1] != 2)
+                return false;
+            open--; dict_entry_depth--;
+            break;
+        default:
+            if (!is_basic_type_code(c))
+                return false;
+            break;
+        }
+
+        // A complete type has ended, counting towards the enclosing container.
+        if (c != DBUS_TYPE_ARRAY && c != DBUS_STRUCT_BEGIN_CHAR && c != DBUS_DICT_ENTRY_BEGIN_CHAR)
+        {
+            if (open > 0)
+                counts[open - 1]++;
+            else
+                complete_types++;
+
+            array_depth = 0;
+        }
+        else if (c == DBUS_TYPE_ARRAY && i + 1 < size &&
+                 (s[i + 1] == DBUS_STRUCT_END_CHAR || s[i + 1] == DBUS_DICT_ENTRY_END_CHAR))
+        {
+            return false;
+        }
+
+        if (last == DBUS_DICT_ENTRY_BEGIN_CHAR && !is_basic_type_code(c))
+            return false;
+
+        last = c;
+    }
+
+    return array_depth == 0 && open == 0 && (!element || complete_types == 1);
+}
+}
+
+bool is_supported(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::scalar:
+        return true;
+    case Isa::sse2:
+        return best_isa() != Isa::scalar;
+    case Isa::avx2:
+        return best_isa() == Isa::avx2;
+    }
+
+    return false;
+}
+
+Isa best_isa()
+{
+    static const Isa isa = detect_isa();
+    return isa;
+}
+
+bool is_valid_utf8(const char* s, std::size_t size)
+{
+    static const Validator validator = utf8_validator(best_isa());
+    return validator(reinterpret_cast<const unsigned char*>(s), size);
+}
+
+bool is_valid_object_path(const char* s, std::size_t size)
+{
+    static const Validator validator = object_path_validator(best_isa());
+    return validator(reinterpret_cast<const unsigned char*>(s), size);
+}
+
+bool is_valid_signature(const char* s, std::size_t size)
+{
+    return signature_scalar(reinterpret_cast<const unsigned char*>(s), size, false);
+}
+
+bool is_valid_element_signature(const char* s, std::size_t size)
+{
+    return signature_scalar(reinterpret_cast<const unsigned char*>(s), size, true);
+}
+
+bool is_valid_utf8(Isa isa, const char* s, std::size_t size)
+{
+    ensure_supported_or_throw(isa);
+    return utf8_validator(isa)(reinterpret_cast<const unsigned char*>(s), size);
+}
+
+bool is_valid_object_path(Isa isa, const char* s, std::size_t size)
+{
+    ensure_supported_or_throw(isa);
+    return object_path_validator(isa)(reinterpret_cast<const unsigned char*>(s), size);
+}
+}
+}
+}
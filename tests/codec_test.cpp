@@ -27,8 +27,10 @@
 #include <core/dbus/types/struct.h>
 #include <core/dbus/types/unix_fd.h>
 #include <core/dbus/types/variant.h>
+#include <core/dbus/types/variant_dict.h>
 
 // STL includes
+#include <core/dbus/types/stl/array.h>
 #include <core/dbus/types/stl/list.h>
 #include <core/dbus/types/stl/map.h>
 #include <core/dbus/types/stl/string.h>
@@ -38,9 +40,31 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <new>
+#include <thread>
 
 namespace dbus = core::dbus;
 
+namespace reflected
+{
+struct Position
+{
+    double latitude;
+    double longitude;
+    std::string label;
+};
+
+struct Fix
+{
+    Position position;
+    std::vector<std::uint32_t> satellites;
+    bool valid;
+};
+}
+
+DBUS_CPP_STRUCT_DEF(reflected::Position, latitude, longitude, label)
+DBUS_CPP_STRUCT_DEF(reflected::Fix, position, satellites, valid)
+
 TEST(Codec, BasicTypesMatchSizeAndAlignOfDBusTypes)
 {
     ::testing::StaticAssertTypeEq<dbus_bool_t, typename core::dbus::helper::DBusTypeMapper<core::dbus::ArgumentType::boolean>::Type>();
@@ -237,6 +261,227 @@ TEST(Codec, DecodingAMessageOfBasicTypesYieldsCorrectValues)
     EXPECT_TRUE(check_value(reader, default_double));
 }
 
+TEST(Codec, TryDecodeMessageReportsErrorsByValue)
+{
+    namespace dbus = core::dbus;
+    auto msg = a_method_call();
+    msg->writer() << std::string{"answer"} << std::vector<std::int32_t>{4, 2};
+
+    std::string s; std::vector<std::int32_t> v; std::uint32_t u;
+    EXPECT_EQ(dbus::DecodeError::none, dbus::try_decode_message(msg, s, v));
+    EXPECT_EQ("answer", s);
+    EXPECT_EQ((std::vector<std::int32_t>{4, 2}), v);
+
+    // Trailing arguments are ignored.
+    EXPECT_EQ(dbus::DecodeError::none, dbus::try_decode_message(msg, s));
+
+    EXPECT_EQ(dbus::DecodeError::signature_mismatch, dbus::try_decode_message(msg, u));
+    EXPECT_EQ(dbus::DecodeError::signature_mismatch, dbus::try_decode_message(msg, s, u));
+    EXPECT_EQ(dbus::DecodeError::signature_mismatch, dbus::try_decode_message(msg, s, v, u));
+
+    std::array<std::int32_t, 3> a;
+    EXPECT_EQ(dbus::DecodeError::invalid_argument, dbus::try_decode_message(msg, s, a));
+}
+
+TEST(Codec, TrustedDecodingYieldsCorrectValues)
+{
+    namespace dbus = core::dbus;
+    auto msg = a_method_call();
+    msg->writer()
+            << std::int64_t{42}
+            << std::vector<std::string>{"a", "b"}
+            << std::map<std::string, dbus::types::Variant>{{"answer", dbus::types::Variant::encode(std::int32_t{42})}}
+            << std::make_tuple(std::uint32_t{7}, 3.14);
+
+    std::int64_t i; std::vector<std::string> v; std::map<std::string, dbus::types::Variant> m;
+    std::tuple<std::uint32_t, double> t;
+    msg->reader() >> i >> v >> m >> t;
+
+    EXPECT_EQ(42, i);
+    EXPECT_EQ((std::vector<std::string>{"a", "b"}), v);
+    EXPECT_EQ(42, m.at("answer").as<std::int32_t>());
+    EXPECT_EQ(std::make_tuple(std::uint32_t{7}, 3.14), t);
+
+    // The contents of variants are checked in any case.
+    EXPECT_ANY_THROW(m.at("answer").as<std::string>());
+
+    // Decoding falls back to checking every value once the position has been left.
+    auto reader = msg->reader();
+    reader.pop_int64();
+    v.clear();
+    reader >> v;
+    EXPECT_EQ((std::vector<std::string>{"a", "b"}), v);
+}
+
+TEST(Codec, TrustedDecodingThrowsForMismatchingSignatures)
+{
+    namespace dbus = core::dbus;
+    auto msg = a_method_call();
+    msg->writer() << std::int64_t{42} << std::vector<std::int32_t>{4, 2};
+
+    std::string s; std::vector<std::string> v;
+    EXPECT_ANY_THROW(msg->reader() >> s);
+
+    auto reader = msg->reader();
+    std::int64_t i;
+    reader >> i;
+    EXPECT_ANY_THROW(reader >> v);
+
+    std::array<std::int32_t, 3> a;
+    reader = msg->reader();
+    reader >> i;
+    EXPECT_ANY_THROW(reader >> a);
+}
+
+namespace unmapped
+{
+// Has a Codec, but no TypeMapper specialization.
+struct Celsius
+{
+    double value;
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+template<>
+struct Codec<unmapped::Celsius>
+{
+    static void encode_argument(Message::Writer& out, const unmapped::Celsius& arg)
+    {
+        out.push_floating_point(arg.value);
+    }
+
+    static void decode_argument(Message::Reader& in, unmapped::Celsius& out)
+    {
+        out.value = in.pop_floating_point();
+    }
+};
+}
+}
+
+TEST(Codec, ContainersOfUnmappedElementsAreDecodedChecked)
+{
+    namespace dbus = core::dbus;
+    static_assert(!dbus::helper::IsMapped<std::vector<unmapped::Celsius>>::value, "");
+    static_assert(!dbus::helper::IsMapped<std::map<std::string, unmapped::Celsius>>::value, "");
+    static_assert(!dbus::helper::IsMapped<std::tuple<std::int32_t, unmapped::Celsius>>::value, "");
+    static_assert(dbus::helper::IsMapped<std::map<std::string, std::vector<double>>>::value, "");
+
+    auto msg = a_method_call();
+    auto writer = msg->writer();
+    auto array = writer.open_array(dbus::types::Signature{DBUS_TYPE_DOUBLE_AS_STRING});
+    array.push_floating_point(21.5);
+    array.push_floating_point(-3.);
+    writer.close_array(std::move(array));
+
+    std::vector<unmapped::Celsius> v;
+    msg->reader() >> v;
+    ASSERT_EQ(2u, v.size());
+    EXPECT_EQ(21.5, v[0].value);
+    EXPECT_EQ(-3., v[1].value);
+}
+
+namespace mismatched
+{
+// Maps to a double, but its codec decodes an integer.
+struct Celsius
+{
+    std::int32_t value;
+};
+
+// Maps to an integer, but its codec runs out of memory decoding it.
+struct Exhausting
+{
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace helper
+{
+template<>
+struct TypeMapper<mismatched::Celsius> : public TypeMapper<double>
+{
+};
+}
+
+template<>
+struct Codec<mismatched::Celsius>
+{
+    static void encode_argument(Message::Writer& out, const mismatched::Celsius& arg)
+    {
+        out.push_int32(arg.value);
+    }
+
+    static void decode_argument(Message::Reader& in, mismatched::Celsius& out)
+    {
+        out.value = in.pop_int32();
+    }
+};
+
+namespace helper
+{
+template<>
+struct TypeMapper<mismatched::Exhausting> : public TypeMapper<std::int32_t>
+{
+};
+}
+
+template<>
+struct Codec<mismatched::Exhausting>
+{
+    static void encode_argument(Message::Writer& out, const mismatched::Exhausting&)
+    {
+        out.push_int32(0);
+    }
+
+    static void decode_argument(Message::Reader& in, mismatched::Exhausting&)
+    {
+        in.pop_int32();
+        throw std::bad_alloc{};
+    }
+};
+}
+}
+
+TEST(Codec, UserCodecsAreDecodedCheckedUnlessOptedIn)
+{
+    namespace dbus = core::dbus;
+    static_assert(dbus::detail::DecodesTrusted<std::vector<std::string>>::value, "");
+    static_assert(dbus::detail::DecodesTrusted<std::map<std::string, dbus::types::Variant>>::value, "");
+    static_assert(dbus::detail::DecodesTrusted<reflected::Fix>::value, "");
+    static_assert(!dbus::detail::DecodesTrusted<std::vector<mismatched::Celsius>>::value, "");
+
+    auto msg = a_method_call();
+    msg->writer() << std::vector<double>{21.5};
+
+    std::vector<mismatched::Celsius> v;
+    EXPECT_ANY_THROW(msg->reader() >> v);
+}
+
+TEST(Codec, TryDecodingPropagatesResourceFailures)
+{
+    namespace dbus = core::dbus;
+    auto msg = a_method_call();
+    msg->writer() << std::int32_t{42} << dbus::types::Variant::encode(std::int32_t{42});
+
+    dbus::types::Variant variant;
+    {
+        auto reader = msg->reader();
+        reader.pop();
+        dbus::decode_argument(reader, variant);
+    }
+
+    mismatched::Exhausting e;
+    EXPECT_THROW(dbus::try_decode_message(msg, e), std::bad_alloc);
+    EXPECT_THROW(variant.try_as(e), std::bad_alloc);
+}
+
 TEST(ObjectPath, TypeMapperSpecializationReturnsCorrectValues)
 {
     namespace dbus = core::dbus;
@@ -328,6 +573,160 @@ TEST(Variant, EncodingAndDecodingWorksCorrectly)
     ASSERT_EQ(expected_value, my_struct);
 }
 
+TEST(Variant, DefaultConstructedVariantDecodesBasicTypesRightAway)
+{
+    namespace dbus = core::dbus;
+
+    auto msg = a_method_call();
+    {
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, dbus::types::Variant::encode<std::string>("a string"));
+        dbus::encode_argument(writer, dbus::types::Variant::encode<std::int32_t>(42));
+    }
+
+    auto reader = msg->reader();
+    dbus::types::Variant s, i;
+    dbus::decode_argument(reader, s);
+    dbus::decode_argument(reader, i);
+
+    EXPECT_EQ("s", s.signature().as_string());
+    EXPECT_EQ("i", i.signature().as_string());
+
+    EXPECT_EQ("a string", s.as<std::string>());
+    EXPECT_EQ("a string", s.as<std::string>());
+    EXPECT_EQ(42, i.as<std::int32_t>());
+    EXPECT_ANY_THROW(i.as<std::string>());
+
+    auto copy = s;
+    s = dbus::types::Variant::encode<std::uint32_t>(1);
+    EXPECT_EQ("a string", copy.as<std::string>());
+
+    // Decoded variants can be passed on.
+    auto forwarded = a_method_call();
+    {
+        auto writer = forwarded->writer();
+        dbus::encode_argument(writer, copy);
+    }
+    dbus::types::TypedVariant<std::string> typed;
+    auto forwarded_reader = forwarded->reader();
+    dbus::decode_argument(forwarded_reader, typed);
+    EXPECT_EQ("a string", typed.get());
+}
+
+TEST(Variant, ContainersAreDecodedOnFirstAccessAndCached)
+{
+    namespace dbus = core::dbus;
+
+    const std::vector<std::int32_t> expected{1, 2, 3};
+    auto msg = a_method_call();
+    {
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, dbus::types::Variant::encode(expected));
+        dbus::encode_argument(writer, std::uint32_t(42));
+    }
+
+    auto reader = msg->reader();
+    dbus::types::Variant variant;
+    dbus::decode_argument(reader, variant);
+    // Decoding has skipped the whole variant.
+    EXPECT_EQ(42u, dbus::decode_argument<std::uint32_t>(reader));
+
+    auto copy = variant;
+    EXPECT_ANY_THROW(variant.as<std::int32_t>());
+    EXPECT_EQ(expected, variant.as<std::vector<std::int32_t>>());
+    EXPECT_EQ(expected, variant.as<std::vector<std::int32_t>>());
+    EXPECT_EQ(expected, copy.as<std::vector<std::int32_t>>());
+    EXPECT_ANY_THROW(variant.as<std::int32_t>());
+}
+
+TEST(Variant, PendingValuesCanBeAccessedConcurrently)
+{
+    namespace dbus = core::dbus;
+
+    const std::vector<std::int32_t> expected{1, 2, 3};
+    auto msg = a_method_call();
+    {
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, dbus::types::Variant::encode(expected));
+    }
+
+    for (unsigned int i = 0; i < 100; i++)
+    {
+        auto reader = msg->reader();
+        dbus::types::Variant variant;
+        dbus::decode_argument(reader, variant);
+
+        std::vector<std::thread> threads;
+        for (unsigned int j = 0; j < 4; j++)
+            threads.emplace_back([&variant, &expected, j]()
+            {
+                EXPECT_EQ("ai", variant.signature().as_string());
+                if (j % 2)
+                    EXPECT_EQ(expected, dbus::types::Variant(variant).as<std::vector<std::int32_t>>());
+                else
+                    EXPECT_EQ(expected, variant.as<std::vector<std::int32_t>>());
+            });
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+}
+
+TEST(Variant, ValuesAreConvertedToTypesOfTheSameSignature)
+{
+    namespace dbus = core::dbus;
+
+    auto msg = a_method_call();
+    {
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, dbus::types::Variant::encode(0.5));
+    }
+
+    auto reader = msg->reader();
+    dbus::types::Variant variant;
+    dbus::decode_argument(reader, variant);
+
+    EXPECT_EQ(0.5f, variant.as<float>());
+    EXPECT_EQ(0.5, variant.as<double>());
+}
+
+TEST(Variant, CopiesOfTypedVariantsOwnTheirValue)
+{
+    namespace dbus = core::dbus;
+
+    dbus::types::TypedVariant<std::string> a{"a"};
+    auto b = a;
+    b.set("a string exceeding the small buffer of std::string");
+
+    EXPECT_EQ("a", a.get());
+    EXPECT_EQ("a string exceeding the small buffer of std::string", b.get());
+    EXPECT_EQ("a", a.as<std::string>());
+}
+
+TEST(Variant, TryAsReportsErrorsByValue)
+{
+    namespace dbus = core::dbus;
+    auto msg = a_method_call();
+    msg->writer() << dbus::types::Variant::encode(std::uint32_t(42))
+                  << dbus::types::Variant::encode(std::vector<std::int32_t>{4, 2});
+
+    dbus::types::Variant basic, container;
+    msg->reader() >> basic >> container;
+
+    std::uint32_t u = 0; std::string s; std::vector<std::int32_t> v; std::vector<std::string> strings;
+    EXPECT_EQ(dbus::DecodeError::none, basic.try_as(u));
+    EXPECT_EQ(42u, u);
+    EXPECT_EQ(dbus::DecodeError::signature_mismatch, basic.try_as(s));
+
+    // Containers are inspected without decoding them.
+    EXPECT_EQ("ai", container.signature().as_string());
+    EXPECT_EQ(dbus::DecodeError::signature_mismatch, container.try_as(strings));
+    EXPECT_EQ(dbus::DecodeError::none, container.try_as(v));
+    EXPECT_EQ((std::vector<std::int32_t>{4, 2}), v);
+
+    EXPECT_EQ(dbus::DecodeError::signature_mismatch, dbus::types::Variant{}.try_as(u));
+}
+
 TEST(Signature, TypeMapperSpecializationReturnsCorrectValues)
 {
     namespace dbus = core::dbus;
@@ -354,6 +753,52 @@ TEST(Signature, EncodingAndDecodingWorksCorrectly)
     ASSERT_EQ(expected_value, signature);
 }
 
+TEST(Struct, RegisteredStructsMapToDBusStructures)
+{
+    namespace dbus = core::dbus;
+    ASSERT_EQ(dbus::ArgumentType::structure, dbus::helper::TypeMapper<reflected::Position>::type_value());
+    ASSERT_FALSE(dbus::helper::TypeMapper<reflected::Position>::is_basic_type());
+    ASSERT_FALSE(dbus::helper::TypeMapper<reflected::Position>::requires_signature());
+    ASSERT_EQ("(dds)", dbus::helper::TypeMapper<reflected::Position>::signature());
+    ASSERT_EQ("((dds)aub)", dbus::helper::TypeMapper<reflected::Fix>::signature());
+}
+
+TEST(Struct, RegisteredStructsAreEncodedAndDecodedFieldByField)
+{
+    namespace dbus = core::dbus;
+    reflected::Fix expected_value;
+    expected_value.position = reflected::Position{52.5, 13.4, "Berlin"};
+    expected_value.satellites = {3, 7, 12};
+    expected_value.valid = true;
+
+    auto msg = a_method_call();
+    msg->writer() << expected_value << dbus::types::Variant::encode(expected_value.position);
+
+    ASSERT_EQ("((dds)aub)v", msg->signature());
+
+    reflected::Fix fix; dbus::types::Variant variant;
+    msg->reader() >> fix >> variant;
+
+    EXPECT_EQ(expected_value.position.latitude, fix.position.latitude);
+    EXPECT_EQ(expected_value.position.longitude, fix.position.longitude);
+    EXPECT_EQ(expected_value.position.label, fix.position.label);
+    EXPECT_EQ(expected_value.satellites, fix.satellites);
+    EXPECT_EQ(expected_value.valid, fix.valid);
+    EXPECT_EQ(expected_value.position.label, variant.as<reflected::Position>().label);
+
+    // Wire-compatible with structures described by tuples.
+    typedef dbus::types::Struct<std::tuple<double, double, std::string>> Tuple;
+    auto reader = msg->reader();
+    auto outer = reader.pop_structure();
+    auto position = dbus::decode_argument<Tuple>(outer);
+    EXPECT_EQ(expected_value.position.label, std::get<2>(position.value));
+
+    auto other = a_method_call();
+    other->writer() << std::uint32_t(42);
+    auto other_reader = other->reader();
+    EXPECT_ANY_THROW(other_reader >> fix);
+}
+
 TEST(Properties, DictionaryMappingToVariantsIsEncodedCorrectly)
 {
     namespace dbus = core::dbus;
@@ -430,3 +875,97 @@ TEST(Properties, DictionaryMappingToVariantsIsEncodedCorrectlyWithMap)
     EXPECT_EQ(std::uint32_t(4), map.at("key4").as<std::uint32_t>());
     EXPECT_EQ(std::uint32_t(5), map.at("key5").as<std::uint32_t>());
 }
+
+TEST(Properties, DictionaryMappingToVariantsIsDecodedLazily)
+{
+    namespace dbus = core::dbus;
+
+    auto msg = a_method_call();
+    {
+        std::map<std::string, dbus::types::Variant> map;
+
+        map["key1"] = dbus::types::Variant::encode<std::uint32_t>(1);
+        map["key2"] = dbus::types::Variant::encode<std::string>("value");
+        map["key3"] = dbus::types::Variant::encode(std::vector<std::int32_t>{1, 2, 3});
+
+        msg->writer() << map << std::uint32_t(42);
+    }
+
+    auto reader = msg->reader();
+    dbus::types::VariantDict dict;
+    std::uint32_t trailer;
+    reader >> dict >> trailer;
+    EXPECT_EQ(42u, trailer);
+
+    // The dictionary keeps the message alive.
+    msg.reset();
+
+    auto copy = dict;
+    ASSERT_EQ(3u, dict.size());
+    EXPECT_STREQ("key1", dict.key(0));
+    EXPECT_STREQ("key3", copy.key(2));
+
+    EXPECT_TRUE(dict.contains("key2"));
+    EXPECT_FALSE(dict.contains("key4"));
+    EXPECT_THROW(dict.at("key4"), std::out_of_range);
+
+    EXPECT_EQ("value", dict.get<std::string>("key2"));
+    EXPECT_EQ((std::vector<std::int32_t>{1, 2, 3}), dict.get<std::vector<std::int32_t>>("key3"));
+    EXPECT_EQ((std::vector<std::int32_t>{1, 2, 3}), copy.get<std::vector<std::int32_t>>("key3"));
+    EXPECT_EQ(std::uint32_t(1), copy.value(0).as<std::uint32_t>());
+}
+
+TEST(Properties, DictionaryKeysOutliveDecodingAllValues)
+{
+    namespace dbus = core::dbus;
+
+    auto msg = a_method_call();
+    msg->writer() << std::map<std::string, dbus::types::Variant>
+    {
+        {"key1", dbus::types::Variant::encode<std::uint32_t>(1)},
+        {"key2", dbus::types::Variant::encode<std::string>("value")}
+    };
+
+    dbus::types::VariantDict dict;
+    {
+        auto reader = msg->reader();
+        reader >> dict;
+    }
+
+    std::weak_ptr<dbus::Message> weak{msg};
+    msg.reset();
+
+    EXPECT_EQ(std::uint32_t(1), dict.value(0).as<std::uint32_t>());
+    EXPECT_EQ("value", dict.value(1).as<std::string>());
+    EXPECT_FALSE(weak.expired());
+
+    // Messages created now must not reuse the memory the keys point into.
+    for (int i = 0; i < 10; i++)
+        a_method_call()->writer() << std::string(64, 'x');
+
+    EXPECT_STREQ("key1", dict.key(0));
+    EXPECT_STREQ("key2", dict.key(1));
+}
+
+TEST(Properties, DictionaryNotMappingToVariantsThrowsOnAccess)
+{
+    namespace dbus = core::dbus;
+
+    auto msg = a_method_call();
+    {
+        std::map<std::string, std::uint32_t> map{{"key1", 1}};
+        msg->writer() << map;
+    }
+
+    auto reader = msg->reader();
+    dbus::types::VariantDict dict;
+    reader >> dict;
+
+    ASSERT_EQ(1u, dict.size());
+    EXPECT_ANY_THROW(dict.value(0));
+
+    auto other = a_method_call();
+    other->writer() << std::uint32_t(42);
+    auto other_reader = other->reader();
+    EXPECT_ANY_THROW(other_reader >> dict);
+}
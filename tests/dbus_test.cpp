@@ -31,6 +31,8 @@
 
 #include <gtest/gtest.h>
 
+#include <thread>
+
 namespace dbus = core::dbus;
 
 namespace
@@ -130,3 +132,26 @@ TEST_F(DBus, QueryingUnixProcessIdReturnsCorrectResult)
     EXPECT_EQ(core::posix::exit::Status::success,
               service_result.detail.if_exited.status);
 }
+
+TEST_F(DBus, ListingNamesStreamsNamesToVisitorUntilItReturnsFalse)
+{
+    auto bus = session_bus();
+    bus->install_executor(core::dbus::asio::make_executor(bus));
+    std::thread t{[bus]() { bus->run(); }};
+
+    dbus::DBus daemon{bus};
+    auto names = daemon.list_names();
+
+    std::vector<std::string> visited;
+    EXPECT_EQ(names.size(), daemon.list_names([&visited](const std::string& name)
+    {
+        visited.push_back(name);
+        return true;
+    }));
+    EXPECT_EQ(names.size(), visited.size());
+
+    EXPECT_EQ(1u, daemon.list_names([](const std::string&) { return false; }));
+
+    bus->stop();
+    t.join();
+}
@@ -17,6 +17,7 @@
  */
 
 #include <core/dbus/asio/executor.h>
+#include <core/dbus/uring/executor.h>
 
 #include <core/dbus/dbus.h>
 #include <core/dbus/fixture.h>
@@ -33,7 +34,13 @@
 #include <boost/asio.hpp>
 #include <gtest/gtest.h>
 
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <functional>
 #include <random>
+#include <stdexcept>
 
 namespace dbus = core::dbus;
 
@@ -61,6 +68,44 @@ struct Executor : public core::dbus::testing::Fixture
     boost::asio::io_service io_service;
 };
 
+// Creates an executor for a bus, the cases below run for every implementation.
+typedef std::function<core::dbus::Executor::Ptr(const core::dbus::Bus::Ptr&, boost::asio::io_service&)> ExecutorFactory;
+
+struct Executors : public Executor, public ::testing::WithParamInterface<ExecutorFactory>
+{
+ protected:
+    core::dbus::Executor::Ptr make_executor(const core::dbus::Bus::Ptr& bus)
+    {
+        return GetParam()(bus, io_service);
+    }
+};
+
+// Only executors created by core::dbus::asio::make_executor report dispatch statistics.
+bool is_asio_executor(const core::dbus::Executor::Ptr& executor)
+{
+    try
+    {
+        core::dbus::asio::dispatch_statistics(executor);
+        return true;
+    } catch(const std::runtime_error&)
+    {
+        return false;
+    }
+}
+
+core::dbus::Executor::Ptr make_uring_executor(const core::dbus::Bus::Ptr& bus, boost::asio::io_service&)
+{
+    auto executor = core::dbus::uring::make_executor(bus);
+
+    // Where io_uring is available, the cases have to exercise it rather than the fallback.
+    if (core::dbus::uring::is_supported())
+    {
+        EXPECT_FALSE(is_asio_executor(executor));
+    }
+
+    return executor;
+}
+
 auto session_bus_config_file =
         core::dbus::testing::Fixture::default_session_bus_config_file() =
         core::testing::session_bus_configuration_file();
@@ -70,18 +115,146 @@ auto system_bus_config_file =
         core::testing::system_bus_configuration_file();
 }
 
-TEST_F(Executor, ThrowsOnConstructionFromNullBus)
+TEST_P(Executors, ThrowsOnConstructionFromNullBus)
+{
+    EXPECT_ANY_THROW(make_executor(core::dbus::Bus::Ptr{}));
+}
+
+TEST_P(Executors, DoesNotThrowForExistingBus)
 {
-    EXPECT_ANY_THROW(core::dbus::asio::make_executor(core::dbus::Bus::Ptr{}, io_service));
+    auto bus = session_bus();
+    EXPECT_NO_THROW(bus->install_executor(make_executor(bus)));
 }
 
-TEST_F(Executor, DoesNotThrowForExistingBus)
+TEST_F(Executor, UringIsUsedIfSupportedAndFallsBackGracefullyOtherwise)
 {
+    // Independent of kernel support, we always end up with a functional executor.
     auto bus = session_bus();
-    EXPECT_NO_THROW(bus->install_executor(core::dbus::asio::make_executor(bus, io_service)));
+    auto executor = core::dbus::uring::make_executor(bus);
+    ASSERT_NE(nullptr, executor);
+    EXPECT_EQ(!core::dbus::uring::is_supported(), is_asio_executor(executor));
 }
 
-TEST_F(Executor, ABusRunByAnExecutorReceivesSignals)
+TEST_F(Executor, DispatchBudgetYieldsWithoutLosingMessages)
+{
+    static const unsigned int signal_count = 1000;
+
+    dbus::asio::DispatchBudget budget;
+    budget.max_messages = 10;
+
+    auto service_bus = session_bus();
+    service_bus->install_executor(dbus::asio::make_executor(service_bus, io_service));
+    auto service = dbus::Service::add_service<test::Service>(service_bus);
+    auto skeleton = service->add_object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+
+    auto bus = session_bus();
+    auto executor = dbus::asio::make_executor(bus, io_service, budget);
+    bus->install_executor(executor);
+    auto stub_service = dbus::Service::use_service(bus, dbus::traits::Service<test::Service>::interface_name());
+    auto stub = stub_service->object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+    auto signal = stub->get_signal<test::Service::Signals::Dummy>();
+
+    std::atomic<unsigned int> received{0};
+    signal->connect([this, &received](const int64_t&)
+    {
+        if (++received == signal_count)
+            io_service.stop();
+    });
+
+    // We queue up a burst of messages before the client starts processing them.
+    for (unsigned int i = 0; i < signal_count; i++)
+        skeleton->emit_signal<test::Service::Signals::Dummy, int64_t>(i);
+    dbus_connection_flush(service_bus->raw());
+
+    boost::asio::deadline_timer guard(io_service);
+    guard.expires_from_now(boost::posix_time::seconds(10));
+    guard.async_wait([this](const boost::system::error_code& ec)
+    {
+        if (!ec)
+            io_service.stop();
+    });
+
+    std::thread worker([this]() { io_service.run(); });
+
+    if (worker.joinable())
+        worker.join();
+
+    EXPECT_EQ(signal_count, received.load());
+
+    auto statistics = dbus::asio::dispatch_statistics(executor);
+    EXPECT_GE(statistics.messages_dispatched, signal_count);
+    EXPECT_GT(statistics.budget_exhaustions, 0u);
+}
+
+TEST_F(Executor, DispatchStatisticsThrowForForeignExecutor)
+{
+    EXPECT_ANY_THROW(dbus::asio::dispatch_statistics(dbus::Executor::Ptr{}));
+}
+
+TEST_F(Executor, ThrowsOnConstructionWithoutThreads)
+{
+    dbus::asio::ExecutorOptions options;
+    options.thread_count = 0;
+
+    EXPECT_ANY_THROW(dbus::asio::make_executor(session_bus(), options));
+}
+
+TEST_F(Executor, DedicatedExecutorsApplyThreadOptionsAndStopIndependently)
+{
+    dbus::asio::ExecutorOptions service_options;
+    service_options.thread_count = 2;
+    service_options.thread_name = "dbus-cpp-service-dispatch";
+    service_options.cpu_affinity = {0};
+
+    auto service_bus = session_bus();
+    service_bus->install_executor(dbus::asio::make_executor(service_bus, service_options));
+    auto service = dbus::Service::add_service(service_bus, dbus::traits::Service<test::Service>::interface_name());
+    auto skeleton = service->add_object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+
+    std::atomic<int> cpu{-1};
+    std::string thread_name;
+    skeleton->install_method_handler<test::Service::Method>([service_bus, &cpu, &thread_name](const dbus::Message::Ptr& msg)
+    {
+        char name[16] = {0};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        thread_name = name;
+        cpu = sched_getcpu();
+
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << int64_t(42);
+        service_bus->send(reply);
+    });
+    std::thread service_worker{[service_bus]() { service_bus->run(); }};
+
+    auto stopped_bus = session_bus();
+    stopped_bus->install_executor(dbus::asio::make_executor(stopped_bus, dbus::asio::ExecutorOptions{}));
+    std::thread stopped_worker{[stopped_bus]() { stopped_bus->run(); }};
+
+    auto bus = session_bus();
+    bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+    std::thread worker{[bus]() { bus->run(); }};
+
+    // Stopping one bus must not affect any of the others.
+    stopped_bus->stop();
+    stopped_worker.join();
+
+    auto stub_service = dbus::Service::use_service(bus, dbus::traits::Service<test::Service>::interface_name());
+    auto stub = stub_service->object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+    auto result = stub->transact_method<test::Service::Method, int64_t>();
+
+    EXPECT_FALSE(result.is_error());
+    EXPECT_EQ(42, result.value());
+    EXPECT_EQ("dbus-cpp-servic", thread_name);
+    EXPECT_EQ(0, cpu.load());
+
+    bus->stop();
+    service_bus->stop();
+
+    worker.join();
+    service_worker.join();
+}
+
+TEST_P(Executors, ABusRunByAnExecutorReceivesSignals)
 {
     core::testing::CrossProcessSync cross_process_sync;
     
@@ -90,7 +263,7 @@ TEST_F(Executor, ABusRunByAnExecutorReceivesSignals)
     {
         core::testing::SigTermCatcher sc;
         auto bus = session_bus();
-        bus->install_executor(dbus::asio::make_executor(bus, io_service));
+        bus->install_executor(make_executor(bus));
         auto service = dbus::Service::add_service<test::Service>(bus);
         auto skeleton = service->add_object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
         skeleton->install_method_handler<test::Service::Method>(
@@ -119,7 +292,7 @@ TEST_F(Executor, ABusRunByAnExecutorReceivesSignals)
     auto client = [this, expected_value, &cross_process_sync]() -> core::posix::exit::Status
     {
         auto bus = session_bus();
-        bus->install_executor(dbus::asio::make_executor(bus, io_service));
+        bus->install_executor(make_executor(bus));
         std::thread t{[bus](){bus->run();}};
         
         EXPECT_EQ(std::uint32_t(1), cross_process_sync.wait_for_signal_ready_for(std::chrono::milliseconds{500}));
@@ -148,7 +321,7 @@ TEST_F(Executor, ABusRunByAnExecutorReceivesSignals)
     EXPECT_EQ(core::testing::ForkAndRunResult::empty, core::testing::fork_and_run(service, client));
 }
 
-TEST_F(Executor, TimeoutsAreHandledCorrectly)
+TEST_P(Executors, TimeoutsAreHandledCorrectly)
 {
     core::testing::CrossProcessSync cross_process_sync;
 
@@ -158,7 +331,7 @@ TEST_F(Executor, TimeoutsAreHandledCorrectly)
         ChaosMonkey chaos_monkey;
         core::testing::SigTermCatcher sc;
         auto bus = session_bus();
-        bus->install_executor(dbus::asio::make_executor(bus, io_service));
+        bus->install_executor(make_executor(bus));
         auto service = dbus::Service::add_service<test::Service>(bus);
         auto skeleton = service->add_object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
         skeleton->install_method_handler<test::Service::Method>(
@@ -195,14 +368,9 @@ TEST_F(Executor, TimeoutsAreHandledCorrectly)
     auto client = [this, expected_value, &cross_process_sync]() -> core::posix::exit::Status
     {
         auto bus = session_bus();
-        bus->install_executor(dbus::asio::make_executor(bus, io_service));
+        bus->install_executor(make_executor(bus));
         std::thread t{[bus](){bus->run();}};
 
-        // If you encounter failures in the client, uncomment the following two lines
-        // and follow the instructions on the terminal.
-        // std::cout << "Invoke gdb with: sudo gdb -p " << getpid() << std::endl;
-        // sleep(10);
-
         EXPECT_EQ(std::uint32_t(1), cross_process_sync.wait_for_signal_ready_for(std::chrono::seconds{20}));
 
         auto stub_service = dbus::Service::use_service(bus, dbus::traits::Service<test::Service>::interface_name());
@@ -212,18 +380,18 @@ TEST_F(Executor, TimeoutsAreHandledCorrectly)
         {
             for (unsigned int counter = 0; counter < 1000; counter++)
             {
+                // Calls the chaos monkey dropped time out, either as error or as exception.
                 try
                 {
                     auto result = stub->transact_method<test::Service::Method, int64_t>();
 
-                    if (result.is_error())
-                        std::cout << result.error().print() << std::endl;
-                    else
+                    if (!result.is_error())
+                    {
                         EXPECT_EQ(42, result.value());
+                    }
 
-                } catch(const std::runtime_error& e)
+                } catch(const std::runtime_error&)
                 {
-                    std::cout << e.what() << std::endl;
                 }
             }
         });
@@ -232,18 +400,18 @@ TEST_F(Executor, TimeoutsAreHandledCorrectly)
         {
             for (unsigned int counter = 0; counter < 1000; counter++)
             {
+                // Calls the chaos monkey dropped time out, either as error or as exception.
                 try
                 {
                     auto result = stub->transact_method<test::Service::Method, int64_t>();
 
-                    if (result.is_error())
-                        std::cout << result.error().print() << std::endl;
-                    else
+                    if (!result.is_error())
+                    {
                         EXPECT_EQ(42, result.value());
+                    }
 
-                } catch(const std::runtime_error& e)
+                } catch(const std::runtime_error&)
                 {
-                    std::cout << e.what() << std::endl;
                 }
             }
         });
@@ -265,6 +433,10 @@ TEST_F(Executor, TimeoutsAreHandledCorrectly)
     EXPECT_EQ(core::testing::ForkAndRunResult::empty, core::testing::fork_and_run(service, client));
 }
 
+INSTANTIATE_TEST_CASE_P(Executors, Executors, ::testing::Values(
+                            ExecutorFactory{[](const core::dbus::Bus::Ptr& bus, boost::asio::io_service& io_service) { return core::dbus::asio::make_executor(bus, io_service); }},
+                            ExecutorFactory{make_uring_executor}));
+
 /*TEST(Bus, TimeoutThrowsForNullDBusWatch)
 {
     boost::asio::io_service io_service;
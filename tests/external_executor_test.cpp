@@ -0,0 +1,332 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/external/executor.h>
+
+#include <core/dbus/dbus.h>
+#include <core/dbus/fixture.h>
+#include <core/dbus/object.h>
+#include <core/dbus/service.h>
+
+#include "test_service.h"
+
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+// A minimal poll(2)-based event loop, standing in for glib, libuv or Qt.
+// It drives any number of buses from the thread calling run_until.
+class PollLoop : public dbus::external::EventLoop
+{
+public:
+    PollLoop()
+    {
+        if (::pipe(wakeup_pipe) == -1)
+            throw std::runtime_error("Could not create wakeup pipe.");
+    }
+
+    ~PollLoop()
+    {
+        ::close(wakeup_pipe[0]);
+        ::close(wakeup_pipe[1]);
+    }
+
+    void add_executor(const dbus::external::Executor::Ptr& executor)
+    {
+        executors.push_back(executor);
+    }
+
+    // Iterates the loop until either predicate holds or timeout elapsed.
+    bool run_until(const std::function<bool()>& predicate, const std::chrono::milliseconds& timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+
+        while (!predicate())
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+                return false;
+
+            iterate(std::min(deadline, next_timeout()) - now);
+        }
+
+        return true;
+    }
+
+    void add_watch(const dbus::external::Watch::Ptr& watch) override
+    {
+        watches.push_back(watch);
+    }
+
+    void remove_watch(const dbus::external::Watch::Ptr& watch) override
+    {
+        watches.erase(std::remove(watches.begin(), watches.end(), watch), watches.end());
+    }
+
+    void watch_toggled(const dbus::external::Watch::Ptr&) override
+    {
+        // We query the state of all watches in every iteration.
+    }
+
+    void add_timeout(const dbus::external::Timeout::Ptr& timeout) override
+    {
+        timeouts[timeout] = std::chrono::steady_clock::now() + timeout->interval();
+    }
+
+    void remove_timeout(const dbus::external::Timeout::Ptr& timeout) override
+    {
+        timeouts.erase(timeout);
+    }
+
+    void timeout_toggled(const dbus::external::Timeout::Ptr& timeout) override
+    {
+        timeouts[timeout] = std::chrono::steady_clock::now() + timeout->interval();
+    }
+
+    void wakeup() override
+    {
+        static const char c = 'w';
+        if (::write(wakeup_pipe[1], &c, sizeof(c)) == -1)
+            throw std::system_error(errno, std::system_category());
+    }
+
+    unsigned int timeouts_handled = 0;
+
+private:
+    std::chrono::steady_clock::time_point next_timeout() const
+    {
+        auto result = std::chrono::steady_clock::time_point::max();
+
+        for (const auto& pair : timeouts)
+            if (pair.first->is_enabled())
+                result = std::min(result, pair.second);
+
+        return result;
+    }
+
+    void iterate(const std::chrono::steady_clock::duration& max_wait)
+    {
+        // Watches and timeouts might be removed while handling events.
+        auto current_watches = watches;
+
+        std::vector<pollfd> fds;
+        fds.push_back(pollfd{wakeup_pipe[0], POLLIN, 0});
+        for (const auto& watch : current_watches)
+        {
+            short events = 0;
+            if (watch->is_enabled())
+            {
+                if (watch->events() & dbus::external::Watch::readable)
+                    events |= POLLIN;
+                if (watch->events() & dbus::external::Watch::writable)
+                    events |= POLLOUT;
+            }
+            fds.push_back(pollfd{events ? watch->fd() : -1, events, 0});
+        }
+
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(max_wait).count() + 1;
+        ::poll(fds.data(), fds.size(), static_cast<int>(std::max<decltype(ms)>(0, ms)));
+
+        if (fds[0].revents & POLLIN)
+        {
+            char buffer[64];
+            if (::read(wakeup_pipe[0], buffer, sizeof(buffer)) == -1)
+                throw std::system_error(errno, std::system_category());
+        }
+
+        for (std::size_t i = 0; i < current_watches.size(); i++)
+        {
+            unsigned int events = 0;
+            if (fds[i+1].revents & POLLIN)
+                events |= dbus::external::Watch::readable;
+            if (fds[i+1].revents & POLLOUT)
+                events |= dbus::external::Watch::writable;
+            if (fds[i+1].revents & POLLERR)
+                events |= dbus::external::Watch::error;
+            if (fds[i+1].revents & POLLHUP)
+                events |= dbus::external::Watch::hangup;
+
+            if (events)
+                current_watches[i]->handle(events);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        auto current_timeouts = timeouts;
+        for (const auto& pair : current_timeouts)
+        {
+            if (!pair.first->is_enabled() || pair.second > now)
+                continue;
+
+            timeouts_handled++;
+            pair.first->handle();
+
+            auto it = timeouts.find(pair.first);
+            if (it != timeouts.end())
+                it->second = now + it->first->interval();
+        }
+
+        for (const auto& executor : executors)
+            while (executor->dispatch(10));
+    }
+
+    int wakeup_pipe[2];
+    std::vector<dbus::external::Watch::Ptr> watches;
+    std::map<dbus::external::Timeout::Ptr, std::chrono::steady_clock::time_point> timeouts;
+    std::vector<dbus::external::Executor::Ptr> executors;
+};
+
+struct ExternalExecutor : public core::dbus::testing::Fixture
+{
+};
+
+auto session_bus_config_file =
+        core::dbus::testing::Fixture::default_session_bus_config_file() =
+        core::testing::session_bus_configuration_file();
+
+auto system_bus_config_file =
+        core::dbus::testing::Fixture::default_system_bus_config_file() =
+        core::testing::system_bus_configuration_file();
+}
+
+TEST_F(ExternalExecutor, ThrowsOnConstructionFromNullBusOrLoop)
+{
+    auto loop = std::make_shared<PollLoop>();
+
+    EXPECT_ANY_THROW(dbus::external::make_executor(dbus::Bus::Ptr{}, loop));
+    EXPECT_ANY_THROW(dbus::external::make_executor(session_bus(), dbus::external::EventLoop::Ptr{}));
+}
+
+TEST_F(ExternalExecutor, HandsWatchesToEventLoop)
+{
+    struct CountingLoop : public PollLoop
+    {
+        void add_watch(const dbus::external::Watch::Ptr& watch) override
+        {
+            EXPECT_GE(watch->fd(), 0);
+            watch_count++;
+            PollLoop::add_watch(watch);
+        }
+
+        unsigned int watch_count = 0;
+    };
+
+    auto loop = std::make_shared<CountingLoop>();
+    auto bus = session_bus();
+    bus->install_executor(dbus::external::make_executor(bus, loop));
+
+    EXPECT_GT(loop->watch_count, 0u);
+}
+
+TEST_F(ExternalExecutor, DrivesMethodCallsAndSignalsFromASingleThread)
+{
+    auto loop = std::make_shared<PollLoop>();
+
+    auto service_bus = session_bus();
+    auto service_executor = dbus::external::make_executor(service_bus, loop);
+    service_bus->install_executor(service_executor);
+    loop->add_executor(service_executor);
+
+    auto service = dbus::Service::add_service(service_bus, dbus::traits::Service<test::Service>::interface_name());
+    auto skeleton = service->add_object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+    skeleton->install_method_handler<test::Service::Method>([service_bus, skeleton](const dbus::Message::Ptr& msg)
+    {
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << int64_t(42);
+        service_bus->send(reply);
+        skeleton->emit_signal<test::Service::Signals::Dummy, int64_t>(42);
+    });
+
+    auto bus = session_bus();
+    auto executor = dbus::external::make_executor(bus, loop);
+    bus->install_executor(executor);
+    loop->add_executor(executor);
+
+    auto stub_service = dbus::Service::use_service(bus, dbus::traits::Service<test::Service>::interface_name());
+    auto stub = stub_service->object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+
+    int64_t signal_value = 0;
+    auto signal = stub->get_signal<test::Service::Signals::Dummy>();
+    signal->connect([&signal_value](const int64_t& value)
+    {
+        signal_value = value;
+    });
+
+    static const unsigned int call_count = 100;
+    unsigned int replies = 0;
+
+    for (unsigned int i = 0; i < call_count; i++)
+    {
+        stub->invoke_method_asynchronously_with_callback<test::Service::Method, int64_t>(
+                    [&replies](const dbus::Result<int64_t>& result)
+        {
+            EXPECT_FALSE(result.is_error());
+            if (!result.is_error() && result.value() == 42)
+                replies++;
+        });
+    }
+
+    EXPECT_TRUE(loop->run_until([&]() { return replies == call_count && signal_value == 42; }, std::chrono::seconds{10}));
+    EXPECT_EQ(call_count, replies);
+    EXPECT_EQ(42, signal_value);
+}
+
+TEST_F(ExternalExecutor, PendingCallsTimeOutThroughEventLoop)
+{
+    auto loop = std::make_shared<PollLoop>();
+
+    auto service_bus = session_bus();
+    auto service_executor = dbus::external::make_executor(service_bus, loop);
+    service_bus->install_executor(service_executor);
+    loop->add_executor(service_executor);
+
+    // We never reply to incoming calls.
+    auto service = dbus::Service::add_service(service_bus, dbus::traits::Service<test::Service>::interface_name());
+    auto skeleton = service->add_object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+    skeleton->install_method_handler<test::Service::Method>([](const dbus::Message::Ptr&) {});
+
+    auto bus = session_bus();
+    auto executor = dbus::external::make_executor(bus, loop);
+    bus->install_executor(executor);
+    loop->add_executor(executor);
+
+    auto stub_service = dbus::Service::use_service(bus, dbus::traits::Service<test::Service>::interface_name());
+    auto stub = stub_service->object_for_path(dbus::types::ObjectPath("/this/is/unlikely/to/exist/Service"));
+
+    bool timed_out = false;
+    stub->invoke_method_asynchronously_with_callback<test::Service::Method, int64_t>(
+                [&timed_out](const dbus::Result<int64_t>& result)
+    {
+        timed_out = result.is_error();
+    });
+
+    EXPECT_TRUE(loop->run_until([&]() { return timed_out; }, std::chrono::seconds{10}));
+    EXPECT_GT(loop->timeouts_handled, 0u);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/free_list.h>
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace
+{
+typedef core::dbus::impl::FreeList<48, 4> FreeList;
+
+struct Instance : public core::dbus::impl::Recycled<Instance>
+{
+    char payload[40];
+};
+}
+
+TEST(FreeList, ReleasedBlocksAreReusedByTheSameThread)
+{
+    auto block = FreeList::allocate();
+    FreeList::deallocate(block);
+
+    EXPECT_EQ(block, FreeList::allocate());
+    FreeList::deallocate(block);
+}
+
+TEST(FreeList, KeepsAtMostCapacityBlocks)
+{
+    std::vector<void*> blocks;
+    for (int i = 0; i < 8; i++)
+        blocks.push_back(FreeList::allocate());
+
+    // Only the first four blocks are kept, the others go back to the heap.
+    for (auto block : blocks)
+        FreeList::deallocate(block);
+
+    std::set<void*> reused;
+    for (int i = 0; i < 4; i++)
+        reused.insert(FreeList::allocate());
+
+    EXPECT_EQ(std::set<void*>(blocks.begin(), blocks.begin() + 4), reused);
+
+    for (auto block : reused)
+        FreeList::deallocate(block);
+}
+
+TEST(FreeList, BlocksCanBeReleasedByAnotherThread)
+{
+    auto block = FreeList::allocate();
+
+    std::thread releaser{[block]()
+    {
+        FreeList::deallocate(block);
+        EXPECT_EQ(block, FreeList::allocate());
+        FreeList::deallocate(block);
+    }};
+    releaser.join();
+}
+
+TEST(FreeList, RecycledInstancesReuseMemory)
+{
+    auto first = new Instance;
+    delete first;
+
+    std::unique_ptr<Instance> second{new Instance};
+    EXPECT_EQ(first, second.get());
+}
+
+TEST(FreeList, AllocatorRecyclesControlBlocksOfSharedPointers)
+{
+    std::shared_ptr<int> first = std::allocate_shared<int>(core::dbus::impl::FreeListAllocator<int>(), 42);
+    auto address = first.get();
+    first.reset();
+
+    auto second = std::allocate_shared<int>(core::dbus::impl::FreeListAllocator<int>(), 43);
+    EXPECT_EQ(address, second.get());
+    EXPECT_EQ(43, *second);
+}
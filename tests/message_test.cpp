@@ -121,6 +121,26 @@ TEST(Message, WriteAndSuccessiveReadAreIdempotent)
     EXPECT_EQ(expected_floating_point_value, d);
 }
 
+TEST(Message, ClonesAreIndependentOfTheirPrototype)
+{
+    auto prototype = core::dbus::Message::make_signal("/core/dbus/test", "core.dbus.test", "Changed");
+
+    auto first = prototype->clone();
+    auto second = prototype->clone();
+
+    EXPECT_EQ(core::dbus::Message::Type::signal, first->type());
+    EXPECT_EQ(prototype->path(), first->path());
+    EXPECT_EQ(prototype->interface(), first->interface());
+    EXPECT_EQ(prototype->member(), first->member());
+
+    first->writer().push_int32(42);
+    second->writer().push_int32(43);
+
+    EXPECT_ANY_THROW(prototype->reader());
+    EXPECT_EQ(42, first->reader().pop_int32());
+    EXPECT_EQ(43, second->reader().pop_int32());
+}
+
 TEST(Message, WriteAndSuccessiveIterationAreIdempotent)
 {
     const std::string destination = core::dbus::DBus::name();
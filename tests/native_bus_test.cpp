@@ -0,0 +1,377 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+#include <core/dbus/bus.h>
+
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/fixture.h>
+#include <core/dbus/object.h>
+#include <core/dbus/service.h>
+#include <core/dbus/signal.h>
+
+#include "test_data.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+struct Calculator
+{
+    struct Add
+    {
+        typedef Calculator Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s{"Add"};
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::seconds{1};
+        }
+    };
+
+    // Never answered by the service.
+    struct Ignored
+    {
+        typedef Calculator Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s{"Ignored"};
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::milliseconds{100};
+        }
+    };
+
+    struct Signals
+    {
+        struct Computed
+        {
+            inline static std::string name()
+            {
+                return "Computed";
+            }
+            typedef Calculator Interface;
+            typedef std::int32_t ArgumentType;
+        };
+    };
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace traits
+{
+template<>
+struct Service<Calculator>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s{"core.dbus.test.Calculator"};
+        return s;
+    }
+};
+}
+}
+}
+
+namespace
+{
+struct NativeBus : public core::dbus::testing::Fixture
+{
+};
+
+auto session_bus_config_file =
+        core::dbus::testing::Fixture::default_session_bus_config_file() =
+        core::testing::session_bus_configuration_file();
+
+auto system_bus_config_file =
+        core::dbus::testing::Fixture::default_system_bus_config_file() =
+        core::testing::system_bus_configuration_file();
+
+const dbus::types::ObjectPath& the_path()
+{
+    static const dbus::types::ObjectPath path{"/core/dbus/test/Calculator"};
+    return path;
+}
+
+// Runs the executor of a bus on a dedicated thread for the lifetime of an instance.
+struct Worker
+{
+    Worker(const dbus::Bus::Ptr& bus) : bus(bus)
+    {
+        bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+        thread = std::thread{[bus]() { bus->run(); }};
+    }
+
+    ~Worker()
+    {
+        bus->stop();
+        thread.join();
+    }
+
+    dbus::Bus::Ptr bus;
+    std::thread thread;
+};
+
+// Answers Add with the sum of its arguments, and announces the sum with Computed.
+dbus::Object::Ptr serve_calculator(const dbus::Bus::Ptr& bus)
+{
+    auto service = dbus::Service::add_service<Calculator>(bus);
+    auto object = service->add_object_for_path(the_path());
+
+    std::weak_ptr<dbus::Object> wp{object};
+    object->install_method_handler<Calculator::Add>([bus, wp](const dbus::Message::Ptr& msg)
+    {
+        std::int32_t lhs = 0, rhs = 0;
+        msg->reader() >> lhs >> rhs;
+
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << lhs + rhs;
+        bus->send(reply);
+
+        if (auto object = wp.lock())
+            object->emit_signal<Calculator::Signals::Computed, std::int32_t>(lhs + rhs);
+    });
+    object->install_method_handler<Calculator::Ignored>([](const dbus::Message::Ptr&) {});
+
+    return object;
+}
+
+// Blocks until value is delivered by the Computed signal of stub.
+struct ComputedObserver
+{
+    ComputedObserver(const dbus::Object::Ptr& stub)
+        : signal(stub->get_signal<Calculator::Signals::Computed>())
+    {
+        signal->connect([this](const std::int32_t& value)
+        {
+            std::lock_guard<std::mutex> lg(guard);
+            values.push_back(value);
+            changed.notify_all();
+        });
+    }
+
+    bool wait_for(std::int32_t value)
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        return changed.wait_for(ul, std::chrono::seconds{5}, [this, value]()
+        {
+            return std::find(values.begin(), values.end(), value) != values.end();
+        });
+    }
+
+    std::shared_ptr<dbus::Signal<Calculator::Signals::Computed, std::int32_t>> signal;
+    std::mutex guard;
+    std::condition_variable changed;
+    std::vector<std::int32_t> values;
+};
+}
+
+TEST_F(NativeBus, ServesMethodCallsAndEmitsSignals)
+{
+    auto service_bus = dbus::Bus::connect_natively(session_bus_address());
+    auto calculator = serve_calculator(service_bus);
+    Worker service_worker{service_bus};
+
+    auto client_bus = session_bus();
+    Worker client_worker{client_bus};
+
+    auto stub = dbus::Service::use_service<Calculator>(client_bus)->object_for_path(the_path());
+    ComputedObserver observer{stub};
+
+    auto result = stub->invoke_method_synchronously<Calculator::Add, std::int32_t>(40, 2);
+    ASSERT_FALSE(result.is_error()) << result.error().print();
+    EXPECT_EQ(42, result.value());
+    EXPECT_TRUE(observer.wait_for(42));
+}
+
+TEST_F(NativeBus, CallsMethodsAndReceivesSignals)
+{
+    auto service_bus = session_bus();
+    auto calculator = serve_calculator(service_bus);
+    Worker service_worker{service_bus};
+
+    auto client_bus = dbus::Bus::connect_natively(session_bus_address());
+    Worker client_worker{client_bus};
+
+    EXPECT_FALSE(client_bus->raw());
+    EXPECT_TRUE(client_bus->has_owner_for_name(dbus::traits::Service<Calculator>::interface_name()));
+
+    auto stub = dbus::Service::use_service<Calculator>(client_bus)->object_for_path(the_path());
+    ComputedObserver observer{stub};
+
+    auto result = stub->invoke_method_synchronously<Calculator::Add, std::int32_t>(20, 3);
+    ASSERT_FALSE(result.is_error()) << result.error().print();
+    EXPECT_EQ(23, result.value());
+    EXPECT_TRUE(observer.wait_for(23));
+
+    auto future = stub->invoke_method_asynchronously<Calculator::Add, std::int32_t>(1, 2);
+    ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds{5}));
+    EXPECT_EQ(3, future.get().value());
+}
+
+TEST_F(NativeBus, BlockingCallsNeitherRequireNorBlockTheExecutor)
+{
+    auto service_bus = dbus::Bus::connect_natively(session_bus_address());
+    EXPECT_TRUE(service_bus->has_owner_for_name("org.freedesktop.DBus"));
+
+    // The handler runs on the executor that delivers the reply to its own call.
+    auto service = dbus::Service::add_service<Calculator>(service_bus);
+    auto object = service->add_object_for_path(the_path());
+    object->install_method_handler<Calculator::Add>([service_bus](const dbus::Message::Ptr& msg)
+    {
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << static_cast<std::int32_t>(service_bus->has_owner_for_name("org.freedesktop.DBus"));
+        service_bus->send(reply);
+    });
+    Worker service_worker{service_bus};
+
+    auto client_bus = session_bus();
+    Worker client_worker{client_bus};
+
+    auto stub = dbus::Service::use_service<Calculator>(client_bus)->object_for_path(the_path());
+    auto result = stub->invoke_method_synchronously<Calculator::Add, std::int32_t>(0, 0);
+    ASSERT_FALSE(result.is_error()) << result.error().print();
+    EXPECT_EQ(1, result.value());
+}
+
+TEST_F(NativeBus, CallsWithoutReplyTimeOut)
+{
+    auto service_bus = session_bus();
+    auto calculator = serve_calculator(service_bus);
+    Worker service_worker{service_bus};
+
+    auto client_bus = dbus::Bus::connect_natively(session_bus_address());
+    Worker client_worker{client_bus};
+
+    auto stub = dbus::Service::use_service<Calculator>(client_bus)->object_for_path(the_path());
+
+    auto future = stub->invoke_method_asynchronously<Calculator::Ignored, void>();
+    ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds{5}));
+    auto result = future.get();
+    ASSERT_TRUE(result.is_error());
+    EXPECT_EQ(DBUS_ERROR_NO_REPLY, result.error().name());
+
+    EXPECT_ANY_THROW((stub->invoke_method_synchronously<Calculator::Ignored, void>()));
+}
+
+TEST_F(NativeBus, AnswersPingsAndRejectsUnknownMethods)
+{
+    auto service_bus = dbus::Bus::connect_natively(session_bus_address());
+    auto calculator = serve_calculator(service_bus);
+    Worker service_worker{service_bus};
+
+    auto client_bus = session_bus();
+
+    auto ping = dbus::Message::make_method_call(
+                dbus::traits::Service<Calculator>::interface_name(),
+                dbus::types::ObjectPath{"/does/not/exist"},
+                DBUS_INTERFACE_PEER,
+                "Ping");
+    auto reply = client_bus->send_with_reply_and_block_for_at_most(ping, std::chrono::seconds{1});
+    EXPECT_EQ(dbus::Message::Type::method_return, reply->type());
+
+    auto unknown = dbus::Message::make_method_call(
+                dbus::traits::Service<Calculator>::interface_name(),
+                the_path(),
+                dbus::traits::Service<Calculator>::interface_name(),
+                "Unknown");
+    EXPECT_ANY_THROW(client_bus->send_with_reply_and_block_for_at_most(unknown, std::chrono::seconds{1}));
+}
+
+TEST_F(NativeBus, RequestsAndReleasesNames)
+{
+    static const std::string name{"core.dbus.test.Name"};
+
+    auto bus = dbus::Bus::connect_natively(session_bus_address());
+    auto observer = session_bus();
+
+    auto owned = bus->request_name_on_bus(name, dbus::Bus::RequestNameFlag::do_not_queue);
+    EXPECT_TRUE(observer->has_owner_for_name(name));
+    EXPECT_THROW(bus->request_name_on_bus(name, dbus::Bus::RequestNameFlag::do_not_queue),
+                 dbus::Bus::Errors::AlreadyOwner);
+    EXPECT_THROW(observer->request_name_on_bus(name, dbus::Bus::RequestNameFlag::do_not_queue),
+                 dbus::Bus::Errors::AlreadyOwned);
+
+    bus->release_name_on_bus(std::move(owned));
+    EXPECT_FALSE(observer->has_owner_for_name(name));
+
+    // Destroying the bus closes the connection, the daemon releases all names.
+    owned = bus->request_name_on_bus(name, dbus::Bus::RequestNameFlag::do_not_queue);
+    bus.reset();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+    while (observer->has_owner_for_name(name) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+
+    EXPECT_FALSE(observer->has_owner_for_name(name));
+}
+
+TEST_F(NativeBus, PendingCallNotificationsMayCallBackIntoTheCall)
+{
+    auto service_bus = session_bus();
+    auto calculator = serve_calculator(service_bus);
+    Worker service_worker{service_bus};
+
+    auto client_bus = dbus::Bus::connect_natively(session_bus_address());
+    Worker client_worker{client_bus};
+
+    auto add = dbus::Message::make_method_call(
+                dbus::traits::Service<Calculator>::interface_name(),
+                the_path(),
+                dbus::traits::Service<Calculator>::interface_name(),
+                Calculator::Add::name());
+    add->writer() << std::int32_t{1} << std::int32_t{2};
+
+    auto call = client_bus->send_with_reply_and_timeout(add, std::chrono::seconds{5});
+
+    // Installing another notification from within a notification must not deadlock.
+    std::promise<std::int32_t> sum;
+    std::weak_ptr<dbus::PendingCall> wp{call};
+    call->then([wp, &sum](const dbus::Message::Ptr&)
+    {
+        if (auto call = wp.lock())
+            call->then([&sum](const dbus::Message::Ptr& reply)
+            {
+                std::int32_t value = 0;
+                reply->reader() >> value;
+                sum.set_value(value);
+            });
+    });
+
+    auto future = sum.get_future();
+    ASSERT_EQ(std::future_status::ready, future.wait_for(std::chrono::seconds{5}));
+    EXPECT_EQ(3, future.get());
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/connection.h>
+
+#include <core/dbus/bus.h>
+#include <core/dbus/codec.h>
+#include <core/dbus/fixture.h>
+#include <core/dbus/message.h>
+
+#include <core/dbus/types/unix_fd.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include "test_data.h"
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+#include <thread>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+struct NativeConnection : public core::dbus::testing::Fixture
+{
+};
+
+auto session_bus_config_file =
+        core::dbus::testing::Fixture::default_session_bus_config_file() =
+        core::testing::session_bus_configuration_file();
+
+auto system_bus_config_file =
+        core::dbus::testing::Fixture::default_system_bus_config_file() =
+        core::testing::system_bus_configuration_file();
+
+dbus::Message::Ptr a_call_to_the_daemon(const std::string& member)
+{
+    return dbus::Message::make_method_call(
+                DBUS_SERVICE_DBUS,
+                dbus::types::ObjectPath{DBUS_PATH_DBUS},
+                DBUS_INTERFACE_DBUS,
+                member);
+}
+
+dbus::native::Connection::Incoming read_reply(const dbus::native::Connection::Ptr& connection, std::uint32_t serial)
+{
+    while (true)
+    {
+        auto incoming = connection->read();
+        if (incoming.reply_serial == serial)
+            return incoming;
+    }
+}
+}
+
+TEST_F(NativeConnection, AuthenticatesAndObtainsUniqueName)
+{
+    auto connection = dbus::native::Connection::open(session_bus_address());
+
+    EXPECT_EQ(':', connection->unique_name().front());
+    EXPECT_GE(connection->fd(), 0);
+}
+
+TEST_F(NativeConnection, OpeningThrowsForUnreachableAddress)
+{
+    EXPECT_ANY_THROW(dbus::native::Connection::open("unix:path=/this/path/does/not/exist"));
+    EXPECT_ANY_THROW(dbus::native::Connection::open("tcp:host=localhost,port=0"));
+    EXPECT_ANY_THROW(dbus::native::Connection::open("malformed"));
+}
+
+TEST_F(NativeConnection, CallsMethodsOfTheBusDaemon)
+{
+    auto connection = dbus::native::Connection::open(session_bus_address());
+
+    auto serial = connection->send(a_call_to_the_daemon("ListNames"));
+    auto reply = read_reply(connection, serial);
+
+    ASSERT_EQ(dbus::Message::Type::method_return, reply.message->type());
+
+    std::vector<std::string> names;
+    auto reader = reply.message->reader();
+    dbus::decode_argument(reader, names);
+
+    EXPECT_NE(names.end(), std::find(names.begin(), names.end(), connection->unique_name()));
+}
+
+TEST_F(NativeConnection, ServesMethodCallsFromLibdbusConnections)
+{
+    auto connection = dbus::native::Connection::open(session_bus_address());
+    auto bus = session_bus();
+
+    std::thread responder([connection]()
+    {
+        while (true)
+        {
+            auto incoming = connection->read();
+            if (incoming.message->type() != dbus::Message::Type::method_call)
+                continue;
+
+            auto reply = dbus::Message::make_method_return(incoming.message);
+            reply->writer().push_stringn("pong", 4);
+            connection->send(reply);
+            return;
+        }
+    });
+
+    auto call = dbus::Message::make_method_call(
+                connection->unique_name(),
+                dbus::types::ObjectPath{"/core/dbus/native"},
+                "core.dbus.native",
+                "Ping");
+
+    auto reply = bus->send_with_reply_and_block_for_at_most(call, std::chrono::seconds{5});
+    responder.join();
+
+    ASSERT_EQ(dbus::Message::Type::method_return, reply->type());
+    EXPECT_EQ(std::string{"pong"}, reply->reader().pop_string());
+}
+
+TEST_F(NativeConnection, SendsConcurrentlyFromManyThreads)
+{
+    static constexpr unsigned int thread_count = 8;
+    static constexpr unsigned int calls_per_thread = 100;
+
+    auto connection = dbus::native::Connection::open(session_bus_address());
+
+    std::vector<std::thread> senders;
+    std::vector<std::vector<std::uint32_t>> serials(thread_count);
+
+    for (unsigned int i = 0; i < thread_count; i++)
+        senders.emplace_back([connection, i, &serials]()
+        {
+            for (unsigned int j = 0; j < calls_per_thread; j++)
+                serials[i].push_back(connection->send(a_call_to_the_daemon("GetId")));
+        });
+
+    std::set<std::uint32_t> replied;
+    while (replied.size() < thread_count * calls_per_thread)
+    {
+        auto incoming = connection->read();
+        if (incoming.message->type() == dbus::Message::Type::method_return)
+            replied.insert(incoming.reply_serial);
+    }
+
+    for (auto& sender : senders)
+        sender.join();
+
+    std::set<std::uint32_t> sent;
+    for (const auto& s : serials)
+        sent.insert(s.begin(), s.end());
+
+    EXPECT_EQ(sent, replied);
+}
+
+TEST_F(NativeConnection, PassesUnixFds)
+{
+    auto connection = dbus::native::Connection::open(session_bus_address());
+    if (!connection->can_pass_unix_fds())
+        return;
+
+    int fds[2];
+    ASSERT_EQ(0, ::pipe(fds));
+
+    // We send the call to ourselves.
+    auto call = dbus::Message::make_method_call(
+                connection->unique_name(),
+                dbus::types::ObjectPath{"/core/dbus/native"},
+                "core.dbus.native",
+                "Fd");
+    {
+        auto writer = call->writer();
+        dbus::encode_argument(writer, dbus::types::UnixFd{fds[1]});
+    }
+
+    EXPECT_ANY_THROW(connection->send(call));
+    connection->send(call, std::vector<int>{fds[1]});
+
+    while (true)
+    {
+        auto incoming = connection->read();
+        if (incoming.message->member() != "Fd")
+            continue;
+
+        ASSERT_EQ(1u, incoming.fds.size());
+        ASSERT_EQ(1, ::write(incoming.fds[0], "x", 1));
+
+        char c = 0;
+        ASSERT_EQ(1, ::read(fds[0], &c, 1));
+        EXPECT_EQ('x', c);
+
+        ::close(incoming.fds[0]);
+        break;
+    }
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_F(NativeConnection, ClosingUnblocksReaders)
+{
+    auto connection = dbus::native::Connection::open(session_bus_address());
+
+    std::thread reader([connection]()
+    {
+        EXPECT_ANY_THROW(while (true) connection->read());
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    connection->close();
+    reader.join();
+
+    EXPECT_ANY_THROW(connection->send(a_call_to_the_daemon("GetId")));
+}
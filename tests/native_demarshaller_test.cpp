@@ -0,0 +1,431 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/byte_swap.h>
+#include <core/dbus/native/codec.h>
+#include <core/dbus/native/demarshaller.h>
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+#include <core/dbus/message_streaming_operators.h>
+
+#include <core/dbus/types/object_path.h>
+#include <core/dbus/types/signature.h>
+#include <core/dbus/types/struct.h>
+#include <core/dbus/types/variant.h>
+
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+dbus::Message::Ptr a_method_call()
+{
+    return dbus::Message::make_method_call(
+                "org.freedesktop.dbus.native",
+                dbus::types::ObjectPath("/org/freedesktop/dbus/native"),
+                "org.freedesktop.dbus.native.Interface",
+                "Method");
+}
+
+// Writes values in the opposite of host byte order, as sent by peers of different endianness.
+struct OppositeEndianWriter
+{
+    void align(std::size_t alignment)
+    {
+        while (bytes.size() % alignment != 0)
+            bytes.push_back(0);
+    }
+
+    template<typename T>
+    void push(T value)
+    {
+        align(sizeof(T));
+        value = dbus::native::swapped_byte_order(value);
+        auto p = reinterpret_cast<const std::uint8_t*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+
+    void push_string(const std::string& s)
+    {
+        push(static_cast<std::uint32_t>(s.size()));
+        bytes.insert(bytes.end(), s.begin(), s.end());
+        bytes.push_back(0);
+    }
+
+    void push_signature(const std::string& s)
+    {
+        bytes.push_back(static_cast<std::uint8_t>(s.size()));
+        bytes.insert(bytes.end(), s.begin(), s.end());
+        bytes.push_back(0);
+    }
+
+    // Returns the offset of the length to be patched by close_array.
+    std::size_t open_array(std::size_t element_alignment)
+    {
+        push(std::uint32_t{0});
+        auto length = bytes.size() - sizeof(std::uint32_t);
+        align(element_alignment);
+        return length;
+    }
+
+    void close_array(std::size_t length, std::size_t element_alignment)
+    {
+        auto begin = (length + sizeof(std::uint32_t) + element_alignment - 1) & ~(element_alignment - 1);
+        patch(length, static_cast<std::uint32_t>(bytes.size() - begin));
+    }
+
+    template<typename T>
+    void push_array(const std::vector<T>& values)
+    {
+        auto length = open_array(sizeof(T));
+        for (auto value : values)
+            push(value);
+        close_array(length, sizeof(T));
+    }
+
+    void patch(std::size_t offset, std::uint32_t value)
+    {
+        value = dbus::native::swapped_byte_order(value);
+        std::memcpy(bytes.data() + offset, &value, sizeof(value));
+    }
+
+    std::vector<std::uint8_t> bytes;
+};
+
+// Creates a signal whose header and body are in the opposite of host byte order,
+// body writes the values described by signature.
+dbus::Message::Ptr an_opposite_endian_signal(const std::string& signature, const std::function<void(OppositeEndianWriter&)>& body)
+{
+    OppositeEndianWriter out;
+
+    out.bytes.push_back(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? DBUS_BIG_ENDIAN : DBUS_LITTLE_ENDIAN);
+    out.bytes.push_back(DBUS_MESSAGE_TYPE_SIGNAL);
+    out.bytes.push_back(0);
+    out.bytes.push_back(DBUS_MAJOR_PROTOCOL_VERSION);
+    out.push(std::uint32_t{0});
+    out.push(std::uint32_t{1});
+
+    auto fields = out.open_array(8);
+    {
+        auto push_field = [&out](std::uint8_t code, const std::string& type, const std::string& value)
+        {
+            out.align(8);
+            out.bytes.push_back(code);
+            out.push_signature(type);
+            if (type == DBUS_TYPE_SIGNATURE_AS_STRING)
+                out.push_signature(value);
+            else
+                out.push_string(value);
+        };
+
+        push_field(DBUS_HEADER_FIELD_PATH, DBUS_TYPE_OBJECT_PATH_AS_STRING, "/org/freedesktop/dbus/native");
+        push_field(DBUS_HEADER_FIELD_INTERFACE, DBUS_TYPE_STRING_AS_STRING, "org.freedesktop.dbus.native.Interface");
+        push_field(DBUS_HEADER_FIELD_MEMBER, DBUS_TYPE_STRING_AS_STRING, "Signal");
+        push_field(DBUS_HEADER_FIELD_SIGNATURE, DBUS_TYPE_SIGNATURE_AS_STRING, signature);
+    }
+    out.close_array(fields, 8);
+
+    out.align(8);
+    auto begin = out.bytes.size();
+    body(out);
+    out.patch(4, static_cast<std::uint32_t>(out.bytes.size() - begin));
+
+    auto raw = dbus_message_demarshal(reinterpret_cast<const char*>(out.bytes.data()), static_cast<int>(out.bytes.size()), nullptr);
+    if (!raw)
+        throw std::runtime_error("Could not demarshal opposite-endian message.");
+
+    auto msg = dbus::Message::from_raw_message(raw);
+    dbus_message_unref(raw);
+    return msg;
+}
+}
+
+TEST(NativeDemarshaller, ReadsAlignedValuesFromBuffer)
+{
+    dbus::native::Marshaller m;
+
+    m.push_byte(42);
+    m.push_int16(-43);
+    m.push_int64(44);
+    m.push_string("abc");
+    m.push_floating_point(.5);
+
+    dbus::native::Demarshaller in{m.data(), m.size()};
+
+    EXPECT_EQ(42, in.pop_byte());
+    EXPECT_EQ(-43, in.pop_int16());
+    EXPECT_EQ(44, in.pop_int64());
+    EXPECT_TRUE(in.pop_string() == "abc");
+    EXPECT_EQ(.5, in.pop_floating_point());
+    EXPECT_EQ(m.size(), in.offset());
+}
+
+TEST(NativeDemarshaller, ThrowsForReadsBeyondBuffer)
+{
+    dbus::native::Marshaller m;
+    m.push_string("abc");
+
+    dbus::native::Demarshaller truncated{m.data(), m.size() - 1};
+    EXPECT_ANY_THROW(truncated.pop_string());
+
+    dbus::native::Demarshaller exhausted{m.data(), m.size()};
+    exhausted.pop_string();
+    EXPECT_ANY_THROW(exhausted.pop_byte());
+}
+
+TEST(NativeDemarshaller, DecodesNativelyEncodedValues)
+{
+    typedef dbus::types::Struct<std::tuple<std::int32_t, dbus::types::ObjectPath>> Entry;
+
+    const std::vector<double> doubles{1., 2., 3.};
+    const std::map<std::string, Entry> map
+    {
+        {"one", Entry{std::make_tuple(1, dbus::types::ObjectPath{"/one"})}},
+        {"two", Entry{std::make_tuple(2, dbus::types::ObjectPath{"/two"})}}
+    };
+    const std::vector<std::string> strings{"a", "bc", "def"};
+
+    dbus::native::Marshaller m;
+    dbus::native::encode_message(m, doubles, map, true, strings);
+
+    std::vector<double> doubles_out; std::map<std::string, Entry> map_out; bool b_out{false}; std::vector<std::string> strings_out;
+    dbus::native::Demarshaller in{m.data(), m.size()};
+    dbus::native::decode_message(in, doubles_out, map_out, b_out, strings_out);
+
+    EXPECT_EQ(doubles, doubles_out);
+    EXPECT_EQ(map, map_out);
+    EXPECT_TRUE(b_out);
+    EXPECT_EQ(strings, strings_out);
+    EXPECT_EQ(m.size(), in.offset());
+}
+
+TEST(NativeDemarshaller, DecodesBodyOfMessageEncodedWithLibdbus)
+{
+    const std::int32_t i{-42};
+    const std::string s{"a string"};
+    const std::vector<std::int64_t> ints{1, 2, 3};
+    const std::uint64_t u64{std::numeric_limits<std::uint64_t>::max()};
+    const dbus::types::Signature signature{"a{sv}"};
+
+    auto msg = a_method_call();
+    {
+        auto writer = msg->writer();
+        dbus::encode_message(writer, i, s, ints, u64, signature);
+    }
+
+    std::int32_t i_out; std::string s_out; std::vector<std::int64_t> ints_out;
+    std::uint64_t u64_out; dbus::types::Signature signature_out;
+
+    auto body = dbus::native::Body::from_message(msg);
+    dbus::native::decode_message(body, i_out, s_out, ints_out, u64_out, signature_out);
+
+    EXPECT_EQ(i, i_out);
+    EXPECT_EQ(s, s_out);
+    EXPECT_EQ(ints, ints_out);
+    EXPECT_EQ(u64, u64_out);
+    EXPECT_EQ(signature, signature_out);
+}
+
+TEST(NativeDemarshaller, DecodesObjectsWithPropertiesLazily)
+{
+    // a(oa{sv}) as returned by, e.g., GetManagedObjects-style calls.
+    auto msg = a_method_call();
+    {
+        auto writer = msg->writer();
+        auto objects = writer.open_array(dbus::types::Signature{"(oa{sv})"});
+        for (int n = 0; n < 2; n++)
+        {
+            auto object = objects.open_structure();
+            object.push_object_path(dbus::types::ObjectPath{"/object/" + std::to_string(n)});
+            auto properties = object.open_array(dbus::types::Signature{"{sv}"});
+            {
+                auto entry = properties.open_dict_entry();
+                entry.push_stringn("Name", 4);
+                dbus::encode_argument(entry, dbus::types::TypedVariant<std::string>{"object" + std::to_string(n)});
+                properties.close_dict_entry(std::move(entry));
+            }
+            {
+                auto entry = properties.open_dict_entry();
+                entry.push_stringn("Values", 6);
+                dbus::encode_argument(entry, dbus::types::TypedVariant<std::vector<std::int32_t>>{std::vector<std::int32_t>{n, n + 1}});
+                properties.close_dict_entry(std::move(entry));
+            }
+            object.close_array(std::move(properties));
+            objects.close_structure(std::move(object));
+        }
+        writer.close_array(std::move(objects));
+    }
+
+    typedef std::map<std::string, dbus::native::VariantView> Properties;
+    typedef dbus::types::Struct<std::tuple<dbus::types::ObjectPath, Properties>> Object;
+
+    std::vector<Object> objects;
+
+    auto body = dbus::native::Body::from_message(msg);
+    dbus::native::decode_message(body, objects);
+
+    ASSERT_EQ(2u, objects.size());
+    for (int n = 0; n < 2; n++)
+    {
+        const auto& properties = std::get<1>(objects[n].value);
+
+        EXPECT_EQ(dbus::types::ObjectPath{"/object/" + std::to_string(n)}, std::get<0>(objects[n].value));
+        ASSERT_EQ(2u, properties.size());
+        EXPECT_EQ("object" + std::to_string(n), properties.at("Name").as<std::string>());
+        EXPECT_EQ((std::vector<std::int32_t>{n, n + 1}), properties.at("Values").as<std::vector<std::int32_t>>());
+        EXPECT_ANY_THROW(properties.at("Name").as<std::int32_t>());
+    }
+}
+
+TEST(NativeDemarshaller, SkipsValuesDescribedBySignature)
+{
+    dbus::native::Marshaller m;
+    dbus::native::encode_message(
+                m,
+                std::map<std::string, dbus::types::Struct<std::tuple<std::int16_t, double>>>
+                {
+                    {"a", dbus::types::Struct<std::tuple<std::int16_t, double>>{std::make_tuple(1, 2.)}}
+                },
+                std::vector<std::string>{"x", "y"});
+    m.push_byte(42);
+
+    dbus::native::Demarshaller in{m.data(), m.size()};
+    in.skip(dbus::types::Signature{"a{s(nd)}as"});
+
+    EXPECT_EQ(42, in.pop_byte());
+    EXPECT_ANY_THROW(in.skip(dbus::types::Signature{"(i"}));
+}
+
+TEST(NativeDemarshaller, DecodingBodyThrowsForMismatchingSignature)
+{
+    auto msg = dbus::native::make_message(a_method_call(), std::int32_t{42});
+    auto body = dbus::native::Body::from_message(msg);
+
+    std::string s;
+    EXPECT_ANY_THROW(dbus::native::decode_message(body, s));
+
+    std::int32_t i{0};
+    dbus::native::decode_message(body, i);
+    EXPECT_EQ(42, i);
+}
+
+TEST(NativeDemarshaller, AccessingBodyThrowsForNullMessage)
+{
+    EXPECT_ANY_THROW(dbus::native::Body::from_message(dbus::Message::Ptr{}));
+}
+
+TEST(NativeByteSwap, AllImplementationsSwapEveryValue)
+{
+    std::mt19937 rng{42};
+    std::vector<std::uint8_t> data(8 * 100);
+    for (auto& byte : data)
+        byte = static_cast<std::uint8_t>(rng());
+
+    for (auto isa : {dbus::validation::Isa::scalar, dbus::validation::Isa::sse2, dbus::validation::Isa::avx2})
+    {
+        if (!dbus::validation::is_supported(isa))
+            continue;
+
+        // Counts that cover full vectors and remainders.
+        for (std::size_t count = 0; count <= 70; count++)
+        {
+            for (std::size_t size : {2, 4, 8})
+            {
+                auto swapped = data;
+                dbus::native::swap_byte_order(isa, swapped.data() + 1, count, size);
+
+                EXPECT_EQ(data[0], swapped[0]);
+                for (std::size_t i = 0; i < count * size; i++)
+                    ASSERT_EQ(data[1 + (i / size) * size + (size - 1 - i % size)], swapped[1 + i])
+                            << static_cast<int>(isa) << ", " << count << " x " << size;
+                EXPECT_TRUE(std::equal(data.begin() + 1 + count * size, data.end(), swapped.begin() + 1 + count * size));
+            }
+        }
+    }
+}
+
+TEST(NativeDemarshaller, DecodesOppositeEndianBodies)
+{
+    const std::vector<std::int16_t> int16s{-1, 2, -300, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17};
+    const std::vector<std::uint32_t> uint32s{1, 0xdeadbeef, 3, 4, 5, 6, 7, 8, 9};
+    const std::vector<std::int64_t> int64s{-1, 1ll << 40, 3, 4, 5};
+    const std::vector<double> doubles{.5, -1e300, 3.25};
+    const std::string s{"opposite"};
+    const std::uint64_t u64{0x0102030405060708ull};
+
+    auto msg = an_opposite_endian_signal("anauaxadsta{sv}", [&](OppositeEndianWriter& out)
+    {
+        out.push_array(int16s);
+        out.push_array(uint32s);
+        out.push_array(int64s);
+        out.push_array(doubles);
+        out.push_string(s);
+        out.push(u64);
+
+        auto properties = out.open_array(8);
+        {
+            out.align(8);
+            out.push_string("Answer");
+            out.push_signature("i");
+            out.push(std::int32_t{42});
+        }
+        out.close_array(properties, 8);
+    });
+
+    // Bodies keep the byte order of the sender until libdbus inspects them.
+    auto body = dbus::native::Body::from_message(msg);
+    EXPECT_TRUE(body.is_swapped());
+
+    std::vector<std::int16_t> int16s_out; std::vector<std::uint32_t> uint32s_out;
+    std::vector<std::int64_t> int64s_out; std::vector<double> doubles_out;
+    std::string s_out; std::uint64_t u64_out;
+    std::map<std::string, dbus::native::VariantView> properties;
+    dbus::native::decode_message(body, int16s_out, uint32s_out, int64s_out, doubles_out, s_out, u64_out, properties);
+
+    EXPECT_EQ(int16s, int16s_out);
+    EXPECT_EQ(uint32s, uint32s_out);
+    EXPECT_EQ(int64s, int64s_out);
+    EXPECT_EQ(doubles, doubles_out);
+    EXPECT_EQ(s, s_out);
+    EXPECT_EQ(u64, u64_out);
+    EXPECT_EQ(42, properties.at("Answer").as<std::int32_t>());
+
+    // libdbus converts the message to host byte order, yielding the same values.
+    int16s_out.clear(); uint32s_out.clear(); int64s_out.clear(); doubles_out.clear();
+    auto reader = msg->reader();
+    reader >> int16s_out >> uint32s_out >> int64s_out >> doubles_out >> s_out >> u64_out;
+
+    EXPECT_EQ(int16s, int16s_out);
+    EXPECT_EQ(uint32s, uint32s_out);
+    EXPECT_EQ(int64s, int64s_out);
+    EXPECT_EQ(doubles, doubles_out);
+    EXPECT_EQ(s, s_out);
+    EXPECT_EQ(u64, u64_out);
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/native/codec.h>
+
+#include <core/dbus/codec.h>
+#include <core/dbus/message.h>
+
+#include <core/dbus/types/object_path.h>
+#include <core/dbus/types/signature.h>
+#include <core/dbus/types/struct.h>
+
+#include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/string.h>
+#include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/vector.h>
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <limits>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+std::uint32_t uint32_at(const dbus::native::Marshaller& m, std::size_t offset)
+{
+    std::uint32_t result;
+    std::memcpy(&result, m.data() + offset, sizeof(result));
+    return result;
+}
+
+dbus::Message::Ptr a_method_call()
+{
+    return dbus::Message::make_method_call(
+                "org.freedesktop.dbus.native",
+                dbus::types::ObjectPath("/org/freedesktop/dbus/native"),
+                "org.freedesktop.dbus.native.Interface",
+                "Method");
+}
+}
+
+TEST(NativeMarshaller, AlignsValuesRelativeToStartOfBuffer)
+{
+    dbus::native::Marshaller m;
+
+    m.push_byte(42);
+    m.push_int16(43);
+    m.push_int64(44);
+    m.push_byte(45);
+    m.push_int32(46);
+
+    ASSERT_EQ(24u, m.size());
+    EXPECT_EQ(42, m.data()[0]);
+    EXPECT_EQ(0, m.data()[1]);
+    EXPECT_EQ(43, m.data()[2]);
+    EXPECT_EQ(44, m.data()[8]);
+    EXPECT_EQ(45, m.data()[16]);
+    EXPECT_EQ(46u, uint32_at(m, 20));
+}
+
+TEST(NativeMarshaller, ArrayLengthExcludesPaddingToFirstElement)
+{
+    dbus::native::Marshaller m;
+
+    m.push_byte(1);
+    dbus::native::encode_message(m, std::vector<std::int64_t>{1, 2});
+
+    // Byte at 0, length at 4, padding from 8 to 8, elements from 8 to 24.
+    ASSERT_EQ(24u, m.size());
+    EXPECT_EQ(16u, uint32_at(m, 4));
+
+    dbus::native::Marshaller n;
+    n.push_byte(1);
+    dbus::native::encode_message(n, std::vector<dbus::types::Struct<std::tuple<std::int32_t>>>{});
+
+    // Empty arrays still carry the padding to their first element.
+    ASSERT_EQ(8u, n.size());
+    EXPECT_EQ(0u, uint32_at(n, 4));
+}
+
+TEST(NativeMarshaller, StringsAndSignaturesAreNullTerminated)
+{
+    dbus::native::Marshaller m;
+
+    m.push_string("abc");
+    m.push_signature(dbus::types::Signature{"a{sv}"});
+
+    ASSERT_EQ(4u + 4u + 7u, m.size());
+    EXPECT_EQ(3u, uint32_at(m, 0));
+    EXPECT_EQ(0, std::memcmp("abc", m.data() + 4, 4));
+    EXPECT_EQ(5, m.data()[8]);
+    EXPECT_EQ(0, std::memcmp("a{sv}", m.data() + 9, 6));
+}
+
+TEST(NativeMarshaller, StringsAreValidatedWhenWritten)
+{
+    dbus::native::Marshaller m;
+
+    EXPECT_ANY_THROW(m.push_string(std::string{"\xff\xfe"}));
+    EXPECT_ANY_THROW(m.push_string(std::string("a\0b", 3)));
+    EXPECT_EQ(0u, m.size());
+
+    EXPECT_NO_THROW(m.push_string("\xc3\xa4"));
+}
+
+TEST(NativeMarshaller, NativelyEncodedMessageDecodesWithLibdbus)
+{
+    typedef dbus::types::Struct<std::tuple<std::int32_t, dbus::types::ObjectPath>> Entry;
+
+    const std::int32_t i{-42};
+    const std::string s{"a string"};
+    const std::vector<double> doubles{1., 2., 3.};
+    const std::map<std::string, Entry> map
+    {
+        {"one", Entry{std::make_tuple(1, dbus::types::ObjectPath{"/one"})}},
+        {"two", Entry{std::make_tuple(2, dbus::types::ObjectPath{"/two"})}}
+    };
+    const std::vector<std::string> strings{"a", "bc", "def"};
+    const bool b{true};
+    const std::int16_t i16{-7};
+    const std::uint64_t u64{std::numeric_limits<std::uint64_t>::max()};
+    const dbus::types::Signature signature{"a{sv}"};
+
+    auto prototype = a_method_call();
+    auto msg = dbus::native::make_message(prototype, i, s, doubles, map, strings, b, i16, u64, signature);
+
+    EXPECT_EQ(prototype->type(), msg->type());
+    EXPECT_EQ(prototype->destination(), msg->destination());
+    EXPECT_EQ(prototype->path(), msg->path());
+    EXPECT_EQ(prototype->interface(), msg->interface());
+    EXPECT_EQ(prototype->member(), msg->member());
+    EXPECT_EQ("isada{s(io)}asbntg", msg->signature());
+
+    std::int32_t i_out; std::string s_out; std::vector<double> doubles_out; std::map<std::string, Entry> map_out;
+    std::vector<std::string> strings_out; bool b_out; std::int16_t i16_out; std::uint64_t u64_out; dbus::types::Signature signature_out;
+
+    auto reader = msg->reader();
+    dbus::decode_message(reader, i_out, s_out, doubles_out, map_out, strings_out, b_out, i16_out, u64_out, signature_out);
+
+    EXPECT_EQ(i, i_out);
+    EXPECT_EQ(s, s_out);
+    EXPECT_EQ(doubles, doubles_out);
+    EXPECT_EQ(map, map_out);
+    EXPECT_EQ(strings, strings_out);
+    EXPECT_EQ(b, b_out);
+    EXPECT_EQ(i16, i16_out);
+    EXPECT_EQ(u64, u64_out);
+    EXPECT_EQ(signature, signature_out);
+}
+
+TEST(NativeMarshaller, MessageWithoutArgumentsHasEmptySignature)
+{
+    auto msg = dbus::native::make_message(a_method_call());
+    EXPECT_EQ("", msg->signature());
+}
+
+TEST(NativeMarshaller, MessageCreationKeepsTypeOfPrototype)
+{
+    auto call = a_method_call();
+    call->ensure_serial_larger_than_zero_for_testing();
+
+    auto reply = dbus::native::make_message(dbus::Message::make_method_return(call), std::string{"reply"});
+    EXPECT_EQ(dbus::Message::Type::method_return, reply->type());
+
+    auto signal = dbus::native::make_message(dbus::Message::make_signal("/a/path", "an.interface", "Signal"), 42);
+    EXPECT_EQ(dbus::Message::Type::signal, signal->type());
+    EXPECT_EQ("Signal", signal->member());
+}
+
+TEST(NativeMarshaller, MessageCreationThrowsForInvalidUtf8)
+{
+    EXPECT_ANY_THROW(dbus::native::make_message(a_method_call(), std::string{"\xff\xfe"}));
+}
+
+TEST(NativeMarshaller, MessageCreationThrowsForNullPrototype)
+{
+    EXPECT_ANY_THROW(dbus::native::make_message(dbus::Message::Ptr{}, 42));
+}
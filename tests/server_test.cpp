@@ -0,0 +1,321 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/server.h>
+
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/bus.h>
+#include <core/dbus/fixture.h>
+#include <core/dbus/object.h>
+#include <core/dbus/service.h>
+#include <core/dbus/signal.h>
+
+#include <core/dbus/interfaces/peer_to_peer.h>
+
+#include "test_data.h"
+
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+struct Peer
+{
+    struct Method
+    {
+        typedef Peer Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s{"Method"};
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::seconds{1};
+        }
+    };
+
+    struct Signals
+    {
+        struct Ping
+        {
+            inline static std::string name()
+            {
+                return "Ping";
+            }
+            typedef Peer Interface;
+            typedef std::int32_t ArgumentType;
+        };
+    };
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace traits
+{
+template<>
+struct Service<Peer>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s{"core.dbus.test.Peer"};
+        return s;
+    }
+};
+}
+}
+}
+
+namespace
+{
+const dbus::types::ObjectPath& the_path()
+{
+    static const dbus::types::ObjectPath path{"/core/dbus/test/Peer"};
+    return path;
+}
+
+// Runs a server in the background, exposing a skeleton on every accepted connection.
+// Both ends live in the same process, so every bus runs on its own io_service.
+struct PeerServer
+{
+    struct Session
+    {
+        ~Session()
+        {
+            bus->stop();
+            worker.join();
+        }
+
+        dbus::Bus::Ptr bus;
+        dbus::Service::Ptr service;
+        dbus::Object::Ptr object;
+        std::thread worker;
+    };
+
+    PeerServer() : server(std::make_shared<dbus::Server>())
+    {
+        server->on_new_connection([this](const dbus::Bus::Ptr& bus)
+        {
+            std::shared_ptr<Session> session{new Session{bus, nullptr, nullptr, std::thread{}}};
+
+            bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+            session->service = dbus::Service::add_service(bus, dbus::traits::Service<Peer>::interface_name());
+            session->object = session->service->add_object_for_path(the_path());
+            session->object->install_method_handler<Peer::Method>([bus](const dbus::Message::Ptr& msg)
+            {
+                auto reply = dbus::Message::make_method_return(msg);
+                reply->writer() << std::int32_t{42};
+                bus->send(reply);
+            });
+            session->worker = std::thread{[bus]() { bus->run(); }};
+
+            std::lock_guard<std::mutex> lg(guard);
+            sessions.push_back(session);
+            accepted.notify_all();
+        });
+
+        worker = std::thread{[this]() { server->run(); }};
+    }
+
+    ~PeerServer()
+    {
+        server->stop();
+        worker.join();
+    }
+
+    std::shared_ptr<Session> wait_for_session()
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        accepted.wait_for(ul, std::chrono::seconds{5}, [this]() { return !sessions.empty(); });
+        return sessions.empty() ? nullptr : sessions.front();
+    }
+
+    dbus::Server::Ptr server;
+    std::thread worker;
+
+    std::mutex guard;
+    std::condition_variable accepted;
+    std::vector<std::shared_ptr<Session>> sessions;
+};
+
+struct Server : public core::dbus::testing::Fixture
+{
+};
+
+auto session_bus_config_file =
+        core::dbus::testing::Fixture::default_session_bus_config_file() =
+        core::testing::session_bus_configuration_file();
+
+auto system_bus_config_file =
+        core::dbus::testing::Fixture::default_system_bus_config_file() =
+        core::testing::system_bus_configuration_file();
+}
+
+TEST_F(Server, ListensOnPrivateAddressByDefault)
+{
+    dbus::Server server;
+    EXPECT_NE(std::string::npos, server.address().find("guid="));
+}
+
+TEST_F(Server, ThrowsForInvalidAddress)
+{
+    EXPECT_ANY_THROW(dbus::Server{"this.is.not.an.address"});
+}
+
+TEST_F(Server, SkeletonServesMethodCallsOfPeerDirectly)
+{
+    PeerServer server;
+
+    auto bus = dbus::Bus::connect_to_peer(server.server->address());
+    EXPECT_TRUE(bus->is_peer_to_peer());
+
+    bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+    std::thread worker{[bus]() { bus->run(); }};
+
+    auto stub = dbus::Service::use_service<Peer>(bus)->object_for_path(the_path());
+    auto result = stub->invoke_method_synchronously<Peer::Method, std::int32_t>();
+
+    EXPECT_FALSE(result.is_error());
+    EXPECT_EQ(42, result.value());
+
+    auto session = server.wait_for_session();
+    ASSERT_NE(nullptr, session);
+    EXPECT_TRUE(session->bus->is_peer_to_peer());
+
+    bus->stop();
+    worker.join();
+}
+
+TEST_F(Server, SignalsReachPeerWithoutMatchRules)
+{
+    PeerServer server;
+
+    auto bus = dbus::Bus::connect_to_peer(server.server->address());
+    bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+    std::thread worker{[bus]() { bus->run(); }};
+
+    auto stub = dbus::Service::use_service<Peer>(bus)->object_for_path(the_path());
+    auto signal = stub->get_signal<Peer::Signals::Ping>();
+
+    std::mutex guard;
+    std::condition_variable received;
+    std::int32_t value{0};
+
+    signal->connect([&](const std::int32_t& v)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        value = v;
+        received.notify_all();
+    });
+
+    // Make sure the connection has been accepted before emitting.
+    stub->invoke_method_synchronously<Peer::Method, std::int32_t>();
+    auto session = server.wait_for_session();
+    ASSERT_NE(nullptr, session);
+
+    session->object->get_signal<Peer::Signals::Ping>()->emit(43);
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        EXPECT_TRUE(received.wait_for(ul, std::chrono::seconds{5}, [&]() { return value == 43; }));
+    }
+
+    bus->stop();
+    worker.join();
+}
+
+TEST_F(Server, PreparedSignalsReachPeer)
+{
+    PeerServer server;
+
+    auto bus = dbus::Bus::connect_to_peer(server.server->address());
+    bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+    std::thread worker{[bus]() { bus->run(); }};
+
+    auto stub = dbus::Service::use_service<Peer>(bus)->object_for_path(the_path());
+    auto signal = stub->get_signal<Peer::Signals::Ping>();
+
+    std::mutex guard;
+    std::condition_variable received;
+    std::vector<std::int32_t> values;
+
+    signal->connect([&](const std::int32_t& v)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        values.push_back(v);
+        received.notify_all();
+    });
+
+    stub->invoke_method_synchronously<Peer::Method, std::int32_t>();
+    auto session = server.wait_for_session();
+    ASSERT_NE(nullptr, session);
+
+    auto emission = session->object->get_signal<Peer::Signals::Ping>()->prepare();
+    for (std::int32_t i = 0; i < 10; i++)
+        emission.emit(i);
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        EXPECT_TRUE(received.wait_for(ul, std::chrono::seconds{5}, [&]() { return values.size() == 10; }));
+    }
+
+    for (std::int32_t i = 0; i < 10; i++)
+        EXPECT_EQ(i, values[i]);
+
+    bus->stop();
+    worker.join();
+}
+
+TEST_F(Server, AddressIsNegotiatedOverTheBus)
+{
+    PeerServer server;
+
+    auto service_bus = session_bus();
+    service_bus->install_executor(dbus::asio::make_executor(service_bus, dbus::asio::ExecutorOptions{}));
+    auto service = dbus::Service::add_service(service_bus, dbus::traits::Service<dbus::interfaces::PeerToPeer>::interface_name());
+    auto object = service->add_object_for_path(the_path());
+    dbus::interfaces::PeerToPeer::announce(service_bus, object, server.server);
+    std::thread service_worker{[service_bus]() { service_bus->run(); }};
+
+    auto client_bus = session_bus();
+    client_bus->install_executor(dbus::asio::make_executor(client_bus, dbus::asio::ExecutorOptions{}));
+    std::thread client_worker{[client_bus]() { client_bus->run(); }};
+
+    EXPECT_FALSE(client_bus->is_peer_to_peer());
+
+    auto proxy = dbus::Service::use_service<dbus::interfaces::PeerToPeer>(client_bus)->object_for_path(the_path());
+    auto address = dbus::interfaces::PeerToPeer::query(proxy);
+
+    EXPECT_EQ(server.server->address(), address);
+    EXPECT_NO_THROW(dbus::Bus::connect_to_peer(address));
+
+    client_bus->stop();
+    client_worker.join();
+    service_bus->stop();
+    service_worker.join();
+}
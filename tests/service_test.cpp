@@ -36,6 +36,7 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <system_error>
 #include <thread>
 
@@ -54,6 +55,44 @@ auto session_bus_config_file =
 auto system_bus_config_file =
         core::dbus::testing::Fixture::default_system_bus_config_file() =
         core::testing::system_bus_configuration_file();
+
+struct Tree
+{
+    struct Depth
+    {
+        typedef Tree Interface;
+
+        inline static const std::string& name()
+        {
+            static const std::string s{"Depth"};
+            return s;
+        }
+
+        inline static const std::chrono::milliseconds default_timeout()
+        {
+            return std::chrono::seconds{1};
+        }
+    };
+};
+}
+
+namespace core
+{
+namespace dbus
+{
+namespace traits
+{
+template<>
+struct Service<Tree>
+{
+    inline static const std::string& interface_name()
+    {
+        static const std::string s{"core.dbus.test.Tree"};
+        return s;
+    }
+};
+}
+}
 }
 
 TEST_F(Service, AccessingAnExistingServiceAndItsObjectsOnTheBusWorks)
@@ -245,6 +284,73 @@ TEST_F(Service, AddingAnExistingServiceThrowsForSpecificFlags)
     ASSERT_ANY_THROW(auto service = dbus::Service::add_service<dbus::DBus>(session_bus(), flags););
 }
 
+TEST_F(Service, SubtreeResolvesObjectsOnDemand)
+{
+    auto service_bus = session_bus();
+    service_bus->install_executor(dbus::asio::make_executor(service_bus, dbus::asio::ExecutorOptions{}));
+    auto service = dbus::Service::add_service(service_bus, dbus::traits::Service<Tree>::interface_name());
+
+    // A single object serves all resolved paths, replying with the depth of the path.
+    auto handler = service->object_for_path(dbus::types::ObjectPath{"/core/dbus/test/Handler"});
+    handler->install_method_handler<Tree::Depth>([service_bus](const dbus::Message::Ptr& msg)
+    {
+        auto reply = dbus::Message::make_method_return(msg);
+        reply->writer() << static_cast<std::int32_t>(msg->path().depth());
+        service_bus->send(reply);
+    });
+
+    const dbus::types::ObjectPath prefix{"/core/dbus/test/Tree"};
+    const dbus::types::ObjectPath missing{"/core/dbus/test/Tree/missing"};
+
+    std::atomic<int> resolved{0};
+    auto subtree = service->add_subtree(prefix, [&](const dbus::types::ObjectPath& path) -> dbus::Object::Ptr
+    {
+        EXPECT_TRUE(path.is_descendant_of(prefix));
+        if (path == missing)
+            return nullptr;
+
+        resolved++;
+        return handler;
+    });
+
+    std::thread service_worker{[service_bus]() { service_bus->run(); }};
+
+    auto client_bus = session_bus();
+    client_bus->install_executor(dbus::asio::make_executor(client_bus, dbus::asio::ExecutorOptions{}));
+    std::thread client_worker{[client_bus]() { client_bus->run(); }};
+
+    auto stub = dbus::Service::use_service<Tree>(client_bus);
+    auto invoke = [&](const std::string& path)
+    {
+        return stub->object_for_path(dbus::types::ObjectPath{path})->invoke_method_synchronously<Tree::Depth, std::int32_t>();
+    };
+
+    auto result = invoke("/core/dbus/test/Tree/a/b");
+    EXPECT_FALSE(result.is_error());
+    EXPECT_EQ(6, result.value());
+
+    result = invoke("/core/dbus/test/Tree/c");
+    EXPECT_FALSE(result.is_error());
+    EXPECT_EQ(5, result.value());
+    EXPECT_EQ(2, resolved.load());
+
+    EXPECT_ANY_THROW(invoke(missing.as_string()));
+    // The object on the prefix itself does not handle the method, unknown methods yield errors.
+    EXPECT_ANY_THROW(invoke(prefix.as_string()));
+    EXPECT_ANY_THROW(invoke("/core/dbus/test/Other"));
+    EXPECT_EQ(2, resolved.load());
+
+    // Destroying the object on the prefix removes the subtree from the bus.
+    subtree.reset();
+    EXPECT_ANY_THROW(invoke("/core/dbus/test/Tree/a/b"));
+    EXPECT_EQ(2, resolved.load());
+
+    client_bus->stop();
+    client_worker.join();
+    service_bus->stop();
+    service_worker.join();
+}
+
 TEST(VoidResult, DefaultConstructionYieldsANonErrorResult)
 {
     dbus::Result<void> result;
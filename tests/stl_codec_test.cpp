@@ -19,14 +19,23 @@
 #include <core/dbus/dbus.h>
 #include <core/dbus/message_streaming_operators.h>
 
+#include <core/dbus/types/array_range.h>
+#include <core/dbus/types/array_view.h>
 #include <core/dbus/types/variant.h>
 
+#include <core/dbus/types/stl/array.h>
+#include <core/dbus/types/stl/deque.h>
 #include <core/dbus/types/stl/map.h>
+#include <core/dbus/types/stl/set.h>
 #include <core/dbus/types/stl/string.h>
 #include <core/dbus/types/stl/tuple.h>
+#include <core/dbus/types/stl/unordered_map.h>
+#include <core/dbus/types/stl/unordered_set.h>
+#include <core/dbus/types/stl/vector.h>
 
 #include <gtest/gtest.h>
 
+#include <list>
 #include <memory>
 
 namespace dbus = core::dbus;
@@ -100,3 +109,207 @@ TEST(CodecForMaps, DictionaryMappingToVariantsIsEncodedAndDecodedCorrectly)
     }
 }
 
+
+TEST(CodecForArrayViews, ElementsAreDecodedWhileIterating)
+{
+    namespace dbus = core::dbus;
+
+    std::vector<std::int32_t> values;
+    for (std::int32_t i = 0; i < 1000; i++)
+        values.push_back(i);
+
+    auto msg = a_method_call();
+    msg->writer() << values << std::string{"trailer"};
+
+    auto reader = msg->reader();
+    std::int32_t expected = 0;
+    for (const auto& value : dbus::decode_argument<dbus::types::ArrayView<std::int32_t>>(reader))
+        EXPECT_EQ(expected++, value);
+
+    EXPECT_EQ(1000, expected);
+    EXPECT_EQ("trailer", dbus::decode_argument<std::string>(reader));
+}
+
+TEST(CodecForArrayViews, VisitingDictionariesStopsEarly)
+{
+    namespace dbus = core::dbus;
+
+    std::map<std::string, std::uint32_t> values{{"a", 0}, {"b", 1}, {"c", 2}, {"d", 3}};
+
+    auto msg = a_method_call();
+    msg->writer() << values << std::string{"trailer"};
+
+    auto reader = msg->reader();
+    std::vector<std::string> keys;
+    auto count = dbus::visit_array<std::pair<std::string, std::uint32_t>>(reader, [&keys](const std::pair<std::string, std::uint32_t>& entry)
+    {
+        keys.push_back(entry.first);
+        EXPECT_EQ(keys.size() - 1, entry.second);
+        return keys.size() < 2;
+    });
+
+    EXPECT_EQ(2u, count);
+    EXPECT_EQ((std::vector<std::string>{"a", "b"}), keys);
+    EXPECT_EQ("trailer", dbus::decode_argument<std::string>(reader));
+
+    auto other_reader = msg->reader();
+    dbus::decode_argument<dbus::types::ArrayView<std::pair<std::string, std::uint32_t>>>(other_reader);
+    EXPECT_ANY_THROW(dbus::decode_argument<dbus::types::ArrayView<std::int32_t>>(other_reader));
+}
+
+TEST(CodecForArrayViews, NestedArraysAreDecodedIntoFreshElements)
+{
+    namespace dbus = core::dbus;
+
+    const std::vector<std::vector<std::string>> strings{{"a", "b"}, {"c"}, {"d", "e", "f"}};
+    const std::vector<std::vector<std::int32_t>> numbers{{1, 2}, {3}, {4, 5, 6}};
+    const std::map<std::string, std::vector<std::uint32_t>> dict{{"a", {1, 2}}, {"b", {3}}};
+
+    auto msg = a_method_call();
+    msg->writer() << strings << numbers << dict;
+
+    auto reader = msg->reader();
+    std::vector<std::vector<std::string>> decoded_strings;
+    for (const auto& value : dbus::decode_argument<dbus::types::ArrayView<std::vector<std::string>>>(reader))
+        decoded_strings.push_back(value);
+    EXPECT_EQ(strings, decoded_strings);
+
+    std::vector<std::vector<std::int32_t>> decoded_numbers;
+    for (const auto& value : dbus::decode_argument<dbus::types::ArrayView<std::vector<std::int32_t>>>(reader))
+        decoded_numbers.push_back(value);
+    EXPECT_EQ(numbers, decoded_numbers);
+
+    std::map<std::string, std::vector<std::uint32_t>> decoded_dict;
+    dbus::visit_array<std::pair<std::string, std::vector<std::uint32_t>>>(reader, [&decoded_dict](const std::pair<std::string, std::vector<std::uint32_t>>& entry)
+    {
+        decoded_dict.insert(entry);
+        return true;
+    });
+    EXPECT_EQ(dict, decoded_dict);
+}
+
+TEST(CodecForArrayRanges, RangesAreEncodedAsArrays)
+{
+    namespace dbus = core::dbus;
+
+    const std::list<std::string> names{"a", "b", "c"};
+    const std::map<std::string, std::uint32_t> dictionary{{"a", 1}, {"b", 2}};
+
+    auto msg = a_method_call();
+    {
+        auto writer = msg->writer();
+        dbus::encode_argument(writer, dbus::types::make_array_range(names));
+        dbus::encode_argument(writer, dbus::types::make_array_range(dictionary.begin(), dictionary.end()));
+    }
+
+    EXPECT_EQ("asa{su}", msg->signature());
+
+    auto reader = msg->reader();
+    EXPECT_EQ((std::vector<std::string>{"a", "b", "c"}), dbus::decode_argument<std::vector<std::string>>(reader));
+    EXPECT_EQ(dictionary, (dbus::decode_argument<std::map<std::string, std::uint32_t>>(reader)));
+}
+
+TEST(CodecForArrayRanges, GeneratedElementsAreEncodedAsArrays)
+{
+    namespace dbus = core::dbus;
+
+    auto msg = a_method_call();
+    msg->writer() << dbus::types::make_generated_array<std::int32_t>([](dbus::types::ArrayYield<std::int32_t>& yield)
+    {
+        for (std::int32_t i = 0; i < 1000; i++)
+            yield(i);
+    });
+
+    EXPECT_EQ("ai", msg->signature());
+
+    std::int32_t expected = 0;
+    auto reader = msg->reader();
+    for (const auto& value : dbus::decode_argument<dbus::types::ArrayView<std::int32_t>>(reader))
+        EXPECT_EQ(expected++, value);
+    EXPECT_EQ(1000, expected);
+}
+
+TEST(CodecForContainers, UnorderedContainersAreEncodedAndDecodedCorrectly)
+{
+    namespace dbus = core::dbus;
+
+    const std::unordered_map<std::string, std::uint32_t> dictionary{{"a", 1}, {"b", 2}, {"c", 3}};
+    const std::unordered_set<std::string> names{"a", "b", "c"};
+
+    auto msg = a_method_call();
+    msg->writer() << dictionary << names;
+
+    EXPECT_EQ("a{su}as", msg->signature());
+
+    auto reader = msg->reader();
+    EXPECT_EQ(dictionary, (dbus::decode_argument<std::unordered_map<std::string, std::uint32_t>>(reader)));
+    EXPECT_EQ(names, dbus::decode_argument<std::unordered_set<std::string>>(reader));
+
+    // Wire-compatible with the ordered counterparts.
+    auto other_reader = msg->reader();
+    EXPECT_EQ((std::map<std::string, std::uint32_t>{{"a", 1}, {"b", 2}, {"c", 3}}),
+              (dbus::decode_argument<std::map<std::string, std::uint32_t>>(other_reader)));
+    EXPECT_EQ((std::set<std::string>{"a", "b", "c"}), dbus::decode_argument<std::set<std::string>>(other_reader));
+}
+
+TEST(CodecForContainers, SetsAndDequesAreEncodedAndDecodedCorrectly)
+{
+    namespace dbus = core::dbus;
+
+    const std::set<std::int32_t> numbers{3, 1, 2};
+    const std::deque<std::string> names{"c", "a", "b"};
+
+    auto msg = a_method_call();
+    msg->writer() << numbers << names;
+
+    EXPECT_EQ("aias", msg->signature());
+
+    auto reader = msg->reader();
+    EXPECT_EQ(numbers, dbus::decode_argument<std::set<std::int32_t>>(reader));
+    EXPECT_EQ(names, dbus::decode_argument<std::deque<std::string>>(reader));
+}
+
+TEST(CodecForContainers, FixedSizeArraysAreEncodedAndDecodedCorrectly)
+{
+    namespace dbus = core::dbus;
+
+    const std::array<std::int64_t, 4> numbers{{-1, 0, 1, 1ll << 40}};
+    const std::array<std::string, 2> names{{"a", "b"}};
+    const std::vector<double> values{0.5, 1.5, 2.5};
+    const std::vector<std::int8_t> empty;
+
+    auto msg = a_method_call();
+    msg->writer() << numbers << names << values << empty;
+
+    EXPECT_EQ("axasaday", msg->signature());
+
+    auto reader = msg->reader();
+    EXPECT_EQ(numbers, (dbus::decode_argument<std::array<std::int64_t, 4>>(reader)));
+    EXPECT_EQ(names, (dbus::decode_argument<std::array<std::string, 2>>(reader)));
+    EXPECT_EQ(values, dbus::decode_argument<std::vector<double>>(reader));
+    EXPECT_EQ(empty, dbus::decode_argument<std::vector<std::int8_t>>(reader));
+
+    auto other_reader = msg->reader();
+    EXPECT_EQ(std::vector<std::int64_t>(numbers.begin(), numbers.end()), dbus::decode_argument<std::vector<std::int64_t>>(other_reader));
+    EXPECT_ANY_THROW((dbus::decode_argument<std::array<std::string, 3>>(other_reader)));
+    EXPECT_ANY_THROW((dbus::decode_argument<std::array<std::int32_t, 3>>(other_reader)));
+}
+
+TEST(CodecForContainers, FlatDictionariesAreEncodedAndDecodedCorrectly)
+{
+    namespace dbus = core::dbus;
+
+    const std::vector<std::pair<std::string, std::uint32_t>> dictionary{{"a", 1}, {"b", 2}, {"c", 3}};
+
+    auto msg = a_method_call();
+    msg->writer() << dictionary;
+
+    EXPECT_EQ("a{su}", msg->signature());
+
+    auto reader = msg->reader();
+    EXPECT_EQ(dictionary, (dbus::decode_argument<std::vector<std::pair<std::string, std::uint32_t>>>(reader)));
+
+    auto other_reader = msg->reader();
+    EXPECT_EQ((std::map<std::string, std::uint32_t>(dictionary.begin(), dictionary.end())),
+              (dbus::decode_argument<std::map<std::string, std::uint32_t>>(other_reader)));
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/stream_channel.h>
+
+#include <core/dbus/asio/executor.h>
+#include <core/dbus/bus.h>
+#include <core/dbus/fixture.h>
+#include <core/dbus/object.h>
+#include <core/dbus/service.h>
+
+#include <core/dbus/interfaces/stream.h>
+
+#include "test_data.h"
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dbus = core::dbus;
+
+namespace
+{
+struct StreamChannel : public core::dbus::testing::Fixture
+{
+};
+
+auto session_bus_config_file =
+        core::dbus::testing::Fixture::default_session_bus_config_file() =
+        core::testing::session_bus_configuration_file();
+
+auto system_bus_config_file =
+        core::dbus::testing::Fixture::default_system_bus_config_file() =
+        core::testing::system_bus_configuration_file();
+
+dbus::StreamChannel::Ptr attach_to(const dbus::StreamChannel::Ptr& channel)
+{
+    return dbus::StreamChannel::attach(
+                dbus::types::UnixFd{::dup(channel->memory().to_int())},
+                dbus::types::UnixFd{::dup(channel->notification().to_int())});
+}
+
+bool write_value(const dbus::StreamChannel::Ptr& channel, std::uint32_t value)
+{
+    return channel->try_write(&value, sizeof(value));
+}
+
+std::vector<std::uint32_t> read_values(const dbus::StreamChannel::Ptr& channel)
+{
+    std::vector<std::uint32_t> values;
+    channel->read([&values](const std::uint8_t* data, std::size_t size)
+    {
+        std::uint32_t value;
+        EXPECT_EQ(sizeof(value), size);
+        std::memcpy(&value, data, sizeof(value));
+        values.push_back(value);
+    });
+    return values;
+}
+}
+
+TEST_F(StreamChannel, CreateThrowsForInvalidCapacity)
+{
+    EXPECT_ANY_THROW(dbus::StreamChannel::create(0));
+    EXPECT_ANY_THROW(dbus::StreamChannel::create(8));
+    EXPECT_ANY_THROW(dbus::StreamChannel::create(1025));
+    EXPECT_NO_THROW(dbus::StreamChannel::create(1024));
+}
+
+TEST_F(StreamChannel, AttachThrowsForFdNotReferringToAChannel)
+{
+    EXPECT_ANY_THROW(dbus::StreamChannel::attach(
+                         dbus::types::UnixFd{::eventfd(0, EFD_CLOEXEC)},
+                         dbus::types::UnixFd{::eventfd(0, EFD_CLOEXEC)}));
+
+    auto buffer = ::memfd_create("not-a-channel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    ASSERT_EQ(0, ::ftruncate(buffer, 4096));
+    ASSERT_EQ(0, ::fcntl(buffer, F_ADD_SEALS, F_SEAL_SHRINK));
+
+    EXPECT_ANY_THROW(dbus::StreamChannel::attach(
+                         dbus::types::UnixFd{buffer},
+                         dbus::types::UnixFd{::eventfd(0, EFD_CLOEXEC)}));
+}
+
+TEST_F(StreamChannel, AttachedChannelReadsRecordsWrittenByCreator)
+{
+    auto producer = dbus::StreamChannel::create(1024);
+    auto consumer = attach_to(producer);
+
+    EXPECT_EQ(producer->capacity(), consumer->capacity());
+
+    const std::string record{"a record in shared memory"};
+    EXPECT_TRUE(producer->try_write(record.data(), record.size()));
+    EXPECT_TRUE(producer->try_write(nullptr, 0));
+
+    std::vector<std::string> records;
+    EXPECT_EQ(2u, consumer->read([&records](const std::uint8_t* data, std::size_t size)
+    {
+        records.emplace_back(reinterpret_cast<const char*>(data), size);
+    }));
+
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(record, records[0]);
+    EXPECT_EQ(std::string{}, records[1]);
+
+    EXPECT_EQ(0u, consumer->read([](const std::uint8_t*, std::size_t) { FAIL(); }));
+}
+
+TEST_F(StreamChannel, ReadStopsAfterMaxRecords)
+{
+    auto producer = dbus::StreamChannel::create(1024);
+    auto consumer = attach_to(producer);
+
+    for (std::uint32_t i = 0; i < 5; i++)
+        EXPECT_TRUE(write_value(producer, i));
+
+    EXPECT_EQ(2u, consumer->read([](const std::uint8_t*, std::size_t) {}, 2));
+    EXPECT_EQ(3u, read_values(consumer).size());
+}
+
+TEST_F(StreamChannel, RecordsWrapAroundTheEndOfTheRing)
+{
+    auto producer = dbus::StreamChannel::create(64);
+    auto consumer = attach_to(producer);
+
+    // Every record occupies 8 bytes, a 20 byte record does not fit the remainder after 7 of them.
+    std::uint32_t expected = 0;
+    for (std::uint32_t round = 0; round < 100; round++)
+    {
+        for (int i = 0; i < 3; i++)
+            EXPECT_TRUE(write_value(producer, round * 3 + i));
+
+        std::uint8_t large[20] = {0};
+        EXPECT_TRUE(producer->try_write(large, sizeof(large)));
+
+        std::size_t count = 0;
+        consumer->read([&](const std::uint8_t* data, std::size_t size)
+        {
+            if (count++ == 3)
+            {
+                EXPECT_EQ(sizeof(large), size);
+                return;
+            }
+
+            std::uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            EXPECT_EQ(expected++, value);
+        });
+        EXPECT_EQ(4u, count);
+    }
+}
+
+TEST_F(StreamChannel, WriteThrowsForRecordsExceedingHalfOfTheCapacity)
+{
+    auto producer = dbus::StreamChannel::create(64);
+    std::uint8_t record[32] = {0};
+
+    EXPECT_NO_THROW(producer->try_write(record, 28));
+    EXPECT_ANY_THROW(producer->try_write(record, sizeof(record)));
+}
+
+TEST_F(StreamChannel, FullRingRequestsResumeOnceConsumerMadeRoom)
+{
+    auto producer = dbus::StreamChannel::create(64);
+    auto consumer = attach_to(producer);
+
+    for (std::uint32_t i = 0; i < 8; i++)
+        EXPECT_TRUE(write_value(producer, i));
+
+    EXPECT_FALSE(consumer->take_resume_request());
+    EXPECT_FALSE(write_value(producer, 8));
+
+    EXPECT_EQ(8u, read_values(consumer).size());
+    EXPECT_TRUE(consumer->take_resume_request());
+    EXPECT_FALSE(consumer->take_resume_request());
+
+    EXPECT_TRUE(write_value(producer, 8));
+    auto values = read_values(consumer);
+    ASSERT_EQ(1u, values.size());
+    EXPECT_EQ(8u, values[0]);
+}
+
+TEST_F(StreamChannel, ReadOnDeliversRecordsFromWithinTheLoopOfTheBus)
+{
+    auto bus = session_bus();
+    bus->install_executor(dbus::asio::make_executor(bus, dbus::asio::ExecutorOptions{}));
+    std::thread worker{[bus]() { bus->run(); }};
+
+    auto producer = dbus::StreamChannel::create(4096);
+    auto consumer = attach_to(producer);
+
+    const std::uint32_t count = 10000;
+
+    std::mutex guard;
+    std::condition_variable changed;
+    std::uint32_t received = 0;
+    bool resume = false;
+
+    const auto producer_thread = std::this_thread::get_id();
+
+    auto handle = consumer->read_on(bus, [&](const std::uint8_t* data, std::size_t)
+    {
+        EXPECT_NE(producer_thread, std::this_thread::get_id());
+
+        std::uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+
+        std::lock_guard<std::mutex> lg(guard);
+        EXPECT_EQ(received++, value);
+        changed.notify_all();
+    }, [&]()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        resume = true;
+        changed.notify_all();
+    });
+
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        while (!write_value(producer, i))
+        {
+            std::unique_lock<std::mutex> ul(guard);
+            ASSERT_TRUE(changed.wait_for(ul, std::chrono::seconds{5}, [&]() { return resume; }));
+            resume = false;
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        EXPECT_TRUE(changed.wait_for(ul, std::chrono::seconds{5}, [&]() { return received == count; }));
+    }
+
+    handle.reset();
+
+    bus->stop();
+    worker.join();
+}
+
+TEST_F(StreamChannel, ChannelIsNegotiatedOverTheBus)
+{
+    auto service_bus = session_bus();
+    service_bus->install_executor(dbus::asio::make_executor(service_bus, dbus::asio::ExecutorOptions{}));
+    std::thread service_worker{[service_bus]() { service_bus->run(); }};
+
+    auto client_bus = session_bus();
+    client_bus->install_executor(dbus::asio::make_executor(client_bus, dbus::asio::ExecutorOptions{}));
+    std::thread client_worker{[client_bus]() { client_bus->run(); }};
+
+    const dbus::types::ObjectPath path{"/core/dbus/test/Stream"};
+
+    std::mutex guard;
+    std::condition_variable changed;
+    std::uint32_t received = 0;
+    bool resume = false;
+
+    auto producer = dbus::StreamChannel::create(256);
+    auto service = dbus::Service::add_service(
+                service_bus,
+                dbus::traits::Service<dbus::interfaces::Stream>::interface_name());
+    auto skeleton = service->add_object_for_path(path);
+    dbus::interfaces::Stream::expose(service_bus, skeleton, producer, [&]()
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        resume = true;
+        changed.notify_all();
+    });
+
+    auto stub = dbus::Service::use_service<dbus::interfaces::Stream>(client_bus)->object_for_path(path);
+    auto consumer = dbus::interfaces::Stream::open(stub);
+    EXPECT_EQ(producer->capacity(), consumer->capacity());
+
+    auto handle = dbus::interfaces::Stream::read(client_bus, stub, consumer, [&](const std::uint8_t*, std::size_t)
+    {
+        std::lock_guard<std::mutex> lg(guard);
+        received++;
+        changed.notify_all();
+    });
+
+    const std::uint32_t count = 1000;
+    for (std::uint32_t i = 0; i < count; i++)
+    {
+        while (!write_value(producer, i))
+        {
+            std::unique_lock<std::mutex> ul(guard);
+            ASSERT_TRUE(changed.wait_for(ul, std::chrono::seconds{5}, [&]() { return resume; }));
+            resume = false;
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> ul(guard);
+        EXPECT_TRUE(changed.wait_for(ul, std::chrono::seconds{5}, [&]() { return received == count; }));
+    }
+
+    handle.reset();
+
+    client_bus->stop();
+    service_bus->stop();
+    client_worker.join();
+    service_worker.join();
+}
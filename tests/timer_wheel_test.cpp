@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/timer_wheel.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+typedef core::dbus::impl::TimerWheel TimerWheel;
+
+struct TestTimer : public TimerWheel::Timer
+{
+    TimerWheel::Tick fired_at = TimerWheel::never;
+};
+
+// Advances the wheel to t, recording the tick each timer fired at.
+void advance(TimerWheel& wheel, TimerWheel::Tick t)
+{
+    wheel.advance(t, [&wheel](TimerWheel::Timer* timer)
+    {
+        static_cast<TestTimer*>(timer)->fired_at = wheel.now() - 1;
+    });
+}
+}
+
+TEST(TimerWheel, EmptyWheelHasNoNextEvent)
+{
+    TimerWheel wheel;
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_TRUE(TimerWheel::never == wheel.next_event());
+}
+
+TEST(TimerWheel, TimersExpireExactlyAtTheirDeadlineAcrossAllLevels)
+{
+    const std::vector<TimerWheel::Tick> deadlines
+    {
+        0, 1, 255, 256, 257, 1000, 25000, 65535, 65536, 70000, 16777215, 16777216, 20000000
+    };
+
+    TimerWheel wheel{42};
+    std::vector<TestTimer> timers(deadlines.size());
+
+    for (std::size_t i = 0; i < deadlines.size(); i++)
+        wheel.schedule(&timers[i], 42 + deadlines[i]);
+
+    EXPECT_EQ(deadlines.size(), wheel.size());
+
+    for (std::size_t i = 0; i < deadlines.size(); i++)
+    {
+        // Nothing fires before the deadline ...
+        if (deadlines[i] > 0)
+        {
+            advance(wheel, 42 + deadlines[i] - 1);
+            EXPECT_TRUE(timers[i].is_scheduled());
+        }
+        // ... and everything at it.
+        advance(wheel, 42 + deadlines[i]);
+        EXPECT_FALSE(timers[i].is_scheduled());
+        EXPECT_EQ(42 + deadlines[i], timers[i].fired_at);
+    }
+
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, NextEventNeverExceedsEarliestDeadline)
+{
+    TimerWheel wheel{1000};
+    TestTimer t1, t2;
+
+    wheel.schedule(&t1, 1000 + 30000);
+    EXPECT_LE(wheel.next_event(), t1.expiry());
+    EXPECT_GT(wheel.next_event(), wheel.now());
+
+    wheel.schedule(&t2, 1000 + 10);
+    EXPECT_EQ(t2.expiry(), wheel.next_event());
+}
+
+TEST(TimerWheel, CancelledTimersDoNotExpire)
+{
+    TimerWheel wheel;
+    TestTimer t1, t2;
+
+    wheel.schedule(&t1, 100);
+    wheel.schedule(&t2, 100000);
+    wheel.cancel(&t1);
+    wheel.cancel(&t2);
+
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_FALSE(t1.is_scheduled());
+
+    advance(wheel, 200000);
+    EXPECT_TRUE(TimerWheel::never == t1.fired_at);
+    EXPECT_TRUE(TimerWheel::never == t2.fired_at);
+}
+
+TEST(TimerWheel, ReschedulingMovesTimer)
+{
+    TimerWheel wheel;
+    TestTimer t;
+
+    wheel.schedule(&t, 100);
+    wheel.schedule(&t, 5000);
+    EXPECT_EQ(1u, wheel.size());
+
+    advance(wheel, 4999);
+    EXPECT_TRUE(t.is_scheduled());
+    advance(wheel, 5000);
+    EXPECT_EQ(5000u, t.fired_at);
+}
+
+TEST(TimerWheel, DeadlinesInThePastExpireWithNextAdvance)
+{
+    TimerWheel wheel{1000};
+    TestTimer t;
+
+    wheel.schedule(&t, 10);
+    EXPECT_EQ(1000u, t.expiry());
+    advance(wheel, 1000);
+    EXPECT_EQ(1000u, t.fired_at);
+}
+
+TEST(TimerWheel, CallbacksMayCancelAndScheduleTimers)
+{
+    TimerWheel wheel;
+    TestTimer t1, t2, t3;
+
+    wheel.schedule(&t1, 10);
+    wheel.schedule(&t2, 10);
+
+    std::vector<TimerWheel::Timer*> fired;
+    wheel.advance(10, [&](TimerWheel::Timer* timer)
+    {
+        fired.push_back(timer);
+        // Whichever timer fires first cancels the other one and schedules a third.
+        wheel.cancel(timer == &t1 ? &t2 : &t1);
+        wheel.schedule(&t3, 10);
+    });
+
+    // t3 has been scheduled for a tick that has already been processed.
+    EXPECT_EQ(1u, fired.size());
+    EXPECT_TRUE(t3.is_scheduled());
+    EXPECT_EQ(11u, t3.expiry());
+
+    fired.clear();
+    wheel.advance(11, [&](TimerWheel::Timer* timer) { fired.push_back(timer); });
+    ASSERT_EQ(1u, fired.size());
+    EXPECT_EQ(&t3, fired.front());
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, RandomizedScheduleCancelAndAdvanceMatchesReference)
+{
+    static const std::size_t timer_count = 2000;
+
+    std::mt19937 rng{42};
+    std::uniform_int_distribution<TimerWheel::Tick> delay{0, 200000};
+    std::uniform_int_distribution<TimerWheel::Tick> step{0, 3000};
+    std::uniform_int_distribution<int> action{0, 9};
+    std::uniform_int_distribution<std::size_t> pick{0, timer_count - 1};
+
+    TimerWheel wheel;
+    std::vector<TestTimer> timers(timer_count);
+    std::multimap<TimerWheel::Tick, std::size_t> reference;
+    std::vector<TimerWheel::Tick> expected(timer_count, TimerWheel::never);
+
+    auto cancel_in_reference = [&](std::size_t i)
+    {
+        auto range = reference.equal_range(expected[i]);
+        for (auto it = range.first; it != range.second; ++it)
+            if (it->second == i)
+            {
+                reference.erase(it);
+                break;
+            }
+        expected[i] = TimerWheel::never;
+    };
+
+    TimerWheel::Tick now = 0;
+    for (unsigned int round = 0; round < 2000; round++)
+    {
+        auto i = pick(rng);
+        switch (action(rng))
+        {
+        case 0:
+        case 1:
+            wheel.cancel(&timers[i]);
+            cancel_in_reference(i);
+            break;
+        default:
+            cancel_in_reference(i);
+            expected[i] = wheel.now() + delay(rng);
+            reference.insert(std::make_pair(expected[i], i));
+            wheel.schedule(&timers[i], expected[i]);
+            break;
+        }
+
+        now += step(rng);
+
+        std::vector<std::pair<TimerWheel::Tick, std::size_t>> fired;
+        wheel.advance(now, [&](TimerWheel::Timer* timer)
+        {
+            fired.push_back(std::make_pair(wheel.now() - 1, static_cast<TestTimer*>(timer) - timers.data()));
+        });
+
+        std::vector<std::pair<TimerWheel::Tick, std::size_t>> due;
+        while (!reference.empty() && reference.begin()->first <= now)
+        {
+            due.push_back(*reference.begin());
+            expected[reference.begin()->second] = TimerWheel::never;
+            reference.erase(reference.begin());
+        }
+
+        std::sort(fired.begin(), fired.end());
+        std::sort(due.begin(), due.end());
+        ASSERT_EQ(due, fired);
+        ASSERT_EQ(reference.size(), wheel.size());
+    }
+}
@@ -16,10 +16,25 @@
  * Authored by: Thomas Voß <thomas.voss@canonical.com>
  */
 
+#include <core/dbus/message.h>
+
 #include <core/dbus/types/object_path.h>
+#include <core/dbus/types/shared_buffer.h>
 
 #include <gtest/gtest.h>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 TEST(ObjectPath, comparison_for_equality_yields_correct_result)
 {
     core::dbus::types::ObjectPath op1{"/does/not/exist"};
@@ -35,3 +50,202 @@ TEST(ObjectPath, comparison_for_inequality_yields_correct_result)
 
     EXPECT_TRUE(op2 != op1);
 }
+
+TEST(ObjectPath, instances_for_the_same_path_share_an_atom)
+{
+    core::dbus::types::ObjectPath op1{"/org/freedesktop/interned"};
+    core::dbus::types::ObjectPath op2{std::string{"/org/freedesktop/"} + "interned"};
+
+    EXPECT_EQ(op1, op2);
+    EXPECT_EQ(op1.id(), op2.id());
+    EXPECT_EQ(std::hash<std::string>{}(op1.as_string()), op1.hash());
+    EXPECT_EQ(op1.hash(), std::hash<core::dbus::types::ObjectPath>{}(op2));
+    EXPECT_NE(op1.id(), core::dbus::types::ObjectPath{"/org/freedesktop"}.id());
+}
+
+TEST(ObjectPath, invalid_paths_are_rejected)
+{
+    EXPECT_THROW(core::dbus::types::ObjectPath{""}, core::dbus::types::ObjectPath::Errors::InvalidObjectPathStringRepresentation);
+    EXPECT_THROW(core::dbus::types::ObjectPath{"/trailing/"}, core::dbus::types::ObjectPath::Errors::InvalidObjectPathStringRepresentation);
+    EXPECT_THROW(core::dbus::types::ObjectPath{"/double//slash"}, core::dbus::types::ObjectPath::Errors::InvalidObjectPathStringRepresentation);
+    EXPECT_THROW(core::dbus::types::ObjectPath{"relative"}, core::dbus::types::ObjectPath::Errors::InvalidObjectPathStringRepresentation);
+}
+
+TEST(ObjectPath, parents_and_namespaces_are_resolved_via_atoms)
+{
+    core::dbus::types::ObjectPath root;
+    core::dbus::types::ObjectPath a{"/a"};
+    core::dbus::types::ObjectPath abc{"/a/b/c"};
+    core::dbus::types::ObjectPath ab2{"/a/b2"};
+
+    EXPECT_EQ(0u, root.depth());
+    EXPECT_EQ(root, root.parent());
+    EXPECT_EQ(3u, abc.depth());
+    EXPECT_EQ(core::dbus::types::ObjectPath{"/a/b"}, abc.parent());
+    EXPECT_EQ(a, abc.parent().parent());
+    EXPECT_EQ(root, a.parent());
+
+    EXPECT_TRUE(abc.is_descendant_of(a));
+    EXPECT_TRUE(abc.is_descendant_of(root));
+    EXPECT_FALSE(a.is_descendant_of(a));
+    EXPECT_FALSE(a.is_descendant_of(abc));
+    EXPECT_FALSE(abc.is_descendant_of(ab2));
+    // A string prefix, but not a parent.
+    EXPECT_FALSE(ab2.is_in_namespace(core::dbus::types::ObjectPath{"/a/b"}));
+
+    EXPECT_TRUE(a.is_in_namespace(a));
+    EXPECT_TRUE(abc.is_in_namespace(a));
+    EXPECT_TRUE(a.is_in_namespace(root));
+    EXPECT_FALSE(root.is_in_namespace(a));
+}
+
+TEST(ObjectPath, ordering_follows_the_string_representation)
+{
+    std::set<core::dbus::types::ObjectPath> paths
+    {
+        core::dbus::types::ObjectPath{"/c"},
+        core::dbus::types::ObjectPath{"/a/b"},
+        core::dbus::types::ObjectPath{"/b"},
+        core::dbus::types::ObjectPath{"/a"}
+    };
+
+    std::vector<std::string> ordered;
+    for (const auto& path : paths)
+        ordered.push_back(path.as_string());
+
+    EXPECT_EQ((std::vector<std::string>{"/a", "/a/b", "/b", "/c"}), ordered);
+}
+
+TEST(ObjectPath, concurrently_interned_paths_are_consistent)
+{
+    static constexpr unsigned int thread_count = 8;
+    static constexpr unsigned int path_count = 200;
+
+    std::vector<std::vector<core::dbus::types::ObjectPath>> interned(thread_count);
+    std::vector<std::thread> threads;
+
+    for (unsigned int t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([t, &interned]()
+        {
+            for (unsigned int round = 0; round < 20; round++)
+            {
+                interned[t].clear();
+                for (unsigned int i = 0; i < path_count; i++)
+                    interned[t].emplace_back("/concurrent/" + std::to_string(i % 10) + "/" + std::to_string(i));
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    for (unsigned int t = 1; t < thread_count; t++)
+        EXPECT_EQ(interned[0], interned[t]);
+
+    for (unsigned int i = 0; i < path_count; i++)
+    {
+        EXPECT_EQ("/concurrent/" + std::to_string(i % 10) + "/" + std::to_string(i), interned[0][i].as_string());
+        EXPECT_EQ(interned[0][i].parent().as_string(), "/concurrent/" + std::to_string(i % 10));
+    }
+}
+
+TEST(ObjectPath, released_paths_can_be_interned_again)
+{
+    std::uint64_t id;
+    {
+        core::dbus::types::ObjectPath op{"/released/path"};
+        id = op.id();
+    }
+
+    core::dbus::types::ObjectPath op{"/released/path"};
+    EXPECT_EQ("/released/path", op.as_string());
+    EXPECT_NE(id, op.id());
+}
+
+TEST(ObjectPath, moves_take_over_the_atom)
+{
+    static_assert(std::is_nothrow_copy_constructible<core::dbus::types::ObjectPath>::value, "");
+    static_assert(std::is_nothrow_move_constructible<core::dbus::types::ObjectPath>::value, "");
+    static_assert(std::is_nothrow_move_assignable<core::dbus::types::ObjectPath>::value, "");
+
+    core::dbus::types::ObjectPath a{"/moved/a"};
+    const auto id = a.id();
+
+    core::dbus::types::ObjectPath b{std::move(a)};
+    EXPECT_EQ(id, b.id());
+    EXPECT_EQ(core::dbus::types::ObjectPath{}, a);
+
+    core::dbus::types::ObjectPath c{"/moved/c"};
+    c = std::move(b);
+    EXPECT_EQ(id, c.id());
+    EXPECT_EQ("/moved/c", b.as_string());
+}
+
+TEST(SharedBuffer, default_constructed_instance_is_invalid)
+{
+    core::dbus::types::SharedBuffer buffer;
+
+    EXPECT_FALSE(buffer.is_valid());
+    EXPECT_EQ(nullptr, buffer.data());
+    EXPECT_EQ(0u, buffer.size());
+}
+
+TEST(SharedBuffer, copy_holds_contents_and_is_sealed)
+{
+    std::vector<std::uint8_t> payload(3 * 1024 * 1024);
+    std::iota(payload.begin(), payload.end(), 0);
+
+    auto buffer = core::dbus::types::SharedBuffer::copy_of(payload.data(), payload.size());
+
+    ASSERT_TRUE(buffer.is_valid());
+    ASSERT_EQ(payload.size(), buffer.size());
+    EXPECT_EQ(0, std::memcmp(payload.data(), buffer.data(), payload.size()));
+
+    EXPECT_EQ(-1, ::ftruncate(buffer.fd().to_int(), 0));
+    EXPECT_EQ(MAP_FAILED, ::mmap(nullptr, buffer.size(), PROT_WRITE, MAP_SHARED, buffer.fd().to_int(), 0));
+}
+
+TEST(SharedBuffer, empty_buffers_are_supported)
+{
+    auto buffer = core::dbus::types::SharedBuffer::copy_of(nullptr, 0);
+
+    EXPECT_TRUE(buffer.is_valid());
+    EXPECT_EQ(0u, buffer.size());
+}
+
+TEST(SharedBuffer, rejects_fds_that_are_not_sealed)
+{
+    int fds[2];
+    ASSERT_EQ(0, ::pipe(fds));
+    ::close(fds[1]);
+
+    EXPECT_ANY_THROW(core::dbus::types::SharedBuffer::from_fd(core::dbus::types::UnixFd{fds[0]}));
+}
+
+TEST(SharedBuffer, round_trips_through_a_message_as_unix_fd)
+{
+    std::vector<std::uint8_t> payload(64 * 1024, 42);
+    auto buffer = core::dbus::types::SharedBuffer::copy_of(payload.data(), payload.size());
+
+    auto msg = core::dbus::Message::make_method_call(
+                "org.freedesktop.DBus",
+                core::dbus::types::ObjectPath("/org/freedesktop/DBus"),
+                "org.freedesktop.DBus",
+                "ListNames");
+    {
+        auto writer = msg->writer();
+        core::dbus::encode_argument(writer, buffer);
+    }
+
+    EXPECT_EQ("h", msg->signature());
+
+    core::dbus::types::SharedBuffer received;
+    auto reader = msg->reader();
+    core::dbus::decode_argument(reader, received);
+
+    ASSERT_TRUE(received.is_valid());
+    EXPECT_NE(buffer.fd().to_int(), received.fd().to_int());
+    ASSERT_EQ(payload.size(), received.size());
+    EXPECT_EQ(0, std::memcmp(payload.data(), received.data(), payload.size()));
+}
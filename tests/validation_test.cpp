@@ -0,0 +1,159 @@
+/*
+ * Copyright © 2013 Canonical Ltd.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 3,
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authored by: Thomas Voß <thomas.voss@canonical.com>
+ */
+
+#include <core/dbus/validation.h>
+
+#include <core/dbus/types/object_path.h>
+#include <core/dbus/types/signature.h>
+
+#include <dbus/dbus.h>
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace validation = core::dbus::validation;
+
+namespace
+{
+std::vector<validation::Isa> supported_isas()
+{
+    std::vector<validation::Isa> result;
+    for (auto isa : {validation::Isa::scalar, validation::Isa::sse2, validation::Isa::avx2})
+        if (validation::is_supported(isa))
+            result.push_back(isa);
+
+    return result;
+}
+
+// Strings of up to 100 bytes, such that vectors are processed in full and in part.
+std::vector<std::string> strings_with(const std::string& infix, char filler)
+{
+    std::vector<std::string> result;
+    for (std::size_t size = 0; size <= 100; size++)
+        for (std::size_t pos = 0; pos <= size; pos++)
+            result.push_back(std::string(pos, filler) + infix + std::string(size - pos, filler));
+
+    return result;
+}
+
+// Random strings drawn from the given characters, reproducible across runs.
+std::vector<std::string> random_strings(const std::string& alphabet, std::size_t count, std::size_t max_size)
+{
+    std::mt19937 rng{42};
+    std::vector<std::string> result;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        std::string s(rng() % (max_size + 1), ' ');
+        for (auto& c : s)
+            c = alphabet[rng() % alphabet.size()];
+        result.push_back(s);
+    }
+
+    return result;
+}
+}
+
+TEST(Validation, Utf8MatchesLibdbusForAllImplementations)
+{
+    std::vector<std::string> inputs;
+    for (std::string infix : {"\xc3\xa4", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\xef\xbf\xbf",
+                              "\xc0\x80", "\xc3", "\xe2\x82", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\x80", "\xff"})
+    {
+        auto strings = strings_with(infix, 'a');
+        inputs.insert(inputs.end(), strings.begin(), strings.end());
+    }
+
+    auto strings = random_strings("ab\x80\xbf\xc3\xe2\xed\xf0\xf4\xff", 20000, 80);
+    inputs.insert(inputs.end(), strings.begin(), strings.end());
+
+    for (auto isa : supported_isas())
+        for (const auto& s : inputs)
+            EXPECT_EQ(dbus_validate_utf8(s.c_str(), nullptr) == TRUE,
+                      validation::is_valid_utf8(isa, s.data(), s.size())) << static_cast<int>(isa) << ": " << s;
+}
+
+TEST(Validation, Utf8RejectsNullBytes)
+{
+    for (auto isa : supported_isas())
+        for (const auto& s : strings_with(std::string(1, '\0'), 'a'))
+            EXPECT_FALSE(validation::is_valid_utf8(isa, s.data(), s.size()));
+}
+
+TEST(Validation, ObjectPathMatchesLibdbusForAllImplementations)
+{
+    std::vector<std::string> inputs{"", "/", "//", "a", "/a/", "/a//b"};
+    for (std::string infix : {"-", "//", ".", "\xc3\xa4", "/"})
+    {
+        for (const auto& s : strings_with(infix, 'a'))
+        {
+            inputs.push_back("/" + s);
+            inputs.push_back(s);
+        }
+    }
+
+    for (std::string s : random_strings("aZ09_/-", 20000, 80))
+        inputs.push_back("/" + s);
+
+    for (auto isa : supported_isas())
+        for (const auto& s : inputs)
+            EXPECT_EQ(dbus_validate_path(s.c_str(), nullptr) == TRUE,
+                      validation::is_valid_object_path(isa, s.data(), s.size())) << static_cast<int>(isa) << ": " << s;
+}
+
+TEST(Validation, SignatureMatchesLibdbus)
+{
+    std::vector<std::string> inputs
+    {
+        "", "i", "ai", "a", "aa", "a{sv}", "{sv}", "a{vs}", "a{s}", "a{sss}", "()", "(i)", "(i", "i)",
+        "a(i)", "a{s(ii)}", "a{sa{sv}}", "aai", "(a)", "a)", "a}", "r", "e", "m", "a{sv}(ia{ss})",
+        std::string(32, 'a') + "i", std::string(33, 'a') + "i",
+        std::string(32, '(') + "i" + std::string(32, ')'), std::string(33, '(') + "i" + std::string(33, ')'),
+        std::string(256, 'i')
+    };
+
+    auto strings = random_strings("aisv(){}", 50000, 12);
+    inputs.insert(inputs.end(), strings.begin(), strings.end());
+
+    for (const auto& s : inputs)
+    {
+        EXPECT_EQ(dbus_signature_validate(s.c_str(), nullptr) == TRUE,
+                  validation::is_valid_signature(s)) << s;
+        EXPECT_EQ(dbus_signature_validate_single(("a" + s).c_str(), nullptr) == TRUE,
+                  validation::is_valid_element_signature(s)) << s;
+    }
+}
+
+TEST(Validation, ObjectPathsAndSignaturesAreValidatedOnConstruction)
+{
+    namespace types = core::dbus::types;
+
+    EXPECT_NO_THROW(types::ObjectPath{"/org/freedesktop/DBus"});
+    EXPECT_THROW(types::ObjectPath{"/org/freedesktop/"}, types::ObjectPath::Errors::InvalidObjectPathStringRepresentation);
+    EXPECT_THROW(types::ObjectPath(std::string("/org\0/a", 7)), types::ObjectPath::Errors::InvalidObjectPathStringRepresentation);
+
+    EXPECT_NO_THROW(types::Signature{});
+    EXPECT_NO_THROW(types::Signature{"a{sv}"});
+    // Describes the elements of a dictionary.
+    EXPECT_NO_THROW(types::Signature{"{sv}"});
+    EXPECT_THROW(types::Signature{"a{sv"}, types::Signature::Errors::InvalidSignatureStringRepresentation);
+    EXPECT_THROW(types::Signature{"{sv}{sv}"}, types::Signature::Errors::InvalidSignatureStringRepresentation);
+}